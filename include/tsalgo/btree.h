@@ -0,0 +1,185 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * B+ Tree
+ * ========================================================================
+ * An ordered container with the same interface and callbacks
+ * as the AVL tree (tsalgo/tree.h), but with fat nodes.
+ * A node holds up to TS_ALGO_BTREE_INNER separators and kids (inner nodes)
+ * or up to TS_ALGO_BTREE_LEAF contents (leaves) in contiguous arrays
+ * and is sized and aligned to TS_ALGO_BTREE_NODESZ bytes
+ * (a small number of cache lines). The content is stored in the leaves,
+ * which are linked in order; inner nodes hold pointers to contents
+ * in the leaves as separators.
+ *
+ * A lookup, hence, loads one node per level of a much lower tree
+ * (log_16(n) instead of log_2(n) levels) and searches it binarily.
+ * Since the compare method works on the content, the number of
+ * contents visited (and compared) is about the same as with
+ * the AVL tree; what is saved are the node loads.
+ * ========================================================================
+ */
+#ifndef ts_algo_btree_decl
+#define ts_algo_btree_decl
+
+#include <tsalgo/types.h>
+#include <tsalgo/list.h>
+#include <tsalgo/tree.h>
+
+/* ------------------------------------------------------------------------
+ * Size of a node in bytes
+ * ------------------------------------------------------------------------
+ */
+#define TS_ALGO_BTREE_NODESZ 256
+
+/* ------------------------------------------------------------------------
+ * Separators per inner node (which has one kid more)
+ * and contents per leaf
+ * ------------------------------------------------------------------------
+ */
+#define TS_ALGO_BTREE_INNER ((TS_ALGO_BTREE_NODESZ-16)/(2*sizeof(void*)))
+#define TS_ALGO_BTREE_LEAF  ((TS_ALGO_BTREE_NODESZ-24)/sizeof(void*))
+
+/* ------------------------------------------------------------------------
+ * A node in a B+ tree
+ * ------------------------------------------------------------------------
+ */
+typedef struct ts_algo_btree_node_st {
+	uint16_t                       n;  /* separators or contents */
+	uint16_t                    leaf;  /* is this a leaf?        */
+	union {
+		struct {
+			void *keys[TS_ALGO_BTREE_INNER];    /* separators */
+			struct ts_algo_btree_node_st
+			     *kids[TS_ALGO_BTREE_INNER+1];  /* kids       */
+		} in;
+		struct {
+			struct ts_algo_btree_node_st *prv;  /* left leaf  */
+			struct ts_algo_btree_node_st *nxt;  /* right leaf */
+			void *cont[TS_ALGO_BTREE_LEAF];     /* contents   */
+		} lf;
+	} u;
+} ts_algo_btree_node_t;
+
+/* ------------------------------------------------------------------------
+ * Head node of a B+ tree
+ * ------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_btree_node_t   *root;  /* the root node            */
+	ts_algo_btree_node_t  *first;  /* the leftmost leaf        */
+	uint32_t               count;  /* how many contents        */
+	uint32_t              height;  /* levels (0: empty)        */
+	void                    *rsc;  /* user resource            */
+	ts_algo_comprsc_t    compare;  /* comparison method        */
+	ts_algo_show_t          show;  /* show method              */
+	ts_algo_update_t    onUpdate;  /* on update                */
+	ts_algo_delete_t    onDelete;  /* on delete                */
+	ts_algo_delete_t   onDestroy;  /* on destroy               */
+} ts_algo_btree_t;
+
+/* ------------------------------------------------------------------------
+ * Allocate a new B+ tree and initialise it
+ * (for the parameters see ts_algo_tree_new).
+ * ------------------------------------------------------------------------
+ */
+ts_algo_btree_t *ts_algo_btree_new(ts_algo_comprsc_t compare,
+                                   ts_algo_show_t    show,
+                                   ts_algo_update_t  onUpdate,
+                                   ts_algo_delete_t  onDelete,
+                                   ts_algo_delete_t  onDestroy);
+
+/* ------------------------------------------------------------------------
+ * Initialise an already allocated B+ tree
+ * (for the parameters see ts_algo_tree_init).
+ * The compare, onUpdate, onDelete and onDestroy methods
+ * receive the B+ tree as first parameter.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_init(ts_algo_btree_t  *tree,
+                                ts_algo_comprsc_t compare,
+                                ts_algo_show_t    show,
+                                ts_algo_update_t  onUpdate,
+                                ts_algo_delete_t  onDelete,
+                                ts_algo_delete_t  onDestroy);
+
+/* ------------------------------------------------------------------------
+ * Destroy everything within a tree.
+ * On each content, the onDestroy method is called;
+ * the nodes are freed.
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_btree_destroy(ts_algo_btree_t *tree);
+
+/* ------------------------------------------------------------------------
+ * Insert a new content
+ *
+ * The position of the content is determined by the compare method.
+ * If the key does already exists, onUpdate is called.
+ * Returns TS_ALGO_NO_MEM if a node could not be allocated.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_insert(ts_algo_btree_t *tree, void *cont);
+
+/* ------------------------------------------------------------------------
+ * Find a content in the tree using the compare method.
+ * If the content exists, it is returned.
+ * Otherwise, NULL is returned.
+ * ------------------------------------------------------------------------
+ */
+void *ts_algo_btree_find(ts_algo_btree_t *tree, void *cont);
+
+/* ------------------------------------------------------------------------
+ * Delete a content
+ *
+ * Delete the content equal to 'cont' using the compare method
+ * for finding it. When the content is removed from the tree,
+ * the onDelete method is called on it.
+ * If the content is not in the tree, delete has no effect.
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_btree_delete(ts_algo_btree_t *tree, void *cont);
+
+/* ------------------------------------------------------------------------
+ * Height of the tree (number of levels)
+ * ------------------------------------------------------------------------
+ */
+int ts_algo_btree_height(ts_algo_btree_t *tree);
+
+/* ------------------------------------------------------------------------
+ * Check the structure of the tree:
+ * - all leaves are on the same level and linked in order,
+ * - all nodes but the root are at least half full,
+ * - the contents are ordered and the separators separate them.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_btree_check(ts_algo_btree_t *tree);
+
+/* ------------------------------------------------------------------------
+ * Show the contents of the tree in order using the show method.
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_btree_show(ts_algo_btree_t *tree);
+
+/* ------------------------------------------------------------------------
+ * Tree to list (see ts_algo_tree_toList)
+ * ------------------------------------------------------------------------
+ */
+ts_algo_list_t *ts_algo_btree_toList(ts_algo_btree_t *tree);
+
+/* ------------------------------------------------------------------------
+ * Map (see ts_algo_tree_map); the contents are visited in order.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_map(ts_algo_btree_t   *tree,
+                               ts_algo_mapper_t mapper);
+
+/* ------------------------------------------------------------------------
+ * Reduce (see ts_algo_tree_reduce); the contents are visited in order.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_reduce(ts_algo_btree_t     *tree,
+                                  void           *aggregate,
+                                  ts_algo_reducer_t reducer);
+
+#endif
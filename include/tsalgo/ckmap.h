@@ -0,0 +1,228 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Cuckoo Map Datatype
+ * A thread-safe hashmap for read-mostly workloads
+ * with lock-free readers.
+ *
+ * The map uses bucketized cuckoo hashing: every key has two candidate
+ * buckets of TS_ALGO_CKMAP_WAYS slots each; a lookup inspects
+ * at most these two buckets. When both are full, an add moves
+ * entries along a path of alternative buckets ("cuckoo path")
+ * to make room; when there is no such path, the table is doubled.
+ *
+ * The buckets are protected by TS_ALGO_CKMAP_STRIPES version counters
+ * (bucket b belongs to stripe b % TS_ALGO_CKMAP_STRIPES).
+ * A writer locks the stripes of the buckets it changes by making
+ * their versions odd and unlocks them by making them even again.
+ * Readers take no lock: they read the versions of the two buckets,
+ * search the buckets and read the versions again; if a version
+ * was odd or has changed, they retry ("optimistic" or "seqlock" reading).
+ * Readers, hence, do not write shared memory and do not contend
+ * with each other; they are only held up by writers operating
+ * on the same stripes and by doubling the table.
+ * Finding a cuckoo path and doubling the table are serialised
+ * by a mutex.
+ *
+ * Since readers may still be reading an entry (or a table)
+ * that a writer has just removed, removed entries and old tables
+ * are not freed immediately, but put on a "retire" list.
+ * The application releases them by calling ts_algo_ckmap_reclaim
+ * at a moment when no reader is inside ts_algo_ckmap_get
+ * (e.g. after all reader threads have passed a barrier).
+ *
+ * As with ts_algo_cmap_t, the map protects its own structure,
+ * not the data stored in it.
+ * The implementation uses the GCC atomic builtins.
+ * ========================================================================
+ */
+#ifndef ts_algo_ckmap_decl
+#define ts_algo_ckmap_decl
+
+#include <tsalgo/types.h>
+#include <tsalgo/map.h>
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/* -------------------------------------------------------------------------
+ * Slots per bucket
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_CKMAP_WAYS 4
+
+/* -------------------------------------------------------------------------
+ * Number of version counters (power of 2)
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_CKMAP_STRIPES 1024
+
+/* -------------------------------------------------------------------------
+ * An entry: the slot (as in ts_algo_map_t) and the key
+ * -------------------------------------------------------------------------
+ */
+typedef struct ts_algo_ckmap_entry_st {
+  ts_algo_map_slot_t slot; // key, key size, hash and data
+  struct ts_algo_ckmap_entry_st *nxt; // Next on the retire list
+  char              key[]; // The key
+} ts_algo_ckmap_entry_t;
+
+/* -------------------------------------------------------------------------
+ * A bucket
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  ts_algo_ckmap_entry_t *e[TS_ALGO_CKMAP_WAYS];
+} ts_algo_ckmap_bucket_t;
+
+/* -------------------------------------------------------------------------
+ * A table of buckets
+ * -------------------------------------------------------------------------
+ */
+typedef struct ts_algo_ckmap_table_st {
+  uint32_t      nbkt; // Number of buckets (power of 2)
+  struct ts_algo_ckmap_table_st *nxt; // Next on the retire list
+  ts_algo_ckmap_bucket_t *bkts; // The buckets
+} ts_algo_ckmap_table_t;
+
+/* -------------------------------------------------------------------------
+ * The map structure
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  ts_algo_hash_t   hsh; // Hash function defined by the application
+  void            *rsc; // Resource passed to the hash function (e.g. a seed)
+  ts_algo_delete_t del; // Function to delete data defined by the application
+  uint32_t       count; // Number of elements in the map
+  uint32_t        *ver; // Version counters of the stripes
+  ts_algo_ckmap_table_t *tab; // The current table
+  pthread_mutex_t grow; // Serialises cuckoo paths and doubling
+  pthread_mutex_t  rtl; // Protects the retire lists
+  ts_algo_ckmap_entry_t *rentries; // Retired entries
+  ts_algo_ckmap_table_t *rtables;  // Retired tables
+} ts_algo_ckmap_t;
+
+/* -------------------------------------------------------------------------
+ * Allocate a new map;
+ * for parameters, please refer to ts_algo_ckmap_init.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_ckmap_t *ts_algo_ckmap_new(uint32_t            sz,
+                                   ts_algo_hash_t     hsh,
+                                   ts_algo_delete_t   del);
+
+/* -------------------------------------------------------------------------
+ * Initialise an already allocated map; the parameters are
+ * - map: The map to initialise
+ * - sz : The number of elements expected (0 for a default)
+ * - hsh: The hash function; if hsh is NULL, ts_algo_hash_bytes
+ *        is used. The two buckets of a key are derived from
+ *        the low and the high 32 bits of the hash,
+ *        so the hash function must distribute well in both.
+ * - del: The function used to free the application data
+ *        (see ts_algo_map_init).
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_ckmap_init(ts_algo_ckmap_t   *map,
+                                uint32_t            sz,
+                                ts_algo_hash_t     hsh,
+                                ts_algo_delete_t   del);
+
+/* -------------------------------------------------------------------------
+ * Destroy the map when not needed anymore.
+ * If a 'del' function was supplied it will applied to all data
+ * in the map. No other thread may use the map anymore.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_ckmap_destroy(ts_algo_ckmap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Add a key value pair to the map.
+ * Different from ts_algo_map_add, this function checks
+ * if the key is already in the map and, in that case,
+ * returns TS_ALGO_INVALID.
+ * The table is doubled only when it is filled by half;
+ * if the key finds no room in a table with less entries
+ * (the hash is degenerate), TS_ALGO_ERR is returned.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_ckmap_add(ts_algo_ckmap_t *map, char *key, size_t ksz,
+                                                              void *data);
+
+/* -------------------------------------------------------------------------
+ * Obtain the data stored with the key (lock-free).
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_ckmap_get(ts_algo_ckmap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and returns them to the application.
+ * The data are not destroyed! The entry is retired (see above).
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_ckmap_remove(ts_algo_ckmap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and, if 'del' is not NULL,
+ * calls this function on the data.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_ckmap_delete(ts_algo_ckmap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Replaces the data stored with the key by the data passed in
+ * (see ts_algo_map_update).
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_ckmap_update(ts_algo_ckmap_t *map, char *key, size_t ksz,
+                                                            void *data);
+
+/* -------------------------------------------------------------------------
+ * Free the retired entries and tables.
+ * This function must not be called while another thread
+ * is in ts_algo_ckmap_get or while the slots passed to forEach
+ * are still in use.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_ckmap_reclaim(ts_algo_ckmap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Number of elements in the map.
+ * -------------------------------------------------------------------------
+ */
+uint32_t ts_algo_ckmap_count(ts_algo_ckmap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all slots in the map passing 'rsc' as
+ * additional resource (see ts_algo_map_forEach).
+ * Cuckoo paths and doubling are blocked during the visit,
+ * so every entry is visited once; entries added or removed
+ * concurrently may or may not be visited. Readers are not blocked.
+ * The callback must not change the map and must not change the slot.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_ckmap_forEach(ts_algo_ckmap_t     *map,
+                                   ts_algo_map_visit_t  fun,
+                                   void                *rsc);
+
+/* -------------------------------------------------------------------------
+ * Convenience interfaces for uint64_t keys
+ * (see ts_algo_map_addId etc.)
+ * -------------------------------------------------------------------------
+ */
+#define ts_algo_ckmap_addId(m,k,d) \
+	ts_algo_ckmap_add(m, (char*)&k, sizeof(uint64_t), d)
+
+#define ts_algo_ckmap_getId(m,k) \
+	ts_algo_ckmap_get(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_ckmap_removeId(m,k) \
+	ts_algo_ckmap_remove(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_ckmap_deleteId(m,k) \
+	ts_algo_ckmap_delete(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_ckmap_updateId(m,k,d) \
+	ts_algo_ckmap_update(m, (char*)&k, sizeof(uint64_t), d)
+
+#endif
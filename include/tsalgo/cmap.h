@@ -0,0 +1,180 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Concurrent Map Datatype
+ * A thread-safe hashmap composed of a number of shards.
+ * Each shard is an ordinary ts_algo_map_t protected by its own
+ * reader-writer lock. The shard of a key is selected by the high bits
+ * of its hash, the bucket within the shard by the low bits
+ * (hash modulo the size of the shard's buffer).
+ * Threads working on keys in different shards, hence, do not contend
+ * and readers of the same shard do not block each other.
+ * Each shard grows independently of the others, so a resize
+ * blocks only the threads operating on the shard being resized.
+ *
+ * Since the shard is selected by the high bits, the hash function
+ * must distribute well in the high bits as well as in the low bits.
+ * ts_algo_hash_id, in particular, is a poor choice;
+ * the hashes in tsalgo/hash.h are good ones.
+ *
+ * Note that the map protects its own structure, not the data
+ * stored in it: the pointer returned by ts_algo_cmap_get
+ * may be removed and deleted by another thread at any time.
+ * The application must manage the life cycle of shared data itself
+ * (e.g. by not passing a 'del' function and by reference counting).
+ * ========================================================================
+ */
+#ifndef ts_algo_cmap_decl
+#define ts_algo_cmap_decl
+
+#include <tsalgo/types.h>
+#include <tsalgo/map.h>
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/* -------------------------------------------------------------------------
+ * A shard: a map and its lock,
+ * aligned to a cache line to avoid false sharing between shards
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  pthread_rwlock_t lock; // Protects the map
+  ts_algo_map_t     map; // The map
+#ifdef __GNUC__
+} __attribute__((aligned(64))) ts_algo_cmap_shard_t;
+#else
+} ts_algo_cmap_shard_t;
+#endif
+
+/* -------------------------------------------------------------------------
+ * The concurrent map structure
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  uint32_t      nshards; // Number of shards (power of 2)
+  uint32_t        shift; // Right shift of the hash to obtain the shard
+  ts_algo_hash_t    hsh; // Hash function defined by the application
+  void             *rsc; // Resource passed to the hash function (e.g. a seed)
+  ts_algo_cmap_shard_t *shards; // The shards
+} ts_algo_cmap_t;
+
+/* -------------------------------------------------------------------------
+ * Allocate a new concurrent map;
+ * for parameters, please refer to ts_algo_cmap_init.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_cmap_t *ts_algo_cmap_new(uint32_t nshards,
+                                 uint32_t      sz,
+                                 ts_algo_hash_t   hsh,
+                                 ts_algo_delete_t del,
+                                 uint32_t        mode);
+
+/* -------------------------------------------------------------------------
+ * Initialise an already allocated concurrent map; the parameters are
+ * - map    : The map to initialise
+ * - nshards: The number of shards; it is rounded up to the next
+ *            power of 2. If nshards is 0, the number of shards
+ *            is derived from the number of processors online.
+ * - sz     : The base size of each shard (see ts_algo_map_init)
+ * - hsh    : The hash function; if hsh is NULL, ts_algo_hash_bytes
+ *            is used. 'rsc' is passed to the hash function
+ *            as for ts_algo_map_t.
+ * - del    : The function used to free the application data
+ *            (see ts_algo_map_init).
+ * - mode   : The mode of the shards (see ts_algo_map_initMode).
+ *            Note that in TS_ALGO_MAP_INCREMENTAL and
+ *            TS_ALGO_MAP_STATS mode get modifies the shard and,
+ *            therefore, needs the exclusive lock;
+ *            readers then block each other.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_cmap_init(ts_algo_cmap_t *map,
+                               uint32_t    nshards,
+                               uint32_t         sz,
+                               ts_algo_hash_t   hsh,
+                               ts_algo_delete_t del,
+                               uint32_t        mode);
+
+/* -------------------------------------------------------------------------
+ * Destroy the map when not needed anymore.
+ * No other thread may access the map concurrently.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_cmap_destroy(ts_algo_cmap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Add a key value pair to the map;
+ * for parameters, please refer to ts_algo_map_add.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_cmap_add(ts_algo_cmap_t *map, char *key, size_t ksz, void *data);
+
+/* -------------------------------------------------------------------------
+ * Obtain the data stored with the key.
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_cmap_get(ts_algo_cmap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and returns them to the application.
+ * The data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_cmap_remove(ts_algo_cmap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and, if 'del' is not NULL,
+ * calls this function on the data.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_cmap_delete(ts_algo_cmap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Replaces the data stored with the key by the data passed in.
+ * If the key was found, the old data are returned, otherwise NULL is returned
+ * and no changes are perfomed. The old data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_cmap_update(ts_algo_cmap_t *map, char *key, size_t ksz, void *data);
+
+/* -------------------------------------------------------------------------
+ * Number of elements in the map. Since the shards are counted
+ * one after the other, the result is only a snapshot
+ * if other threads are modifying the map.
+ * -------------------------------------------------------------------------
+ */
+uint32_t ts_algo_cmap_count(ts_algo_cmap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all slots in the map passing 'rsc' as
+ * additional resource (see ts_algo_map_forEach).
+ * The shards are visited one after the other; while a shard is visited,
+ * it is locked exclusively. The callback, hence, shall not access
+ * the map.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_cmap_forEach(ts_algo_cmap_t      *map,
+                                  ts_algo_map_visit_t  fun,
+                                  void                *rsc);
+
+/* -------------------------------------------------------------------------
+ * Convenience interfaces for uint64_t keys.
+ * -------------------------------------------------------------------------
+ */
+#define ts_algo_cmap_addId(m,k,d) \
+	ts_algo_cmap_add(m, (char*)&k, sizeof(uint64_t), d)
+
+#define ts_algo_cmap_getId(m,k) \
+	ts_algo_cmap_get(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_cmap_removeId(m,k) \
+	ts_algo_cmap_remove(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_cmap_deleteId(m,k) \
+	ts_algo_cmap_delete(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_cmap_updateId(m,k,d) \
+	ts_algo_cmap_update(m, (char*)&k, sizeof(uint64_t), d)
+
+#endif
@@ -0,0 +1,172 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The File Map Datatype
+ * A read-only map stored in a file, which is mapped into memory
+ * with mmap. The file is written once from a ts_algo_map_t and
+ * can then be opened by any process without deserialisation:
+ * ts_algo_fmap_get reads the keys and values directly from the
+ * mapped pages; opening a file costs only the page faults
+ * for the parts of the file actually touched.
+ *
+ * The file uses the perfect hash of ts_algo_pmap_t and
+ * contains only offsets, no pointers (it is position-independent):
+ * - the header (ts_algo_fmap_head_t)
+ * - the displacements (one uint32_t per bucket)
+ * - the records (key and value, each padded to 8 bytes)
+ * - the slots (ts_algo_fmap_slot_t), one per key
+ * Integers are stored in the byte order of the machine
+ * that wrote the file; files from machines with
+ * a different byte order are rejected.
+ * ========================================================================
+ */
+#ifndef ts_algo_fmap_decl
+#define ts_algo_fmap_decl
+
+#include <tsalgo/types.h>
+#include <tsalgo/map.h>
+#include <tsalgo/pmap.h>
+
+#include <stdlib.h>
+
+/* -------------------------------------------------------------------------
+ * File format version
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_FMAP_MAGIC   "TSFMAP\0\0"
+#define TS_ALGO_FMAP_VERSION 1
+
+/* -------------------------------------------------------------------------
+ * File header
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+	char     magic[8]; // TS_ALGO_FMAP_MAGIC
+	uint32_t  version; // TS_ALGO_FMAP_VERSION
+	uint32_t    order; // 0x01020304 in the byte order of the writer
+	uint32_t    count; // Number of keys
+	uint32_t     nbkt; // Number of buckets
+	uint64_t     seed; // Seed of the perfect hash
+	uint64_t     disp; // Offset of the displacements
+	uint64_t    slots; // Offset of the slots
+	uint64_t     size; // Size of the file
+} ts_algo_fmap_head_t;
+
+/* -------------------------------------------------------------------------
+ * Slot in the file
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+	uint64_t hash; // The hash of the key
+	uint64_t  off; // Offset of the key; the value follows the padded key
+	uint32_t  ksz; // Size of the key
+	uint32_t  vsz; // Size of the value
+} ts_algo_fmap_slot_t;
+
+/* -------------------------------------------------------------------------
+ * The map structure
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+	int               fd; // The file descriptor
+	size_t          size; // Size of the file (and the mapping)
+	const char     *base; // Start of the mapping
+	const ts_algo_fmap_head_t *head; // The header
+	const uint32_t *disp; // The displacements
+	const ts_algo_fmap_slot_t *slots; // The slots
+} ts_algo_fmap_t;
+
+/* -------------------------------------------------------------------------
+ * Callback to obtain the value to be stored for the data in the map.
+ * The first parameter is the resource passed to ts_algo_fmap_write,
+ * the second are the data. The callback shall set 'val' to the bytes
+ * to be stored and 'vsz' to their size. The bytes are written
+ * before the callback is called again.
+ * -------------------------------------------------------------------------
+ */
+typedef ts_algo_rc_t (*ts_algo_fmap_value_t)(void*,void*,char**,size_t*);
+
+/* -------------------------------------------------------------------------
+ * Visitor callback for ts_algo_fmap_forEach. It receives
+ * the resource, the key, the key size, the value and the value size.
+ * -------------------------------------------------------------------------
+ */
+typedef ts_algo_rc_t (*ts_algo_fmap_visit_t)(void*,const char*,size_t,
+                                             const char*,size_t);
+
+/* -------------------------------------------------------------------------
+ * Write a map into a file; parameters:
+ * - map : The map to store
+ * - path: The file; it is written under a temporary name
+ *         and renamed to 'path' when complete.
+ * - val : Callback to obtain the value of the data in the map.
+ *         If NULL, the data pointers themselves are stored
+ *         (as 8 bytes), which is useful for data that are
+ *         integers cast to pointers.
+ * - rsc : Resource passed to 'val'
+ * The map must not contain the same key twice (TS_ALGO_INVALID).
+ * Only the hashes and the layout of the perfect hash are kept
+ * in memory; keys and values are streamed from the map into the file.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_fmap_write(ts_algo_map_t       *map,
+                                const char         *path,
+                                ts_algo_fmap_value_t val,
+                                void                *rsc);
+
+/* -------------------------------------------------------------------------
+ * Allocate a new map and open the file;
+ * for parameters, please refer to ts_algo_fmap_open.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_fmap_t *ts_algo_fmap_new(const char *path);
+
+/* -------------------------------------------------------------------------
+ * Open the file 'path' and map it into memory.
+ * Only the header is checked (TS_ALGO_INVALID); the slots are checked
+ * when they are used by ts_algo_fmap_get and ts_algo_fmap_forEach.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_fmap_open(ts_algo_fmap_t *map, const char *path);
+
+/* -------------------------------------------------------------------------
+ * Unmap and close the file.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_fmap_close(ts_algo_fmap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Number of keys in the map.
+ * -------------------------------------------------------------------------
+ */
+#define ts_algo_fmap_count(m) ((m)->head->count)
+
+/* -------------------------------------------------------------------------
+ * Obtain the value stored with the key and its size (vsz).
+ * The value points into the mapped file; it is valid
+ * until the map is closed and must not be changed.
+ * NULL is returned if the key is not in the map
+ * or if its record is not within the file (the file is corrupted).
+ * -------------------------------------------------------------------------
+ */
+const char *ts_algo_fmap_get(ts_algo_fmap_t *map, char *key, size_t ksz,
+                                                         size_t *vsz);
+
+/* -------------------------------------------------------------------------
+ * Convenience interface for uint64_t keys.
+ * -------------------------------------------------------------------------
+ */
+#define ts_algo_fmap_getId(m,k,s) \
+	ts_algo_fmap_get(m, (char*)&k, sizeof(uint64_t), s)
+
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all keys and values in the map passing 'rsc' as
+ * additional resource. If the record of a slot is not within
+ * the file, the visit stops with TS_ALGO_INVALID.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_fmap_forEach(ts_algo_fmap_t       *map,
+                                  ts_algo_fmap_visit_t  fun,
+                                  void                 *rsc);
+
+#endif
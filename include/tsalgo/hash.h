@@ -0,0 +1,77 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * Hash Functions
+ * ========================================================================
+ * Provides fast, well-distributed 64bit hash functions for use
+ * with the hashmaps of this library:
+ * - ts_algo_hash_bytes for byte keys of arbitrary length;
+ * - ts_algo_hash_u32 and ts_algo_hash_u64 for keys
+ *   of exactly 4 and 8 bytes respectively.
+ *
+ * All functions accept a seed passed in through the resource parameter
+ * of ts_algo_hash_t: if the resource is not NULL, it is interpreted as
+ * a pointer to a uint64_t seed; otherwise the seed is 0.
+ * Seeding the hash with a random value protects hash tables
+ * against hash flooding, i.e. against keys that were chosen
+ * to collide on purpose.
+ *
+ * For long keys, ts_algo_hash_bytes processes 64 bytes at a time
+ * in 8 independent lanes; on platforms with SSE2, the lanes are
+ * processed with vector instructions. The result does not depend on
+ * whether the vectorised path is used or not (the vectorised path can be
+ * disabled by defining TS_ALGO_NO_SIMD when compiling the library).
+ * It does, however, depend on the byte order of the platform.
+ * These hashes, hence, are not intended for persistent data
+ * shared between platforms or between releases of the library.
+ *
+ * The design follows the ideas of wyhash (by Wang Yi) for short keys
+ * and XXH3 (by Yann Collet) for long keys.
+ * ========================================================================
+ */
+#ifndef ts_algo_hash_decl
+#define ts_algo_hash_decl
+
+#include <tsalgo/types.h>
+#include <stdlib.h>
+
+/* -------------------------------------------------------------------------
+ * Type of a hash function that, provided a byte buffer, returns a 64bit key.
+ * The third parameter is intended for additional resources needed by the
+ * concrete hash function.
+ * -------------------------------------------------------------------------
+ */
+typedef uint64_t (*ts_algo_hash_t)(const char*,size_t,void*);
+
+/* -------------------------------------------------------------------------
+ * Hash for byte keys of arbitrary length.
+ * If key is NULL, ksz is treated as 0.
+ * 'seed' is NULL or a pointer to a uint64_t.
+ * -------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_bytes(const char *key, size_t ksz, void *seed);
+
+/* -------------------------------------------------------------------------
+ * Hash for keys of exactly 4 bytes (e.g. uint32_t).
+ * For keys of any other size, ts_algo_hash_bytes is used.
+ * 'seed' is NULL or a pointer to a uint64_t.
+ * -------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_u32(const char *key, size_t ksz, void *seed);
+
+/* -------------------------------------------------------------------------
+ * Hash for keys of exactly 8 bytes (e.g. uint64_t).
+ * For keys of any other size, ts_algo_hash_bytes is used.
+ * 'seed' is NULL or a pointer to a uint64_t.
+ * -------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_u64(const char *key, size_t ksz, void *seed);
+
+/* -------------------------------------------------------------------------
+ * The mixer used in ts_algo_hash_u64 applied directly to a number.
+ * It is a bijection on uint64_t for every seed.
+ * -------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_mix64(uint64_t x, uint64_t seed);
+
+#endif
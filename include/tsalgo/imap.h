@@ -0,0 +1,199 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Integer Map Datatype
+ * A hashmap specialised for uint64_t keys.
+ * Different from ts_algo_map_t and ts_algo_oamap_t, keys are not
+ * copied into separately allocated memory, but stored in the slot
+ * together with the data, the hash is not computed by a callback,
+ * but by the built-in mixer ts_algo_hash_mix64, and keys are compared
+ * as integers.
+ *
+ * Like ts_algo_oamap_t, the slots are stored in one flat buffer and
+ * collisions are resolved by linear probing with the Robin Hood strategy.
+ * The probe distance of each slot is kept in a separate array of bytes
+ * (0 meaning "empty"), so that no key value needs to be reserved
+ * for empty slots and the distance need not be recomputed from the hash.
+ * ========================================================================
+ */
+#ifndef ts_algo_imap_decl
+#define ts_algo_imap_decl
+
+#include <tsalgo/types.h>
+#include <tsalgo/list.h>
+#include <tsalgo/hash.h>
+
+#include <stdlib.h>
+
+/* -------------------------------------------------------------------------
+ * Slot Structure
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+	uint64_t  key; // The key
+	void    *data; // The data stored under the key
+} ts_algo_imap_slot_t;
+
+/* -------------------------------------------------------------------------
+ * The map structure
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  uint32_t    baseSize; // Base size defined by the application (power of 2)
+  uint32_t     curSize; // Current size (always a power of 2)
+  uint32_t       count; // Number of elements in the map
+  uint32_t        maxd; // Greatest probe distance since the last resize
+  uint64_t        seed; // Seed for the hash (0 by default)
+  ts_algo_delete_t del; // Function to delete data defined by the application
+  uint8_t       *dist; // Probe distance + 1 per slot (0: empty)
+  ts_algo_imap_slot_t *buf; // Flat buffer of slots
+} ts_algo_imap_t;
+
+/* -------------------------------------------------------------------------
+ * Map Iterator
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  ts_algo_imap_t *map; // The map over which to iterate
+  uint32_t       slot; // Current slot in the buffer
+  uint32_t      count; // Number of the element we will see next
+} ts_algo_imap_it_t;
+
+/* -------------------------------------------------------------------------
+ * Visitor callback for ts_algo_imap_forEach
+ * (see ts_algo_map_visit_t).
+ * -------------------------------------------------------------------------
+ */
+typedef ts_algo_rc_t (*ts_algo_imap_visit_t)(void*,ts_algo_imap_slot_t*);
+
+/* -------------------------------------------------------------------------
+ * Allocate a new map; for parameters, please refer to ts_algo_imap_init.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_imap_t *ts_algo_imap_new(uint32_t sz, ts_algo_delete_t del);
+
+/* -------------------------------------------------------------------------
+ * Initialise an already allocated map; the parameters are
+ * - map: The map to initialise
+ * - sz : The base size of the map buffer, if sz is 0, the buffer will be
+ *        initialised to a default. The size is rounded up to
+ *        the next power of 2. The buffer is doubled in size
+ *        when it is filled by 7/8.
+ * - del: The function used to free the memory of the application data
+ *        when deleted or when the map is destroyed.
+ *        If the map shall not free that memory, the application shall
+ *        pass NULL.
+ * The field 'seed' is initialised to 0; it may be set by the application
+ * before the first element is added.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_imap_init(ts_algo_imap_t  *map,
+                               uint32_t          sz,
+                               ts_algo_delete_t del);
+
+/* -------------------------------------------------------------------------
+ * Destroy the map when not needed anymore.
+ * If a 'del' function was supplied it will applied to all data
+ * in the map.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_imap_destroy(ts_algo_imap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Add a key value pair to the map. As ts_algo_map_add,
+ * this function does not check if the key is already in the map.
+ * If one key is added again and again (more than 200 times or so),
+ * TS_ALGO_ERR is returned and the map remains unchanged.
+ * The same happens for many distinct keys sharing one home position
+ * while the map is filled by less than half (the buffer is not resized).
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_imap_add(ts_algo_imap_t *map, uint64_t key, void *data);
+
+/* -------------------------------------------------------------------------
+ * Obtain the data stored with the key.
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_imap_get(ts_algo_imap_t *map, uint64_t key);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and returns them to the application.
+ * The data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_imap_remove(ts_algo_imap_t *map, uint64_t key);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and, if 'del' is not NULL,
+ * calls this function on the data.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_imap_delete(ts_algo_imap_t *map, uint64_t key);
+
+/* -------------------------------------------------------------------------
+ * Replaces the data stored with the key by the data passed in.
+ * If the key was found, the old data are returned, otherwise NULL is returned
+ * and no changes are perfomed. The old data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_imap_update(ts_algo_imap_t *map, uint64_t key, void *data);
+
+/* -------------------------------------------------------------------------
+ * Create an iterator for the map.
+ * The iterator is used exactly like the iterator of ts_algo_map_t.
+ * Note that the slots returned by ts_algo_imap_it_get
+ * point into the buffer of the map; they are invalidated
+ * by any add or remove on the map.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_imap_it_t *ts_algo_imap_iterate(ts_algo_imap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Advance the iterator.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_imap_it_advance(ts_algo_imap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Check if the iterator reached the end of the map.
+ * -------------------------------------------------------------------------
+ */
+char ts_algo_imap_it_eof(ts_algo_imap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Rewind the iterator.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_imap_it_rewind(ts_algo_imap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Get the current slot.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_imap_slot_t *ts_algo_imap_it_get(ts_algo_imap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all slots in the map passing 'rsc' as
+ * additional resource (see ts_algo_map_forEach).
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_imap_forEach(ts_algo_imap_t       *map,
+                                  ts_algo_imap_visit_t  fun,
+                                  void                 *rsc);
+
+/* -------------------------------------------------------------------------
+ * Convert map to list. The list contains pointers to the slots
+ * in the buffer of the map. The list is invalidated
+ * by any add or remove on the map.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_list_t *ts_algo_imap_toList(ts_algo_imap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Debug function that shows the probe distance of every slot
+ * (-1 for empty slots).
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_imap_showslots(ts_algo_imap_t *map);
+
+#endif
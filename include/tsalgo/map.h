@@ -12,6 +12,7 @@
  * Such a hash would be a poor choice where persistency is needed.
  * The library provides an "identity" hash intended for applications
  * where the key can be represented as an unsigend 64bit integer.
+ * General purpose hashes are provided in tsalgo/hash.h.
  * ========================================================================
  */
 #ifndef ts_algo_map_decl
@@ -19,17 +20,11 @@
 
 #include <tsalgo/types.h>
 #include <tsalgo/list.h>
+#include <tsalgo/slab.h>
+#include <tsalgo/hash.h>
 
 #include <stdlib.h>
 
-/* -------------------------------------------------------------------------
- * Type of a hash function that, provided a byte buffer, returns a 64bit key.
- * The third parameter is intended for additional resources needed by the
- * concrete hash function.
- * -------------------------------------------------------------------------
- */
-typedef uint64_t (*ts_algo_hash_t)(const char*,size_t,void*);
-
 /* -------------------------------------------------------------------------
  * The id "hash" that, provided a byte buffer representing an integer,
  * returns a 64bit key that corresponds to the bytes in the buffer
@@ -45,6 +40,93 @@ typedef uint64_t (*ts_algo_hash_t)(const char*,size_t,void*);
  */
 uint64_t ts_algo_hash_id(const char *key, size_t ksz, void *ignore);
 
+/* -------------------------------------------------------------------------
+ * Map modes (may be combined with '|'):
+ * - TS_ALGO_MAP_DEFAULT: every entry consists of three allocations
+ *                        (the list node, the slot and the key)
+ * - TS_ALGO_MAP_SLAB   : list node, slot and key are packed into
+ *                        one entry, which is obtained from slabs
+ *                        owned by the map. Entries with big keys
+ *                        (> TS_ALGO_MAP_SLABKEY bytes) are allocated
+ *                        individually as one block.
+ *                        Adding and removing does not call malloc/free
+ *                        in steady state and destroying the map
+ *                        releases the slabs at once.
+ * - TS_ALGO_MAP_INCREMENTAL: when the map outgrows its buffer,
+ *                        the new buffer is allocated, but the entries
+ *                        are not moved at once. Instead, each add, get,
+ *                        remove and update moves the entries of
+ *                        TS_ALGO_MAP_MIGRATE buckets from the old
+ *                        to the new buffer. The worst-case latency of add
+ *                        thus does not depend on the number of entries.
+ *                        Note that, in this mode, get and update
+ *                        modify the internal structure of the map.
+ *                        Creating an iterator or converting the map
+ *                        to a list completes an ongoing migration.
+ * - TS_ALGO_MAP_SHRINK : when, after removing entries, there is
+ *                        less than one entry per 8 buckets,
+ *                        the buffer is shrunk to a quarter of its size
+ *                        (but not below the base size).
+ *                        Combined with TS_ALGO_MAP_INCREMENTAL,
+ *                        the entries are moved incrementally.
+ * - TS_ALGO_MAP_STATS  : lookups and the nodes visited per lookup
+ *                        are counted and the time spent in incremental
+ *                        migration is measured (see ts_algo_map_stats).
+ *                        Note that, in this mode, get modifies
+ *                        the counters of the map.
+ * - TS_ALGO_MAP_SMALL  : the map starts with a buffer of one bucket,
+ *                        i.e. all entries are in one list searched
+ *                        linearly (comparing the stored hashes),
+ *                        until there are more than TS_ALGO_MAP_SMALLSZ
+ *                        entries; then the buffer is resized
+ *                        to the base size. An empty map, thus, costs
+ *                        the map structure and one list header instead
+ *                        of 'baseSize' list headers. In combination with
+ *                        TS_ALGO_MAP_SHRINK, the map returns to one bucket
+ *                        when there are no more than TS_ALGO_MAP_SMALLSZ/2
+ *                        entries left. For many tiny maps, this mode
+ *                        should not be combined with TS_ALGO_MAP_SLAB,
+ *                        since every map then owns its slabs.
+ * - TS_ALGO_MAP_BORROW : the keys are not copied; the map stores
+ *                        the pointer passed in as key. This is intended
+ *                        for keys that are part of the data stored
+ *                        with them (e.g. a field in a struct): the key
+ *                        must remain valid and unchanged as long as
+ *                        the data are in the map. Update and upsert
+ *                        store the key passed in together with the new
+ *                        data, so the key of the new data must be passed.
+ *                        An entry then consists of two allocations
+ *                        (list node and slot) in default mode and
+ *                        of one allocation without key in slab mode
+ *                        (for keys of any size).
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_MAP_DEFAULT     0
+#define TS_ALGO_MAP_SLAB        1
+#define TS_ALGO_MAP_INCREMENTAL 2
+#define TS_ALGO_MAP_SHRINK      4
+#define TS_ALGO_MAP_STATS       8
+#define TS_ALGO_MAP_SMALL      16
+#define TS_ALGO_MAP_BORROW     32
+
+/* -------------------------------------------------------------------------
+ * Greatest number of entries in small representation
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_MAP_SMALLSZ 16
+
+/* -------------------------------------------------------------------------
+ * Number of buckets migrated per operation in incremental mode
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_MAP_MIGRATE 8
+
+/* -------------------------------------------------------------------------
+ * Greatest key size stored in slabs
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_MAP_SLABKEY 128
+
 /* -------------------------------------------------------------------------
  * The map structure
  * -------------------------------------------------------------------------
@@ -53,11 +135,60 @@ typedef struct {
   uint32_t    baseSize; // Base size defined by the application
   uint32_t     curSize; // Current size, which, after resizing, may differ from the base size
   uint32_t       count; // Number of elements in the map
+  uint32_t        mode; // Mode flags (see above)
   ts_algo_hash_t   hsh; // Hash function defined by the application
+  void            *rsc; // Resource passed to the hash function (e.g. a seed)
   ts_algo_delete_t del; // Function to delete data defined by the application
   ts_algo_list_t  *buf; // Internal buffer to store the data
+  ts_algo_slab_t *slabs; // Slabs for entries (TS_ALGO_MAP_SLAB only)
+  ts_algo_list_t  *old; // Buffer being migrated (TS_ALGO_MAP_INCREMENTAL only)
+  uint32_t     oldSize; // Size of the buffer being migrated
+  uint32_t       moved; // Number of buckets already migrated
+  uint32_t     resizes; // Number of resizes
+  uint64_t     rsztime; // Nanoseconds spent resizing
+  uint64_t     lookups; // Number of lookups (TS_ALGO_MAP_STATS only)
+  uint64_t      probes; // Nodes visited by lookups (TS_ALGO_MAP_STATS only)
+  size_t           mem; // Bytes allocated for entries not in slabs
+  ts_algo_list_t  *cow; // Buffer shared with a snapshot (see ts_algo_map_snapshot)
+  uint8_t     *cowbits; // Buckets copied since the snapshot (one bit per bucket)
+  uint32_t       snaps; // Snapshots not yet released (attached or detached)
 } ts_algo_map_t;
 
+/* -------------------------------------------------------------------------
+ * A snapshot of the map (see ts_algo_map_snapshot)
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  ts_algo_map_t   *map; // The map of which this is a snapshot
+  ts_algo_list_t  *buf; // The buckets at the time of the snapshot
+  uint32_t        size; // Number of buckets
+  uint32_t       count; // Number of elements at the time of the snapshot
+} ts_algo_map_snap_t;
+
+/* -------------------------------------------------------------------------
+ * Number of bins in the chain length histogram
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_MAP_HISTO 16
+
+/* -------------------------------------------------------------------------
+ * Map statistics
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  uint32_t     buckets; // Number of buckets (both buffers during migration)
+  uint32_t       count; // Number of elements
+  double          load; // Elements per bucket
+  uint32_t    maxchain; // Longest chain
+  uint32_t histo[TS_ALGO_MAP_HISTO]; // Buckets per chain length;
+                        // the last bin counts all longer chains
+  uint64_t     lookups; // Number of lookups (TS_ALGO_MAP_STATS only)
+  uint64_t      probes; // Nodes visited by lookups (TS_ALGO_MAP_STATS only)
+  uint32_t     resizes; // Number of resizes
+  uint64_t  resizeTime; // Nanoseconds spent resizing
+  size_t           mem; // Bytes allocated for buffers and entries
+} ts_algo_map_stats_t;
+
 /* -------------------------------------------------------------------------
  * Map Iterator
  * -------------------------------------------------------------------------
@@ -67,6 +198,7 @@ typedef struct {
   int           slot; // Current slot in the buffer
   int          entry; // Current entry in that slot
   uint32_t     count; // Number of the element we will see next (starting from 0)
+  ts_algo_list_node_t *node; // Current node in that slot
 } ts_algo_map_it_t;
 
 /* -------------------------------------------------------------------------
@@ -80,6 +212,15 @@ typedef struct {
 	void    *data; // The data stored under the key
 } ts_algo_map_slot_t;
 
+/* -------------------------------------------------------------------------
+ * Visitor callback for ts_algo_map_forEach. It receives
+ * - an additional resource passed in by the application
+ * - the current slot
+ * If it returns anything but TS_ALGO_OK, the traversal is stopped.
+ * -------------------------------------------------------------------------
+ */
+typedef ts_algo_rc_t (*ts_algo_map_visit_t)(void*,ts_algo_map_slot_t*);
+
 /* -------------------------------------------------------------------------
  * Allocate a new map; for parameters, please refer to ts_algo_map_init.
  * -------------------------------------------------------------------------
@@ -96,7 +237,12 @@ ts_algo_map_t *ts_algo_map_new(uint32_t sz,
  *        is known in advance, setting the size to at least half of that
  *        number can improve performance up to factor 2.
  * - hsh: The hash function; if no hashing is necessary, ts_algo_hash_id
- *        shall be passed.
+ *        shall be passed. If hsh is NULL, ts_algo_hash_bytes is used.
+ *        The hash function is called with the field 'rsc' of the map
+ *        as third parameter. 'rsc' is initialised to NULL;
+ *        it may be set by the application before the first element
+ *        is added, e.g. to a random seed for the hashes
+ *        in tsalgo/hash.h.
  * - del: The function used to free the memory of the application data
  *        when deleted or when the map is destroyed.
  *        If the map shall not free that memory, the application shall
@@ -108,6 +254,30 @@ ts_algo_rc_t ts_algo_map_init(ts_algo_map_t   *map,
                               ts_algo_hash_t   hsh,
                               ts_algo_delete_t del);
 
+/* -------------------------------------------------------------------------
+ * Allocate a new map with the given mode;
+ * for parameters, please refer to ts_algo_map_initMode.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_map_t *ts_algo_map_newMode(uint32_t sz,
+                          ts_algo_hash_t   hsh,
+                          ts_algo_delete_t del,
+                          uint32_t        mode);
+
+/* -------------------------------------------------------------------------
+ * Initialise an already allocated map with the given mode.
+ * The parameters map, sz, hsh and del are the same as in ts_algo_map_init;
+ * mode is a combination of the mode flags defined above.
+ * ts_algo_map_init is the same as ts_algo_map_initMode with
+ * TS_ALGO_MAP_DEFAULT.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_initMode(ts_algo_map_t   *map,
+                                  uint32_t          sz,
+                                  ts_algo_hash_t   hsh,
+                                  ts_algo_delete_t del,
+                                  uint32_t        mode);
+
 /* -------------------------------------------------------------------------
  * Destroy the map when not needed anymore. 
  * If a 'del' function was supplied it will applied to all data
@@ -122,7 +292,8 @@ void ts_algo_map_destroy(ts_algo_map_t *map);
  * - map : The map on which we are operating;
  * - key : The byte buffer holding the key data. The bytes are copyied
  *         into the map structure, so the user does not worry about the
- *         life cycle after adding the pair to the map.
+ *         life cycle after adding the pair to the map
+ *         (unless the map is in TS_ALGO_MAP_BORROW mode).
  * - ksz : Size of the key data, e.g.
  *         - in case of a string: the string length, either with or without
  *           the terminating 0 (but consistent for one application)
@@ -164,6 +335,131 @@ void ts_algo_map_delete(ts_algo_map_t *map, char *key, size_t ksz);
  */
 void *ts_algo_map_update(ts_algo_map_t *map, char *key, size_t ksz, void *data);
 
+/* -------------------------------------------------------------------------
+ * Variants of add, get, remove and update for callers that have
+ * already hashed the key (e.g. to choose a shard in ts_algo_cmap_t).
+ * h must be the value map->hsh returns for the key;
+ * otherwise the key will not be found again.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_addHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                                   uint64_t h, void *data);
+
+void *ts_algo_map_getHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                            uint64_t h);
+
+void *ts_algo_map_removeHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                               uint64_t h);
+
+void *ts_algo_map_updateHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                               uint64_t h, void *data);
+
+/* -------------------------------------------------------------------------
+ * Resize the buffer, such that n elements fit into the map
+ * without further resizing. If the buffer is already big enough,
+ * nothing happens. An ongoing migration is completed.
+ * Reserving space before adding a large number of elements avoids
+ * the repeated moving of all entries while the map grows.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_reserve(ts_algo_map_t *map, uint32_t n);
+
+/* -------------------------------------------------------------------------
+ * Shrink the buffer to one bucket per element
+ * (but not below the base size) to give memory back, e.g.
+ * after many elements were removed. An ongoing migration is completed.
+ * In TS_ALGO_MAP_SMALL mode, a map with no more than TS_ALGO_MAP_SMALLSZ
+ * elements returns to the small representation.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_shrink(ts_algo_map_t *map);
+
+/* -------------------------------------------------------------------------
+ * Obtain the slot of the key; if the key is not in the map,
+ * it is added with the data passed in. The key is hashed once
+ * and the map is probed once. Parameters:
+ * - map, key, ksz, data: as in ts_algo_map_add
+ * - inserted: if not NULL, receives 1 if the key was added
+ *             and 0 if it was already in the map.
+ * The slot returned may be used to read and change the data
+ * (e.g. to increment a counter), but the key shall not be changed.
+ * The slot is valid until the next add or remove on the map.
+ * If the key had to be added, but there is not enough memory,
+ * NULL is returned.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_map_slot_t *ts_algo_map_getOrInsert(ts_algo_map_t *map,
+                                            char *key, size_t ksz,
+                                            void *data, char *inserted);
+
+/* -------------------------------------------------------------------------
+ * Add the key with the data passed in, if it is not in the map yet,
+ * or replace the data stored with the key otherwise (in one probe).
+ * If old is not NULL, it receives the data replaced or NULL
+ * if the key was added. The old data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_upsert(ts_algo_map_t *map, char *key, size_t ksz,
+                                                void *data, void **old);
+
+/* -------------------------------------------------------------------------
+ * Obtain the data stored with n keys at once; parameters:
+ * - map : The map on which we are operating;
+ * - keys: Array of n pointers to the key data;
+ * - ksz : Array of the n key sizes;
+ * - n   : Number of keys;
+ * - out : Array of n pointers receiving the data
+ *         (NULL for keys not found).
+ * The keys are processed in small windows. In each window,
+ * all keys are hashed first and their buckets and entries are
+ * prefetched before they are searched, so that the cache misses
+ * of different keys overlap instead of being paid one after the other.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_map_getBatch(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                              uint32_t n, void **out);
+
+/* -------------------------------------------------------------------------
+ * Add n key value pairs at once (see ts_algo_map_getBatch).
+ * data is an array of n pointers to the data.
+ * If an error occurs, the pairs before the failing one remain
+ * in the map and the error is returned.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_addBatch(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                                void **data, uint32_t n);
+
+/* -------------------------------------------------------------------------
+ * Remove n keys at once (see ts_algo_map_getBatch).
+ * If out is not NULL, it receives the data removed
+ * (NULL for keys not found). The data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_map_removeBatch(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                                 uint32_t n, void **out);
+
+/* -------------------------------------------------------------------------
+ * Add n key value pairs (see ts_algo_map_addBatch) using up to
+ * 'nthreads' threads (0: one per processor online). The buffer
+ * is resized once for all pairs; then the keys are hashed
+ * and partitioned by bucket range in parallel and each thread
+ * creates the entries of one range of buckets. Parameters:
+ * - map, keys, ksz, data, n: as in ts_algo_map_addBatch
+ *   (the map may already contain elements);
+ * - nthreads: the greatest number of threads to use.
+ * Below 4096 pairs per thread, fewer threads are used;
+ * with only one thread, this is ts_algo_map_addBatch.
+ * The hash function must be safe to call from several threads
+ * with the same 'rsc' (the hashes in tsalgo/hash.h are).
+ * The temporary memory needed is about 12 bytes per pair.
+ * As with ts_algo_map_addBatch, keys are not checked for duplicates.
+ * If there is not enough memory, some of the pairs may have been
+ * added and TS_ALGO_NO_MEM is returned.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_fromArray(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                   void **data, uint32_t n, uint32_t nthreads);
+
 /* -------------------------------------------------------------------------
  * Convenience interfaces for a map using ts_algo_hash_id.
  * The parameters in all interfaces are:
@@ -187,6 +483,12 @@ void *ts_algo_map_update(ts_algo_map_t *map, char *key, size_t ksz, void *data);
 #define ts_algo_map_updateId(m,k,d) \
 	ts_algo_map_update(m, (char*)&k, sizeof(uint64_t), d)
 
+#define ts_algo_map_getOrInsertId(m,k,d,i) \
+	ts_algo_map_getOrInsert(m, (char*)&k, sizeof(uint64_t), d, i)
+
+#define ts_algo_map_upsertId(m,k,d,o) \
+	ts_algo_map_upsert(m, (char*)&k, sizeof(uint64_t), d, o)
+
 /* -------------------------------------------------------------------------
  * Create an iterator for the map.
  * Iterators are used according to the following recipe:
@@ -202,6 +504,8 @@ void *ts_algo_map_update(ts_algo_map_t *map, char *key, size_t ksz, void *data);
  * 
  * Note that the order of elements as presented by the iterator is
  *      arbitrary. Application code should rely on any specific ordering.
+ * The iterator holds the current list node, so that each step
+ * costs O(1). The iterator is invalidated by add and remove.
  * -------------------------------------------------------------------------
  */
 ts_algo_map_it_t *ts_algo_map_iterate(ts_algo_map_t *map);
@@ -238,10 +542,190 @@ ts_algo_map_slot_t *ts_algo_map_it_get(ts_algo_map_it_t *it);
  */
 ts_algo_list_t *ts_algo_map_toList(ts_algo_map_t *map);
 
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all slots in the map passing 'rsc' as
+ * additional resource. The traversal allocates no memory and
+ * does not change the map (not even in incremental mode).
+ * The callback may change the data in the slot,
+ * but it shall not add or remove entries.
+ * If 'fun' returns an error, the traversal stops and
+ * that error is returned.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_forEach(ts_algo_map_t       *map,
+                                 ts_algo_map_visit_t  fun,
+                                 void                *rsc);
+
+/* -------------------------------------------------------------------------
+ * Conflict policies for ts_algo_map_merge:
+ * - TS_ALGO_MAP_KEEP   : the data in the destination are kept
+ * - TS_ALGO_MAP_REPLACE: the data in the destination are replaced
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_MAP_KEEP    0
+#define TS_ALGO_MAP_REPLACE 1
+
+/* -------------------------------------------------------------------------
+ * Move all elements of 'src' into 'dst'; src is empty afterwards.
+ * If a key is in both maps, 'policy' decides which data remain
+ * in dst; the other data are passed to the 'del' function
+ * of the map they came from (if not NULL). Parameters:
+ * - dst     : the map receiving the elements;
+ * - src     : the map giving its elements;
+ * - policy  : TS_ALGO_MAP_KEEP or TS_ALGO_MAP_REPLACE;
+ * - nthreads: the greatest number of threads to use
+ *             (0: one per processor online; see ts_algo_map_fromArray).
+ * dst is resized once for all elements. If both maps are in the same
+ * TS_ALGO_MAP_SLAB and TS_ALGO_MAP_BORROW mode, the entries
+ * (list nodes, slots and keys) are moved, not copied: in slab mode,
+ * the slabs of src are handed over to dst. The entries are then
+ * partitioned by destination bucket range and inserted in parallel.
+ * Otherwise the entries are copied one after the other and,
+ * if there is not enough memory, the elements not yet merged
+ * remain in src. If the maps have different hash functions
+ * (or different 'rsc'), the keys are hashed again with the hash
+ * of dst, which must then be thread-safe.
+ * If dst borrows its keys, src must borrow them as well
+ * (otherwise TS_ALGO_INVALID is returned).
+ * Snapshots of src must be released before (TS_ALGO_INVALID);
+ * releasing them later would free entries into slabs
+ * that src has handed over to dst.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_merge(ts_algo_map_t *dst, ts_algo_map_t *src,
+                               uint32_t policy, uint32_t nthreads);
+
+/* -------------------------------------------------------------------------
+ * Remove all elements from 'dst' whose keys are not in 'src';
+ * their data are passed to the 'del' function of dst (if not NULL).
+ * src is not changed. The buckets of dst are split
+ * into ranges visited by up to 'nthreads' threads
+ * (0: one per processor online; see ts_algo_map_forEachPar).
+ * If the maps have different hash functions (or different 'rsc'),
+ * the keys are hashed with the hash of src, which must then
+ * be thread-safe.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_intersect(ts_algo_map_t *dst, ts_algo_map_t *src,
+                                   uint32_t nthreads);
+
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all slots in the map (see ts_algo_map_forEach)
+ * using up to 'nthreads' threads (0: one per processor online).
+ * The buckets are split into contiguous ranges, one per thread;
+ * below 4096 buckets per thread, fewer threads are used.
+ * 'fun' is called concurrently with the same 'rsc',
+ * so it must be thread-safe; every slot is visited by exactly
+ * one thread. If 'fun' returns an error, all threads stop
+ * (after their current bucket) and that error is returned;
+ * which slots were visited before is then undefined.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_forEachPar(ts_algo_map_t       *map,
+                                    ts_algo_map_visit_t  fun,
+                                    void                *rsc,
+                                    uint32_t        nthreads);
+
+/* -------------------------------------------------------------------------
+ * Take a snapshot of the map: the snapshot sees the map as it is now
+ * while the map continues to change. Taking the snapshot costs
+ * one new (empty) buffer and one bit per bucket; the entries
+ * are not copied. Instead, the map and the snapshot share the buckets;
+ * the first time the map changes a bucket after the snapshot,
+ * it copies the entries of that bucket (copy-on-write).
+ * A snapshot, hence, costs memory in proportion to the buckets changed
+ * while it is alive. If the map is resized (or reserve, shrink, merge,
+ * intersect or fromArray are called) while the snapshot is attached,
+ * the map first copies all buckets not yet copied and the snapshot
+ * then owns its buckets exclusively ("detached").
+ * There is at most one attached snapshot; taking a new one
+ * detaches the previous one.
+ *
+ * The snapshot is intended for a reader thread that needs
+ * a consistent view of the map while a writer thread changes it:
+ * ts_algo_map_snapshot and ts_algo_map_release are called
+ * by the writer (or under the lock that protects the map);
+ * ts_algo_map_snapGet, ts_algo_map_snapForEach and snap->count
+ * may be used in another thread concurrently with the writer.
+ * The hash function, hence, must be thread-safe.
+ * Handing the snapshot over to the reader (and back for release)
+ * must be synchronised by the application. As for ts_algo_cmap_t,
+ * the snapshot protects the structure of the map, not the data:
+ * data removed from the map after the snapshot must not be deleted
+ * while the snapshot is alive. Note also that the slots passed
+ * to ts_algo_map_forEach or obtained from an iterator may be shared
+ * with the snapshot: changing their data changes the snapshot
+ * (update, upsert and getOrInsert copy the bucket first).
+ * Changing the map may return TS_ALGO_NO_MEM or, for remove and
+ * update, NULL if there is not enough memory to copy the bucket.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_snapshot(ts_algo_map_t *map, ts_algo_map_snap_t *snap);
+
+/* -------------------------------------------------------------------------
+ * Release the snapshot; the entries only the snapshot sees are freed
+ * (the data are not deleted!). If the snapshot is still attached,
+ * the buckets not copied are handed back to the map.
+ * Must be called by the writer after the reader is done
+ * and before the map is destroyed; this holds for all snapshots,
+ * attached or detached, since releasing a snapshot uses the map.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_map_release(ts_algo_map_snap_t *snap);
+
+/* -------------------------------------------------------------------------
+ * Obtain the data stored with the key at the time of the snapshot.
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_map_snapGet(ts_algo_map_snap_t *snap, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all slots in the snapshot (see ts_algo_map_forEach).
+ * The callback must not change the slots.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_snapForEach(ts_algo_map_snap_t  *snap,
+                                     ts_algo_map_visit_t  fun,
+                                     void                *rsc);
+
+/* -------------------------------------------------------------------------
+ * Convenience interface for uint64_t keys (see ts_algo_map_getId).
+ * -------------------------------------------------------------------------
+ */
+#define ts_algo_map_snapGetId(s,k) \
+	ts_algo_map_snapGet(s, (char*)&k, sizeof(uint64_t))
+
 /* -------------------------------------------------------------------------
  * Debug function that shows the number of entries per slot.
  * -------------------------------------------------------------------------
  */
 void ts_algo_map_showslots(ts_algo_map_t *map);
 
+/* -------------------------------------------------------------------------
+ * Obtain statistics of the map:
+ * - The histogram, the longest chain and the load factor
+ *   are computed from the buffer (O(buckets)).
+ * - Resizes, resize time and memory are counted in all modes.
+ *   The resize time includes the allocation of the new buffer and,
+ *   unless the map is in TS_ALGO_MAP_INCREMENTAL mode, moving the entries.
+ *   In TS_ALGO_MAP_INCREMENTAL mode, the time spent in the migration
+ *   steps is added only in TS_ALGO_MAP_STATS mode.
+ * - Lookups and probes (nodes visited by lookups) are counted
+ *   only in TS_ALGO_MAP_STATS mode. Every get, update, remove,
+ *   getOrInsert and upsert is one lookup.
+ *   probes/lookups is the average cost of a lookup;
+ *   for a good hash function, it is close to 1 + load/2.
+ * - Memory counts the buffers, the slabs and the entries
+ *   allocated individually. It does not include the memory
+ *   of the data and the overhead of malloc.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_map_stats(ts_algo_map_t *map, ts_algo_map_stats_t *stats);
+
+/* -------------------------------------------------------------------------
+ * Reset the counters (lookups, probes, resizes and resize time).
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_map_resetStats(ts_algo_map_t *map);
+
 #endif
@@ -0,0 +1,217 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Open Addressing Map Datatype
+ * A hashmap with the same interface as ts_algo_map_t, but instead of
+ * chaining entries in lists attached to the buckets, the slots are stored
+ * in one flat buffer and collisions are resolved by linear probing.
+ * The placement follows the Robin Hood strategy: when an entry is inserted,
+ * it takes the place of an entry that is closer to its home position and
+ * the displaced entry continues probing. Removal shifts the following
+ * entries backwards, so no tombstones are needed.
+ * Since the slots (including the hash) are stored inline,
+ * a lookup usually costs one cache miss per probe and probe sequences
+ * are short, even with high load. Keys up to TS_ALGO_OAMAP_INLINE bytes
+ * are stored inline as well (each entry fills one cache line),
+ * so comparing the key costs no further miss;
+ * only longer keys are allocated separately.
+ * Different from ts_algo_map_t, the map is a separate type
+ * with its own functions (named like those of ts_algo_map_t),
+ * since the modes of ts_algo_map_t (slabs, incremental resize,
+ * snapshots, merge, etc.) are built on the chained buckets.
+ * See: Pedro Celis: "Robin Hood Hashing", Waterloo, 1986.
+ * ========================================================================
+ */
+#ifndef ts_algo_oamap_decl
+#define ts_algo_oamap_decl
+
+#include <tsalgo/types.h>
+#include <tsalgo/list.h>
+#include <tsalgo/map.h>
+
+#include <stdlib.h>
+
+/* -------------------------------------------------------------------------
+ * Keys up to this size are stored in the entry
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_OAMAP_INLINE 32
+
+/* -------------------------------------------------------------------------
+ * An entry in the buffer
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  ts_algo_map_slot_t slot; // The slot (key == NULL: empty)
+  char ikey[TS_ALGO_OAMAP_INLINE]; // Short keys; slot.key points here
+} ts_algo_oamap_entry_t;
+
+/* -------------------------------------------------------------------------
+ * The map structure
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  uint32_t    baseSize; // Base size defined by the application (power of 2)
+  uint32_t     curSize; // Current size (always a power of 2)
+  uint32_t       count; // Number of elements in the map
+  ts_algo_hash_t   hsh; // Hash function defined by the application
+  void            *rsc; // Resource passed to the hash function (e.g. a seed)
+  ts_algo_delete_t del; // Function to delete data defined by the application
+  ts_algo_oamap_entry_t *buf; // Flat buffer of entries
+} ts_algo_oamap_t;
+
+/* -------------------------------------------------------------------------
+ * Map Iterator
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  ts_algo_oamap_t *map; // The map over which to iterate
+  uint32_t        slot; // Current slot in the buffer
+  uint32_t       count; // Number of the element we will see next
+} ts_algo_oamap_it_t;
+
+/* -------------------------------------------------------------------------
+ * Allocate a new map; for parameters, please refer to ts_algo_oamap_init.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_oamap_t *ts_algo_oamap_new(uint32_t sz,
+                          ts_algo_hash_t   hsh,
+                          ts_algo_delete_t del);
+
+/* -------------------------------------------------------------------------
+ * Initialise an already allocated map; the parameters are
+ * - map: The map to initialise
+ * - sz : The base size of the map buffer, if sz is 0, the buffer will be
+ *        initialised to a default. The size is rounded up to
+ *        the next power of 2. Different from ts_algo_map_t,
+ *        the buffer holds at most one element per slot; the buffer
+ *        is doubled in size when it is filled by 7/8.
+ * - hsh: The hash function. Since the lower bits of the hash
+ *        determine the position in the buffer, the hash should
+ *        distribute well in the lower bits.
+ *        If hsh is NULL, ts_algo_hash_bytes is used. As for
+ *        ts_algo_map_t, the field 'rsc' is passed to the hash function.
+ * - del: The function used to free the memory of the application data
+ *        when deleted or when the map is destroyed.
+ *        If the map shall not free that memory, the application shall
+ *        pass NULL.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_oamap_init(ts_algo_oamap_t *map,
+                                uint32_t          sz,
+                                ts_algo_hash_t   hsh,
+                                ts_algo_delete_t del);
+
+/* -------------------------------------------------------------------------
+ * Destroy the map when not needed anymore.
+ * If a 'del' function was supplied it will applied to all data
+ * in the map.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_oamap_destroy(ts_algo_oamap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Add a key value pair to the map;
+ * for parameters, please refer to ts_algo_map_add.
+ * Keys may be empty (ksz == 0).
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_oamap_add(ts_algo_oamap_t *map, char *key, size_t ksz, void *data);
+
+/* -------------------------------------------------------------------------
+ * Obtain the data stored with the key.
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_oamap_get(ts_algo_oamap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and returns them to the application.
+ * The data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_oamap_remove(ts_algo_oamap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Removes the data stored with the key and, if 'del' is not NULL,
+ * calls this function on the data.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_oamap_delete(ts_algo_oamap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Replaces the data stored with the key by the data passed in.
+ * If the key was found, the old data are returned, otherwise NULL is returned
+ * and no changes are perfomed. The old data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_oamap_update(ts_algo_oamap_t *map, char *key, size_t ksz, void *data);
+
+/* -------------------------------------------------------------------------
+ * Convenience interfaces for a map using uint64_t keys.
+ * -------------------------------------------------------------------------
+ */
+#define ts_algo_oamap_addId(m,k,d) \
+	ts_algo_oamap_add(m, (char*)&k, sizeof(uint64_t), d)
+
+#define ts_algo_oamap_getId(m,k) \
+	ts_algo_oamap_get(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_oamap_removeId(m,k) \
+	ts_algo_oamap_remove(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_oamap_deleteId(m,k) \
+	ts_algo_oamap_delete(m, (char*)&k, sizeof(uint64_t))
+
+#define ts_algo_oamap_updateId(m,k,d) \
+	ts_algo_oamap_update(m, (char*)&k, sizeof(uint64_t), d)
+
+/* -------------------------------------------------------------------------
+ * Create an iterator for the map.
+ * The iterator is used exactly like the iterator of ts_algo_map_t.
+ * Note that the slots returned by ts_algo_oamap_it_get
+ * point into the buffer of the map; they are invalidated
+ * by any add or remove on the map.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_oamap_it_t *ts_algo_oamap_iterate(ts_algo_oamap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Advance the iterator.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_oamap_it_advance(ts_algo_oamap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Check if the iterator reached the end of the map.
+ * -------------------------------------------------------------------------
+ */
+char ts_algo_oamap_it_eof(ts_algo_oamap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Rewind the iterator.
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_oamap_it_rewind(ts_algo_oamap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Get the current slot.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_map_slot_t *ts_algo_oamap_it_get(ts_algo_oamap_it_t *it);
+
+/* -------------------------------------------------------------------------
+ * Convert map to list. The list contains pointers to the slots
+ * in the buffer of the map. The list is invalidated
+ * by any add or remove on the map.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_list_t *ts_algo_oamap_toList(ts_algo_oamap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Debug function that shows the probe distance of every slot
+ * (-1 for empty slots).
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_oamap_showslots(ts_algo_oamap_t *map);
+
+#endif
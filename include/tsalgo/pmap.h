@@ -0,0 +1,160 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Perfect Hash Map Datatype
+ * A read-only map built once from a fixed set of keys,
+ * e.g. from a ts_algo_map_t that will not change anymore or
+ * from arrays of keys and data.
+ * The map uses a minimal perfect hash function: each of the n keys
+ * is mapped to its own slot in an array of exactly n slots,
+ * so a lookup costs one hash and one probe, there are no chains and
+ * no empty slots.
+ *
+ * The perfect hash follows the "hash, displace and compress"
+ * scheme (CHD): the keys are distributed over n/4 buckets
+ * by the high bits of their hash; for each bucket, a displacement d
+ * is searched, such that all keys in the bucket land
+ * in free slots when the hash is mixed with d.
+ * Buckets are placed from the largest to the smallest.
+ * The structure, hence, consists of one 32bit displacement per bucket
+ * (about one byte per key), the slots and one block holding all keys.
+ * See: Belazzougui, Botelho, Dietzfelbinger: "Hash, displace, and compress",
+ *      ESA 2009.
+ * ========================================================================
+ */
+#ifndef ts_algo_pmap_decl
+#define ts_algo_pmap_decl
+
+#include <tsalgo/types.h>
+#include <tsalgo/hash.h>
+#include <tsalgo/map.h>
+
+#include <stdlib.h>
+
+/* -------------------------------------------------------------------------
+ * Average number of keys per bucket
+ * -------------------------------------------------------------------------
+ */
+#define TS_ALGO_PMAP_LAMBDA 4
+
+/* -------------------------------------------------------------------------
+ * The map structure
+ * -------------------------------------------------------------------------
+ */
+typedef struct {
+  uint32_t       count; // Number of keys (and slots)
+  uint32_t        nbkt; // Number of buckets
+  uint64_t        seed; // Seed for ts_algo_hash_bytes found by the builder
+  uint32_t       *disp; // Displacement per bucket
+  char           *keys; // All keys in one block
+  ts_algo_map_slot_t *slots; // Slots (the keys point into 'keys')
+} ts_algo_pmap_t;
+
+/* -------------------------------------------------------------------------
+ * The bucket of hash h
+ * -------------------------------------------------------------------------
+ */
+static inline uint32_t ts_algo_pmap_bucket(uint64_t h, uint32_t nbkt) {
+	return (uint32_t)((h>>32)%nbkt);
+}
+
+/* -------------------------------------------------------------------------
+ * The slot of hash h with displacement d in a map of n slots.
+ * The builder computes this function very often, it is therefore
+ * a cheap mixer followed by a multiplication instead of a modulo.
+ * -------------------------------------------------------------------------
+ */
+static inline uint32_t ts_algo_pmap_slot(uint64_t h, uint32_t d, uint32_t n) {
+	uint64_t x = h ^ (d*0x9e3779b97f4a7c15ULL);
+	x ^= x>>32; x *= 0xd6e8feb86659fd93ULL;
+	x ^= x>>32;
+	return (uint32_t)(((x&0xffffffff)*n)>>32);
+}
+
+/* -------------------------------------------------------------------------
+ * Compute the perfect hash for n distinct hashes; parameters:
+ * - h   : Array of n hashes
+ * - n   : Number of hashes
+ * - nbkt: Number of buckets
+ * - disp: Array of nbkt displacements (output)
+ * - pos : Array of n slots (output),
+ *         pos[i] == ts_algo_pmap_slot(h[i], disp[ts_algo_pmap_bucket(h[i],
+ *                                              nbkt)], n)
+ * Returns TS_ALGO_ERR if no perfect hash was found,
+ * in that case the caller shall try again with another seed.
+ * The builder of ts_algo_pmap_t is based on this function;
+ * it may also be used by other read-only structures.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_layout(const uint64_t *h, uint32_t n, uint32_t nbkt,
+                                 uint32_t *disp, uint32_t *pos);
+
+/* -------------------------------------------------------------------------
+ * Allocate a new map;
+ * for parameters, please refer to ts_algo_pmap_init.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_pmap_t *ts_algo_pmap_new(char **keys, size_t *ksz,
+                                 void **data, uint32_t n);
+
+/* -------------------------------------------------------------------------
+ * Build the map from arrays; parameters:
+ * - map : The map to initialise
+ * - keys: Array of n pointers to the key data
+ * - ksz : Array of the n key sizes
+ * - data: Array of n pointers to the data
+ * - n   : Number of keys
+ * The keys are copied into the map, the data are not;
+ * the application manages the life cycle of the data.
+ * If the same key appears twice, TS_ALGO_INVALID is returned.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_init(ts_algo_pmap_t *map, char **keys, size_t *ksz,
+                                                void **data, uint32_t n);
+
+/* -------------------------------------------------------------------------
+ * Allocate a new map from a ts_algo_map_t;
+ * for parameters, please refer to ts_algo_pmap_initFromMap.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_pmap_t *ts_algo_pmap_newFromMap(ts_algo_map_t *src);
+
+/* -------------------------------------------------------------------------
+ * Build the map from all keys and data in src.
+ * The data are shared by both maps; src remains unchanged.
+ * If src contains the same key twice, TS_ALGO_INVALID is returned.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_initFromMap(ts_algo_pmap_t *map, ts_algo_map_t *src);
+
+/* -------------------------------------------------------------------------
+ * Destroy the map when not needed anymore.
+ * The data are not destroyed!
+ * -------------------------------------------------------------------------
+ */
+void ts_algo_pmap_destroy(ts_algo_pmap_t *map);
+
+/* -------------------------------------------------------------------------
+ * Obtain the data stored with the key.
+ * -------------------------------------------------------------------------
+ */
+void *ts_algo_pmap_get(ts_algo_pmap_t *map, char *key, size_t ksz);
+
+/* -------------------------------------------------------------------------
+ * Convenience interface for uint64_t keys.
+ * -------------------------------------------------------------------------
+ */
+#define ts_algo_pmap_getId(m,k) \
+	ts_algo_pmap_get(m, (char*)&k, sizeof(uint64_t))
+
+/* -------------------------------------------------------------------------
+ * Apply 'fun' to all slots in the map passing 'rsc' as
+ * additional resource (see ts_algo_map_forEach).
+ * The callback may change the data, but not the key.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_forEach(ts_algo_pmap_t      *map,
+                                  ts_algo_map_visit_t  fun,
+                                  void                *rsc);
+
+#endif
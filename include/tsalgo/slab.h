@@ -0,0 +1,79 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * Slab Allocator
+ * --------------
+ * Provides objects of a fixed size carved from big chunks of memory.
+ * Freed objects are kept in a free list and are reused
+ * by subsequent allocations, so that, in steady state,
+ * allocation and release cost only a pointer swap.
+ * All chunks are released at once when the slab is destroyed.
+ * The slab is *not* thread safe.
+ * ========================================================================
+ */
+#ifndef ts_algo_slab_decl
+#define ts_algo_slab_decl
+
+#include <tsalgo/types.h>
+#include <stdlib.h>
+
+/* ------------------------------------------------------------------------
+ * The slab
+ * ------------------------------------------------------------------------
+ */
+typedef struct {
+	size_t      objsz;  /* size of one object (aligned)        */
+	uint32_t    chunk;  /* number of objects per chunk         */
+	void        *free;  /* list of released objects            */
+	char         *cur;  /* next unused object in current chunk */
+	char         *end;  /* end of the current chunk            */
+	void      *chunks;  /* list of all chunks                  */
+	uint64_t      mem;  /* bytes allocated from the system     */
+} ts_algo_slab_t;
+
+/* ------------------------------------------------------------------------
+ * Initialise a slab for objects of size 'objsz'
+ * allocating 'chunk' objects at once (0: default).
+ * No memory is allocated before the first object is requested.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_slab_init(ts_algo_slab_t *slab, size_t objsz,
+                                                   uint32_t chunk);
+
+/* ------------------------------------------------------------------------
+ * Release all memory of the slab.
+ * All objects obtained from the slab are invalid afterwards.
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_slab_destroy(ts_algo_slab_t *slab);
+
+/* ------------------------------------------------------------------------
+ * Obtain one object from the slab.
+ * Returns NULL if no memory is available.
+ * running time: O(1)
+ * ------------------------------------------------------------------------
+ */
+void *ts_algo_slab_alloc(ts_algo_slab_t *slab);
+
+/* ------------------------------------------------------------------------
+ * Return one object to the slab.
+ * The object must have been obtained from the same slab.
+ * running time: O(1)
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_slab_free(ts_algo_slab_t *slab, void *obj);
+
+/* ------------------------------------------------------------------------
+ * Move all memory of 'src' to 'dst': the chunks of src are added
+ * to the chunks of dst and the objects still free in src
+ * are added to the free list of dst. Objects obtained from src
+ * must be released to dst afterwards. Both slabs must have
+ * the same object size. src is empty afterwards, but still
+ * initialised. This allows threads to allocate from private slabs
+ * and to hand the objects over to a shared slab at the end.
+ * running time: O(chunks + free objects in src)
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_slab_merge(ts_algo_slab_t *dst, ts_algo_slab_t *src);
+
+#endif
@@ -5,6 +5,10 @@
  * ========================================================================
  * Provides the AVL data structure 
  * with callbacks to handle application-defined data.
+ * The nodes are obtained from a slab owned by the tree
+ * (see tsalgo/slab.h), so that, in steady state, insert and delete
+ * do not call malloc and free and destroying the tree
+ * releases the nodes in a few chunks.
  * ========================================================================
  */
 #ifndef ts_algo_tree_decl
@@ -12,6 +16,7 @@
 
 #include <tsalgo/types.h>
 #include <tsalgo/list.h>
+#include <tsalgo/slab.h>
 
 /* ------------------------------------------------------------------------
  * A node in a tree
@@ -20,10 +25,25 @@
 typedef struct ts_algo_tree_node_st {
 	void                        *cont;  /* the content    */
 	char                         bal;   /* balancing flag */
+	uint32_t                     size;  /* subtree size   */
 	struct ts_algo_tree_node_st *right; /* right kid      */
 	struct ts_algo_tree_node_st *left;  /* left kid       */
 } ts_algo_tree_node_t; 
 
+/* ------------------------------------------------------------------------
+ * Nodes allocated at once by the slab of the tree
+ * ------------------------------------------------------------------------
+ */
+#define TS_ALGO_TREE_CHUNK 256
+
+/* ------------------------------------------------------------------------
+ * Greatest height of a tree
+ * (the height of an AVL tree is less than 1.45*log2(n+2),
+ *  i.e. less than 47 for 2^32 nodes).
+ * ------------------------------------------------------------------------
+ */
+#define TS_ALGO_TREE_MAXDEPTH 64
+
 /* ------------------------------------------------------------------------
  * Head node of a tree
  * ------------------------------------------------------------------------
@@ -38,6 +58,8 @@ typedef struct {
 	ts_algo_update_t    onUpdate;  /* on update                */
 	ts_algo_delete_t    onDelete;  /* on delete                */
 	ts_algo_delete_t   onDestroy;  /* on destroy               */
+	ts_algo_slab_t          slab;  /* node pool                */
+	ts_algo_bool_t        ranked;  /* maintain subtree sizes   */
 } ts_algo_tree_t;
 
 /* ------------------------------------------------------------------------
@@ -247,4 +269,160 @@ ts_algo_rc_t ts_algo_tree_reduce(ts_algo_tree_t      *tree,
                                  void           *aggregate,
                                  ts_algo_reducer_t reducer);
 
+/* ------------------------------------------------------------------------
+ * Cursor
+ * ------
+ * A cursor points to one node of the tree and moves
+ * forward (next) and backward (prev) in the order of the tree.
+ * It keeps the path from the root to the current node,
+ * so that each step costs amortised O(1) and seeking O(log n).
+ * The cursor is owned by the application (e.g. on the stack)
+ * and needs not be released. It is invalidated by insert and delete.
+ *
+ * Cursors are used according to the following recipe:
+ *
+ * ts_algo_tree_cursor_t cur;
+ * for(ts_algo_tree_lowerBound(tree, &cur, from);
+ *    !ts_algo_tree_cur_eof(&cur); ts_algo_tree_next(&cur)) {
+ *   mytype_t *x = ts_algo_tree_cur_get(&cur);
+ *   // do something with x
+ * }
+ * ------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_tree_t      *tree;  /* the tree                   */
+	int                 depth;  /* nodes on the path (0: eof) */
+	ts_algo_tree_node_t *path[TS_ALGO_TREE_MAXDEPTH]; /* root..current */
+} ts_algo_tree_cursor_t;
+
+/* ------------------------------------------------------------------------
+ * Position the cursor on the smallest content.
+ * Returns FALSE if the tree is empty.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_first(ts_algo_tree_t        *tree,
+                                  ts_algo_tree_cursor_t  *cur);
+
+/* ------------------------------------------------------------------------
+ * Position the cursor on the greatest content.
+ * Returns FALSE if the tree is empty.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_last(ts_algo_tree_t        *tree,
+                                 ts_algo_tree_cursor_t  *cur);
+
+/* ------------------------------------------------------------------------
+ * Position the cursor on the smallest content
+ * that is greater than or equal to 'cont' (according to compare).
+ * Returns FALSE if there is no such content.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_lowerBound(ts_algo_tree_t        *tree,
+                                       ts_algo_tree_cursor_t  *cur,
+                                       void                  *cont);
+
+/* ------------------------------------------------------------------------
+ * Position the cursor on the smallest content
+ * that is greater than 'cont' (according to compare).
+ * Returns FALSE if there is no such content.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_upperBound(ts_algo_tree_t        *tree,
+                                       ts_algo_tree_cursor_t  *cur,
+                                       void                  *cont);
+
+/* ------------------------------------------------------------------------
+ * Move the cursor to the next content.
+ * Returns FALSE if there is none (the cursor is then at eof).
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_next(ts_algo_tree_cursor_t *cur);
+
+/* ------------------------------------------------------------------------
+ * Move the cursor to the previous content.
+ * Returns FALSE if there is none (the cursor is then at eof).
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_prev(ts_algo_tree_cursor_t *cur);
+
+/* ------------------------------------------------------------------------
+ * Check if the cursor is beyond the contents.
+ * ------------------------------------------------------------------------
+ */
+#define ts_algo_tree_cur_eof(cur) \
+	((cur)->depth == 0)
+
+/* ------------------------------------------------------------------------
+ * Content under the cursor (NULL at eof).
+ * ------------------------------------------------------------------------
+ */
+#define ts_algo_tree_cur_get(cur) \
+	((cur)->depth == 0?NULL:(cur)->path[(cur)->depth-1]->cont)
+
+/* ------------------------------------------------------------------------
+ * Range
+ * -----
+ * Range applies 'mapper' in order on each content that is
+ * greater than or equal to 'from' and less than 'to'.
+ * If 'from' is NULL, the range starts at the smallest content;
+ * if 'to' is NULL, it ends with the greatest content.
+ * The visit stops at the first return code other than TS_ALGO_OK,
+ * which is then returned. The cost is O(log n + k)
+ * for k contents in the range.
+ * As with map, the mapper shall not change the keys.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_tree_range(ts_algo_tree_t    *tree,
+                                void              *from,
+                                void                *to,
+                                ts_algo_mapper_t mapper);
+
+/* ------------------------------------------------------------------------
+ * Order Statistics
+ * ----------------
+ * When enabled, every node keeps the size of its subtree
+ * (in the padding after 'bal', so the nodes do not grow).
+ * Insert and delete then update the sizes on their path
+ * and the rotations fix the sizes of the nodes they move.
+ * Rank, select and countRange are O(log n).
+ * Enabling is O(n) on a non-empty tree and cannot be undone.
+ * On a tree without ranks, rank and countRange return 0,
+ * select returns NULL and seekRank returns FALSE.
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_tree_enableRank(ts_algo_tree_t *tree);
+
+/* ------------------------------------------------------------------------
+ * Number of contents less than 'cont'
+ * (whether or not 'cont' is in the tree).
+ * ------------------------------------------------------------------------
+ */
+uint32_t ts_algo_tree_rank(ts_algo_tree_t *tree, void *cont);
+
+/* ------------------------------------------------------------------------
+ * The k-th smallest content (starting from 0)
+ * or NULL if there are not more than k contents.
+ * ------------------------------------------------------------------------
+ */
+void *ts_algo_tree_select(ts_algo_tree_t *tree, uint32_t k);
+
+/* ------------------------------------------------------------------------
+ * Position the cursor on the k-th smallest content (starting from 0),
+ * e.g. to read a page of contents with ts_algo_tree_next.
+ * Returns FALSE if there are not more than k contents.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_seekRank(ts_algo_tree_t        *tree,
+                                     ts_algo_tree_cursor_t  *cur,
+                                     uint32_t                  k);
+
+/* ------------------------------------------------------------------------
+ * Number of contents that are greater than or equal to 'from'
+ * and less than 'to' (see ts_algo_tree_range).
+ * ------------------------------------------------------------------------
+ */
+uint32_t ts_algo_tree_countRange(ts_algo_tree_t *tree,
+                                 void           *from,
+                                 void             *to);
+
 #endif
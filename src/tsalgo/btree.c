@@ -0,0 +1,704 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * B+ Tree
+ * ========================================================================
+ * The separator at position i of an inner node is always
+ * the smallest content in the subtree of kid i+1.
+ * Separators are pointers to contents in the leaves, so when the
+ * smallest content of a subtree is deleted, the separator pointing
+ * to it is replaced by the next content (see fixsep).
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <tsalgo/btree.h>
+
+/* duplicate detected */
+#define DOUBLE 2
+
+/* ------------------------------------------------------------------------
+ * Capacities and minimum fill of the nodes
+ * ------------------------------------------------------------------------
+ */
+#define INNER TS_ALGO_BTREE_INNER
+#define LEAF  TS_ALGO_BTREE_LEAF
+#define CAP(x) ((x)->leaf?LEAF:INNER)
+#define MIN(x) ((x)->leaf?LEAF/2:INNER/2)
+
+#define KEYS(x) ((x)->u.in.keys)
+#define KIDS(x) ((x)->u.in.kids)
+#define CONT(x) ((x)->u.lf.cont)
+
+/* ------------------------------------------------------------------------
+ * Greatest height of a tree: with at least INNER/2+1 kids per node,
+ * 2^32 contents do not need more than 32 levels.
+ * ------------------------------------------------------------------------
+ */
+#define MAXHEIGHT 32
+
+/* ------------------------------------------------------------------------
+ * Allocate a new node aligned to a cache line
+ * ------------------------------------------------------------------------
+ */
+static ts_algo_btree_node_t *newnode(char leaf) {
+	ts_algo_btree_node_t *node;
+	if (posix_memalign((void**)&node, 64,
+	                   sizeof(ts_algo_btree_node_t)) != 0) return NULL;
+	node->n = 0;
+	node->leaf = leaf;
+	if (leaf) {
+		node->u.lf.prv = NULL;
+		node->u.lf.nxt = NULL;
+	}
+	return node;
+}
+
+/* ------------------------------------------------------------------------
+ * Position of the kid where cont lives: the first separator
+ * greater than cont. If a separator is equal to cont,
+ * it is the one before that position and *eq is set.
+ * ------------------------------------------------------------------------
+ */
+static inline int innerpos(ts_algo_btree_t      *tree,
+                           ts_algo_btree_node_t *node,
+                           void                 *cont,
+                           char                   *eq)
+{
+	int lo = 0, hi = node->n;
+	while(lo < hi) {
+		int mid = (lo+hi)>>1;
+		ts_algo_cmp_t cmp = tree->compare(tree, cont, KEYS(node)[mid]);
+		if (cmp == ts_algo_cmp_less) hi = mid;
+		else {
+			if (cmp == ts_algo_cmp_equal) *eq = 1;
+			lo = mid+1;
+		}
+	}
+	return lo;
+}
+
+/* ------------------------------------------------------------------------
+ * Position of cont in the leaf: the first content not less than cont.
+ * If that content is equal to cont, *eq is set.
+ * ------------------------------------------------------------------------
+ */
+static inline int leafpos(ts_algo_btree_t      *tree,
+                          ts_algo_btree_node_t *node,
+                          void                 *cont,
+                          char                   *eq)
+{
+	int lo = 0, hi = node->n;
+	while(lo < hi) {
+		int mid = (lo+hi)>>1;
+		ts_algo_cmp_t cmp = tree->compare(tree, cont, CONT(node)[mid]);
+		if (cmp == ts_algo_cmp_greater) lo = mid+1;
+		else {
+			if (cmp == ts_algo_cmp_equal) *eq = 1;
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/* ------------------------------------------------------------------------
+ * Nodes allocated before an insert for the splits it may cause,
+ * so that an insert either succeeds or does not change the tree.
+ * ------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_btree_node_t *nodes[MAXHEIGHT+1];
+	int                   n;
+} pool_t;
+
+static inline ts_algo_btree_node_t *fromPool(pool_t *pool, char leaf) {
+	ts_algo_btree_node_t *node = pool->nodes[--pool->n];
+	node->n = 0;
+	node->leaf = leaf;
+	if (leaf) {
+		node->u.lf.prv = NULL;
+		node->u.lf.nxt = NULL;
+	}
+	return node;
+}
+
+static inline ts_algo_rc_t toPool(pool_t *pool) {
+	ts_algo_btree_node_t *node = newnode(0);
+	if (node == NULL) return TS_ALGO_NO_MEM;
+	pool->nodes[pool->n++] = node;
+	return TS_ALGO_OK;
+}
+
+static inline void freePool(pool_t *pool) {
+	while(pool->n > 0) free(pool->nodes[--pool->n]);
+}
+
+/* ------------------------------------------------------------------------
+ * Split a full leaf inserting cont at position i;
+ * the new right leaf and its first content are returned.
+ * ------------------------------------------------------------------------
+ */
+static void splitleaf(ts_algo_btree_node_t  *node,
+                      int                       i,
+                      void                  *cont,
+                      pool_t                *pool,
+                      void                  **sep,
+                      ts_algo_btree_node_t **right)
+{
+	void *tmp[LEAF+1];
+	int m = (LEAF+1)/2;
+	ts_algo_btree_node_t *r = fromPool(pool, 1);
+
+	memcpy(tmp, CONT(node), i*sizeof(void*));
+	tmp[i] = cont;
+	memcpy(tmp+i+1, CONT(node)+i, (LEAF-i)*sizeof(void*));
+
+	memcpy(CONT(node), tmp, m*sizeof(void*));
+	memcpy(CONT(r), tmp+m, (LEAF+1-m)*sizeof(void*));
+	node->n = m;
+	r->n = LEAF+1-m;
+
+	r->u.lf.prv = node;
+	r->u.lf.nxt = node->u.lf.nxt;
+	if (r->u.lf.nxt != NULL) r->u.lf.nxt->u.lf.prv = r;
+	node->u.lf.nxt = r;
+
+	*sep = CONT(r)[0];
+	*right = r;
+}
+
+/* ------------------------------------------------------------------------
+ * Split a full inner node inserting separator s and kid k
+ * at position i; the middle separator goes up.
+ * ------------------------------------------------------------------------
+ */
+static void splitinner(ts_algo_btree_node_t  *node,
+                       int                       i,
+                       void                     *s,
+                       ts_algo_btree_node_t     *k,
+                       pool_t                *pool,
+                       void                  **sep,
+                       ts_algo_btree_node_t **right)
+{
+	void                 *keys[INNER+1];
+	ts_algo_btree_node_t *kids[INNER+2];
+	int m = (INNER+1)/2;
+	ts_algo_btree_node_t *r = fromPool(pool, 0);
+
+	memcpy(keys, KEYS(node), i*sizeof(void*));
+	keys[i] = s;
+	memcpy(keys+i+1, KEYS(node)+i, (INNER-i)*sizeof(void*));
+
+	memcpy(kids, KIDS(node), (i+1)*sizeof(void*));
+	kids[i+1] = k;
+	memcpy(kids+i+2, KIDS(node)+i+1, (INNER-i)*sizeof(void*));
+
+	memcpy(KEYS(node), keys, m*sizeof(void*));
+	memcpy(KIDS(node), kids, (m+1)*sizeof(void*));
+	node->n = m;
+
+	memcpy(KEYS(r), keys+m+1, (INNER-m)*sizeof(void*));
+	memcpy(KIDS(r), kids+m+1, (INNER-m+1)*sizeof(void*));
+	r->n = INNER-m;
+
+	*sep = keys[m];
+	*right = r;
+}
+
+/* ------------------------------------------------------------------------
+ * Recursively insert cont into the subtree of node.
+ * If node was split, the new right node and its separator are returned.
+ * ------------------------------------------------------------------------
+ */
+static ts_algo_rc_t insert(ts_algo_btree_t       *tree,
+                           ts_algo_btree_node_t  *node,
+                           void                  *cont,
+                           pool_t                *pool,
+                           void                  **sep,
+                           ts_algo_btree_node_t **right)
+{
+	ts_algo_btree_node_t *r = NULL;
+	ts_algo_rc_t rc;
+	void *s = NULL;
+	char eq = 0;
+	int i;
+
+	*right = NULL;
+
+	/* a full node is split if its kid is split */
+	if (node->n == CAP(node)) {
+		rc = toPool(pool);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	if (node->leaf) {
+		i = leafpos(tree, node, cont, &eq);
+		if (eq) {
+			rc = tree->onUpdate(tree, CONT(node)[i], cont);
+			if (rc != TS_ALGO_OK) return rc;
+			return DOUBLE;
+		}
+		if (node->n == LEAF) {
+			splitleaf(node, i, cont, pool, sep, right);
+			return TS_ALGO_OK;
+		}
+		memmove(CONT(node)+i+1, CONT(node)+i, (node->n-i)*sizeof(void*));
+		CONT(node)[i] = cont;
+		node->n++;
+		return TS_ALGO_OK;
+	}
+	i = innerpos(tree, node, cont, &eq);
+	rc = insert(tree, KIDS(node)[i], cont, pool, &s, &r);
+	if (rc != TS_ALGO_OK || r == NULL) return rc;
+
+	if (node->n == INNER) {
+		splitinner(node, i, s, r, pool, sep, right);
+		return TS_ALGO_OK;
+	}
+	memmove(KEYS(node)+i+1, KEYS(node)+i, (node->n-i)*sizeof(void*));
+	memmove(KIDS(node)+i+2, KIDS(node)+i+1, (node->n-i)*sizeof(void*));
+	KEYS(node)[i] = s;
+	KIDS(node)[i+1] = r;
+	node->n++;
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Kid i of node has less than the minimum:
+ * borrow from a sibling or merge with it.
+ * ------------------------------------------------------------------------
+ */
+static void rebalance(ts_algo_btree_node_t *node, int i) {
+	ts_algo_btree_node_t *c = KIDS(node)[i];
+	ts_algo_btree_node_t *l = i>0?KIDS(node)[i-1]:NULL;
+	ts_algo_btree_node_t *r = i<node->n?KIDS(node)[i+1]:NULL;
+
+	if (c->leaf) {
+		/* borrow the greatest content of the left leaf */
+		if (l != NULL && l->n > MIN(l)) {
+			memmove(CONT(c)+1, CONT(c), c->n*sizeof(void*));
+			CONT(c)[0] = CONT(l)[--l->n];
+			c->n++;
+			KEYS(node)[i-1] = CONT(c)[0];
+			return;
+		}
+		/* borrow the smallest content of the right leaf */
+		if (r != NULL && r->n > MIN(r)) {
+			CONT(c)[c->n++] = CONT(r)[0];
+			memmove(CONT(r), CONT(r)+1, (--r->n)*sizeof(void*));
+			KEYS(node)[i] = CONT(r)[0];
+			return;
+		}
+		/* merge c into l or r into c */
+		if (l != NULL) {
+			r = c; c = l; i--;
+		}
+		memcpy(CONT(c)+c->n, CONT(r), r->n*sizeof(void*));
+		c->n += r->n;
+		c->u.lf.nxt = r->u.lf.nxt;
+		if (c->u.lf.nxt != NULL) c->u.lf.nxt->u.lf.prv = c;
+	} else {
+		/* rotate the greatest kid of l over the separator */
+		if (l != NULL && l->n > MIN(l)) {
+			memmove(KEYS(c)+1, KEYS(c), c->n*sizeof(void*));
+			memmove(KIDS(c)+1, KIDS(c), (c->n+1)*sizeof(void*));
+			KEYS(c)[0] = KEYS(node)[i-1];
+			KIDS(c)[0] = KIDS(l)[l->n];
+			KEYS(node)[i-1] = KEYS(l)[l->n-1];
+			l->n--; c->n++;
+			return;
+		}
+		/* rotate the smallest kid of r over the separator */
+		if (r != NULL && r->n > MIN(r)) {
+			KEYS(c)[c->n] = KEYS(node)[i];
+			KIDS(c)[c->n+1] = KIDS(r)[0];
+			KEYS(node)[i] = KEYS(r)[0];
+			memmove(KEYS(r), KEYS(r)+1, (r->n-1)*sizeof(void*));
+			memmove(KIDS(r), KIDS(r)+1, r->n*sizeof(void*));
+			r->n--; c->n++;
+			return;
+		}
+		/* merge c into l or r into c pulling down the separator */
+		if (l != NULL) {
+			r = c; c = l; i--;
+		}
+		KEYS(c)[c->n] = KEYS(node)[i];
+		memcpy(KEYS(c)+c->n+1, KEYS(r), r->n*sizeof(void*));
+		memcpy(KIDS(c)+c->n+1, KIDS(r), (r->n+1)*sizeof(void*));
+		c->n += r->n+1;
+	}
+	/* remove separator i and kid i+1 (= r) */
+	memmove(KEYS(node)+i, KEYS(node)+i+1, (node->n-i-1)*sizeof(void*));
+	memmove(KIDS(node)+i+1, KIDS(node)+i+2, (node->n-i-1)*sizeof(void*));
+	node->n--;
+	free(r);
+}
+
+/* ------------------------------------------------------------------------
+ * Recursively remove cont from the subtree of node;
+ * the content removed is returned in found.
+ * If a separator is equal to cont, *sep is set.
+ * ------------------------------------------------------------------------
+ */
+static ts_algo_bool_t delete(ts_algo_btree_t      *tree,
+                             ts_algo_btree_node_t *node,
+                             void                 *cont,
+                             void                **found,
+                             char                   *sep)
+{
+	char eq = 0;
+	int i;
+
+	if (node->leaf) {
+		i = leafpos(tree, node, cont, &eq);
+		if (!eq) return FALSE;
+		*found = CONT(node)[i];
+		node->n--;
+		memmove(CONT(node)+i, CONT(node)+i+1, (node->n-i)*sizeof(void*));
+		return TRUE;
+	}
+	i = innerpos(tree, node, cont, &eq);
+	if (eq) *sep = 1;
+	if (!delete(tree, KIDS(node)[i], cont, found, sep)) return FALSE;
+	if (KIDS(node)[i]->n < MIN(KIDS(node)[i])) rebalance(node, i);
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------
+ * The content cont was removed, but a separator still points to it;
+ * replace that separator by the next content in order.
+ * ------------------------------------------------------------------------
+ */
+static void fixsep(ts_algo_btree_t *tree, void *cont) {
+	ts_algo_btree_node_t *node = tree->root;
+	void **slot = NULL;
+	char eq = 0;
+	int i;
+
+	while(!node->leaf) {
+		eq = 0;
+		i = innerpos(tree, node, cont, &eq);
+		if (eq) slot = KEYS(node)+i-1;
+		node = KIDS(node)[i];
+	}
+	if (slot == NULL) return;
+	i = leafpos(tree, node, cont, &eq);
+	if (i < node->n) {
+		*slot = CONT(node)[i];
+	} else if (node->u.lf.nxt != NULL) {
+		*slot = CONT(node->u.lf.nxt)[0];
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * Recursively destroy a subtree
+ * ------------------------------------------------------------------------
+ */
+static void destroytree(ts_algo_btree_t      *tree,
+                        ts_algo_btree_node_t *node)
+{
+	if (node->leaf) {
+		for(int i=0; i<node->n; i++) {
+			tree->onDestroy(tree, CONT(node)+i);
+		}
+	} else {
+		for(int i=0; i<=node->n; i++) {
+			destroytree(tree, KIDS(node)[i]);
+		}
+	}
+	free(node);
+}
+
+/* ------------------------------------------------------------------------
+ * Recursively check a subtree; all contents must be
+ * greater or equal than lo and less than hi (if not NULL).
+ * Returns the smallest content in the subtree.
+ * ------------------------------------------------------------------------
+ */
+static ts_algo_bool_t checktree(ts_algo_btree_t      *tree,
+                                ts_algo_btree_node_t *node,
+                                uint32_t            depth,
+                                void                  *lo,
+                                void                  *hi,
+                                void                **min)
+{
+	if (node != tree->root && node->n < MIN(node)) return FALSE;
+	if (node->n > CAP(node)) return FALSE;
+	if (node->leaf) {
+		if (depth != tree->height) return FALSE;
+		for(int i=0; i<node->n; i++) {
+			void *c = CONT(node)[i];
+			if (lo != NULL &&
+			    tree->compare(tree, c, lo) == ts_algo_cmp_less) return FALSE;
+			if (hi != NULL &&
+			    tree->compare(tree, c, hi) != ts_algo_cmp_less) return FALSE;
+			if (i > 0 && tree->compare(tree, CONT(node)[i-1],
+			                           c) != ts_algo_cmp_less) return FALSE;
+		}
+		*min = node->n>0?CONT(node)[0]:NULL;
+		return TRUE;
+	}
+	if (node->n == 0) return FALSE;
+	for(int i=0; i<=node->n; i++) {
+		void *m = NULL;
+		if (!checktree(tree, KIDS(node)[i], depth+1,
+		               i>0?KEYS(node)[i-1]:lo,
+		               i<node->n?KEYS(node)[i]:hi, &m)) return FALSE;
+		/* the separator is the smallest content of the right kid */
+		if (i > 0 && m != KEYS(node)[i-1]) return FALSE;
+		if (i == 0) *min = m;
+	}
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------
+ * Allocate and initialise a new tree.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_btree_t *ts_algo_btree_new(ts_algo_comprsc_t compare,
+                                   ts_algo_show_t    show,
+                                   ts_algo_update_t  onUpdate,
+                                   ts_algo_delete_t  onDelete,
+                                   ts_algo_delete_t  onDestroy)
+{
+	ts_algo_btree_t *t = malloc(sizeof(ts_algo_btree_t));
+	if (t == NULL) return NULL;
+	if (ts_algo_btree_init(t, compare, show, onUpdate,
+	                                         onDelete,
+	                                         onDestroy) != TS_ALGO_OK)
+	{
+		free(t); return NULL;
+	}
+	return t;
+}
+
+/* ------------------------------------------------------------------------
+ * Initialise an already allocated tree.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_init(ts_algo_btree_t  *t,
+                                ts_algo_comprsc_t compare,
+                                ts_algo_show_t    show,
+                                ts_algo_update_t  onUpdate,
+                                ts_algo_delete_t  onDelete,
+                                ts_algo_delete_t  onDestroy)
+{
+	if (t == NULL) return TS_ALGO_INVALID;
+	t->root      = NULL;
+	t->first     = NULL;
+	t->count     = 0;
+	t->height    = 0;
+	t->rsc       = NULL;
+	t->compare   = compare;
+	t->show      = show;
+	t->onUpdate  = onUpdate;
+	t->onDelete  = onDelete;
+	t->onDestroy = onDestroy;
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Destroy the whole tree
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_btree_destroy(ts_algo_btree_t *tree) {
+	if (tree->root != NULL) {
+		destroytree(tree, tree->root);
+		tree->root = NULL;
+	}
+	tree->first  = NULL;
+	tree->count  = 0;
+	tree->height = 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Insert
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_insert(ts_algo_btree_t *tree, void *cont) {
+	ts_algo_btree_node_t *r = NULL;
+	ts_algo_rc_t rc;
+	pool_t pool;
+	void *s;
+
+	if (cont == NULL) return TS_ALGO_INVALID;
+	if (tree->root == NULL) {
+		tree->root = newnode(1);
+		if (tree->root == NULL) return TS_ALGO_NO_MEM;
+		tree->first = tree->root;
+		tree->height = 1;
+	}
+	pool.n = 0;
+
+	/* if the root is full, we may need a new root */
+	if (tree->root->n == CAP(tree->root)) {
+		rc = toPool(&pool);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	rc = insert(tree, tree->root, cont, &pool, &s, &r);
+	if (rc == TS_ALGO_OK) {
+		tree->count++;
+		if (r != NULL) {
+			ts_algo_btree_node_t *root = fromPool(&pool, 0);
+			KEYS(root)[0] = s;
+			KIDS(root)[0] = tree->root;
+			KIDS(root)[1] = r;
+			root->n = 1;
+			tree->root = root;
+			tree->height++;
+		}
+	}
+	freePool(&pool);
+
+	if (rc == DOUBLE) return TS_ALGO_OK;
+	return rc;
+}
+
+/* ------------------------------------------------------------------------
+ * Find
+ * ------------------------------------------------------------------------
+ */
+void *ts_algo_btree_find(ts_algo_btree_t *tree, void *cont) {
+	ts_algo_btree_node_t *node = tree->root;
+	char eq = 0;
+	int i;
+
+	if (node == NULL) return NULL;
+	while(!node->leaf) {
+		i = innerpos(tree, node, cont, &eq);
+		/* separators are contents */
+		if (eq) return KEYS(node)[i-1];
+		node = KIDS(node)[i];
+	}
+	i = leafpos(tree, node, cont, &eq);
+	if (eq) return CONT(node)[i];
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------
+ * Delete
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_btree_delete(ts_algo_btree_t *tree, void *cont) {
+	void *found = NULL;
+	char sep = 0;
+
+	if (tree->root == NULL) return;
+	if (!delete(tree, tree->root, cont, &found, &sep)) return;
+	tree->count--;
+
+	/* the root has one kid left or it is empty */
+	if (!tree->root->leaf && tree->root->n == 0) {
+		ts_algo_btree_node_t *tmp = tree->root;
+		tree->root = KIDS(tmp)[0];
+		tree->height--;
+		free(tmp);
+	} else if (tree->root->leaf && tree->root->n == 0) {
+		free(tree->root);
+		tree->root   = NULL;
+		tree->first  = NULL;
+		tree->height = 0;
+	}
+	/* found is still valid for comparing */
+	if (sep && tree->root != NULL) fixsep(tree, found);
+	tree->onDelete(tree, &found);
+}
+
+/* ------------------------------------------------------------------------
+ * Height
+ * ------------------------------------------------------------------------
+ */
+int ts_algo_btree_height(ts_algo_btree_t *tree) {
+	return tree->height;
+}
+
+/* ------------------------------------------------------------------------
+ * Check the structure
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_btree_check(ts_algo_btree_t *tree) {
+	ts_algo_btree_node_t *prv = NULL;
+	uint32_t n = 0;
+	void *min;
+
+	if (tree->root == NULL) return (tree->count == 0 &&
+	                                tree->first == NULL);
+	if (!checktree(tree, tree->root, 1, NULL, NULL, &min)) return FALSE;
+
+	/* the leaves are linked in order */
+	for(ts_algo_btree_node_t *l=tree->first; l!=NULL; l=l->u.lf.nxt) {
+		if (l->u.lf.prv != prv) return FALSE;
+		if (prv != NULL && tree->compare(tree, CONT(prv)[prv->n-1],
+		                         CONT(l)[0]) != ts_algo_cmp_less) return FALSE;
+		n += l->n; prv = l;
+	}
+	return (n == tree->count);
+}
+
+/* ------------------------------------------------------------------------
+ * Show
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_btree_show(ts_algo_btree_t *tree) {
+	for(ts_algo_btree_node_t *l=tree->first; l!=NULL; l=l->u.lf.nxt) {
+		for(int i=0; i<l->n; i++) tree->show(CONT(l)[i]);
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * Tree to list
+ * ------------------------------------------------------------------------
+ */
+ts_algo_list_t *ts_algo_btree_toList(ts_algo_btree_t *tree) {
+	ts_algo_list_t *list;
+
+	if (tree->root == NULL) return NULL;
+
+	list = malloc(sizeof(ts_algo_list_t));
+	if (list == NULL) return NULL;
+	ts_algo_list_init(list);
+
+	for(ts_algo_btree_node_t *l=tree->first; l!=NULL; l=l->u.lf.nxt) {
+		for(int i=0; i<l->n; i++) {
+			if (ts_algo_list_append(list, CONT(l)[i]) != TS_ALGO_OK) {
+				ts_algo_list_destroy(list); free(list);
+				return NULL;
+			}
+		}
+	}
+	return list;
+}
+
+/* ------------------------------------------------------------------------
+ * Map
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_map(ts_algo_btree_t *tree, ts_algo_mapper_t map) {
+	if (tree == NULL) return TS_ALGO_OK;
+	for(ts_algo_btree_node_t *l=tree->first; l!=NULL; l=l->u.lf.nxt) {
+		for(int i=0; i<l->n; i++) {
+			ts_algo_rc_t rc = map(tree, CONT(l)[i]);
+			if (rc != TS_ALGO_OK) return rc;
+		}
+	}
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Reduce
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_btree_reduce(ts_algo_btree_t    *tree,
+                                  void          *aggregate,
+                                  ts_algo_reducer_t   fold)
+{
+	if (tree == NULL) return TS_ALGO_OK;
+	for(ts_algo_btree_node_t *l=tree->first; l!=NULL; l=l->u.lf.nxt) {
+		for(int i=0; i<l->n; i++) {
+			ts_algo_rc_t rc = fold(tree, aggregate, CONT(l)[i]);
+			if (rc != TS_ALGO_OK) return rc;
+		}
+	}
+	return TS_ALGO_OK;
+}
@@ -0,0 +1,629 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Cuckoo Map Datatype Implementation
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <tsalgo/ckmap.h>
+
+/* ----------------------------------------------------------------------------
+ * Just shorthands
+ * ----------------------------------------------------------------------------
+ */
+#define entry_t  ts_algo_ckmap_entry_t
+#define bucket_t ts_algo_ckmap_bucket_t
+#define table_t  ts_algo_ckmap_table_t
+#define WAYS     TS_ALGO_CKMAP_WAYS
+
+/* ----------------------------------------------------------------------------
+ * The stripe of bucket b
+ * ----------------------------------------------------------------------------
+ */
+#define STRIPE(b) ((b)&(TS_ALGO_CKMAP_STRIPES-1))
+
+/* ----------------------------------------------------------------------------
+ * Atomic shorthands
+ * ----------------------------------------------------------------------------
+ */
+#define LOAD(p)    __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE(p,v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/* ----------------------------------------------------------------------------
+ * Spins before we yield the processor
+ * ----------------------------------------------------------------------------
+ */
+#define SPIN 64
+
+/* ----------------------------------------------------------------------------
+ * Greatest number of buckets inspected when searching a cuckoo path
+ * ----------------------------------------------------------------------------
+ */
+#define MAXBFS 512
+
+/* ----------------------------------------------------------------------------
+ * Cuckoo paths invalidated by concurrent writers before we double
+ * ----------------------------------------------------------------------------
+ */
+#define MAXTRIES 8
+
+/* ----------------------------------------------------------------------------
+ * Entries kicked out when placing an entry into a new table
+ * ----------------------------------------------------------------------------
+ */
+#define MAXKICKS 512
+
+/* ----------------------------------------------------------------------------
+ * We double only when the table is filled by half;
+ * if a table with less entries has no room, the hash is degenerate
+ * and doubling would not help.
+ * ----------------------------------------------------------------------------
+ */
+#define LOADED(m,t) \
+	(ts_algo_ckmap_count(m) >= (uint64_t)(t)->nbkt*WAYS/2)
+
+/* ----------------------------------------------------------------------------
+ * Internal return code: the cuckoo path was invalidated by another writer
+ * ----------------------------------------------------------------------------
+ */
+#define RETRY 1
+
+/* ----------------------------------------------------------------------------
+ * Helper: wait a bit
+ * ----------------------------------------------------------------------------
+ */
+static inline void backoff(int i) {
+	if (i >= SPIN) sched_yield();
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: the two buckets of hash h
+ * ----------------------------------------------------------------------------
+ */
+static inline uint32_t bucket1(table_t *t, uint64_t h) {
+	return (uint32_t)h&(t->nbkt-1);
+}
+
+static inline uint32_t bucket2(table_t *t, uint64_t h) {
+	uint32_t b1 = bucket1(t, h);
+	uint32_t b2 = (uint32_t)(h>>32)&(t->nbkt-1);
+	return b1 == b2 ? b1^1 : b2;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: the other bucket of an entry with hash h in bucket b
+ * ----------------------------------------------------------------------------
+ */
+static inline uint32_t altbucket(table_t *t, uint64_t h, uint32_t b) {
+	uint32_t b1 = bucket1(t, h);
+	return b == b1 ? bucket2(t, h) : b1;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: lock and unlock stripes
+ * ----------------------------------------------------------------------------
+ */
+static inline void lockstripe(ts_algo_ckmap_t *map, uint32_t s) {
+	for(int i=0;;i++) {
+		uint32_t v = __atomic_load_n(map->ver+s, __ATOMIC_RELAXED);
+		if (!(v&1) && __atomic_compare_exchange_n(map->ver+s, &v, v+1, 0,
+		                           __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return;
+		}
+		backoff(i);
+	}
+}
+
+static inline void unlockstripe(ts_algo_ckmap_t *map, uint32_t s) {
+	__atomic_fetch_add(map->ver+s, 1, __ATOMIC_RELEASE);
+}
+
+// stripes are locked in ascending order
+static inline void lock2(ts_algo_ckmap_t *map, uint32_t s1, uint32_t s2) {
+	if (s1 > s2) {
+		uint32_t tmp = s1; s1 = s2; s2 = tmp;
+	}
+	lockstripe(map, s1);
+	if (s2 != s1) lockstripe(map, s2);
+}
+
+static inline void unlock2(ts_algo_ckmap_t *map, uint32_t s1, uint32_t s2) {
+	unlockstripe(map, s1);
+	if (s2 != s1) unlockstripe(map, s2);
+}
+
+static inline void lockall(ts_algo_ckmap_t *map) {
+	for(uint32_t s=0; s<TS_ALGO_CKMAP_STRIPES; s++) lockstripe(map, s);
+}
+
+static inline void unlockall(ts_algo_ckmap_t *map) {
+	for(uint32_t s=0; s<TS_ALGO_CKMAP_STRIPES; s++) unlockstripe(map, s);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: find the key in bucket b; returns the slot or -1
+ * ----------------------------------------------------------------------------
+ */
+static inline int findin(bucket_t *b, uint64_t h, char *key, size_t ksz,
+                                                   entry_t **found) {
+	for(int i=0; i<WAYS; i++) {
+		entry_t *e = LOAD(&b->e[i]);
+		if (e != NULL && e->slot.hash == h && e->slot.ksz == ksz &&
+		    memcmp(e->key, key, ksz) == 0) {
+			*found = e; return i;
+		}
+	}
+	return -1;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: put the entry into a free slot of b (if any)
+ * ----------------------------------------------------------------------------
+ */
+static inline char putin(bucket_t *b, entry_t *e) {
+	for(int i=0; i<WAYS; i++) {
+		if (b->e[i] == NULL) {
+			STORE(&b->e[i], e); return 1;
+		}
+	}
+	return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: allocate a table
+ * ----------------------------------------------------------------------------
+ */
+static table_t *newtable(uint32_t nbkt) {
+	table_t *t = malloc(sizeof(table_t));
+	if (t == NULL) return NULL;
+	t->bkts = calloc(nbkt, sizeof(bucket_t));
+	if (t->bkts == NULL) {
+		free(t); return NULL;
+	}
+	t->nbkt = nbkt;
+	t->nxt = NULL;
+	return t;
+}
+
+static void freetable(table_t *t) {
+	free(t->bkts); free(t);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: put an entry or a table on the retire list
+ * ----------------------------------------------------------------------------
+ */
+static void retire(ts_algo_ckmap_t *map, entry_t *e, table_t *t) {
+	pthread_mutex_lock(&map->rtl);
+	if (e != NULL) {
+		e->nxt = map->rentries; map->rentries = e;
+	}
+	if (t != NULL) {
+		t->nxt = map->rtables; map->rtables = t;
+	}
+	pthread_mutex_unlock(&map->rtl);
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map and initialise it
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_ckmap_t *ts_algo_ckmap_new(uint32_t            sz,
+                                   ts_algo_hash_t     hsh,
+                                   ts_algo_delete_t   del) {
+	ts_algo_ckmap_t *map = malloc(sizeof(ts_algo_ckmap_t));
+	if (map == NULL) return NULL;
+	ts_algo_rc_t rc = ts_algo_ckmap_init(map, sz, hsh, del);
+	if (rc != TS_ALGO_OK) {
+		free(map); return NULL;
+	}
+	return map;
+}
+
+/* ----------------------------------------------------------------------------
+ * Initialise an already allocated map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_ckmap_init(ts_algo_ckmap_t   *map,
+                                uint32_t            sz,
+                                ts_algo_hash_t     hsh,
+                                ts_algo_delete_t   del) {
+	uint32_t nbkt = 16;
+
+	if (map == NULL) return TS_ALGO_INVALID;
+
+	// we aim at a load of less than 3/4
+	while(nbkt < 0x80000000 && nbkt*3 < sz) nbkt<<=1;
+
+	map->hsh = hsh==NULL?ts_algo_hash_bytes:hsh;
+	map->rsc = NULL;
+	map->del = del;
+	map->count = 0;
+	map->rentries = NULL;
+	map->rtables = NULL;
+	map->ver = calloc(TS_ALGO_CKMAP_STRIPES, sizeof(uint32_t));
+	if (map->ver == NULL) return TS_ALGO_NO_MEM;
+	map->tab = newtable(nbkt);
+	if (map->tab == NULL) {
+		free(map->ver); map->ver = NULL;
+		return TS_ALGO_NO_MEM;
+	}
+	if (pthread_mutex_init(&map->grow, NULL) != 0) {
+		freetable(map->tab); map->tab = NULL;
+		free(map->ver); map->ver = NULL;
+		return TS_ALGO_ERR;
+	}
+	if (pthread_mutex_init(&map->rtl, NULL) != 0) {
+		pthread_mutex_destroy(&map->grow);
+		freetable(map->tab); map->tab = NULL;
+		free(map->ver); map->ver = NULL;
+		return TS_ALGO_ERR;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Destroy the map
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_ckmap_destroy(ts_algo_ckmap_t *map) {
+	if (map == NULL) return;
+	if (map->tab == NULL) return;
+	for(uint32_t i=0; i<map->tab->nbkt; i++) {
+		for(int j=0; j<WAYS; j++) {
+			entry_t *e = map->tab->bkts[i].e[j];
+			if (e == NULL) continue;
+			if (map->del != NULL) map->del(NULL, &e->slot.data);
+			free(e);
+		}
+	}
+	ts_algo_ckmap_reclaim(map);
+	freetable(map->tab); map->tab = NULL;
+	free(map->ver); map->ver = NULL;
+	pthread_mutex_destroy(&map->grow);
+	pthread_mutex_destroy(&map->rtl);
+	map->count = 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Free the retired entries and tables
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_ckmap_reclaim(ts_algo_ckmap_t *map) {
+	pthread_mutex_lock(&map->rtl);
+	entry_t *e = map->rentries;
+	table_t *t = map->rtables;
+	map->rentries = NULL;
+	map->rtables = NULL;
+	pthread_mutex_unlock(&map->rtl);
+
+	while(e != NULL) {
+		entry_t *tmp = e->nxt;
+		free(e); e = tmp;
+	}
+	while(t != NULL) {
+		table_t *tmp = t->nxt;
+		freetable(t); t = tmp;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Number of elements
+ * ----------------------------------------------------------------------------
+ */
+uint32_t ts_algo_ckmap_count(ts_algo_ckmap_t *map) {
+	return __atomic_load_n(&map->count, __ATOMIC_RELAXED);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: lock the stripes of the buckets of h in the current table.
+ *         When we hold the stripes, the table cannot be doubled,
+ *         but it may have been doubled before we got them.
+ * ----------------------------------------------------------------------------
+ */
+static inline table_t *lockbuckets(ts_algo_ckmap_t *map, uint64_t h,
+                                   uint32_t *b1, uint32_t *b2) {
+	for(;;) {
+		table_t *t = LOAD(&map->tab);
+		*b1 = bucket1(t, h);
+		*b2 = bucket2(t, h);
+		lock2(map, STRIPE(*b1), STRIPE(*b2));
+		if (LOAD(&map->tab) == t) return t;
+		unlock2(map, STRIPE(*b1), STRIPE(*b2));
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: add the entry if there is room in one of its buckets
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t tryadd(ts_algo_ckmap_t *map, entry_t *e) {
+	uint32_t b1, b2;
+	entry_t *x;
+	ts_algo_rc_t rc = TS_ALGO_ERR;
+	table_t *t = lockbuckets(map, e->slot.hash, &b1, &b2);
+
+	if (findin(t->bkts+b1, e->slot.hash, e->key, e->slot.ksz, &x) >= 0 ||
+	    findin(t->bkts+b2, e->slot.hash, e->key, e->slot.ksz, &x) >= 0) {
+		rc = TS_ALGO_INVALID;
+	} else if (putin(t->bkts+b1, e) || putin(t->bkts+b2, e)) {
+		__atomic_fetch_add(&map->count, 1, __ATOMIC_RELAXED);
+		rc = TS_ALGO_OK;
+	}
+	unlock2(map, STRIPE(b1), STRIPE(b2));
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Cuckoo path: a breadth-first search from the buckets of the new key
+ * to a bucket with a free slot; every node remembers the node
+ * from which it was reached and the slot of the entry that would move.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	uint32_t bkt;
+	int32_t  parent;
+	int      slot;
+} pathnode_t;
+
+/* ----------------------------------------------------------------------------
+ * Helper: move the entries along the path backwards starting from
+ *         node k, whose bucket has a free slot. Each move locks
+ *         the stripes of the two buckets and checks that the path
+ *         is still valid. (The caller holds the 'grow' mutex.)
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t movepath(ts_algo_ckmap_t *map, table_t *t,
+                             pathnode_t *q, int32_t k) {
+	while(q[k].parent >= 0) {
+		uint32_t from = q[q[k].parent].bkt;
+		uint32_t to   = q[k].bkt;
+		int      i    = q[k].slot;
+		char     ok   = 0;
+
+		lock2(map, STRIPE(from), STRIPE(to));
+		entry_t *e = t->bkts[from].e[i];
+		if (e == NULL) {
+			// someone else made room
+			unlock2(map, STRIPE(from), STRIPE(to));
+			return TS_ALGO_OK;
+		}
+		if (altbucket(t, e->slot.hash, from) == to) {
+			ok = putin(t->bkts+to, e);
+			if (ok) STORE(&t->bkts[from].e[i], NULL);
+		}
+		unlock2(map, STRIPE(from), STRIPE(to));
+		if (!ok) return RETRY;
+		k = q[k].parent;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: make room in one of the buckets of h
+ *         by moving entries to their alternative buckets.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t cuckoo(ts_algo_ckmap_t *map, uint64_t h) {
+	pathnode_t q[MAXBFS];
+	int32_t head = 0, tail = 0;
+	table_t *t = LOAD(&map->tab);
+
+	q[tail].bkt = bucket1(t, h); q[tail].parent = -1; q[tail++].slot = 0;
+	q[tail].bkt = bucket2(t, h); q[tail].parent = -1; q[tail++].slot = 0;
+
+	for(; head < tail; head++) {
+		bucket_t *b = t->bkts+q[head].bkt;
+		for(int i=0; i<WAYS; i++) {
+			if (LOAD(&b->e[i]) == NULL) return movepath(map, t, q, head);
+		}
+		for(int i=0; i<WAYS && tail < MAXBFS; i++) {
+			entry_t *e = LOAD(&b->e[i]);
+			if (e == NULL) continue;
+			q[tail].bkt = altbucket(t, e->slot.hash, q[head].bkt);
+			q[tail].parent = head;
+			q[tail++].slot = i;
+		}
+	}
+	return TS_ALGO_ERR;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: place an entry in a table that nobody else sees yet,
+ *         kicking out other entries if needed.
+ *         If this fails, one entry is not in the table.
+ * ----------------------------------------------------------------------------
+ */
+static char place(table_t *t, entry_t *e) {
+	uint32_t b = bucket1(t, e->slot.hash);
+	for(int n=0; n<MAXKICKS; n++) {
+		uint32_t a = altbucket(t, e->slot.hash, b);
+		if (putin(t->bkts+b, e) || putin(t->bkts+a, e)) return 1;
+		// kick out one entry of b, which then goes to its other bucket
+		entry_t *x = t->bkts[b].e[n%WAYS];
+		t->bkts[b].e[n%WAYS] = e;
+		e = x;
+		b = altbucket(t, e->slot.hash, b);
+	}
+	return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: double the table (the caller holds the 'grow' mutex).
+ *         All stripes are locked while the entries are moved,
+ *         so writers and readers wait. If the entries do not fit
+ *         into the new table, the old table is kept.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t doubletable(ts_algo_ckmap_t *map) {
+	table_t *o = map->tab;
+	table_t *t;
+
+	if (o->nbkt >= 0x80000000) return TS_ALGO_NO_MEM;
+
+	lockall(map);
+	t = newtable(o->nbkt<<1);
+	if (t == NULL) {
+		unlockall(map); return TS_ALGO_NO_MEM;
+	}
+	for(uint32_t i=0; i<o->nbkt; i++) {
+		for(int j=0; j<WAYS; j++) {
+			if (o->bkts[i].e[j] == NULL) continue;
+			if (!place(t, o->bkts[i].e[j])) {
+				unlockall(map); freetable(t);
+				return TS_ALGO_ERR;
+			}
+		}
+	}
+	STORE(&map->tab, t);
+	unlockall(map);
+	retire(map, NULL, o);
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Add
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_ckmap_add(ts_algo_ckmap_t *map, char *key, size_t ksz,
+                                                              void *data) {
+	ts_algo_rc_t rc;
+	entry_t *e = malloc(sizeof(entry_t)+ksz);
+	if (e == NULL) return TS_ALGO_NO_MEM;
+
+	memcpy(e->key, key, ksz);
+	e->slot.key  = e->key;
+	e->slot.ksz  = ksz;
+	e->slot.hash = map->hsh(key, ksz, map->rsc);
+	e->slot.data = data;
+	e->nxt = NULL;
+
+	for(;;) {
+		rc = tryadd(map, e);
+		if (rc == TS_ALGO_OK) return rc;
+		if (rc != TS_ALGO_ERR) break;
+
+		// both buckets are full
+		pthread_mutex_lock(&map->grow);
+		rc = RETRY;
+		for(int i=0; i<MAXTRIES && rc == RETRY; i++) {
+			rc = cuckoo(map, e->slot.hash);
+		}
+		if (rc != TS_ALGO_OK) {
+			rc = LOADED(map, map->tab) ? doubletable(map) : TS_ALGO_ERR;
+		}
+		pthread_mutex_unlock(&map->grow);
+		if (rc != TS_ALGO_OK) break;
+	}
+	free(e);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get (lock-free)
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_ckmap_get(ts_algo_ckmap_t *map, char *key, size_t ksz) {
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+
+	for(int i=0;;i++) {
+		table_t  *t  = LOAD(&map->tab);
+		uint32_t  b1 = bucket1(t, h);
+		uint32_t  b2 = bucket2(t, h);
+		uint32_t *v1 = map->ver+STRIPE(b1);
+		uint32_t *v2 = map->ver+STRIPE(b2);
+		uint32_t  x1 = LOAD(v1);
+		uint32_t  x2 = LOAD(v2);
+
+		// the table may have been doubled before we read the versions
+		if (!((x1|x2)&1) && LOAD(&map->tab) == t) {
+			entry_t *e = NULL;
+			void *data = NULL;
+			if (findin(t->bkts+b1, h, key, ksz, &e) >= 0 ||
+			    findin(t->bkts+b2, h, key, ksz, &e) >= 0) {
+				data = LOAD(&e->slot.data);
+			}
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(v1, __ATOMIC_RELAXED) == x1 &&
+			    __atomic_load_n(v2, __ATOMIC_RELAXED) == x2) return data;
+		}
+		backoff(i);
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Remove
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_ckmap_remove(ts_algo_ckmap_t *map, char *key, size_t ksz) {
+	uint32_t b1, b2;
+	entry_t *e = NULL;
+	void *data = NULL;
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	table_t *t = lockbuckets(map, h, &b1, &b2);
+
+	int i = findin(t->bkts+b1, h, key, ksz, &e);
+	uint32_t b = b1;
+	if (i < 0) {
+		i = findin(t->bkts+b2, h, key, ksz, &e); b = b2;
+	}
+	if (i >= 0) {
+		STORE(&t->bkts[b].e[i], NULL);
+		__atomic_fetch_sub(&map->count, 1, __ATOMIC_RELAXED);
+		data = LOAD(&e->slot.data);
+	}
+	unlock2(map, STRIPE(b1), STRIPE(b2));
+	if (i >= 0) retire(map, e, NULL);
+	return data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Delete
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_ckmap_delete(ts_algo_ckmap_t *map, char *key, size_t ksz) {
+	void *data = ts_algo_ckmap_remove(map, key, ksz);
+	if (data != NULL && map->del != NULL) map->del(NULL, &data);
+}
+
+/* ----------------------------------------------------------------------------
+ * Update
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_ckmap_update(ts_algo_ckmap_t *map, char *key, size_t ksz,
+                                                            void *data) {
+	uint32_t b1, b2;
+	entry_t *e = NULL;
+	void *old = NULL;
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	table_t *t = lockbuckets(map, h, &b1, &b2);
+
+	if (findin(t->bkts+b1, h, key, ksz, &e) >= 0 ||
+	    findin(t->bkts+b2, h, key, ksz, &e) >= 0) {
+		old = __atomic_exchange_n(&e->slot.data, data, __ATOMIC_ACQ_REL);
+	}
+	unlock2(map, STRIPE(b1), STRIPE(b2));
+	return old;
+}
+
+/* ----------------------------------------------------------------------------
+ * Apply fun on all slots
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_ckmap_forEach(ts_algo_ckmap_t     *map,
+                                   ts_algo_map_visit_t  fun,
+                                   void                *rsc) {
+	ts_algo_rc_t rc = TS_ALGO_OK;
+	pthread_mutex_lock(&map->grow);
+	table_t *t = map->tab;
+	for(uint32_t i=0; i<t->nbkt && rc == TS_ALGO_OK; i++) {
+		for(int j=0; j<WAYS && rc == TS_ALGO_OK; j++) {
+			entry_t *e = LOAD(&t->bkts[i].e[j]);
+			if (e != NULL) rc = fun(rsc, &e->slot);
+		}
+	}
+	pthread_mutex_unlock(&map->grow);
+	return rc;
+}
@@ -0,0 +1,231 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Concurrent Map Datatype Implementation
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <tsalgo/cmap.h>
+
+/* ----------------------------------------------------------------------------
+ * Default number of shards per processor
+ * ----------------------------------------------------------------------------
+ */
+#define SHARDSPERCPU 4
+
+/* ----------------------------------------------------------------------------
+ * Helper: the shard of hash h
+ * ----------------------------------------------------------------------------
+ */
+#define SHARD(m,h) \
+	((m)->shards+((m)->shift==64?0:(h)>>(m)->shift))
+
+/* ----------------------------------------------------------------------------
+ * Lock shorthands
+ * ----------------------------------------------------------------------------
+ */
+#define RDLOCK(s) pthread_rwlock_rdlock(&(s)->lock)
+#define WRLOCK(s) pthread_rwlock_wrlock(&(s)->lock)
+#define UNLOCK(s) pthread_rwlock_unlock(&(s)->lock)
+
+/* ----------------------------------------------------------------------------
+ * Helper: the shards share the hash function and the resource
+ *         of the concurrent map, which may be set by the application
+ *         after initialisation.
+ * ----------------------------------------------------------------------------
+ */
+static uint64_t shardhash(const char *key, size_t ksz, void *rsc) {
+	ts_algo_cmap_t *map = rsc;
+	return map->hsh(key, ksz, map->rsc);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: lock the shard of hash h; the hash is passed on
+ *         to the shard map, so the key is hashed only once.
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_cmap_shard_t *lockshard(ts_algo_cmap_t *map,
+                                              uint64_t h, char exclusive) {
+	ts_algo_cmap_shard_t *s = SHARD(map, h);
+	if (exclusive) WRLOCK(s); else RDLOCK(s);
+	return s;
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map and initialise it
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_cmap_t *ts_algo_cmap_new(uint32_t nshards,
+                                 uint32_t      sz,
+                                 ts_algo_hash_t   hsh,
+                                 ts_algo_delete_t del,
+                                 uint32_t        mode) {
+	ts_algo_cmap_t *map = malloc(sizeof(ts_algo_cmap_t));
+	if (map == NULL) return NULL;
+	ts_algo_rc_t rc = ts_algo_cmap_init(map, nshards, sz, hsh, del, mode);
+	if (rc != TS_ALGO_OK) {
+		free(map); return NULL;
+	}
+	return map;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: destroy the first n shards
+ * ----------------------------------------------------------------------------
+ */
+static void destroyshards(ts_algo_cmap_t *map, uint32_t n) {
+	for(uint32_t i=0; i<n; i++) {
+		ts_algo_map_destroy(&map->shards[i].map);
+		pthread_rwlock_destroy(&map->shards[i].lock);
+	}
+	free(map->shards); map->shards = NULL;
+}
+
+/* ----------------------------------------------------------------------------
+ * Initialise an already allocated map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_cmap_init(ts_algo_cmap_t *map,
+                               uint32_t    nshards,
+                               uint32_t         sz,
+                               ts_algo_hash_t   hsh,
+                               ts_algo_delete_t del,
+                               uint32_t        mode) {
+	uint32_t i;
+
+	if (map == NULL) return TS_ALGO_INVALID;
+	if (nshards == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		nshards = n>0?(uint32_t)n*SHARDSPERCPU:SHARDSPERCPU;
+	}
+	if (nshards > 65536) return TS_ALGO_INVALID;
+
+	map->nshards = 1; map->shift = 64;
+	while(map->nshards < nshards) {
+		map->nshards<<=1; map->shift--;
+	}
+	map->hsh = hsh==NULL?ts_algo_hash_bytes:hsh;
+	map->rsc = NULL;
+
+	if (posix_memalign((void**)&map->shards, 64,
+	                   map->nshards*sizeof(ts_algo_cmap_shard_t)) != 0) {
+		map->shards = NULL;
+		return TS_ALGO_NO_MEM;
+	}
+	for(i=0; i<map->nshards; i++) {
+		ts_algo_cmap_shard_t *s = map->shards+i;
+		if (pthread_rwlock_init(&s->lock, NULL) != 0) break;
+		if (ts_algo_map_initMode(&s->map, sz, shardhash,
+		                               del, mode) != TS_ALGO_OK) {
+			pthread_rwlock_destroy(&s->lock);
+			break;
+		}
+		s->map.rsc = map;
+	}
+	if (i < map->nshards) {
+		destroyshards(map, i);
+		return TS_ALGO_NO_MEM;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Destroy the map
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_cmap_destroy(ts_algo_cmap_t *map) {
+	if (map == NULL || map->shards == NULL) return;
+	destroyshards(map, map->nshards);
+}
+
+/* ----------------------------------------------------------------------------
+ * Add
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_cmap_add(ts_algo_cmap_t *map, char *key, size_t ksz, void *data) {
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	ts_algo_cmap_shard_t *s = lockshard(map, h, 1);
+	ts_algo_rc_t rc = ts_algo_map_addHashed(&s->map, key, ksz, h, data);
+	UNLOCK(s);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get (in incremental mode get moves entries and in stats mode
+ *      it counts; we then need the exclusive lock)
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_cmap_get(ts_algo_cmap_t *map, char *key, size_t ksz) {
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	ts_algo_cmap_shard_t *s = lockshard(map, h,
+	                  map->shards->map.mode & (TS_ALGO_MAP_INCREMENTAL |
+	                                           TS_ALGO_MAP_STATS));
+	void *data = ts_algo_map_getHashed(&s->map, key, ksz, h);
+	UNLOCK(s);
+	return data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Remove
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_cmap_remove(ts_algo_cmap_t *map, char *key, size_t ksz) {
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	ts_algo_cmap_shard_t *s = lockshard(map, h, 1);
+	void *data = ts_algo_map_removeHashed(&s->map, key, ksz, h);
+	UNLOCK(s);
+	return data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Delete (the data are deleted outside of the lock)
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_cmap_delete(ts_algo_cmap_t *map, char *key, size_t ksz) {
+	void *data = ts_algo_cmap_remove(map, key, ksz);
+	ts_algo_delete_t del = map->shards->map.del;
+	if (data != NULL && del != NULL) del(NULL, &data);
+}
+
+/* ----------------------------------------------------------------------------
+ * Update
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_cmap_update(ts_algo_cmap_t *map, char *key, size_t ksz, void *data) {
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	ts_algo_cmap_shard_t *s = lockshard(map, h, 1);
+	void *old = ts_algo_map_updateHashed(&s->map, key, ksz, h, data);
+	UNLOCK(s);
+	return old;
+}
+
+/* ----------------------------------------------------------------------------
+ * Count
+ * ----------------------------------------------------------------------------
+ */
+uint32_t ts_algo_cmap_count(ts_algo_cmap_t *map) {
+	uint32_t n = 0;
+	for(uint32_t i=0; i<map->nshards; i++) {
+		ts_algo_cmap_shard_t *s = map->shards+i;
+		RDLOCK(s); n += s->map.count; UNLOCK(s);
+	}
+	return n;
+}
+
+/* ----------------------------------------------------------------------------
+ * ForEach
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_cmap_forEach(ts_algo_cmap_t      *map,
+                                  ts_algo_map_visit_t  fun,
+                                  void                *rsc) {
+	for(uint32_t i=0; i<map->nshards; i++) {
+		ts_algo_cmap_shard_t *s = map->shards+i;
+		WRLOCK(s);
+		ts_algo_rc_t rc = ts_algo_map_forEach(&s->map, fun, rsc);
+		UNLOCK(s);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
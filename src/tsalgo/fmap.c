@@ -0,0 +1,466 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The File Map Datatype Implementation
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tsalgo/fmap.h>
+
+/* ----------------------------------------------------------------------------
+ * Just shorthands
+ * ----------------------------------------------------------------------------
+ */
+#define head_t ts_algo_fmap_head_t
+#define slot_t ts_algo_fmap_slot_t
+
+/* ----------------------------------------------------------------------------
+ * Keys and values are padded to 8 bytes
+ * ----------------------------------------------------------------------------
+ */
+#define ALIGN8(x) (((uint64_t)(x)+7)&~(uint64_t)7)
+
+/* ----------------------------------------------------------------------------
+ * Byte order mark
+ * ----------------------------------------------------------------------------
+ */
+#define ORDER 0x01020304
+
+/* ----------------------------------------------------------------------------
+ * Helper: write n bytes (n may be 0)
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_rc_t writebytes(FILE *f, const void *p, size_t n) {
+	if (n == 0) return TS_ALGO_OK;
+	if (fwrite(p, n, 1, f) != 1) return TS_ALGO_FWRITE;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: write zeros up to the next multiple of 8
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_rc_t pad(FILE *f, uint64_t n) {
+	static const char zeros[8] = {0};
+	return writebytes(f, zeros, ALIGN8(n)-n);
+}
+
+/* ----------------------------------------------------------------------------
+ * Number of seeds we try before we give up (as ts_algo_pmap_t)
+ * ----------------------------------------------------------------------------
+ */
+#define MAXSEEDS 32
+
+/* ----------------------------------------------------------------------------
+ * The perfect hash over the slots of the source map.
+ * Only hashes and positions are kept in memory,
+ * the keys remain in the source map.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_map_slot_t **src; // The slots of the source map
+	uint64_t              *h; // Hash of each key
+	uint32_t            *pos; // Slot of each key
+	uint32_t           *disp; // Displacement per bucket
+	uint64_t            *tmp; // Sorted hashes to find equal hashes
+	uint64_t            seed; // The seed of the hashes
+	uint32_t            nbkt; // Number of buckets
+	uint32_t               n; // Number of keys
+	uint32_t             max; // Number of keys in the source map
+} layout_t;
+
+/* ----------------------------------------------------------------------------
+ * Helper: collect the slots of the source map
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t collect(void *rsc, ts_algo_map_slot_t *s) {
+	layout_t *l = rsc;
+	if (l->n >= l->max) return TS_ALGO_ERR;
+	l->src[l->n++] = s;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: compare hashes
+ * ----------------------------------------------------------------------------
+ */
+static int byhash(const void *one, const void *two) {
+	uint64_t a = *(const uint64_t*)one;
+	uint64_t b = *(const uint64_t*)two;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: keys with the same hash can't be placed.
+ *         If the keys are equal, the input is invalid,
+ *         otherwise, we try another seed.
+ *         Equal hashes are rare; we only then search the keys.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t checkhashes(layout_t *l) {
+	memcpy(l->tmp, l->h, l->n*sizeof(uint64_t));
+	qsort(l->tmp, l->n, sizeof(uint64_t), byhash);
+	for(uint32_t i=1; i<l->n; i++) {
+		if (l->tmp[i] != l->tmp[i-1]) continue;
+		for(uint32_t a=0; a<l->n; a++) {
+			if (l->h[a] != l->tmp[i]) continue;
+			for(uint32_t b=a+1; b<l->n; b++) {
+				ts_algo_map_slot_t *x = l->src[a];
+				ts_algo_map_slot_t *y = l->src[b];
+				if (l->h[b] != l->h[a] || x->ksz != y->ksz) continue;
+				if (x->ksz == 0 || memcmp(x->key, y->key, x->ksz) == 0) {
+					return TS_ALGO_INVALID;
+				}
+			}
+		}
+		return TS_ALGO_ERR;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: compute the perfect hash (as ts_algo_pmap_init)
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t findlayout(layout_t *l) {
+	ts_algo_rc_t rc = TS_ALGO_ERR;
+	for(uint32_t s=0; s<MAXSEEDS; s++) {
+		l->seed = ts_algo_hash_mix64(s, l->n);
+		for(uint32_t i=0; i<l->n; i++) {
+			l->h[i] = ts_algo_hash_bytes(l->src[i]->key,
+			                             l->src[i]->ksz, &l->seed);
+		}
+		rc = checkhashes(l);
+		if (rc == TS_ALGO_INVALID) return rc;
+		if (rc != TS_ALGO_OK) continue;
+
+		rc = ts_algo_pmap_layout(l->h, l->n, l->nbkt, l->disp, l->pos);
+		if (rc != TS_ALGO_ERR) break;
+	}
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: release the layout
+ * ----------------------------------------------------------------------------
+ */
+static void freelayout(layout_t *l) {
+	if (l->src  != NULL) free(l->src);
+	if (l->h    != NULL) free(l->h);
+	if (l->pos  != NULL) free(l->pos);
+	if (l->disp != NULL) free(l->disp);
+	if (l->tmp  != NULL) free(l->tmp);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: compute the layout of the perfect hash for the map
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t initlayout(layout_t *l, ts_algo_map_t *map) {
+	ts_algo_rc_t rc;
+	uint32_t n = map->count;
+
+	memset(l, 0, sizeof(layout_t));
+	if (n == 0) return TS_ALGO_OK;
+
+	l->max  = n;
+	l->nbkt = n/TS_ALGO_PMAP_LAMBDA + 1;
+	l->src  = malloc(n*sizeof(ts_algo_map_slot_t*));
+	l->h    = malloc(n*sizeof(uint64_t));
+	l->pos  = malloc(n*sizeof(uint32_t));
+	l->disp = malloc(l->nbkt*sizeof(uint32_t));
+	l->tmp  = malloc(n*sizeof(uint64_t));
+	if (l->src == NULL || l->h    == NULL || l->pos == NULL ||
+	    l->disp == NULL || l->tmp == NULL) {
+		freelayout(l); return TS_ALGO_NO_MEM;
+	}
+	rc = ts_algo_map_forEach(map, collect, l);
+	if (rc == TS_ALGO_OK && l->n != n) rc = TS_ALGO_ERR;
+	if (rc == TS_ALGO_OK) rc = findlayout(l);
+
+	// the sorted hashes are not needed anymore
+	free(l->tmp); l->tmp = NULL;
+
+	if (rc != TS_ALGO_OK) freelayout(l);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: write the records into the stream;
+ *         keys and values are streamed from the source map
+ *         in the order of the source map.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t writelayout(layout_t             *l,
+                                FILE                  *f,
+                                ts_algo_fmap_value_t val,
+                                void                 *rsc) {
+	ts_algo_rc_t rc = TS_ALGO_OK;
+	slot_t  *slots = NULL;
+	uint64_t off;
+	head_t   head;
+
+	memset(&head, 0, sizeof(head_t));
+	memcpy(head.magic, TS_ALGO_FMAP_MAGIC, 8);
+	head.version = TS_ALGO_FMAP_VERSION;
+	head.order   = ORDER;
+	head.count   = l->n;
+	head.nbkt    = l->nbkt;
+	head.seed    = l->seed;
+	head.disp    = ALIGN8(sizeof(head_t));
+
+	if (l->n > 0) {
+		slots = malloc(l->n*sizeof(slot_t));
+		if (slots == NULL) return TS_ALGO_NO_MEM;
+	}
+
+	// header (written again at the end), displacements
+	rc = writebytes(f, &head, sizeof(head_t));
+	if (rc != TS_ALGO_OK) goto cleanup;
+	rc = pad(f, sizeof(head_t));
+	if (rc != TS_ALGO_OK) goto cleanup;
+	rc = writebytes(f, l->disp, head.nbkt*sizeof(uint32_t));
+	if (rc != TS_ALGO_OK) goto cleanup;
+	rc = pad(f, head.nbkt*sizeof(uint32_t));
+	if (rc != TS_ALGO_OK) goto cleanup;
+
+	off = head.disp + ALIGN8(head.nbkt*sizeof(uint32_t));
+
+	// records; the slot of each record is given by the layout
+	for(uint32_t i=0; i<l->n; i++) {
+		ts_algo_map_slot_t *s = l->src[i];
+		slot_t *x = slots+l->pos[i];
+		char  *v;
+		size_t vsz;
+
+		if (val == NULL) {
+			v = (char*)&s->data; vsz = sizeof(void*);
+		} else {
+			rc = val(rsc, s->data, &v, &vsz);
+			if (rc != TS_ALGO_OK) goto cleanup;
+		}
+		if (s->ksz > UINT32_MAX || vsz > UINT32_MAX) {
+			rc = TS_ALGO_INVALID; goto cleanup;
+		}
+		x->hash = l->h[i];
+		x->off  = off;
+		x->ksz  = (uint32_t)s->ksz;
+		x->vsz  = (uint32_t)vsz;
+
+		rc = writebytes(f, s->key, s->ksz);
+		if (rc != TS_ALGO_OK) goto cleanup;
+		rc = pad(f, s->ksz);
+		if (rc != TS_ALGO_OK) goto cleanup;
+		rc = writebytes(f, v, vsz);
+		if (rc != TS_ALGO_OK) goto cleanup;
+		rc = pad(f, vsz);
+		if (rc != TS_ALGO_OK) goto cleanup;
+
+		off += ALIGN8(s->ksz) + ALIGN8(vsz);
+	}
+
+	// slots and final header
+	head.slots = off;
+	head.size  = off + l->n*sizeof(slot_t);
+
+	rc = writebytes(f, slots, l->n*sizeof(slot_t));
+	if (rc != TS_ALGO_OK) goto cleanup;
+	if (fseek(f, 0, SEEK_SET) != 0) {
+		rc = TS_ALGO_FSEEK; goto cleanup;
+	}
+	rc = writebytes(f, &head, sizeof(head_t));
+	if (rc != TS_ALGO_OK) goto cleanup;
+	if (fflush(f) != 0) rc = TS_ALGO_FFLUSH;
+
+cleanup:
+	if (slots != NULL) free(slots);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Write a map into a file
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_fmap_write(ts_algo_map_t       *map,
+                                const char         *path,
+                                ts_algo_fmap_value_t val,
+                                void                *rsc) {
+	ts_algo_rc_t rc;
+	layout_t l;
+	char tmp[MAXPATH];
+	FILE *f;
+
+	if (map == NULL || path == NULL) return TS_ALGO_INVALID;
+	if (strlen(path)+5 > MAXPATH) return TS_ALGO_INVALID;
+	sprintf(tmp, "%s.tmp", path);
+
+	rc = initlayout(&l, map);
+	if (rc != TS_ALGO_OK) return rc;
+
+	f = fopen(tmp, "wb");
+	if (f == NULL) {
+		freelayout(&l);
+		return TS_ALGO_FOPEN;
+	}
+	rc = writelayout(&l, f, val, rsc);
+	if (fclose(f) != 0 && rc == TS_ALGO_OK) rc = TS_ALGO_FFLUSH;
+	freelayout(&l);
+
+	if (rc == TS_ALGO_OK && rename(tmp, path) != 0) rc = TS_ALGO_RENAME;
+	if (rc != TS_ALGO_OK) unlink(tmp);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map and open the file
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_fmap_t *ts_algo_fmap_new(const char *path) {
+	ts_algo_fmap_t *map = malloc(sizeof(ts_algo_fmap_t));
+	if (map == NULL) return NULL;
+	ts_algo_rc_t rc = ts_algo_fmap_open(map, path);
+	if (rc != TS_ALGO_OK) {
+		free(map); return NULL;
+	}
+	return map;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: check the header
+ * ----------------------------------------------------------------------------
+ */
+static char checkhead(const head_t *head, size_t size) {
+	if (memcmp(head->magic, TS_ALGO_FMAP_MAGIC, 8) != 0) return 0;
+	if (head->version != TS_ALGO_FMAP_VERSION) return 0;
+	if (head->order != ORDER) return 0;
+	if (head->size != size) return 0;
+	if (head->count > 0 && head->nbkt == 0) return 0;
+	if (head->disp < sizeof(head_t) || head->disp%8 != 0) return 0;
+	if (head->disp + (uint64_t)head->nbkt*sizeof(uint32_t) > head->slots) {
+		return 0;
+	}
+	if (head->slots%8 != 0 ||
+	    head->slots + (uint64_t)head->count*sizeof(slot_t) != size) {
+		return 0;
+	}
+	return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * Open the file and map it into memory
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_fmap_open(ts_algo_fmap_t *map, const char *path) {
+	struct stat st;
+	void *p;
+
+	if (map == NULL || path == NULL) return TS_ALGO_INVALID;
+	memset(map, 0, sizeof(ts_algo_fmap_t));
+
+	map->fd = open(path, O_RDONLY);
+	if (map->fd < 0) return TS_ALGO_FOPEN;
+
+	if (fstat(map->fd, &st) != 0) {
+		close(map->fd); map->fd = -1;
+		return TS_ALGO_FREAD;
+	}
+	if ((size_t)st.st_size < sizeof(head_t)) {
+		close(map->fd); map->fd = -1;
+		return TS_ALGO_INVALID;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, map->fd, 0);
+	if (p == MAP_FAILED) {
+		close(map->fd); map->fd = -1;
+		return TS_ALGO_FREAD;
+	}
+	map->size = st.st_size;
+	map->base = p;
+	map->head = p;
+	if (!checkhead(map->head, map->size)) {
+		ts_algo_fmap_close(map);
+		return TS_ALGO_INVALID;
+	}
+	map->disp  = (const uint32_t*)(map->base+map->head->disp);
+	map->slots = (const slot_t*)(map->base+map->head->slots);
+
+	// lookups are random: readahead would load pages nobody asked for
+#ifdef MADV_RANDOM
+	madvise(p, map->size, MADV_RANDOM);
+#endif
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Unmap and close the file
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_fmap_close(ts_algo_fmap_t *map) {
+	if (map == NULL) return;
+	if (map->base != NULL) {
+		munmap((void*)map->base, map->size); map->base = NULL;
+	}
+	if (map->fd >= 0) {
+		close(map->fd); map->fd = -1;
+	}
+	map->head  = NULL;
+	map->disp  = NULL;
+	map->slots = NULL;
+	map->size  = 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: is the record of the slot within the file?
+ *         Slots are checked when they are used, not on open,
+ *         which would touch all slot pages.
+ * ----------------------------------------------------------------------------
+ */
+static inline char inside(const ts_algo_fmap_t *map, const slot_t *s) {
+	if (s->off > map->size) return 0;
+	return (ALIGN8(s->ksz) + (uint64_t)s->vsz <= map->size - s->off);
+}
+
+/* ----------------------------------------------------------------------------
+ * Get value: one hash, one probe, one key comparison
+ * ----------------------------------------------------------------------------
+ */
+const char *ts_algo_fmap_get(ts_algo_fmap_t *map, char *key, size_t ksz,
+                                                         size_t *vsz) {
+	const head_t *head = map->head;
+	uint64_t seed = head->seed;
+
+	if (head->count == 0) return NULL;
+
+	uint64_t h = ts_algo_hash_bytes(key, ksz, &seed);
+	uint32_t d = map->disp[ts_algo_pmap_bucket(h, head->nbkt)];
+	const slot_t *s = map->slots+ts_algo_pmap_slot(h, d, head->count);
+
+	if (s->hash != h || s->ksz != ksz) return NULL;
+	if (!inside(map, s)) return NULL;
+	if (ksz > 0 && memcmp(map->base+s->off, key, ksz) != 0) return NULL;
+	if (vsz != NULL) *vsz = s->vsz;
+	return map->base+s->off+ALIGN8(ksz);
+}
+
+/* ----------------------------------------------------------------------------
+ * Apply 'fun' to all keys and values
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_fmap_forEach(ts_algo_fmap_t       *map,
+                                  ts_algo_fmap_visit_t  fun,
+                                  void                 *rsc) {
+	ts_algo_rc_t rc;
+	for(uint32_t i=0; i<map->head->count; i++) {
+		const slot_t *s = map->slots+i;
+		if (!inside(map, s)) return TS_ALGO_INVALID;
+		const char   *k = map->base+s->off;
+		rc = fun(rsc, k, s->ksz, k+ALIGN8(s->ksz), s->vsz);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
@@ -0,0 +1,237 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * Hash Functions
+ * ========================================================================
+ */
+#include <string.h>
+#include <tsalgo/hash.h>
+
+#if defined(__SSE2__) && !defined(TS_ALGO_NO_SIMD)
+#include <emmintrin.h>
+#define SIMD
+#endif
+
+/* ------------------------------------------------------------------------
+ * Constants
+ * ------------------------------------------------------------------------
+ */
+#define P0 0xa0761d6478bd642fULL
+#define P1 0xe7037ed1a0b428dbULL
+#define P2 0x8ebc6af09c88c6e3ULL
+#define P3 0x589965cc75374cc3ULL
+
+#define PRIME32 0x9E3779B1U
+
+static const uint64_t K[8] = {
+	0xbe4ba423396cfeb8ULL, 0x1cad21f72c81017cULL,
+	0xdb979083e96dd4deULL, 0x1f67b3b7a4a44072ULL,
+	0x78e5c0cc4ee679cbULL, 0x2172ffcc7dd05a82ULL,
+	0x8e2443f7744608b8ULL, 0x4c263a81e69035e0ULL
+};
+
+/* ------------------------------------------------------------------------
+ * Keys of this size or longer are processed in stripes of 64 bytes
+ * ------------------------------------------------------------------------
+ */
+#define LONGKEY 256
+#define STRIPE   64
+
+/* ------------------------------------------------------------------------
+ * Get the seed from the resource
+ * ------------------------------------------------------------------------
+ */
+#define SEED(s) ((s)==NULL?0:*(uint64_t*)(s))
+
+/* ------------------------------------------------------------------------
+ * Read 8 and 4 bytes (the byte order is that of the platform)
+ * ------------------------------------------------------------------------
+ */
+static inline uint64_t r64(const unsigned char *p) {
+	uint64_t v; memcpy(&v, p, 8); return v;
+}
+
+static inline uint64_t r32(const unsigned char *p) {
+	uint32_t v; memcpy(&v, p, 4); return v;
+}
+
+/* ------------------------------------------------------------------------
+ * 64x64 -> 128 multiplication; a receives the low, b the high part
+ * ------------------------------------------------------------------------
+ */
+static inline void mul128(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r; *b = (uint64_t)(r>>64);
+#else
+	uint64_t ha = *a>>32, hb = *b>>32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha*hb, rm0 = ha*lb, rm1 = hb*la, rl = la*lb;
+	uint64_t t = rl+(rm0<<32), c = t<rl;
+	uint64_t lo = t+(rm1<<32); c += lo<t;
+	*a = lo; *b = rh+(rm0>>32)+(rm1>>32)+c;
+#endif
+}
+
+/* ------------------------------------------------------------------------
+ * Multiply and fold
+ * ------------------------------------------------------------------------
+ */
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+	mul128(&a, &b); return a^b;
+}
+
+/* ------------------------------------------------------------------------
+ * Long keys: accumulate one stripe in 8 lanes.
+ * Each lane adds the product of the low and the high half
+ * of the keyed input to itself and the input to its neighbour.
+ * ------------------------------------------------------------------------
+ */
+#ifdef SIMD
+static inline void accumulate(uint64_t *acc, const unsigned char *p,
+                                             const uint64_t *sec) {
+	for(int i=0; i<4; i++) {
+		__m128i d = _mm_loadu_si128((const __m128i*)(p+16*i));
+		__m128i s = _mm_loadu_si128((const __m128i*)(sec+2*i));
+		__m128i a = _mm_loadu_si128((const __m128i*)(acc+2*i));
+		__m128i k = _mm_xor_si128(d, s);
+		__m128i h = _mm_shuffle_epi32(k, _MM_SHUFFLE(0,3,0,1));
+		__m128i x = _mm_mul_epu32(k, h);
+		__m128i w = _mm_shuffle_epi32(d, _MM_SHUFFLE(1,0,3,2));
+		a = _mm_add_epi64(a, _mm_add_epi64(x, w));
+		_mm_storeu_si128((__m128i*)(acc+2*i), a);
+	}
+}
+#else
+static inline void accumulate(uint64_t *acc, const unsigned char *p,
+                                             const uint64_t *sec) {
+	for(int j=0; j<8; j++) {
+		uint64_t d = r64(p+8*j);
+		uint64_t k = d^sec[j];
+		acc[j^1] += d;
+		acc[j] += (k&0xffffffff)*(k>>32);
+	}
+}
+#endif
+
+/* ------------------------------------------------------------------------
+ * Long keys: scramble the lanes (every 16 stripes)
+ * ------------------------------------------------------------------------
+ */
+#ifdef SIMD
+static inline void scramble(uint64_t *acc, const uint64_t *sec) {
+	const __m128i p = _mm_set1_epi32((int)PRIME32);
+	for(int i=0; i<4; i++) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(acc+2*i));
+		__m128i s = _mm_loadu_si128((const __m128i*)(sec+2*i));
+		a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+		a = _mm_xor_si128(a, s);
+		__m128i lo = _mm_mul_epu32(a, p);
+		__m128i hi = _mm_mul_epu32(_mm_srli_epi64(a, 32), p);
+		a = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+		_mm_storeu_si128((__m128i*)(acc+2*i), a);
+	}
+}
+#else
+static inline void scramble(uint64_t *acc, const uint64_t *sec) {
+	for(int j=0; j<8; j++) {
+		uint64_t a = acc[j];
+		a ^= a>>47; a ^= sec[j];
+		acc[j] = a*PRIME32;
+	}
+}
+#endif
+
+/* ------------------------------------------------------------------------
+ * Long keys: process all complete stripes,
+ *            'done' receives the number of bytes processed.
+ * ------------------------------------------------------------------------
+ */
+static uint64_t longhash(const unsigned char *p, size_t len,
+                         uint64_t seed, size_t *done) {
+	uint64_t acc[8] = {P0, P1, P2, P3, K[0], K[1], K[2], K[3]};
+	uint64_t sec[8];
+	size_t n = len/STRIPE;
+
+	for(int j=0; j<8; j++) sec[j] = K[j]^seed;
+	for(size_t i=0; i<n; i++) {
+		accumulate(acc, p+i*STRIPE, sec);
+		if ((i&15) == 15) scramble(acc, sec);
+	}
+	*done = n*STRIPE;
+
+	uint64_t h = seed^(len*P0);
+	for(int j=0; j<8; j+=2) {
+		h += mix(acc[j]^K[j], acc[j+1]^K[j+1]);
+	}
+	return h;
+}
+
+/* ------------------------------------------------------------------------
+ * Byte keys
+ * ------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_bytes(const char *key, size_t ksz, void *rsc) {
+	const unsigned char *p = (const unsigned char*)key;
+	uint64_t seed = SEED(rsc)^P0;
+	uint64_t a, b;
+
+	if (p == NULL) ksz = 0;
+
+	// short keys: 0 - 16 bytes, possibly overlapping
+	if (ksz <= 16) {
+		if (ksz >= 4) {
+			size_t m = (ksz>>3)<<2;
+			a = (r32(p)<<32)|r32(p+m);
+			b = (r32(p+ksz-4)<<32)|r32(p+ksz-4-m);
+		} else if (ksz > 0) {
+			a = ((uint64_t)p[0]<<16)|((uint64_t)p[ksz>>1]<<8)|p[ksz-1];
+			b = 0;
+		} else {
+			a = 0; b = 0;
+		}
+
+	// longer keys: stripes (if long), then 16 bytes at a time
+	} else {
+		size_t i = 0;
+		if (ksz >= LONGKEY) seed = longhash(p, ksz, seed, &i);
+		for(; ksz-i > 16; i+=16) {
+			seed = mix(r64(p+i)^P1, r64(p+i+8)^seed);
+		}
+		a = r64(p+ksz-16);
+		b = r64(p+ksz-8);
+	}
+	a ^= P1; b ^= seed;
+	mul128(&a, &b);
+	return mix(a^P0^ksz, b^P1);
+}
+
+/* ------------------------------------------------------------------------
+ * Mixer
+ * ------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_mix64(uint64_t x, uint64_t seed) {
+	x ^= seed; x += P0;
+	x ^= x>>30; x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x>>27; x *= 0x94d049bb133111ebULL;
+	x ^= x>>31;
+	return x;
+}
+
+/* ------------------------------------------------------------------------
+ * 4-byte keys
+ * ------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_u32(const char *key, size_t ksz, void *rsc) {
+	if (key == NULL || ksz != 4) return ts_algo_hash_bytes(key, ksz, rsc);
+	return ts_algo_hash_mix64(r32((const unsigned char*)key), SEED(rsc)^P2);
+}
+
+/* ------------------------------------------------------------------------
+ * 8-byte keys
+ * ------------------------------------------------------------------------
+ */
+uint64_t ts_algo_hash_u64(const char *key, size_t ksz, void *rsc) {
+	if (key == NULL || ksz != 8) return ts_algo_hash_bytes(key, ksz, rsc);
+	return ts_algo_hash_mix64(r64((const unsigned char*)key), SEED(rsc));
+}
@@ -0,0 +1,413 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Integer Map Datatype Implementation
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tsalgo/imap.h>
+
+/* ----------------------------------------------------------------------------
+ * Just a shorthand
+ * ----------------------------------------------------------------------------
+ */
+#define slot_t ts_algo_imap_slot_t
+
+/* ----------------------------------------------------------------------------
+ * Mask to compute the home position from the hash
+ * ----------------------------------------------------------------------------
+ */
+#define MASK(m) ((m)->curSize-1)
+
+/* ----------------------------------------------------------------------------
+ * Hash of a key
+ * ----------------------------------------------------------------------------
+ */
+#define HASH(m,k) ts_algo_hash_mix64(k, (m)->seed)
+
+/* ----------------------------------------------------------------------------
+ * Is the slot empty?
+ * ----------------------------------------------------------------------------
+ */
+#define EMPTY(m,p) ((m)->dist[p] == 0)
+
+/* ----------------------------------------------------------------------------
+ * We grow when the buffer is filled by 7/8
+ * ----------------------------------------------------------------------------
+ */
+#define FULL(m) ((m)->count >= (m)->curSize - ((m)->curSize>>3))
+
+/* ----------------------------------------------------------------------------
+ * A long probe run in a buffer filled by less than half
+ * is caused by colliding keys, not by the load:
+ * resizing would only waste memory.
+ * ----------------------------------------------------------------------------
+ */
+#define LOADED(m) ((m)->count >= ((m)->curSize>>1))
+
+/* ----------------------------------------------------------------------------
+ * An insert increases the probe distance of any slot by at most one.
+ * As long as the greatest distance is below this limit,
+ * the distances fit into one byte.
+ * ----------------------------------------------------------------------------
+ */
+#define MAXDIST 200
+
+/* ----------------------------------------------------------------------------
+ * Helper: round up to the next power of 2
+ * ----------------------------------------------------------------------------
+ */
+static inline uint32_t pow2(uint32_t sz) {
+	uint32_t p = 8;
+	while(p < sz && p < 0x80000000) p<<=1;
+	return p;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: place a slot (without checking for duplicates);
+ *         the caller guarantees that there is at least one free slot.
+ *         d is the probe distance + 1.
+ * ----------------------------------------------------------------------------
+ */
+static inline void place(ts_algo_imap_t *map, slot_t cur) {
+	uint32_t p = HASH(map, cur.key)&MASK(map);
+	uint8_t  d = 1;
+
+	for(;;) {
+		if (EMPTY(map,p)) {
+			map->buf[p] = cur; map->dist[p] = d;
+			if (d > map->maxd) map->maxd = d;
+			return;
+		}
+		// the resident is closer to its home than we are:
+		// we take its place and continue with the resident
+		if (map->dist[p] < d) {
+			slot_t  tmp = map->buf[p];
+			uint8_t x = map->dist[p];
+			map->buf[p] = cur; map->dist[p] = d;
+			if (d > map->maxd) map->maxd = d;
+			cur = tmp; d = x;
+		}
+		p = (p+1)&MASK(map); d++;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: allocate buffers of size sz
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_rc_t newbuf(ts_algo_imap_t *map, uint32_t sz) {
+	map->buf = malloc(sz*sizeof(slot_t));
+	if (map->buf == NULL) return TS_ALGO_NO_MEM;
+	map->dist = calloc(sz, 1);
+	if (map->dist == NULL) {
+		free(map->buf); map->buf = NULL;
+		return TS_ALGO_NO_MEM;
+	}
+	map->curSize = sz;
+	map->maxd = 0;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: resize the buffer
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t bufresize(ts_algo_imap_t *map) {
+	slot_t  *old  = map->buf;
+	uint8_t *odst = map->dist;
+	uint32_t osz  = map->curSize;
+	uint32_t omax = map->maxd;
+
+	if (osz >= 0x80000000) return TS_ALGO_NO_MEM;
+
+	if (newbuf(map, osz<<1) != TS_ALGO_OK) {
+		map->buf = old; map->dist = odst;
+		map->curSize = osz; map->maxd = omax;
+		return TS_ALGO_NO_MEM;
+	}
+	for(uint32_t i=0; i<osz; i++) {
+		if (odst[i] != 0) place(map, old[i]);
+	}
+	free(old); free(odst);
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: find the position of a key or return -1.
+ *         A key with home position h is found at distance d
+ *         only in a slot with distance d.
+ * ----------------------------------------------------------------------------
+ */
+static inline int64_t findpos(ts_algo_imap_t *map, uint64_t key) {
+	uint32_t p = HASH(map, key)&MASK(map);
+	uint8_t  d = 1;
+
+	for(;;) {
+		// if the key were here, we would have seen it already
+		// (this includes empty slots)
+		if (map->dist[p] < d) return -1;
+		if (map->dist[p] == d && map->buf[p].key == key) return p;
+		p = (p+1)&MASK(map); d++;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: compute the greatest probe distance placing the key would cause
+ *         (including the entries it displaces) without changing the map.
+ *         The number of entries with the same key is passed back in 'same'.
+ * ----------------------------------------------------------------------------
+ */
+static inline uint32_t probe(ts_algo_imap_t *map, uint64_t key, uint32_t *same) {
+	uint32_t p = HASH(map, key)&MASK(map);
+	uint32_t d = 1, mx = 1;
+	char     mine = 1;
+
+	*same = 0;
+	while(!EMPTY(map,p)) {
+		if (mine && map->dist[p] == d && map->buf[p].key == key) (*same)++;
+		// here we would displace the resident
+		if (map->dist[p] < d) {
+			d = map->dist[p]; mine = 0;
+		}
+		p = (p+1)&MASK(map); d++;
+		if (d > mx) mx = d;
+	}
+	return mx;
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map and initialise it
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_imap_t *ts_algo_imap_new(uint32_t sz, ts_algo_delete_t del) {
+	ts_algo_imap_t *map = malloc(sizeof(ts_algo_imap_t));
+	if (map == NULL) return NULL;
+	ts_algo_rc_t rc = ts_algo_imap_init(map, sz, del);
+	if (rc != TS_ALGO_OK) {
+		free(map); return NULL;
+	}
+	return map;
+}
+
+/* ----------------------------------------------------------------------------
+ * Initialise an already allocated map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_imap_init(ts_algo_imap_t  *map,
+                               uint32_t          sz,
+                               ts_algo_delete_t del) {
+	if (map == NULL) return TS_ALGO_INVALID;
+	map->baseSize = pow2(sz==0?8192:sz);
+	map->count    = 0;
+	map->seed     = 0;
+	map->del      = del;
+	return newbuf(map, map->baseSize);
+}
+
+/* ----------------------------------------------------------------------------
+ * Destroy an existing map
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_imap_destroy(ts_algo_imap_t *map) {
+	if (map == NULL) return;
+	if (map->buf == NULL) return;
+	if (map->del != NULL) {
+		for(uint32_t i=0; i<map->curSize; i++) {
+			if (!EMPTY(map,i)) map->del(NULL, &map->buf[i].data);
+		}
+	}
+	free(map->buf); map->buf = NULL;
+	free(map->dist); map->dist = NULL;
+	map->count = 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Add a new element to the map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_imap_add(ts_algo_imap_t *map, uint64_t key, void *data) {
+	slot_t slot;
+	uint32_t same;
+
+	if (FULL(map)) {
+		ts_algo_rc_t rc = bufresize(map);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	// there may be a long probe run somewhere:
+	// check if it affects this key before we resize
+	if (map->maxd >= MAXDIST && probe(map, key, &same) > MAXDIST) {
+		// resizing does not help with the same key added many times
+		// nor with colliding keys in a buffer that is not loaded
+		if (same >= MAXDIST-1 || !LOADED(map)) return TS_ALGO_ERR;
+		ts_algo_rc_t rc = bufresize(map);
+		if (rc != TS_ALGO_OK) return rc;
+		if (probe(map, key, &same) > MAXDIST) return TS_ALGO_ERR;
+	}
+	slot.key  = key;
+	slot.data = data;
+	place(map, slot);
+	map->count++;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get the data associated with a key
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_imap_get(ts_algo_imap_t *map, uint64_t key) {
+	int64_t p = findpos(map, key);
+	if (p < 0) return NULL;
+	return map->buf[p].data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Remove a key from the map
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_imap_remove(ts_algo_imap_t *map, uint64_t key) {
+	int64_t x = findpos(map, key);
+	if (x < 0) return NULL;
+
+	uint32_t p = (uint32_t)x;
+	void *data = map->buf[p].data;
+
+	// backward shift: move the following entries
+	// one position closer to their home until
+	// we see an empty slot or an entry at home.
+	for(uint32_t n = (p+1)&MASK(map);
+	    map->dist[n] > 1;
+	    n = (n+1)&MASK(map))
+	{
+		map->buf[p] = map->buf[n];
+		map->dist[p] = map->dist[n]-1; p = n;
+	}
+	map->dist[p] = 0;
+	map->count--;
+	return data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Delete a key from the map, i.e. remove it from the key and free the memory.
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_imap_delete(ts_algo_imap_t *map, uint64_t key) {
+	void *data = ts_algo_imap_remove(map, key);
+	if (data != NULL && map->del != NULL) map->del(NULL, &data);
+}
+
+/* ----------------------------------------------------------------------------
+ * Overwrite the data assocated with a key
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_imap_update(ts_algo_imap_t *map, uint64_t key, void *data) {
+	int64_t p = findpos(map, key);
+	if (p < 0) return NULL;
+	void *d = map->buf[p].data;
+	map->buf[p].data = data;
+	return d;
+}
+
+/* ----------------------------------------------------------------------------
+ * Create an iterator for the map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_imap_it_t *ts_algo_imap_iterate(ts_algo_imap_t *map) {
+	ts_algo_imap_it_t *it = calloc(1, sizeof(ts_algo_imap_it_t));
+	if (it == NULL) return NULL;
+	it->map = map;
+	ts_algo_imap_it_rewind(it);
+	return it;
+}
+
+/* ----------------------------------------------------------------------------
+ * Check if the iterator reached the end of the map.
+ * ----------------------------------------------------------------------------
+ */
+char ts_algo_imap_it_eof(ts_algo_imap_it_t *it) {
+	return (it->slot >= it->map->curSize);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: move to the next occupied slot starting at 'slot'
+ * ----------------------------------------------------------------------------
+ */
+static inline void skipempty(ts_algo_imap_it_t *it) {
+	while(it->slot < it->map->curSize && EMPTY(it->map, it->slot)) {
+		it->slot++;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Rewind the iterator.
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_imap_it_rewind(ts_algo_imap_it_t *it) {
+	it->count = 0;
+	it->slot  = 0;
+	skipempty(it);
+}
+
+/* ----------------------------------------------------------------------------
+ * Advance the iterator
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_imap_it_advance(ts_algo_imap_it_t *it) {
+	if (it->slot >= it->map->curSize) return;
+	it->slot++; skipempty(it);
+	it->count++;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get the current entry
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_imap_slot_t *ts_algo_imap_it_get(ts_algo_imap_it_t *it) {
+	if (it->slot >= it->map->curSize) return NULL;
+	return it->map->buf+it->slot;
+}
+
+/* ----------------------------------------------------------------------------
+ * Apply fun to all slots
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_imap_forEach(ts_algo_imap_t       *map,
+                                  ts_algo_imap_visit_t  fun,
+                                  void                 *rsc) {
+	for(uint32_t i=0; i<map->curSize; i++) {
+		if (EMPTY(map,i)) continue;
+		ts_algo_rc_t rc = fun(rsc, map->buf+i);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
+
+/* -------------------------------------------------------------------------
+ * Convert map to list.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_list_t *ts_algo_imap_toList(ts_algo_imap_t *map) {
+	ts_algo_list_t *l = malloc(sizeof(ts_algo_list_t));
+	if (l == NULL) return NULL;
+	ts_algo_list_init(l);
+	for(uint32_t i=0; i<map->curSize; i++) {
+		if (EMPTY(map,i)) continue;
+		if (ts_algo_list_insert(l, map->buf+i) != TS_ALGO_OK) {
+			ts_algo_list_destroy(l); free(l);
+			return NULL;
+		}
+	}
+	return l;
+}
+
+/* ----------------------------------------------------------------------------
+ * Debug: Show probe distance of slots
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_imap_showslots(ts_algo_imap_t *map) {
+	for (uint32_t i=0;i<map->curSize;i++) {
+		fprintf(stderr, "%06u: %d\n", i, (int)map->dist[i]-1);
+	}
+}
@@ -5,8 +5,12 @@
  * ========================================================================
  */
 #include <stdlib.h>
+#include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <tsalgo/map.h>
 
 /* ----------------------------------------------------------------------------
@@ -16,26 +20,134 @@
 #define slot_t ts_algo_map_slot_t
 
 /* ----------------------------------------------------------------------------
- * Create a new slot
+ * Another shorthand
+ * ----------------------------------------------------------------------------
+ */
+#define SLOT(x) ((slot_t*)x)
+
+/* ----------------------------------------------------------------------------
+ * An entry in slab mode: list node, slot and key in one block
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_list_node_t node;
+	slot_t              slot;
+	char                key[];
+} entry_t;
+
+/* ----------------------------------------------------------------------------
+ * Does the map borrow the keys from the application?
+ * ----------------------------------------------------------------------------
+ */
+#define BORROWED(m) ((m)->mode & TS_ALGO_MAP_BORROW)
+
+/* ----------------------------------------------------------------------------
+ * Bytes of key stored in the entry (none for borrowed keys)
+ * ----------------------------------------------------------------------------
+ */
+#define KEYSZ(m,s) (BORROWED(m)?0:(s))
+
+/* ----------------------------------------------------------------------------
+ * Slab classes: one per 16 bytes of key size
+ * ----------------------------------------------------------------------------
+ */
+#define SLABCLASSES ((TS_ALGO_MAP_SLABKEY>>4)+1)
+#define SLABCLASS(s) (((s)+15)>>4)
+#define SLABBED(m,s) ((m)->mode & TS_ALGO_MAP_SLAB && \
+                      KEYSZ(m,s) <= TS_ALGO_MAP_SLABKEY)
+
+/* ----------------------------------------------------------------------------
+ * Is the map in small representation (one bucket)?
+ * ----------------------------------------------------------------------------
+ */
+#define ISSMALL(m) ((m)->mode & TS_ALGO_MAP_SMALL && (m)->curSize == 1)
+
+/* ----------------------------------------------------------------------------
+ * Helper: monotonic time in nanoseconds (for statistics)
+ * ----------------------------------------------------------------------------
+ */
+static inline uint64_t now() {
+	struct timespec t;
+	if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) return 0;
+	return (uint64_t)t.tv_sec*1000000000 + t.tv_nsec;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: create a new entry consisting of list node, slot and key copy.
+ *         In default mode these are three allocations,
+ *         in slab mode one allocation from the slab of the key size.
+ *         Borrowed keys are not copied: the entry has no key
+ *         and the slot points to the key of the application.
+ *         The slabs and the memory counter are passed in,
+ *         so that threads building the map in parallel
+ *         can use their own (see ts_algo_map_fromArray).
  * ----------------------------------------------------------------------------
  */
-#define MAKESLOT(k,s,h,d) \
-	slot_t *slot = malloc(sizeof(slot_t)); \
-	if (slot == NULL) return TS_ALGO_NO_MEM; \
-	slot->key = malloc(s); \
-	if (slot->key == NULL) {\
-		free(slot); return TS_ALGO_NO_MEM; \
-	}\
-	memcpy(slot->key, k, s);\
-	slot->ksz = s; \
-	slot->data = d; \
+static inline ts_algo_list_node_t *newentry(ts_algo_map_t *map,
+                                            ts_algo_slab_t *slabs,
+                                            size_t *mem,
+                                            char *key, size_t ksz,
+                                            uint64_t h, void *data) {
+	ts_algo_list_node_t *node;
+	slot_t *slot;
+	size_t s = KEYSZ(map, ksz);
+
+	if (map->mode & TS_ALGO_MAP_SLAB) {
+		entry_t *e;
+		if (SLABBED(map, ksz)) {
+			e = ts_algo_slab_alloc(slabs+SLABCLASS(s));
+		} else {
+			e = malloc(sizeof(entry_t)+s);
+			if (e != NULL) *mem += sizeof(entry_t)+s;
+		}
+		if (e == NULL) return NULL;
+		node = &e->node;
+		slot = &e->slot;
+		slot->key = e->key;
+	} else {
+		node = malloc(sizeof(ts_algo_list_node_t));
+		if (node == NULL) return NULL;
+		slot = malloc(sizeof(slot_t));
+		if (slot == NULL) {
+			free(node); return NULL;
+		}
+		if (s > 0) {
+			slot->key = malloc(s);
+			if (slot->key == NULL) {
+				free(slot); free(node); return NULL;
+			}
+		}
+		*mem += sizeof(ts_algo_list_node_t)+sizeof(slot_t)+s;
+	}
+	if (BORROWED(map)) slot->key = key; else memcpy(slot->key, key, ksz);
+	slot->ksz  = ksz;
+	slot->data = data;
 	slot->hash = h;
+	node->cont = slot;
+	return node;
+}
 
 /* ----------------------------------------------------------------------------
- * Another shorthand
+ * Helper: release an entry (not the data!)
  * ----------------------------------------------------------------------------
  */
-#define SLOT(x) ((slot_t*)x)
+static inline void freeentry(ts_algo_map_t *map, ts_algo_list_node_t *node) {
+	slot_t *slot = node->cont;
+	size_t s = KEYSZ(map, slot->ksz);
+	if (map->mode & TS_ALGO_MAP_SLAB) {
+		// the node is the first member of the entry
+		if (SLABBED(map, slot->ksz)) {
+			ts_algo_slab_free(map->slabs+SLABCLASS(s), node);
+		} else {
+			map->mem -= sizeof(entry_t)+s;
+			free(node);
+		}
+	} else {
+		map->mem -= sizeof(ts_algo_list_node_t)+sizeof(slot_t)+s;
+		if (s > 0) free(slot->key);
+		free(slot); free(node);
+	}
+}
 
 /* ----------------------------------------------------------------------------
  * Implementation of the Id Hash
@@ -47,70 +159,206 @@ uint64_t ts_algo_hash_id(const char *key, size_t ksz, void *ignore) {
 }
 
 /* ----------------------------------------------------------------------------
- * Helper: initialise the buffer
+ * Helper: allocate and initialise a buffer.
+ *         An all-zero list is an initialised empty list,
+ *         so we do not need to touch the memory here;
+ *         this keeps the start of an incremental resize cheap.
  * ----------------------------------------------------------------------------
  */
-static ts_algo_rc_t bufinit(ts_algo_map_t *map) {
-	map->buf = calloc(map->baseSize, sizeof(ts_algo_list_t));
-	if (map->buf == NULL) return TS_ALGO_NO_MEM;
-	for(int i=0; i<map->baseSize; i++) {
-		ts_algo_list_init(map->buf+i);
+static inline ts_algo_list_t *newbuf(uint32_t sz) {
+	return calloc(sz, sizeof(ts_algo_list_t));
+}
+
+/* ----------------------------------------------------------------------------
+ * Copy-on-write: while a snapshot is attached, bucket i of the map
+ * is cow[i] (shared with the snapshot) until the map copies it
+ * to buf[i] and sets bit i in cowbits.
+ * ----------------------------------------------------------------------------
+ */
+#define COPIED(m,i) ((m)->cowbits[(i)>>3] & (1<<((i)&7)))
+#define SHARED(m,b) ((m)->cow != NULL && (b) >= (m)->cow && \
+                                         (b) <  (m)->cow+(m)->curSize)
+
+/* ----------------------------------------------------------------------------
+ * Helper: bucket i of the current buffer as the map sees it
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_list_t *view(ts_algo_map_t *map, uint32_t i) {
+	if (map->cow != NULL && !COPIED(map, i)) return map->cow+i;
+	return map->buf+i;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: copy the entries of the shared bucket i into buf[i]
+ *         (keeping their order); the shared entries are not touched,
+ *         since the snapshot may be reading them.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_list_t *copybucket(ts_algo_map_t *map, uint32_t i) {
+	ts_algo_list_t *b = map->buf+i;
+	for(ts_algo_list_node_t *run=map->cow[i].last; run!=NULL; run=run->prv) {
+		slot_t *s = SLOT(run->cont);
+		ts_algo_list_node_t *node = newentry(map, map->slabs, &map->mem,
+		                                     s->key, s->ksz, s->hash, s->data);
+		if (node == NULL) {
+			while(b->head != NULL) {
+				node = b->head;
+				ts_algo_list_remove(b, node);
+				freeentry(map, node);
+			}
+			return NULL;
+		}
+		ts_algo_list_insertNode(b, node->cont, node);
+	}
+	map->cowbits[i>>3] |= 1<<(i&7);
+	return b;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: make bucket b private to the map before changing it;
+ *         returns the private bucket or NULL if there is no memory.
+ *         b may be a shared bucket obtained before it was copied.
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_list_t *own(ts_algo_map_t *map, ts_algo_list_t *b) {
+	if (!SHARED(map, b)) return b;
+	uint32_t i = (uint32_t)(b-map->cow);
+	if (COPIED(map, i)) return map->buf+i;
+	return copybucket(map, i);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: detach the snapshot by copying all buckets still shared;
+ *         the snapshot then owns the old buffer alone.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t detach(ts_algo_map_t *map) {
+	if (map->cow == NULL) return TS_ALGO_OK;
+	for(uint32_t i=0; i<map->curSize; i++) {
+		if (COPIED(map, i)) continue;
+		if (copybucket(map, i) == NULL) return TS_ALGO_NO_MEM;
 	}
+	free(map->cowbits); map->cowbits = NULL;
+	map->cow = NULL;
 	return TS_ALGO_OK;
 }
 
 /* ----------------------------------------------------------------------------
- * Helper: move all entries from src to trg,
- *         src is empty afterwards!
+ * Helper: the bucket where an entry with hash h lives.
+ *         During migration, this is the bucket in the old buffer,
+ *         unless that one was already moved to the new buffer.
  * ----------------------------------------------------------------------------
  */
-static inline ts_algo_rc_t moveall(ts_algo_map_t *src,
-                                   ts_algo_map_t *trg)
-{
-	ts_algo_rc_t rc = TS_ALGO_OK;
+static inline ts_algo_list_t *bucket(ts_algo_map_t *map, uint64_t h) {
+	if (map->old != NULL) {
+		uint32_t k = h%map->oldSize;
+		if (k >= map->moved) return map->old+k;
+	}
+	return view(map, h%map->curSize);
+}
 
-	for(int i=0; i<src->curSize; i++) {
-		for(ts_algo_list_node_t *run=src->buf[i].head; run!=NULL;) {
-			ts_algo_map_slot_t *s = run->cont;
-			if (s == NULL) break;
-			uint64_t k = s->hash%trg->curSize;
+/* ----------------------------------------------------------------------------
+ * Helper: migrate up to n buckets from the old to the new buffer
+ * ----------------------------------------------------------------------------
+ */
+static void migrate(ts_algo_map_t *map, uint32_t n) {
+	if (map->old == NULL) return;
+	uint64_t t = map->mode & TS_ALGO_MAP_STATS ? now() : 0;
+	for(uint32_t i=0; i<n && map->moved < map->oldSize; i++) {
+		ts_algo_list_t *src = map->old+map->moved;
+		for(ts_algo_list_node_t *run=src->head; run!=NULL;) {
 			ts_algo_list_node_t *tmp = run->nxt;
-			ts_algo_list_remove(src->buf+i, run);
-			rc = ts_algo_list_insertNode(&trg->buf[k], s, run);
+			ts_algo_list_insertNode(map->buf+
+			           SLOT(run->cont)->hash%map->curSize,
+			           run->cont, run);
 			run = tmp;
 		}
+		ts_algo_list_init(src);
+		map->moved++;
 	}
-	trg->count = src->count;
-	return rc;
+	if (map->moved >= map->oldSize) {
+		free(map->old); map->old = NULL;
+		map->oldSize = 0;
+		map->moved = 0;
+	}
+	if (map->mode & TS_ALGO_MAP_STATS) map->rsztime += now()-t;
 }
 
 /* ----------------------------------------------------------------------------
- * Helper: resize the buffer
+ * Helper: complete an ongoing migration
  * ----------------------------------------------------------------------------
  */
-static ts_algo_rc_t bufresize(ts_algo_map_t *map) {
-	ts_algo_map_t tmp;
-	ts_algo_rc_t rc = TS_ALGO_OK;
+static inline void finish(ts_algo_map_t *map) {
+	if (map->old != NULL) migrate(map, map->oldSize);
+}
 
-	// initialise a local map, 4 times as big as the original
-	rc = ts_algo_map_init(&tmp, map->curSize<<2, map->hsh, map->del);
-	if (rc != TS_ALGO_OK) return rc;
+/* ----------------------------------------------------------------------------
+ * Helper: start an incremental resize; the current buffer
+ *         becomes the old one and a new buffer of size sz
+ *         is allocated (bigger or smaller than the current one).
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t startresize(ts_algo_map_t *map, uint32_t sz) {
+	// we outgrew the map before the last migration was done
+	finish(map);
+	if (detach(map) != TS_ALGO_OK) return TS_ALGO_NO_MEM;
 
-	// Move all entries from the original to the local map
-	rc = moveall(map, &tmp);
-	if (rc != TS_ALGO_OK) {
-		ts_algo_map_destroy(&tmp);
-		return rc;
+	uint64_t t = now();
+	ts_algo_list_t *buf = newbuf(sz);
+	if (buf == NULL) return TS_ALGO_NO_MEM;
+
+	map->old = map->buf;
+	map->oldSize = map->curSize;
+	map->moved = 0;
+	map->buf = buf;
+	map->curSize = sz;
+
+	map->resizes++;
+	map->rsztime += now()-t;
+
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: move all entries from the map buffer to buf (of size sz),
+ *         the list nodes are reused, the map buffer is empty afterwards!
+ * ----------------------------------------------------------------------------
+ */
+static inline void moveall(ts_algo_map_t *map, ts_algo_list_t *buf, uint32_t sz)
+{
+	for(int i=0; i<map->curSize; i++) {
+		for(ts_algo_list_node_t *run=map->buf[i].head; run!=NULL;) {
+			ts_algo_list_node_t *tmp = run->nxt;
+			ts_algo_list_insertNode(buf+SLOT(run->cont)->hash%sz,
+			                        run->cont, run);
+			run = tmp;
+		}
+		ts_algo_list_init(map->buf+i);
 	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: resize the buffer to sz buckets
+ *         (there must be no ongoing migration)
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t bufresize(ts_algo_map_t *map, uint32_t sz) {
+	if (detach(map) != TS_ALGO_OK) return TS_ALGO_NO_MEM;
+
+	uint64_t t = now();
+	ts_algo_list_t *buf = newbuf(sz);
+	if (buf == NULL) return TS_ALGO_NO_MEM;
+
+	// Move all entries from the original to the new buffer
+	moveall(map, buf, sz);
 
 	// swap the buffers
-	ts_algo_list_t *buf = map->buf;
-	map->buf = tmp.buf; tmp.buf = buf;
-	tmp.curSize = map->curSize;
-	map->curSize=tmp.baseSize;
+	free(map->buf);
+	map->buf = buf;
+	map->curSize = sz;
 
-	// destroy the local map
-	ts_algo_map_destroy(&tmp);
+	map->resizes++;
+	map->rsztime += now()-t;
 
 	return TS_ALGO_OK;
 }
@@ -122,9 +370,20 @@ static ts_algo_rc_t bufresize(ts_algo_map_t *map) {
 ts_algo_map_t *ts_algo_map_new(uint32_t sz,
                                ts_algo_hash_t   hsh,
                                ts_algo_delete_t del) {
+	return ts_algo_map_newMode(sz, hsh, del, TS_ALGO_MAP_DEFAULT);
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map with mode and initialise it
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_map_t *ts_algo_map_newMode(uint32_t sz,
+                                   ts_algo_hash_t   hsh,
+                                   ts_algo_delete_t del,
+                                   uint32_t        mode) {
 	ts_algo_map_t *map = malloc(sizeof(ts_algo_map_t));
 	if (map == NULL) return NULL;
-	ts_algo_rc_t rc = ts_algo_map_init(map, sz, hsh, del);
+	ts_algo_rc_t rc = ts_algo_map_initMode(map, sz, hsh, del, mode);
 	if (rc != TS_ALGO_OK) {
 		free(map); return NULL;
 	}
@@ -138,31 +397,68 @@ ts_algo_map_t *ts_algo_map_new(uint32_t sz,
 ts_algo_rc_t ts_algo_map_init(ts_algo_map_t *map, uint32_t sz,
 		                         ts_algo_hash_t   hsh,
 		                         ts_algo_delete_t del) {
+	return ts_algo_map_initMode(map, sz, hsh, del, TS_ALGO_MAP_DEFAULT);
+}
+
+/* ----------------------------------------------------------------------------
+ * Initialise an already allocated map with mode
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_initMode(ts_algo_map_t *map, uint32_t sz,
+		                             ts_algo_hash_t   hsh,
+		                             ts_algo_delete_t del,
+		                             uint32_t        mode) {
 	if (map == NULL) return TS_ALGO_INVALID;
 	map->baseSize = sz==0?8192:sz;
-	map->curSize  = map->baseSize;
+	map->curSize  = mode & TS_ALGO_MAP_SMALL?1:map->baseSize;
 	map->count    = 0;
+	map->mode     = mode;
 	map->del      = del;
-	map->hsh      = hsh;
-	map->buf      = NULL;
-	return bufinit(map);
+	map->hsh      = hsh==NULL?ts_algo_hash_bytes:hsh;
+	map->rsc      = NULL;
+	map->slabs    = NULL;
+	map->old      = NULL;
+	map->oldSize  = 0;
+	map->moved    = 0;
+	map->resizes  = 0;
+	map->rsztime  = 0;
+	map->lookups  = 0;
+	map->probes   = 0;
+	map->mem      = 0;
+	map->cow      = NULL;
+	map->cowbits  = NULL;
+	map->snaps    = 0;
+	map->buf      = newbuf(map->curSize);
+	if (map->buf == NULL) return TS_ALGO_NO_MEM;
+	if (mode & TS_ALGO_MAP_SLAB) {
+		map->slabs = calloc(SLABCLASSES, sizeof(ts_algo_slab_t));
+		if (map->slabs == NULL) {
+			free(map->buf); map->buf = NULL;
+			return TS_ALGO_NO_MEM;
+		}
+		for(int i=0; i<SLABCLASSES; i++) {
+			ts_algo_slab_init(map->slabs+i, sizeof(entry_t)+(i<<4), 0);
+		}
+	}
+	return TS_ALGO_OK;
 }
 
 /* ----------------------------------------------------------------------------
  * Helper: Destroy everything in the list
  * ----------------------------------------------------------------------------
  */
-static inline void listdestroy(ts_algo_list_t *list, ts_algo_delete_t del) {
-	for(ts_algo_list_node_t *run=list->head; run!=NULL; run=run->nxt) {
-		if (run->cont != NULL) {
-			void *x = SLOT(run->cont)->data;
-			free(SLOT(run->cont)->key);
-			free(run->cont);
-			if (del != NULL) { // we manage the memory
-				del(NULL, &x);
-			}
+static inline void listdestroy(ts_algo_map_t *map, ts_algo_list_t *list) {
+	for(ts_algo_list_node_t *run=list->head; run!=NULL;) {
+		ts_algo_list_node_t *tmp = run->nxt;
+		void *x = SLOT(run->cont)->data;
+		// slabbed entries are released with the slabs
+		if (!SLABBED(map, SLOT(run->cont)->ksz)) freeentry(map, run);
+		if (map->del != NULL) { // we manage the memory
+			map->del(NULL, &x);
 		}
+		run = tmp;
 	}
+	ts_algo_list_init(list);
 }
 
 /* ----------------------------------------------------------------------------
@@ -172,62 +468,204 @@ static inline void listdestroy(ts_algo_list_t *list, ts_algo_delete_t del) {
 void ts_algo_map_destroy(ts_algo_map_t *map) {
 	if (map == NULL) return;
 	if (map->buf == NULL) return;
+	// snapshots must be released before (see ts_algo_map_release)
+	assert(map->snaps == 0);
+	if (map->old != NULL) {
+		for(int i=map->moved;i<map->oldSize;i++) {
+			listdestroy(map, map->old+i);
+		}
+		free(map->old); map->old = NULL;
+		map->oldSize = 0;
+		map->moved = 0;
+	}
 	for(int i=0;i<map->curSize;i++) {
-		listdestroy(map->buf+i, map->del);
-		ts_algo_list_destroy(map->buf+i);
+		listdestroy(map, map->buf+i);
 	}
 	free(map->buf); map->buf = NULL;
+	if (map->slabs != NULL) {
+		for(int i=0; i<SLABCLASSES; i++) {
+			ts_algo_slab_destroy(map->slabs+i);
+		}
+		free(map->slabs); map->slabs = NULL;
+	}
+	map->count = 0;
 }
 
 /* ----------------------------------------------------------------------------
- * Add a new element to the map
+ * Helper: make room for n more elements;
+ *         if we outgrew the map (twice as many elements as slots)
+ *         resize the buffer!
+ *         A small map outgrows its single bucket with more than
+ *         TS_ALGO_MAP_SMALLSZ elements and is resized to the base size.
  * ----------------------------------------------------------------------------
  */
-ts_algo_rc_t ts_algo_map_add(ts_algo_map_t *map, char *key, size_t ksz, void *data) {
-	ts_algo_rc_t rc=TS_ALGO_OK;
-	// if we outgrew the map (twice as many elements as slots)
-	// resize the buffer!
-	if (map->count >= map->curSize<<1) {
-		rc = bufresize(map);
-	        if (rc != TS_ALGO_OK) return rc;
-	}
-	// compute the hash
-	uint64_t k = map->hsh(key, ksz, NULL);
-	// make a slot (this also remembers the hash,
-	// so we don't need to compute it again when resizing;
-	// error handling is defined in the macro
-	MAKESLOT(key, ksz, k, data);
-	// compute the modulus
-	k%=map->curSize;
+static inline ts_algo_rc_t grow(ts_algo_map_t *map, uint32_t n) {
+	uint32_t sz;
+	if (ISSMALL(map)) {
+		if (map->count+n <= TS_ALGO_MAP_SMALLSZ) return TS_ALGO_OK;
+		sz = map->baseSize;
+		while(map->count+n > sz<<1) sz<<=2;
+	} else if (map->count+n > map->curSize<<1) {
+		// the new buffer is 4 times as big as the current one
+		sz = map->curSize<<2;
+	} else {
+		return TS_ALGO_OK;
+	}
+	if (map->mode & TS_ALGO_MAP_INCREMENTAL) {
+		return startresize(map, sz);
+	}
+	return bufresize(map, sz);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: in shrink mode, if the load dropped below 1/4
+ *         (less than one element per 8 buckets), shrink the buffer
+ *         to a quarter, but not below the base size.
+ *         We do not shrink during a migration.
+ *         If there is not enough memory, we just keep the buffer.
+ * ----------------------------------------------------------------------------
+ */
+static inline void autoshrink(ts_algo_map_t *map) {
+	uint32_t sz;
+
+	if (!(map->mode & TS_ALGO_MAP_SHRINK)) return;
+	if (map->old != NULL) return;
+
+	// back to small representation
+	if (map->mode & TS_ALGO_MAP_SMALL && map->curSize > 1 &&
+	    map->count <= TS_ALGO_MAP_SMALLSZ/2) {
+		sz = 1;
+	} else {
+		if (map->curSize <= map->baseSize) return;
+		if (map->count >= map->curSize>>3) return;
+
+		sz = map->curSize>>2;
+		if (sz < map->baseSize) sz = map->baseSize;
+	}
+	if (map->mode & TS_ALGO_MAP_INCREMENTAL) {
+		startresize(map, sz);
+	} else {
+		bufresize(map, sz);
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: insert a new element with hash h into bucket b
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_rc_t insert(ts_algo_map_t *map, ts_algo_list_t *b,
+                                  char *key, size_t ksz,
+                                  uint64_t h, void *data) {
+	b = own(map, b);
+	if (b == NULL) return TS_ALGO_NO_MEM;
+	// make an entry (this also remembers the hash,
+	// so we don't need to compute it again when resizing)
+	ts_algo_list_node_t *node = newentry(map, map->slabs, &map->mem,
+	                                     key, ksz, h, data);
+	if (node == NULL) return TS_ALGO_NO_MEM;
 	// insert into the list
-	rc = ts_algo_list_insert(&map->buf[k], slot);
-	map->count++;
+	ts_algo_rc_t rc = ts_algo_list_insertNode(b, node->cont, node);
 	if (rc != TS_ALGO_OK) {
-		free(slot->key);
-		free(slot);
+		freeentry(map, node);
+		return rc;
 	}
+	map->count++;
 	return rc;
 }
 
 /* ----------------------------------------------------------------------------
- * Helper: Get the list node associated with a key
+ * Add a new element to the map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_add(ts_algo_map_t *map, char *key, size_t ksz, void *data) {
+	return ts_algo_map_addHashed(map, key, ksz,
+	                             map->hsh(key, ksz, map->rsc), data);
+}
+
+/* ----------------------------------------------------------------------------
+ * Add a new element with a precomputed hash
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_addHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                                   uint64_t h, void *data) {
+	ts_algo_rc_t rc;
+	migrate(map, TS_ALGO_MAP_MIGRATE);
+	rc = grow(map, 1);
+	if (rc != TS_ALGO_OK) return rc;
+	return insert(map, bucket(map, h), key, ksz, h, data);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: Find the list node associated with a key with hash h in bucket b.
+ *         The stored hash and key size are compared first,
+ *         so the key memory is touched only if the key is very likely
+ *         to match (in slab mode, the slot and the node
+ *         are in the same cache line).
+ *         The number of nodes visited is added to p.
  * ----------------------------------------------------------------------------
  */
-static inline ts_algo_list_node_t *getnode(ts_algo_map_t *map, char *key, size_t ksz) {
-	uint64_t k = map->hsh(key, ksz, NULL)%map->curSize;
-	for(ts_algo_list_node_t *run=map->buf[k].head; run!=NULL; run=run->nxt) {
-		if (memcmp(key, SLOT(run->cont)->key, ksz) == 0) return run;
+static inline ts_algo_list_node_t *scan(ts_algo_list_t *b, uint64_t h,
+                                        char *key, size_t ksz, uint64_t *p) {
+	ts_algo_list_node_t *run;
+	for(run=b->head; run!=NULL; run=run->nxt) {
+		slot_t *s = SLOT(run->cont);
+		(*p)++;
+		if (s->hash == h && s->ksz == ksz &&
+		    memcmp(key, s->key, ksz) == 0) break;
 	}
-	return NULL;
+	return run;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: scan the bucket; in stats mode,
+ *         the lookup and the nodes visited are counted.
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_list_node_t *findnode(ts_algo_map_t  *map,
+                                            ts_algo_list_t *b, uint64_t h,
+                                            char *key, size_t ksz) {
+	uint64_t p = 0;
+	ts_algo_list_node_t *run = scan(b, h, key, ksz, &p);
+	if (map->mode & TS_ALGO_MAP_STATS) {
+		map->lookups++; map->probes += p;
+	}
+	return run;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: node was found in bucket b and is about to be changed;
+ *         if b is shared with a snapshot, it is copied and
+ *         the copy of the node is returned (NULL if there is no memory).
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_list_node_t *writable(ts_algo_map_t *map,
+                                            ts_algo_list_t *b,
+                                            ts_algo_list_node_t *node,
+                                            uint64_t h, char *key, size_t ksz) {
+	uint64_t p = 0;
+	if (node == NULL || !SHARED(map, b)) return node;
+	b = own(map, b);
+	if (b == NULL) return NULL;
+	return scan(b, h, key, ksz, &p);
+}
 
+/* ----------------------------------------------------------------------------
+ * Helper: Get the list node associated with a key
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_list_node_t *getnode(ts_algo_map_t *map, char *key, size_t ksz,
+                                           uint64_t h) {
+	migrate(map, TS_ALGO_MAP_MIGRATE);
+	return findnode(map, bucket(map, h), h, key, ksz);
 }
 
 /* ----------------------------------------------------------------------------
  * Helper: Get the slot associated with a key
  * ----------------------------------------------------------------------------
  */
-static inline slot_t *getslot(ts_algo_map_t *map, char *key, size_t ksz) {
-	ts_algo_list_node_t *n = getnode(map, key, ksz);
+static inline slot_t *getslot(ts_algo_map_t *map, char *key, size_t ksz,
+                              uint64_t h) {
+	ts_algo_list_node_t *n = getnode(map, key, ksz, h);
 	if (n != NULL) return n->cont;
 	return NULL;
 
@@ -238,28 +676,84 @@ static inline slot_t *getslot(ts_algo_map_t *map, char *key, size_t ksz) {
  * ----------------------------------------------------------------------------
  */
 void *ts_algo_map_get(ts_algo_map_t *map, char *key, size_t ksz) {
-	slot_t *s = getslot(map, key, ksz);
+	return ts_algo_map_getHashed(map, key, ksz,
+	                             map->hsh(key, ksz, map->rsc));
+}
+
+/* ----------------------------------------------------------------------------
+ * Get with a precomputed hash
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_map_getHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                            uint64_t h) {
+	slot_t *s = getslot(map, key, ksz, h);
 	if (s != NULL) return s->data;
 	return NULL;
 }
 
+/* ----------------------------------------------------------------------------
+ * Helper: Remove a key with hash h from bucket b
+ * ----------------------------------------------------------------------------
+ */
+static inline void *removefrom(ts_algo_map_t *map, ts_algo_list_t *b,
+                               uint64_t h, char *key, size_t ksz) {
+	ts_algo_list_node_t *run = findnode(map, b, h, key, ksz);
+	run = writable(map, b, run, h, key, ksz);
+	if (run == NULL) return NULL;
+	b = own(map, b);
+	ts_algo_list_remove(b, run);
+	void *data = SLOT(run->cont)->data;
+	freeentry(map, run);
+	map->count--;
+	return data;
+}
+
 /* ----------------------------------------------------------------------------
  * Remove a key from the map
  * ----------------------------------------------------------------------------
  */
 void *ts_algo_map_remove(ts_algo_map_t *map, char *key, size_t ksz) {
-	uint64_t k = map->hsh(key, ksz, NULL)%map->curSize;
-	for(ts_algo_list_node_t *run=map->buf[k].head; run!=NULL; run=run->nxt) {
-		if (memcmp(key, SLOT(run->cont)->key, ksz) == 0) {
-			ts_algo_list_remove(map->buf+k, run);
-			slot_t *slot = run->cont;
-			void *data = slot->data;
-			free(run); free(slot->key); free(slot);
-			map->count--;
-			return data;
-		}
-	}
-	return NULL;
+	return ts_algo_map_removeHashed(map, key, ksz,
+	                                map->hsh(key, ksz, map->rsc));
+}
+
+/* ----------------------------------------------------------------------------
+ * Remove with a precomputed hash
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_map_removeHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                               uint64_t h) {
+	migrate(map, TS_ALGO_MAP_MIGRATE);
+	void *data = removefrom(map, bucket(map, h), h, key, ksz);
+	autoshrink(map);
+	return data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Reserve space for n elements
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_reserve(ts_algo_map_t *map, uint32_t n) {
+	// we grow when there are twice as many elements as buckets
+	uint32_t sz = n/2+1;
+	if (ISSMALL(map) && n <= TS_ALGO_MAP_SMALLSZ) return TS_ALGO_OK;
+	if (sz <= map->curSize) return TS_ALGO_OK;
+	finish(map);
+	return bufresize(map, sz);
+}
+
+/* ----------------------------------------------------------------------------
+ * Shrink the buffer to the current number of elements
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_shrink(ts_algo_map_t *map) {
+	uint32_t sz = map->count;
+	if (sz < map->baseSize) sz = map->baseSize;
+	if (map->mode & TS_ALGO_MAP_SMALL &&
+	    map->count <= TS_ALGO_MAP_SMALLSZ) sz = 1;
+	finish(map);
+	if (sz >= map->curSize) return TS_ALGO_OK;
+	return bufresize(map, sz);
 }
 
 /* ----------------------------------------------------------------------------
@@ -268,7 +762,7 @@ void *ts_algo_map_remove(ts_algo_map_t *map, char *key, size_t ksz) {
  */
 void ts_algo_map_delete(ts_algo_map_t *map, char *key, size_t ksz) {
 	void *data = ts_algo_map_remove(map, key, ksz);
-	if (data != NULL && map->del != NULL) map->del(NULL, data);
+	if (data != NULL && map->del != NULL) map->del(NULL, &data);
 }
 
 /* ----------------------------------------------------------------------------
@@ -278,122 +772,1028 @@ void ts_algo_map_delete(ts_algo_map_t *map, char *key, size_t ksz) {
  * ----------------------------------------------------------------------------
  */
 void *ts_algo_map_update(ts_algo_map_t *map, char *key, size_t ksz, void *data) {
-	slot_t *s = getslot(map, key, ksz);
-	if (s == NULL) return NULL;
+	return ts_algo_map_updateHashed(map, key, ksz,
+	                                map->hsh(key, ksz, map->rsc), data);
+}
+
+/* ----------------------------------------------------------------------------
+ * Update with a precomputed hash
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_map_updateHashed(ts_algo_map_t *map, char *key, size_t ksz,
+                               uint64_t h, void *data) {
+	migrate(map, TS_ALGO_MAP_MIGRATE);
+	ts_algo_list_t *b = bucket(map, h);
+	ts_algo_list_node_t *node = writable(map, b, findnode(map, b, h, key, ksz),
+	                                     h, key, ksz);
+	if (node == NULL) return NULL;
+	slot_t *s = node->cont;
 	void *d = s->data;
 	s->data = data;
+	// the new data carry the key
+	if (BORROWED(map)) s->key = key;
 	return d;
 }
 
 /* ----------------------------------------------------------------------------
- * Create an iterator for the map
+ * Get the slot of a key or insert the key with data if it is not there yet;
+ * the map is resized before the probe, so the slot found or created
+ * remains valid until the next add or remove.
  * ----------------------------------------------------------------------------
  */
-ts_algo_map_it_t *ts_algo_map_iterate(ts_algo_map_t *map) {
-	ts_algo_map_it_t *it = calloc(1, sizeof(ts_algo_map_it_t));
-	if (it == NULL) return NULL;
-	it->map = map;
-	ts_algo_map_it_rewind(it);
-	return it;
+ts_algo_map_slot_t *ts_algo_map_getOrInsert(ts_algo_map_t *map,
+                                            char *key, size_t ksz,
+                                            void *data, char *inserted) {
+	migrate(map, TS_ALGO_MAP_MIGRATE);
+	if (inserted != NULL) *inserted = 0;
+	if (grow(map, 1) != TS_ALGO_OK) return NULL;
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	ts_algo_list_t *b = bucket(map, h);
+	ts_algo_list_node_t *node = findnode(map, b, h, key, ksz);
+	if (node != NULL) {
+		node = writable(map, b, node, h, key, ksz);
+		return node==NULL?NULL:node->cont;
+	}
+	b = own(map, b);
+	if (b == NULL) return NULL;
+	if (insert(map, b, key, ksz, h, data) != TS_ALGO_OK) return NULL;
+	if (inserted != NULL) *inserted = 1;
+	// insert puts the new node at the head of the list
+	return b->head->cont;
 }
 
 /* ----------------------------------------------------------------------------
- * Check if the iterator reached the end of the map.
- * We reached the iterator when we more often
- * than there are elements in the map.
+ * Insert or update
  * ----------------------------------------------------------------------------
  */
-char ts_algo_map_it_eof(ts_algo_map_it_t *it) {
-	if (it->count > it->map->count) return 1;
-	return 0;
+ts_algo_rc_t ts_algo_map_upsert(ts_algo_map_t *map, char *key, size_t ksz,
+                                                void *data, void **old) {
+	char inserted;
+	slot_t *s = ts_algo_map_getOrInsert(map, key, ksz, data, &inserted);
+	if (old != NULL) *old = NULL;
+	if (s == NULL) return TS_ALGO_NO_MEM;
+	if (!inserted) {
+		if (old != NULL) *old = s->data;
+		s->data = data;
+		if (BORROWED(map)) s->key = key;
+	}
+	return TS_ALGO_OK;
 }
 
 /* ----------------------------------------------------------------------------
- * Rewind the iterator.
+ * Batches are processed in windows of BATCH keys
  * ----------------------------------------------------------------------------
  */
-void ts_algo_map_it_rewind(ts_algo_map_it_t *it) {
-	it->count = 0;
-	it->slot  = 0;
-	it->entry = -1; // note that we start below the first element
-	ts_algo_map_it_advance(it);
-}
+#define BATCH 16
+
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
 
 /* ----------------------------------------------------------------------------
- * Advance the iterator
+ * Helper: hash a window of keys and find their buckets.
+ *         The buckets, the first nodes and their slots are prefetched
+ *         one stage after the other, so that, in each stage,
+ *         the loads of all keys in the window are on their way
+ *         before the first of them is used.
  * ----------------------------------------------------------------------------
  */
-void ts_algo_map_it_advance(ts_algo_map_it_t *it) {
-	// we passed beyond the last slot
-	// note: if it->count <= map.count,
-	//       something is wrong!
-	if (it->slot >= it->map->curSize) return;
-	// advance slot
-	if (it->entry+1 == it->map->buf[it->slot].len) {
-		it->entry = 0;
-		do {
-			it->slot++;
-		} while(it->slot < it->map->curSize &&
-		        it->map->buf[it->slot].len == 0);
-	// advance entry
-	} else {
-		it->entry++;
+static inline void prepare(ts_algo_map_t *map, char **keys, size_t *ksz,
+                           uint32_t n, uint64_t *h, ts_algo_list_t **b) {
+	for(uint32_t i=0; i<n; i++) {
+		h[i] = map->hsh(keys[i], ksz[i], map->rsc);
+		b[i] = bucket(map, h[i]);
+		PREFETCH(b[i]);
+	}
+	for(uint32_t i=0; i<n; i++) {
+		if (b[i]->head != NULL) PREFETCH(b[i]->head);
+	}
+	for(uint32_t i=0; i<n; i++) {
+		if (b[i]->head != NULL) PREFETCH(b[i]->head->cont);
 	}
-	// advance count
-	it->count++;
 }
 
 /* ----------------------------------------------------------------------------
- * Get the current entry
+ * Get a batch of keys
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_map_getBatch(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                              uint32_t n, void **out) {
+	uint64_t        h[BATCH];
+	ts_algo_list_t *b[BATCH];
+
+	for(uint32_t i=0; i<n; i+=BATCH) {
+		uint32_t w = n-i<BATCH?n-i:BATCH;
+		migrate(map, TS_ALGO_MAP_MIGRATE);
+		prepare(map, keys+i, ksz+i, w, h, b);
+		for(uint32_t j=0; j<w; j++) {
+			ts_algo_list_node_t *node = findnode(map, b[j], h[j],
+			                                     keys[i+j], ksz[i+j]);
+			out[i+j] = node==NULL?NULL:SLOT(node->cont)->data;
+		}
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Add a batch of keys
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_addBatch(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                                void **data, uint32_t n) {
+	uint64_t        h[BATCH];
+	ts_algo_list_t *b[BATCH];
+	ts_algo_rc_t rc;
+
+	for(uint32_t i=0; i<n; i+=BATCH) {
+		uint32_t w = n-i<BATCH?n-i:BATCH;
+		migrate(map, TS_ALGO_MAP_MIGRATE);
+		// resize before computing the buckets
+		rc = grow(map, w);
+		if (rc != TS_ALGO_OK) return rc;
+		prepare(map, keys+i, ksz+i, w, h, b);
+		for(uint32_t j=0; j<w; j++) {
+			rc = insert(map, b[j], keys[i+j], ksz[i+j], h[j], data[i+j]);
+			if (rc != TS_ALGO_OK) return rc;
+		}
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Remove a batch of keys
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_map_removeBatch(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                                 uint32_t n, void **out) {
+	uint64_t        h[BATCH];
+	ts_algo_list_t *b[BATCH];
+
+	for(uint32_t i=0; i<n; i+=BATCH) {
+		uint32_t w = n-i<BATCH?n-i:BATCH;
+		migrate(map, TS_ALGO_MAP_MIGRATE);
+		prepare(map, keys+i, ksz+i, w, h, b);
+		for(uint32_t j=0; j<w; j++) {
+			void *d = removefrom(map, b[j], h[j], keys[i+j], ksz[i+j]);
+			if (out != NULL) out[i+j] = d;
+		}
+		// shrinking invalidates the buckets of the window
+		autoshrink(map);
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Parallel operations: a thread is worth it only
+ * for at least PARMIN records or buckets
+ * ----------------------------------------------------------------------------
+ */
+#define PARMIN 4096
+
+/* ----------------------------------------------------------------------------
+ * Greatest number of threads used by parallel operations
+ * ----------------------------------------------------------------------------
+ */
+#define MAXTHREADS 256
+
+/* ----------------------------------------------------------------------------
+ * Helper: number of threads for m units of work
+ *         (nthreads 0 means one per processor)
+ * ----------------------------------------------------------------------------
+ */
+static inline uint32_t nworkers(uint32_t nthreads, uint32_t m) {
+	if (nthreads == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = n>0?(uint32_t)n:1;
+	}
+	if (nthreads > MAXTHREADS) nthreads = MAXTHREADS;
+	if (nthreads > m/PARMIN) nthreads = m/PARMIN;
+	return nthreads;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: run fun on n workers of size wsz; worker 0 runs in
+ *         the calling thread, and so does any worker
+ *         for which no thread can be created.
+ * ----------------------------------------------------------------------------
+ */
+static void runpar(void *(*fun)(void*), void *ws, size_t wsz, uint32_t n) {
+	pthread_t tids[MAXTHREADS];
+	char      started[MAXTHREADS];
+
+	for(uint32_t i=1; i<n; i++) {
+		started[i] = pthread_create(tids+i, NULL, fun, (char*)ws+i*wsz) == 0;
+	}
+	fun(ws);
+	for(uint32_t i=1; i<n; i++) {
+		if (started[i]) pthread_join(tids[i], NULL); else fun((char*)ws+i*wsz);
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * The buckets are divided into as many partitions as there are workers;
+ * this is the partition of bucket b
+ * ----------------------------------------------------------------------------
+ */
+#define PARTITION(b,sz,n) ((uint32_t)(((uint64_t)(b)*(n))/(sz)))
+
+/* ----------------------------------------------------------------------------
+ * A worker of fromArray; it passes through three phases:
+ * 0: hash the records lo..hi and count them per partition
+ * 1: scatter the record numbers into perm ordered by partition
+ * 2: create the entries of partition 'id' (perm[lo..hi])
+ *    and insert them into its buckets.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_map_t *map;
+	char         **keys;
+	size_t         *ksz;
+	void         **data;
+	uint64_t         *h; // hashes of all records
+	uint32_t      *perm; // record numbers ordered by partition
+	uint32_t       *cnt; // counters of this worker per partition
+	uint32_t         id; // worker number = partition
+	uint32_t          n; // number of workers
+	uint32_t         lo; // first record (or first index in perm)
+	uint32_t         hi; // end of records (or of indices in perm)
+	int           phase; // current phase
+	ts_algo_slab_t slabs[SLABCLASSES]; // private slabs (slab mode)
+	size_t          mem; // bytes allocated outside of slabs
+	uint32_t      count; // entries inserted
+	ts_algo_rc_t     rc; // result of phase 2
+} builder_t;
+
+static void *build(void *arg) {
+	builder_t *w = arg;
+	ts_algo_map_t *map = w->map;
+	uint32_t sz = map->curSize;
+
+	switch(w->phase) {
+	case 0:
+		for(uint32_t i=w->lo; i<w->hi; i++) {
+			w->h[i] = map->hsh(w->keys[i], w->ksz[i], map->rsc);
+			w->cnt[PARTITION(w->h[i]%sz, sz, w->n)]++;
+		}
+		break;
+	case 1:
+		for(uint32_t i=w->lo; i<w->hi; i++) {
+			w->perm[w->cnt[PARTITION(w->h[i]%sz, sz, w->n)]++] = i;
+		}
+		break;
+	default:
+		for(uint32_t j=w->lo; j<w->hi; j++) {
+			uint32_t i = w->perm[j];
+			ts_algo_list_node_t *node = newentry(map, w->slabs, &w->mem,
+			                                     w->keys[i], w->ksz[i],
+			                                     w->h[i], w->data[i]);
+			if (node == NULL) {
+				w->rc = TS_ALGO_NO_MEM; break;
+			}
+			ts_algo_list_insertNode(map->buf+w->h[i]%sz, node->cont, node);
+			w->count++;
+		}
+	}
+	return NULL;
+}
+
+/* ----------------------------------------------------------------------------
+ * Build from array
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_fromArray(ts_algo_map_t *map, char **keys, size_t *ksz,
+                                   void **data, uint32_t n, uint32_t nthreads) {
+	ts_algo_rc_t rc;
+	uint32_t  *start = NULL;
+	uint32_t  *cnt   = NULL;
+	uint64_t  *h     = NULL;
+	uint32_t  *perm  = NULL;
+	builder_t *ws    = NULL;
+
+	nthreads = nworkers(nthreads, n);
+	if (nthreads < 2) return ts_algo_map_addBatch(map, keys, ksz, data, n);
+
+	// make room for all records at once;
+	// the workers write to the buffer directly
+	finish(map);
+	rc = detach(map);
+	if (rc != TS_ALGO_OK) return rc;
+	rc = ts_algo_map_reserve(map, map->count+n);
+	if (rc != TS_ALGO_OK) return rc;
+
+	start = malloc((nthreads+1)*sizeof(uint32_t));
+	cnt   = calloc(nthreads*nthreads, sizeof(uint32_t));
+	h     = malloc(n*sizeof(uint64_t));
+	perm  = malloc(n*sizeof(uint32_t));
+	ws    = calloc(nthreads, sizeof(builder_t));
+	if (start == NULL || cnt == NULL || h == NULL ||
+	    perm  == NULL || ws  == NULL) {
+		rc = TS_ALGO_NO_MEM; goto cleanup;
+	}
+	for(uint32_t t=0; t<nthreads; t++) {
+		builder_t *w = ws+t;
+		w->map  = map;
+		w->keys = keys;
+		w->ksz  = ksz;
+		w->data = data;
+		w->h    = h;
+		w->perm = perm;
+		w->cnt  = cnt+t*nthreads;
+		w->id   = t;
+		w->n    = nthreads;
+		w->lo   = (uint32_t)(((uint64_t)n*t)/nthreads);
+		w->hi   = (uint32_t)(((uint64_t)n*(t+1))/nthreads);
+		w->rc   = TS_ALGO_OK;
+		for(int i=0; i<SLABCLASSES && map->slabs != NULL; i++) {
+			ts_algo_slab_init(w->slabs+i, sizeof(entry_t)+(i<<4), 0);
+		}
+	}
+	runpar(build, ws, sizeof(builder_t), nthreads);
+
+	// the counters become the positions in perm:
+	// partition by partition and, within a partition, worker by worker
+	for(uint32_t p=0, pos=0; p<nthreads; p++) {
+		start[p] = pos;
+		for(uint32_t t=0; t<nthreads; t++) {
+			uint32_t c = ws[t].cnt[p];
+			ws[t].cnt[p] = pos; pos += c;
+		}
+	}
+	start[nthreads] = n;
+	for(uint32_t t=0; t<nthreads; t++) ws[t].phase = 1;
+	runpar(build, ws, sizeof(builder_t), nthreads);
+
+	for(uint32_t t=0; t<nthreads; t++) {
+		ws[t].phase = 2;
+		ws[t].lo = start[t];
+		ws[t].hi = start[t+1];
+	}
+	runpar(build, ws, sizeof(builder_t), nthreads);
+
+	// collect what the workers allocated
+	for(uint32_t t=0; t<nthreads; t++) {
+		map->count += ws[t].count;
+		map->mem   += ws[t].mem;
+		for(int i=0; i<SLABCLASSES && map->slabs != NULL; i++) {
+			ts_algo_slab_merge(map->slabs+i, ws[t].slabs+i);
+		}
+		if (ws[t].rc != TS_ALGO_OK) rc = ws[t].rc;
+	}
+cleanup:
+	free(start); free(cnt); free(h); free(perm); free(ws);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Can the entries of s be moved to d as they are?
+ * (They are allocated in the same way; in slab mode,
+ *  the slabs of s are merged into those of d.)
+ * ----------------------------------------------------------------------------
+ */
+#define MOVABLE(d,s) ((((d)->mode^(s)->mode) & \
+                      (TS_ALGO_MAP_SLAB|TS_ALGO_MAP_BORROW)) == 0)
+
+/* ----------------------------------------------------------------------------
+ * Do the maps d and s compute the same hashes?
+ * ----------------------------------------------------------------------------
+ */
+#define SAMEHASH(d,s) ((d)->hsh == (s)->hsh && (d)->rsc == (s)->rsc)
+
+/* ----------------------------------------------------------------------------
+ * Helper: resolve a conflict between the entry 'found' in dst and
+ *         the slot s of src that has the same key. Afterwards, s holds
+ *         the data to be dropped, i.e. its own data (KEEP) or the
+ *         data of 'found' (REPLACE), which is then swapped into s.
+ *         Borrowed keys go with their data.
+ * ----------------------------------------------------------------------------
+ */
+static inline void resolve(ts_algo_map_t *dst, slot_t *found,
+                           slot_t *s, uint32_t policy) {
+	if (policy == TS_ALGO_MAP_REPLACE) {
+		void *d = found->data;
+		found->data = s->data; s->data = d;
+		if (BORROWED(dst)) {
+			char *k = found->key;
+			found->key = s->key; s->key = k;
+		}
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: release the nodes on the chain (linked by nxt) that were
+ *         dropped by merge or intersect and apply del on their data.
+ * ----------------------------------------------------------------------------
+ */
+static void dropchain(ts_algo_map_t *map, ts_algo_list_node_t *chain,
+                                          ts_algo_delete_t     del) {
+	while(chain != NULL) {
+		ts_algo_list_node_t *tmp = chain->nxt;
+		void *data = SLOT(chain->cont)->data;
+		freeentry(map, chain);
+		if (del != NULL) del(NULL, &data);
+		chain = tmp;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * A worker of merge and intersect.
+ * merge passes through two phases:
+ * 0: unlink the nodes of the src buckets lo..hi and put them on
+ *    the chain of the dst partition they belong to
+ * 1: insert the nodes on the chains of partition 'id' into dst
+ *    (or drop them if the key is already there).
+ * intersect has one phase: unlink the nodes of the dst buckets lo..hi
+ * whose keys are not in src.
+ * Dropped nodes are collected and released by the calling thread,
+ * since releasing them changes the slabs and the memory counter.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_map_t  *dst;
+	ts_algo_map_t  *src;
+	uint32_t     policy; // conflict policy (merge only)
+	uint32_t         id; // worker number = partition
+	uint32_t          n; // number of workers
+	uint32_t         lo; // first bucket
+	uint32_t         hi; // end of buckets
+	int           phase; // current phase
+	ts_algo_list_node_t **chains; // n*n chains [worker][partition]
+	ts_algo_list_node_t  *drop; // nodes to be released
+	uint32_t      count; // nodes inserted (merge) or dropped (intersect)
+} mover_t;
+
+static void *move(void *arg) {
+	mover_t *w = arg;
+	ts_algo_map_t *dst = w->dst;
+	ts_algo_map_t *src = w->src;
+	uint32_t sz = dst->curSize;
+	uint64_t p = 0;
+
+	if (w->phase == 0) {
+		for(uint32_t i=w->lo; i<w->hi; i++) {
+			for(ts_algo_list_node_t *run=src->buf[i].head; run!=NULL;) {
+				ts_algo_list_node_t *tmp = run->nxt;
+				slot_t *s = SLOT(run->cont);
+				if (!SAMEHASH(dst, src)) {
+					s->hash = dst->hsh(s->key, s->ksz, dst->rsc);
+				}
+				ts_algo_list_node_t **c = w->chains+w->id*w->n+
+				                          PARTITION(s->hash%sz, sz, w->n);
+				run->nxt = *c; *c = run;
+				run = tmp;
+			}
+			ts_algo_list_init(src->buf+i);
+		}
+		return NULL;
+	}
+	for(uint32_t t=0; t<w->n; t++) {
+		ts_algo_list_node_t *run = w->chains[t*w->n+w->id];
+		while(run != NULL) {
+			ts_algo_list_node_t *tmp = run->nxt;
+			slot_t *s = SLOT(run->cont);
+			ts_algo_list_t *b = dst->buf+s->hash%sz;
+			ts_algo_list_node_t *found = scan(b, s->hash, s->key, s->ksz, &p);
+			if (found != NULL) {
+				resolve(dst, found->cont, s, w->policy);
+				run->nxt = w->drop; w->drop = run;
+			} else {
+				ts_algo_list_insertNode(b, s, run);
+				w->count++;
+			}
+			run = tmp;
+		}
+	}
+	return NULL;
+}
+
+static void *sieve(void *arg) {
+	mover_t *w = arg;
+	ts_algo_map_t *dst = w->dst;
+	ts_algo_map_t *src = w->src;
+	uint64_t p = 0;
+
+	for(uint32_t i=w->lo; i<w->hi; i++) {
+		for(ts_algo_list_node_t *run=dst->buf[i].head; run!=NULL;) {
+			ts_algo_list_node_t *tmp = run->nxt;
+			slot_t *s = SLOT(run->cont);
+			uint64_t h = SAMEHASH(dst, src) ? s->hash :
+			             src->hsh(s->key, s->ksz, src->rsc);
+			if (scan(bucket(src, h), h, s->key, s->ksz, &p) == NULL) {
+				ts_algo_list_remove(dst->buf+i, run);
+				run->nxt = w->drop; w->drop = run;
+				w->count++;
+			}
+			run = tmp;
+		}
+	}
+	return NULL;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: merge entries that cannot be moved;
+ *         they are copied into dst and released in src one by one,
+ *         so, if we run out of memory, src keeps the rest.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t copyall(ts_algo_map_t *dst, ts_algo_map_t *src,
+                            uint32_t policy) {
+	uint64_t p = 0;
+	for(uint32_t i=0; i<src->curSize; i++) {
+		ts_algo_list_t *l = src->buf+i;
+		while(l->head != NULL) {
+			ts_algo_list_node_t *run = l->head;
+			slot_t *s = SLOT(run->cont);
+			uint64_t h = SAMEHASH(dst, src) ? s->hash :
+			             dst->hsh(s->key, s->ksz, dst->rsc);
+			ts_algo_list_t *b = bucket(dst, h);
+			ts_algo_list_node_t *found = scan(b, h, s->key, s->ksz, &p);
+			if (found != NULL) {
+				resolve(dst, found->cont, s, policy);
+			} else {
+				ts_algo_rc_t rc = insert(dst, b, s->key, s->ksz,
+				                         h, s->data);
+				if (rc != TS_ALGO_OK) return rc;
+			}
+			ts_algo_list_remove(l, run);
+			src->count--;
+			void *data = s->data;
+			freeentry(src, run);
+			if (found != NULL) {
+				ts_algo_delete_t del = policy == TS_ALGO_MAP_REPLACE ?
+				                       dst->del : src->del;
+				if (del != NULL) del(NULL, &data);
+			}
+		}
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Merge
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_merge(ts_algo_map_t *dst, ts_algo_map_t *src,
+                               uint32_t policy, uint32_t nthreads) {
+	ts_algo_rc_t rc;
+	ts_algo_list_node_t **chains;
+	mover_t ws[MAXTHREADS];
+
+	if (dst == src) return TS_ALGO_INVALID;
+	if (policy != TS_ALGO_MAP_KEEP &&
+	    policy != TS_ALGO_MAP_REPLACE) return TS_ALGO_INVALID;
+	// dst would point to keys released with src
+	if (BORROWED(dst) && !BORROWED(src)) return TS_ALGO_INVALID;
+	// the snapshots would release entries into the slabs of dst
+	if (src->snaps > 0) return TS_ALGO_INVALID;
+
+	finish(src); finish(dst);
+	rc = detach(src);
+	if (rc != TS_ALGO_OK) return rc;
+	rc = detach(dst);
+	if (rc != TS_ALGO_OK) return rc;
+	rc = ts_algo_map_reserve(dst, dst->count+src->count);
+	if (rc != TS_ALGO_OK) return rc;
+
+	if (!MOVABLE(dst, src)) {
+		rc = copyall(dst, src, policy);
+		autoshrink(src);
+		return rc;
+	}
+	nthreads = nworkers(nthreads, src->curSize);
+	if (nthreads < 1) nthreads = 1;
+
+	chains = calloc(nthreads*nthreads, sizeof(ts_algo_list_node_t*));
+	if (chains == NULL) return TS_ALGO_NO_MEM;
+	// from here on, nothing can fail: the entries of src become ours
+	if (dst->slabs != NULL) {
+		for(int i=0; i<SLABCLASSES; i++) {
+			ts_algo_slab_merge(dst->slabs+i, src->slabs+i);
+		}
+	}
+	dst->mem += src->mem; src->mem = 0;
+
+	memset(ws, 0, nthreads*sizeof(mover_t));
+	for(uint32_t t=0; t<nthreads; t++) {
+		ws[t].dst    = dst;
+		ws[t].src    = src;
+		ws[t].policy = policy;
+		ws[t].id     = t;
+		ws[t].n      = nthreads;
+		ws[t].lo     = (uint32_t)(((uint64_t)src->curSize*t)/nthreads);
+		ws[t].hi     = (uint32_t)(((uint64_t)src->curSize*(t+1))/nthreads);
+		ws[t].chains = chains;
+	}
+	runpar(move, ws, sizeof(mover_t), nthreads);
+	for(uint32_t t=0; t<nthreads; t++) ws[t].phase = 1;
+	runpar(move, ws, sizeof(mover_t), nthreads);
+
+	src->count = 0;
+	for(uint32_t t=0; t<nthreads; t++) {
+		dst->count += ws[t].count;
+		dropchain(dst, ws[t].drop, policy == TS_ALGO_MAP_REPLACE ?
+		                           dst->del : src->del);
+	}
+	free(chains);
+	autoshrink(src);
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Intersect
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_intersect(ts_algo_map_t *dst, ts_algo_map_t *src,
+                                   uint32_t nthreads) {
+	mover_t ws[MAXTHREADS];
+
+	if (dst == src) return TS_ALGO_OK;
+
+	finish(dst);
+	if (detach(dst) != TS_ALGO_OK) return TS_ALGO_NO_MEM;
+	nthreads = nworkers(nthreads, dst->curSize);
+	if (nthreads < 1) nthreads = 1;
+
+	memset(ws, 0, nthreads*sizeof(mover_t));
+	for(uint32_t t=0; t<nthreads; t++) {
+		ws[t].dst = dst;
+		ws[t].src = src;
+		ws[t].id  = t;
+		ws[t].n   = nthreads;
+		ws[t].lo  = (uint32_t)(((uint64_t)dst->curSize*t)/nthreads);
+		ws[t].hi  = (uint32_t)(((uint64_t)dst->curSize*(t+1))/nthreads);
+	}
+	runpar(sieve, ws, sizeof(mover_t), nthreads);
+	for(uint32_t t=0; t<nthreads; t++) {
+		dst->count -= ws[t].count;
+		dropchain(dst, ws[t].drop, dst->del);
+	}
+	autoshrink(dst);
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Create an iterator for the map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_map_it_t *ts_algo_map_iterate(ts_algo_map_t *map) {
+	ts_algo_map_it_t *it = calloc(1, sizeof(ts_algo_map_it_t));
+	if (it == NULL) return NULL;
+	// the iterator sees only the current buffer
+	finish(map);
+	it->map = map;
+	ts_algo_map_it_rewind(it);
+	return it;
+}
+
+/* ----------------------------------------------------------------------------
+ * Check if the iterator reached the end of the map.
+ * We reached the iterator when we more often
+ * than there are elements in the map.
+ * ----------------------------------------------------------------------------
+ */
+char ts_algo_map_it_eof(ts_algo_map_it_t *it) {
+	if (it->count > it->map->count) return 1;
+	return 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: move the iterator to the head of the next non-empty slot
+ * ----------------------------------------------------------------------------
+ */
+static inline void nextslot(ts_algo_map_it_t *it) {
+	it->entry = 0;
+	it->node = NULL;
+	do {
+		it->slot++;
+	} while(it->slot < it->map->curSize &&
+	        view(it->map, it->slot)->head == NULL);
+	if (it->slot < it->map->curSize) {
+		it->node = view(it->map, it->slot)->head;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Rewind the iterator.
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_map_it_rewind(ts_algo_map_it_t *it) {
+	it->slot  = 0;
+	it->entry = 0;
+	it->node  = view(it->map, 0)->head;
+	if (it->node == NULL) nextslot(it);
+	it->count = 1; // the count is one ahead (see eof)
+}
+
+/* ----------------------------------------------------------------------------
+ * Advance the iterator
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_map_it_advance(ts_algo_map_it_t *it) {
+	// we passed beyond the last slot
+	// note: if it->count <= map.count,
+	//       something is wrong!
+	if (it->slot >= it->map->curSize) return;
+	// advance entry
+	if (it->node != NULL && it->node->nxt != NULL) {
+		it->node = it->node->nxt;
+		it->entry++;
+	// advance slot
+	} else {
+		nextslot(it);
+	}
+	// advance count
+	it->count++;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get the current entry
  * ----------------------------------------------------------------------------
  */
 ts_algo_map_slot_t *ts_algo_map_it_get(ts_algo_map_it_t *it) {
 	if (it->slot >= it->map->curSize) return NULL;
-	int i=0;
-	for(ts_algo_list_node_t *run=it->map->buf[it->slot].head;
-	    run!=NULL; run=run->nxt)
-	{
-		if (i == it->entry) return run->cont;
-		i++;
+	if (it->node == NULL) return NULL;
+	return it->node->cont;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: apply fun on all slots in the list
+ * ----------------------------------------------------------------------------
+ */
+static inline ts_algo_rc_t visitlist(ts_algo_list_t      *list,
+                                     ts_algo_map_visit_t  fun,
+                                     void                *rsc) {
+	for(ts_algo_list_node_t *run=list->head; run!=NULL; run=run->nxt) {
+		ts_algo_rc_t rc = fun(rsc, run->cont);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Apply fun on all slots in the map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_forEach(ts_algo_map_t       *map,
+                                 ts_algo_map_visit_t  fun,
+                                 void                *rsc) {
+	ts_algo_rc_t rc;
+	// the buckets not yet migrated
+	for(uint32_t i=map->moved; map->old!=NULL && i<map->oldSize; i++) {
+		rc = visitlist(map->old+i, fun, rsc);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	for(uint32_t i=0; i<map->curSize; i++) {
+		rc = visitlist(view(map, i), fun, rsc);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * A worker of forEachPar visiting the buckets lo..hi;
+ * the buckets not yet migrated come first, then the current buffer.
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_map_t      *map;
+	ts_algo_map_visit_t fun;
+	void               *rsc;
+	uint32_t             lo;
+	uint32_t             hi;
+	char              *stop; // set by the first worker that fails
+	ts_algo_rc_t         rc;
+} visitor_t;
+
+static void *visit(void *arg) {
+	visitor_t *w = arg;
+	ts_algo_map_t *map = w->map;
+	uint32_t nold = map->old==NULL?0:map->oldSize-map->moved;
+
+	for(uint32_t i=w->lo; i<w->hi; i++) {
+		if (__atomic_load_n(w->stop, __ATOMIC_RELAXED)) break;
+		w->rc = visitlist(i<nold?map->old+map->moved+i:view(map, i-nold),
+		                  w->fun, w->rsc);
+		if (w->rc != TS_ALGO_OK) {
+			__atomic_store_n(w->stop, 1, __ATOMIC_RELAXED); break;
+		}
 	}
 	return NULL;
 }
 
+/* ----------------------------------------------------------------------------
+ * Apply fun on all slots in the map in parallel
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_forEachPar(ts_algo_map_t       *map,
+                                    ts_algo_map_visit_t  fun,
+                                    void                *rsc,
+                                    uint32_t        nthreads) {
+	visitor_t ws[MAXTHREADS];
+	char stop = 0;
+	uint32_t m = map->curSize;
+
+	if (map->old != NULL) m += map->oldSize-map->moved;
+	nthreads = nworkers(nthreads, m);
+	if (nthreads < 2) return ts_algo_map_forEach(map, fun, rsc);
+
+	for(uint32_t t=0; t<nthreads; t++) {
+		ws[t].map  = map;
+		ws[t].fun  = fun;
+		ws[t].rsc  = rsc;
+		ws[t].lo   = (uint32_t)(((uint64_t)m*t)/nthreads);
+		ws[t].hi   = (uint32_t)(((uint64_t)m*(t+1))/nthreads);
+		ws[t].stop = &stop;
+		ws[t].rc   = TS_ALGO_OK;
+	}
+	runpar(visit, ws, sizeof(visitor_t), nthreads);
+	for(uint32_t t=0; t<nthreads; t++) {
+		if (ws[t].rc != TS_ALGO_OK) return ws[t].rc;
+	}
+	return TS_ALGO_OK;
+}
+
+/* -------------------------------------------------------------------------
+ * Helper: forEach callback for toList
+ * -------------------------------------------------------------------------
+ */
+static ts_algo_rc_t inserttolist(void *list, slot_t *s) {
+	return ts_algo_list_insert(list, s);
+}
+
 /* -------------------------------------------------------------------------
  * Convert map to list.
  * -------------------------------------------------------------------------
  */
 ts_algo_list_t *ts_algo_map_toList(ts_algo_map_t *map) {
-	ts_algo_rc_t rc = TS_ALGO_OK;
 	ts_algo_list_t *l = malloc(sizeof(ts_algo_list_t));
 	if (l == NULL) return NULL;
 	ts_algo_list_init(l);
-	ts_algo_map_it_t *it = ts_algo_map_iterate(map);
-	if (it == NULL) {
-		free(l); return NULL;
-	}
-	for(;!ts_algo_map_it_eof(it);ts_algo_map_it_advance(it)) {
-		slot_t *s = ts_algo_map_it_get(it);
-		if (s == NULL) {
-			rc = TS_ALGO_ERR; break;
-		}
-		rc = ts_algo_list_insert(l, s);
-		if (rc != TS_ALGO_OK) break;
-	}
-	free(it);
-	if (rc != TS_ALGO_OK) {
+	if (ts_algo_map_forEach(map, inserttolist, l) != TS_ALGO_OK) {
 		ts_algo_list_destroy(l); free(l);
 		return NULL;
 	}
 	return l;
 }
 
+/* ----------------------------------------------------------------------------
+ * Snapshot
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_snapshot(ts_algo_map_t *map, ts_algo_map_snap_t *snap) {
+	if (map == NULL || snap == NULL) return TS_ALGO_INVALID;
+
+	// the snapshot shares the current buffer only
+	finish(map);
+
+	// the previous snapshot keeps what it sees
+	ts_algo_rc_t rc = detach(map);
+	if (rc != TS_ALGO_OK) return rc;
+
+	ts_algo_list_t *buf = newbuf(map->curSize);
+	if (buf == NULL) return TS_ALGO_NO_MEM;
+	map->cowbits = calloc((map->curSize+7)/8, 1);
+	if (map->cowbits == NULL) {
+		free(buf); return TS_ALGO_NO_MEM;
+	}
+	snap->map   = map;
+	snap->buf   = map->buf;
+	snap->size  = map->curSize;
+	snap->count = map->count;
+
+	map->cow = map->buf;
+	map->buf = buf;
+	map->snaps++;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Release a snapshot
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_map_release(ts_algo_map_snap_t *snap) {
+	if (snap == NULL || snap->buf == NULL) return;
+	ts_algo_map_t *map = snap->map;
+	char attached = map->cow == snap->buf;
+
+	for(uint32_t i=0; i<snap->size; i++) {
+		// the map has not changed this bucket: it is the map's again
+		if (attached && !COPIED(map, i)) {
+			map->buf[i] = snap->buf[i]; continue;
+		}
+		// only the snapshot sees these entries
+		for(ts_algo_list_node_t *run=snap->buf[i].head; run!=NULL;) {
+			ts_algo_list_node_t *tmp = run->nxt;
+			freeentry(map, run);
+			run = tmp;
+		}
+	}
+	if (attached) {
+		free(map->cowbits); map->cowbits = NULL;
+		map->cow = NULL;
+	}
+	free(snap->buf); snap->buf = NULL;
+	snap->size = 0;
+	snap->count = 0;
+	map->snaps--;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get from a snapshot
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_map_snapGet(ts_algo_map_snap_t *snap, char *key, size_t ksz) {
+	uint64_t p = 0;
+	uint64_t h = snap->map->hsh(key, ksz, snap->map->rsc);
+	ts_algo_list_node_t *node = scan(snap->buf+h%snap->size,
+	                                 h, key, ksz, &p);
+	if (node != NULL) return SLOT(node->cont)->data;
+	return NULL;
+}
+
+/* ----------------------------------------------------------------------------
+ * Apply fun on all slots in a snapshot
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_map_snapForEach(ts_algo_map_snap_t  *snap,
+                                     ts_algo_map_visit_t  fun,
+                                     void                *rsc) {
+	for(uint32_t i=0; i<snap->size; i++) {
+		ts_algo_rc_t rc = visitlist(snap->buf+i, fun, rsc);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
+
 /* ----------------------------------------------------------------------------
  * Debug: Show size of slots
  * ----------------------------------------------------------------------------
  */
 void ts_algo_map_showslots(ts_algo_map_t *map) {
+	for (int i=map->moved;map->old!=NULL && i<map->oldSize;i++) {
+		fprintf(stderr, "old %06d: %d\n", i, map->old[i].len);
+	}
 	for (int i=0;i<map->curSize;i++) {
-		fprintf(stderr, "%06d: %d\n", i, map->buf[i].len);
+		fprintf(stderr, "%06d: %d\n", i, view(map, i)->len);
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: add a chain of length l to the statistics
+ * ----------------------------------------------------------------------------
+ */
+static inline void chain(uint32_t l, ts_algo_map_stats_t *stats) {
+	if (l > stats->maxchain) stats->maxchain = l;
+	stats->histo[l<TS_ALGO_MAP_HISTO?l:TS_ALGO_MAP_HISTO-1]++;
+}
+
+/* ----------------------------------------------------------------------------
+ * Statistics
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_map_stats(ts_algo_map_t *map, ts_algo_map_stats_t *stats) {
+	memset(stats, 0, sizeof(ts_algo_map_stats_t));
+
+	stats->count = map->count;
+	stats->buckets = map->curSize;
+	for(uint32_t i=0; i<map->curSize; i++) {
+		chain(view(map, i)->len, stats);
+	}
+	stats->mem = map->curSize*sizeof(ts_algo_list_t);
+	if (map->old != NULL) {
+		stats->buckets += map->oldSize - map->moved;
+		for(uint32_t i=map->moved; i<map->oldSize; i++) {
+			chain(map->old[i].len, stats);
+		}
+		stats->mem += map->oldSize*sizeof(ts_algo_list_t);
 	}
+	// the shared buffer belongs to the map and the snapshot
+	if (map->cow != NULL) {
+		stats->mem += map->curSize*sizeof(ts_algo_list_t)+
+		              (map->curSize+7)/8;
+	}
+	stats->load = (double)map->count/(double)stats->buckets;
+
+	stats->lookups    = map->lookups;
+	stats->probes     = map->probes;
+	stats->resizes    = map->resizes;
+	stats->resizeTime = map->rsztime;
+
+	stats->mem += map->mem;
+	if (map->slabs != NULL) {
+		stats->mem += SLABCLASSES*sizeof(ts_algo_slab_t);
+		for(int i=0; i<SLABCLASSES; i++) {
+			stats->mem += map->slabs[i].mem;
+		}
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Reset the counters
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_map_resetStats(ts_algo_map_t *map) {
+	map->lookups = 0;
+	map->probes  = 0;
+	map->resizes = 0;
+	map->rsztime = 0;
 }
@@ -0,0 +1,373 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Open Addressing Map Datatype Implementation
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tsalgo/oamap.h>
+
+/* ----------------------------------------------------------------------------
+ * Just shorthands
+ * ----------------------------------------------------------------------------
+ */
+#define slot_t  ts_algo_map_slot_t
+#define entry_t ts_algo_oamap_entry_t
+
+/* ----------------------------------------------------------------------------
+ * Mask to compute the home position from the hash
+ * ----------------------------------------------------------------------------
+ */
+#define MASK(m) ((m)->curSize-1)
+
+/* ----------------------------------------------------------------------------
+ * Distance of the slot at position p from its home position
+ * ----------------------------------------------------------------------------
+ */
+#define DIST(m,p) ((uint32_t)(((p) - (m)->buf[p].slot.hash)&MASK(m)))
+
+/* ----------------------------------------------------------------------------
+ * Is the slot empty?
+ * ----------------------------------------------------------------------------
+ */
+#define EMPTY(m,p) ((m)->buf[p].slot.key == NULL)
+
+/* ----------------------------------------------------------------------------
+ * Is the key stored in the entry?
+ * ----------------------------------------------------------------------------
+ */
+#define INLINE(e) ((e)->slot.ksz <= TS_ALGO_OAMAP_INLINE)
+
+/* ----------------------------------------------------------------------------
+ * We grow when the buffer is filled by 7/8
+ * ----------------------------------------------------------------------------
+ */
+#define FULL(m) ((m)->count >= (m)->curSize - ((m)->curSize>>3))
+
+/* ----------------------------------------------------------------------------
+ * Helper: round up to the next power of 2
+ * ----------------------------------------------------------------------------
+ */
+static inline uint32_t pow2(uint32_t sz) {
+	uint32_t p = 8;
+	while(p < sz && p < 0x80000000) p<<=1;
+	return p;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: store an entry at position p;
+ *         an inline key moves with the entry.
+ * ----------------------------------------------------------------------------
+ */
+static inline void put(ts_algo_oamap_t *map, uint32_t p, entry_t *e) {
+	map->buf[p] = *e;
+	if (INLINE(e)) map->buf[p].slot.key = map->buf[p].ikey;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: allocate a buffer of sz entries aligned to the cache line
+ * ----------------------------------------------------------------------------
+ */
+static inline entry_t *newbuf(uint32_t sz) {
+	entry_t *buf;
+	if (posix_memalign((void**)&buf, 64, (size_t)sz*sizeof(entry_t)) != 0) {
+		return NULL;
+	}
+	memset(buf, 0, (size_t)sz*sizeof(entry_t));
+	return buf;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: place an entry (without checking for duplicates);
+ *         the caller guarantees that there is at least one free slot.
+ * ----------------------------------------------------------------------------
+ */
+static inline void place(ts_algo_oamap_t *map, entry_t *e) {
+	entry_t cur = *e;
+	uint32_t p = cur.slot.hash&MASK(map);
+	uint32_t d = 0;
+
+	for(;;) {
+		if (EMPTY(map,p)) {
+			put(map, p, &cur); return;
+		}
+		// the resident is closer to its home than we are:
+		// we take its place and continue with the resident
+		uint32_t x = DIST(map,p);
+		if (x < d) {
+			entry_t tmp = map->buf[p];
+			put(map, p, &cur); cur = tmp; d = x;
+		}
+		p = (p+1)&MASK(map); d++;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: resize the buffer
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t bufresize(ts_algo_oamap_t *map) {
+	entry_t *old = map->buf;
+	uint32_t osz = map->curSize;
+
+	if (osz >= 0x80000000) return TS_ALGO_NO_MEM;
+
+	map->buf = newbuf(osz<<1);
+	if (map->buf == NULL) {
+		map->buf = old; return TS_ALGO_NO_MEM;
+	}
+	map->curSize = osz<<1;
+
+	// long keys are not copied, only the entries are moved
+	for(uint32_t i=0; i<osz; i++) {
+		if (old[i].slot.key != NULL) place(map, old+i);
+	}
+	free(old);
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: find the position of a key or return -1
+ * ----------------------------------------------------------------------------
+ */
+static inline int64_t findpos(ts_algo_oamap_t *map, char *key, size_t ksz) {
+	uint64_t h = map->hsh(key, ksz, map->rsc);
+	uint32_t p = h&MASK(map);
+	uint32_t d = 0;
+
+	for(;;) {
+		if (EMPTY(map,p)) return -1;
+		// if the key were here, we would have seen it already
+		if (DIST(map,p) < d) return -1;
+		if (map->buf[p].slot.hash == h   &&
+		    map->buf[p].slot.ksz  == ksz &&
+		    (ksz == 0 || memcmp(key, map->buf[p].slot.key, ksz) == 0)) {
+			return p;
+		}
+		p = (p+1)&MASK(map); d++;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map and initialise it
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_oamap_t *ts_algo_oamap_new(uint32_t sz,
+                                   ts_algo_hash_t   hsh,
+                                   ts_algo_delete_t del) {
+	ts_algo_oamap_t *map = malloc(sizeof(ts_algo_oamap_t));
+	if (map == NULL) return NULL;
+	ts_algo_rc_t rc = ts_algo_oamap_init(map, sz, hsh, del);
+	if (rc != TS_ALGO_OK) {
+		free(map); return NULL;
+	}
+	return map;
+}
+
+/* ----------------------------------------------------------------------------
+ * Initialise an already allocated map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_oamap_init(ts_algo_oamap_t *map, uint32_t sz,
+		                             ts_algo_hash_t   hsh,
+		                             ts_algo_delete_t del) {
+	if (map == NULL) return TS_ALGO_INVALID;
+	map->baseSize = pow2(sz==0?8192:sz);
+	map->curSize  = map->baseSize;
+	map->count    = 0;
+	map->del      = del;
+	map->hsh      = hsh==NULL?ts_algo_hash_bytes:hsh;
+	map->rsc      = NULL;
+	map->buf      = newbuf(map->baseSize);
+	if (map->buf == NULL) return TS_ALGO_NO_MEM;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Destroy an existing map
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_oamap_destroy(ts_algo_oamap_t *map) {
+	if (map == NULL) return;
+	if (map->buf == NULL) return;
+	for(uint32_t i=0; i<map->curSize; i++) {
+		if (EMPTY(map,i)) continue;
+		if (!INLINE(map->buf+i)) free(map->buf[i].slot.key);
+		if (map->del != NULL) map->del(NULL, &map->buf[i].slot.data);
+	}
+	free(map->buf); map->buf = NULL;
+	map->count = 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Add a new element to the map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_oamap_add(ts_algo_oamap_t *map, char *key, size_t ksz, void *data) {
+	entry_t e;
+
+	if (FULL(map)) {
+		ts_algo_rc_t rc = bufresize(map);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	e.slot.ksz = ksz;
+	if (INLINE(&e)) {
+		e.slot.key = e.ikey;
+	} else {
+		e.slot.key = malloc(ksz);
+		if (e.slot.key == NULL) return TS_ALGO_NO_MEM;
+	}
+	if (ksz > 0) memcpy(e.slot.key, key, ksz);
+	e.slot.hash = map->hsh(key, ksz, map->rsc);
+	e.slot.data = data;
+	place(map, &e);
+	map->count++;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get the data associated with a key
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_oamap_get(ts_algo_oamap_t *map, char *key, size_t ksz) {
+	int64_t p = findpos(map, key, ksz);
+	if (p < 0) return NULL;
+	return map->buf[p].slot.data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Remove a key from the map
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_oamap_remove(ts_algo_oamap_t *map, char *key, size_t ksz) {
+	int64_t x = findpos(map, key, ksz);
+	if (x < 0) return NULL;
+
+	uint32_t p = (uint32_t)x;
+	void *data = map->buf[p].slot.data;
+	if (!INLINE(map->buf+p)) free(map->buf[p].slot.key);
+
+	// backward shift: move the following entries
+	// one position closer to their home until
+	// we see an empty slot or an entry at home.
+	for(uint32_t n = (p+1)&MASK(map);
+	    !EMPTY(map,n) && DIST(map,n) > 0;
+	    n = (n+1)&MASK(map))
+	{
+		put(map, p, map->buf+n); p = n;
+	}
+	memset(map->buf+p, 0, sizeof(entry_t));
+	map->count--;
+	return data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Delete a key from the map, i.e. remove it from the key and free the memory.
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_oamap_delete(ts_algo_oamap_t *map, char *key, size_t ksz) {
+	void *data = ts_algo_oamap_remove(map, key, ksz);
+	if (data != NULL && map->del != NULL) map->del(NULL, &data);
+}
+
+/* ----------------------------------------------------------------------------
+ * Overwrite the data assocated with a key
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_oamap_update(ts_algo_oamap_t *map, char *key, size_t ksz, void *data) {
+	int64_t p = findpos(map, key, ksz);
+	if (p < 0) return NULL;
+	void *d = map->buf[p].slot.data;
+	map->buf[p].slot.data = data;
+	return d;
+}
+
+/* ----------------------------------------------------------------------------
+ * Create an iterator for the map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_oamap_it_t *ts_algo_oamap_iterate(ts_algo_oamap_t *map) {
+	ts_algo_oamap_it_t *it = calloc(1, sizeof(ts_algo_oamap_it_t));
+	if (it == NULL) return NULL;
+	it->map = map;
+	ts_algo_oamap_it_rewind(it);
+	return it;
+}
+
+/* ----------------------------------------------------------------------------
+ * Check if the iterator reached the end of the map.
+ * ----------------------------------------------------------------------------
+ */
+char ts_algo_oamap_it_eof(ts_algo_oamap_it_t *it) {
+	return (it->slot >= it->map->curSize);
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: move to the next occupied slot starting at 'slot'
+ * ----------------------------------------------------------------------------
+ */
+static inline void skipempty(ts_algo_oamap_it_t *it) {
+	while(it->slot < it->map->curSize && EMPTY(it->map, it->slot)) {
+		it->slot++;
+	}
+}
+
+/* ----------------------------------------------------------------------------
+ * Rewind the iterator.
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_oamap_it_rewind(ts_algo_oamap_it_t *it) {
+	it->count = 0;
+	it->slot  = 0;
+	skipempty(it);
+}
+
+/* ----------------------------------------------------------------------------
+ * Advance the iterator
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_oamap_it_advance(ts_algo_oamap_it_t *it) {
+	if (it->slot >= it->map->curSize) return;
+	it->slot++; skipempty(it);
+	it->count++;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get the current entry
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_map_slot_t *ts_algo_oamap_it_get(ts_algo_oamap_it_t *it) {
+	if (it->slot >= it->map->curSize) return NULL;
+	return &it->map->buf[it->slot].slot;
+}
+
+/* -------------------------------------------------------------------------
+ * Convert map to list.
+ * -------------------------------------------------------------------------
+ */
+ts_algo_list_t *ts_algo_oamap_toList(ts_algo_oamap_t *map) {
+	ts_algo_list_t *l = malloc(sizeof(ts_algo_list_t));
+	if (l == NULL) return NULL;
+	ts_algo_list_init(l);
+	for(uint32_t i=0; i<map->curSize; i++) {
+		if (EMPTY(map,i)) continue;
+		if (ts_algo_list_insert(l, &map->buf[i].slot) != TS_ALGO_OK) {
+			ts_algo_list_destroy(l); free(l);
+			return NULL;
+		}
+	}
+	return l;
+}
+
+/* ----------------------------------------------------------------------------
+ * Debug: Show probe distance of slots
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_oamap_showslots(ts_algo_oamap_t *map) {
+	for (uint32_t i=0;i<map->curSize;i++) {
+		if (EMPTY(map,i)) fprintf(stderr, "%06u: -1\n", i);
+		else fprintf(stderr, "%06u: %u\n", i, DIST(map,i));
+	}
+}
@@ -0,0 +1,382 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * The Perfect Hash Map Datatype Implementation
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <tsalgo/pmap.h>
+
+/* ----------------------------------------------------------------------------
+ * Just a shorthand
+ * ----------------------------------------------------------------------------
+ */
+#define slot_t ts_algo_map_slot_t
+
+/* ----------------------------------------------------------------------------
+ * Number of seeds we try before we give up
+ * ----------------------------------------------------------------------------
+ */
+#define MAXSEEDS 32
+
+/* ----------------------------------------------------------------------------
+ * Bitmap of taken slots
+ * ----------------------------------------------------------------------------
+ */
+#define TAKEN(t,p) ((t)[(p)>>6] & (1ULL<<((p)&63)))
+#define TAKE(t,p)  (t)[(p)>>6] |= (1ULL<<((p)&63))
+
+/* ----------------------------------------------------------------------------
+ * Number of displacements we try per bucket.
+ * When the map is nearly full, a bucket with one key
+ * finds a free slot with probability free/n. For the last buckets,
+ * we therefore need a multiple of n attempts.
+ * ----------------------------------------------------------------------------
+ */
+static inline uint32_t maxdisp(uint32_t n) {
+	if (n < 65536) return 1<<20;
+	if (n > UINT32_MAX/16) return UINT32_MAX;
+	return n<<4;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: compare buckets by size (descending)
+ * ----------------------------------------------------------------------------
+ */
+static int bysize(const void *one, const void *two) {
+	uint64_t a = *(const uint64_t*)one;
+	uint64_t b = *(const uint64_t*)two;
+	return a < b ? 1 : a > b ? -1 : 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: try to place all keys of one bucket with displacement d
+ * ----------------------------------------------------------------------------
+ */
+static inline char tryplace(const uint64_t *h, const uint32_t *idx,
+                            uint32_t  s, uint32_t d, uint32_t n,
+                            uint64_t *taken, uint32_t *p) {
+	for(uint32_t j=0; j<s; j++) {
+		p[j] = ts_algo_pmap_slot(h[idx[j]], d, n);
+		if (TAKEN(taken, p[j])) return 0;
+		for(uint32_t k=0; k<j; k++) {
+			if (p[k] == p[j]) return 0;
+		}
+	}
+	return 1;
+}
+
+/* ----------------------------------------------------------------------------
+ * Compute the perfect hash
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_layout(const uint64_t *h, uint32_t n, uint32_t nbkt,
+                                 uint32_t *disp, uint32_t *pos) {
+	ts_algo_rc_t rc = TS_ALGO_OK;
+	uint32_t  *start = NULL; // start of each bucket in 'order'
+	uint32_t  *order = NULL; // keys sorted by bucket
+	uint64_t  *bkts  = NULL; // buckets sorted by size
+	uint64_t  *taken = NULL; // bitmap of taken slots
+	uint32_t  *p     = NULL; // slots of the current bucket
+	uint32_t   maxs  = 0;
+	uint32_t   maxd  = maxdisp(n);
+
+	if (n == 0 || nbkt == 0) return TS_ALGO_INVALID;
+
+	memset(disp, 0, nbkt*sizeof(uint32_t));
+
+	start = calloc((size_t)nbkt+2, sizeof(uint32_t));
+	order = malloc(n*sizeof(uint32_t));
+	bkts  = malloc(nbkt*sizeof(uint64_t));
+	taken = calloc((n+63)>>6, sizeof(uint64_t));
+	if (start == NULL || order == NULL ||
+	    bkts  == NULL || taken == NULL) {
+		rc = TS_ALGO_NO_MEM; goto cleanup;
+	}
+
+	// counting sort by bucket:
+	// bucket b holds the keys order[start[b]] .. order[start[b+1]-1]
+	for(uint32_t i=0; i<n; i++) start[ts_algo_pmap_bucket(h[i], nbkt)+2]++;
+	for(uint32_t b=2; b<nbkt+2; b++) start[b] += start[b-1];
+	for(uint32_t i=0; i<n; i++) {
+		order[start[ts_algo_pmap_bucket(h[i], nbkt)+1]++] = i;
+	}
+
+	// place the biggest buckets first
+	for(uint32_t b=0; b<nbkt; b++) {
+		uint32_t s = start[b+1] - start[b];
+		if (s > maxs) maxs = s;
+		bkts[b] = ((uint64_t)s<<32) | b;
+	}
+	qsort(bkts, nbkt, sizeof(uint64_t), bysize);
+
+	p = malloc(maxs*sizeof(uint32_t));
+	if (p == NULL) {
+		rc = TS_ALGO_NO_MEM; goto cleanup;
+	}
+	for(uint32_t i=0; i<nbkt; i++) {
+		uint32_t b = (uint32_t)bkts[i];
+		uint32_t s = (uint32_t)(bkts[i]>>32);
+		uint32_t d;
+
+		if (s == 0) break;
+
+		for(d=0; d<maxd; d++) {
+			if (tryplace(h, order+start[b], s, d, n, taken, p)) break;
+		}
+		if (d == maxd) {
+			rc = TS_ALGO_ERR; goto cleanup;
+		}
+		disp[b] = d;
+		for(uint32_t j=0; j<s; j++) {
+			TAKE(taken, p[j]);
+			pos[order[start[b]+j]] = p[j];
+		}
+	}
+cleanup:
+	if (start != NULL) free(start);
+	if (order != NULL) free(order);
+	if (bkts  != NULL) free(bkts);
+	if (taken != NULL) free(taken);
+	if (p     != NULL) free(p);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: hash and index of one key, used to find equal hashes
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	uint64_t h;
+	uint32_t i;
+} hidx_t;
+
+static int byhash(const void *one, const void *two) {
+	const hidx_t *a = one;
+	const hidx_t *b = two;
+	return a->h < b->h ? -1 : a->h > b->h ? 1 : 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: keys with the same hash can't be placed.
+ *         If the keys are equal, the input is invalid,
+ *         otherwise, we try another seed.
+ * ----------------------------------------------------------------------------
+ */
+static ts_algo_rc_t checkhashes(const uint64_t *h, char **keys, size_t *ksz,
+                                uint32_t n, hidx_t *tmp) {
+	for(uint32_t i=0; i<n; i++) {
+		tmp[i].h = h[i]; tmp[i].i = i;
+	}
+	qsort(tmp, n, sizeof(hidx_t), byhash);
+	for(uint32_t i=1; i<n; i++) {
+		if (tmp[i].h != tmp[i-1].h) continue;
+		uint32_t a = tmp[i].i;
+		uint32_t b = tmp[i-1].i;
+		if (ksz[a] == ksz[b] &&
+		    (ksz[a] == 0 || memcmp(keys[a], keys[b], ksz[a]) == 0)) {
+			return TS_ALGO_INVALID;
+		}
+		return TS_ALGO_ERR;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_pmap_t *ts_algo_pmap_new(char **keys, size_t *ksz,
+                                 void **data, uint32_t n) {
+	ts_algo_pmap_t *map = malloc(sizeof(ts_algo_pmap_t));
+	if (map == NULL) return NULL;
+	ts_algo_rc_t rc = ts_algo_pmap_init(map, keys, ksz, data, n);
+	if (rc != TS_ALGO_OK) {
+		free(map); return NULL;
+	}
+	return map;
+}
+
+/* ----------------------------------------------------------------------------
+ * Build the map from arrays
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_init(ts_algo_pmap_t *map, char **keys, size_t *ksz,
+                                                void **data, uint32_t n) {
+	ts_algo_rc_t rc = TS_ALGO_ERR;
+	uint64_t *h   = NULL;
+	uint32_t *pos = NULL;
+	hidx_t   *tmp = NULL;
+	size_t    tsz = 0;
+	size_t    off = 0;
+
+	if (map == NULL) return TS_ALGO_INVALID;
+
+	memset(map, 0, sizeof(ts_algo_pmap_t));
+	if (n == 0) return TS_ALGO_OK;
+
+	if (keys == NULL || ksz == NULL || data == NULL) return TS_ALGO_INVALID;
+
+	for(uint32_t i=0; i<n; i++) tsz += ksz[i];
+
+	map->nbkt  = n/TS_ALGO_PMAP_LAMBDA + 1;
+	map->disp  = malloc(map->nbkt*sizeof(uint32_t));
+	map->slots = malloc(n*sizeof(slot_t));
+	map->keys  = malloc(tsz>0?tsz:1);
+	h   = malloc(n*sizeof(uint64_t));
+	pos = malloc(n*sizeof(uint32_t));
+	tmp = malloc(n*sizeof(hidx_t));
+	if (map->disp == NULL || map->slots == NULL || map->keys == NULL ||
+	    h == NULL || pos == NULL || tmp == NULL) {
+		rc = TS_ALGO_NO_MEM; goto cleanup;
+	}
+
+	for(uint32_t s=0; s<MAXSEEDS; s++) {
+		map->seed = ts_algo_hash_mix64(s, n);
+		for(uint32_t i=0; i<n; i++) {
+			h[i] = ts_algo_hash_bytes(keys[i], ksz[i], &map->seed);
+		}
+		rc = checkhashes(h, keys, ksz, n, tmp);
+		if (rc == TS_ALGO_INVALID) goto cleanup;
+		if (rc != TS_ALGO_OK) continue;
+
+		rc = ts_algo_pmap_layout(h, n, map->nbkt, map->disp, pos);
+		if (rc != TS_ALGO_ERR) break;
+	}
+	if (rc != TS_ALGO_OK) goto cleanup;
+
+	for(uint32_t i=0; i<n; i++) {
+		slot_t *s = map->slots+pos[i];
+		s->key  = map->keys+off;
+		s->ksz  = ksz[i];
+		s->hash = h[i];
+		s->data = data[i];
+		if (ksz[i] > 0) memcpy(s->key, keys[i], ksz[i]);
+		off += ksz[i];
+	}
+	map->count = n;
+
+cleanup:
+	if (h   != NULL) free(h);
+	if (pos != NULL) free(pos);
+	if (tmp != NULL) free(tmp);
+	if (rc  != TS_ALGO_OK) ts_algo_pmap_destroy(map);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Allocate a new map from a ts_algo_map_t
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_pmap_t *ts_algo_pmap_newFromMap(ts_algo_map_t *src) {
+	ts_algo_pmap_t *map = malloc(sizeof(ts_algo_pmap_t));
+	if (map == NULL) return NULL;
+	ts_algo_rc_t rc = ts_algo_pmap_initFromMap(map, src);
+	if (rc != TS_ALGO_OK) {
+		free(map); return NULL;
+	}
+	return map;
+}
+
+/* ----------------------------------------------------------------------------
+ * Helper: collect the slots of a ts_algo_map_t
+ * ----------------------------------------------------------------------------
+ */
+typedef struct {
+	char   **keys;
+	size_t   *ksz;
+	void   **data;
+	uint32_t    n;
+	uint32_t  max;
+} collect_t;
+
+static ts_algo_rc_t collect(void *rsc, slot_t *s) {
+	collect_t *c = rsc;
+	if (c->n >= c->max) return TS_ALGO_ERR;
+	c->keys[c->n] = s->key;
+	c->ksz[c->n]  = s->ksz;
+	c->data[c->n] = s->data;
+	c->n++;
+	return TS_ALGO_OK;
+}
+
+/* ----------------------------------------------------------------------------
+ * Build the map from a ts_algo_map_t
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_initFromMap(ts_algo_pmap_t *map, ts_algo_map_t *src) {
+	ts_algo_rc_t rc;
+	collect_t c;
+
+	if (map == NULL || src == NULL) return TS_ALGO_INVALID;
+	if (src->count == 0) return ts_algo_pmap_init(map, NULL, NULL, NULL, 0);
+
+	c.n = 0; c.max = src->count;
+	c.keys = malloc(c.max*sizeof(char*));
+	c.ksz  = malloc(c.max*sizeof(size_t));
+	c.data = malloc(c.max*sizeof(void*));
+	if (c.keys == NULL || c.ksz == NULL || c.data == NULL) {
+		rc = TS_ALGO_NO_MEM; goto cleanup;
+	}
+	rc = ts_algo_map_forEach(src, collect, &c);
+	if (rc != TS_ALGO_OK) goto cleanup;
+
+	rc = ts_algo_pmap_init(map, c.keys, c.ksz, c.data, c.n);
+
+cleanup:
+	if (c.keys != NULL) free(c.keys);
+	if (c.ksz  != NULL) free(c.ksz);
+	if (c.data != NULL) free(c.data);
+	return rc;
+}
+
+/* ----------------------------------------------------------------------------
+ * Destroy the map
+ * ----------------------------------------------------------------------------
+ */
+void ts_algo_pmap_destroy(ts_algo_pmap_t *map) {
+	if (map == NULL) return;
+	if (map->disp != NULL) {
+		free(map->disp); map->disp = NULL;
+	}
+	if (map->slots != NULL) {
+		free(map->slots); map->slots = NULL;
+	}
+	if (map->keys != NULL) {
+		free(map->keys); map->keys = NULL;
+	}
+	map->count = 0;
+}
+
+/* ----------------------------------------------------------------------------
+ * Get data: one hash, one probe, one key comparison
+ * ----------------------------------------------------------------------------
+ */
+void *ts_algo_pmap_get(ts_algo_pmap_t *map, char *key, size_t ksz) {
+	if (map->count == 0) return NULL;
+
+	uint64_t h = ts_algo_hash_bytes(key, ksz, &map->seed);
+	uint32_t d = map->disp[ts_algo_pmap_bucket(h, map->nbkt)];
+	slot_t  *s = map->slots+ts_algo_pmap_slot(h, d, map->count);
+
+	if (s->hash != h || s->ksz != ksz) return NULL;
+	if (ksz > 0 && memcmp(s->key, key, ksz) != 0) return NULL;
+	return s->data;
+}
+
+/* ----------------------------------------------------------------------------
+ * Apply 'fun' to all slots
+ * ----------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_pmap_forEach(ts_algo_pmap_t      *map,
+                                  ts_algo_map_visit_t  fun,
+                                  void                *rsc) {
+	ts_algo_rc_t rc;
+	for(uint32_t i=0; i<map->count; i++) {
+		rc = fun(rsc, map->slots+i);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
@@ -0,0 +1,140 @@
+/* ========================================================================
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ * Slab Allocator
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <tsalgo/slab.h>
+
+/* ------------------------------------------------------------------------
+ * Objects and chunks are aligned to 16 bytes
+ * ------------------------------------------------------------------------
+ */
+#define ALIGN 16
+#define ALIGNED(x) (((x)+ALIGN-1)&~((size_t)ALIGN-1))
+
+/* ------------------------------------------------------------------------
+ * Default chunk size in bytes
+ * ------------------------------------------------------------------------
+ */
+#define CHUNKSZ (16*TS_ALGO_PAGE)
+
+/* ------------------------------------------------------------------------
+ * Chunk header: links all chunks, so we can release them
+ * ------------------------------------------------------------------------
+ */
+typedef struct chunk_st {
+	struct chunk_st *nxt;
+} chunk_t;
+
+#define HDRSZ ALIGNED(sizeof(chunk_t))
+
+/* ------------------------------------------------------------------------
+ * Init
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_slab_init(ts_algo_slab_t *slab, size_t objsz,
+                                                   uint32_t chunk) {
+	if (slab == NULL || objsz == 0) return TS_ALGO_INVALID;
+	slab->objsz  = ALIGNED(objsz);
+	slab->chunk  = chunk;
+	if (slab->chunk == 0) {
+		slab->chunk = (CHUNKSZ-HDRSZ)/slab->objsz;
+		if (slab->chunk == 0) slab->chunk = 1;
+	}
+	slab->free   = NULL;
+	slab->cur    = NULL;
+	slab->end    = NULL;
+	slab->chunks = NULL;
+	slab->mem    = 0;
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Destroy
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_slab_destroy(ts_algo_slab_t *slab) {
+	chunk_t *c = slab->chunks;
+	while(c != NULL) {
+		chunk_t *tmp = c->nxt;
+		free(c); c = tmp;
+	}
+	slab->free   = NULL;
+	slab->cur    = NULL;
+	slab->end    = NULL;
+	slab->chunks = NULL;
+	slab->mem    = 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Helper: allocate a new chunk
+ * ------------------------------------------------------------------------
+ */
+static ts_algo_rc_t newchunk(ts_algo_slab_t *slab) {
+	size_t sz = HDRSZ + slab->chunk * slab->objsz;
+	chunk_t *c = malloc(sz);
+	if (c == NULL) return TS_ALGO_NO_MEM;
+	c->nxt = slab->chunks; slab->chunks = c;
+	slab->cur = (char*)c + HDRSZ;
+	slab->end = (char*)c + sz;
+	slab->mem += sz;
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Alloc: first try the free list, then the current chunk
+ * ------------------------------------------------------------------------
+ */
+void *ts_algo_slab_alloc(ts_algo_slab_t *slab) {
+	void *obj;
+
+	if (slab->free != NULL) {
+		obj = slab->free;
+		slab->free = *(void**)obj;
+		return obj;
+	}
+	if (slab->cur == slab->end) {
+		if (newchunk(slab) != TS_ALGO_OK) return NULL;
+	}
+	obj = slab->cur; slab->cur += slab->objsz;
+	return obj;
+}
+
+/* ------------------------------------------------------------------------
+ * Free: push the object on the free list
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_slab_free(ts_algo_slab_t *slab, void *obj) {
+	if (obj == NULL) return;
+	*(void**)obj = slab->free; slab->free = obj;
+}
+
+/* ------------------------------------------------------------------------
+ * Merge: the rest of the current chunk of src is put on its free list;
+ *        then the free list and the chunks are prepended to dst.
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_slab_merge(ts_algo_slab_t *dst, ts_algo_slab_t *src) {
+	for(; src->cur != NULL && src->cur < src->end; src->cur += src->objsz) {
+		ts_algo_slab_free(src, src->cur);
+	}
+	if (src->free != NULL) {
+		void *last = src->free;
+		while(*(void**)last != NULL) last = *(void**)last;
+		*(void**)last = dst->free; dst->free = src->free;
+	}
+	if (src->chunks != NULL) {
+		chunk_t *last = src->chunks;
+		while(last->nxt != NULL) last = last->nxt;
+		last->nxt = dst->chunks; dst->chunks = src->chunks;
+	}
+	dst->mem += src->mem;
+
+	src->free   = NULL;
+	src->cur    = NULL;
+	src->end    = NULL;
+	src->chunks = NULL;
+	src->mem    = 0;
+}
@@ -18,36 +18,49 @@
 /* duplicate detected */
 #define DOUBLE 2
 
+/* ------------------------------------------------------------------------
+ * Greatest path length
+ * ------------------------------------------------------------------------
+ */
+#define MAXDEPTH TS_ALGO_TREE_MAXDEPTH
+
+/* ------------------------------------------------------------------------
+ * Directions on the path
+ * ------------------------------------------------------------------------
+ */
+#define LEFT  0
+#define RIGHT 1
+
 /* ------------------------------------------------------------------------
  * Allocate a new node making cont its content
  * ------------------------------------------------------------------------
  */
-static ts_algo_tree_node_t *maketreenode(void *cont) {
+static ts_algo_tree_node_t *maketreenode(ts_algo_tree_t *head,
+                                         void           *cont)
+{
 	ts_algo_tree_node_t *t;
 
 	if (cont == NULL) return NULL;
-	t = malloc(sizeof(ts_algo_tree_node_t));
+	t = ts_algo_slab_alloc(&head->slab);
 	if (t == NULL) return NULL;
 	t->cont  = cont;
 	t->bal   = 0;
+	t->size  = 1;
 	t->right = NULL; 
 	t->left  = NULL; 
 	return t;
 }
 
 /* ------------------------------------------------------------------------
- * Destroy a node. 
+ * Destroy the contents of a subtree.
+ * The nodes are released with the slab.
  * ------------------------------------------------------------------------
  */
 static void destroytree(ts_algo_tree_t      *head,
                         ts_algo_tree_node_t *node) 
 {
-	if (node->left  != NULL) {
-		destroytree(head,node->left); free(node->left);
-	}
-	if (node->right != NULL) {
-		destroytree(head,node->right); free(node->right);
-	}
+	if (node->left  != NULL) destroytree(head,node->left);
+	if (node->right != NULL) destroytree(head,node->right);
 	head->onDestroy(head,&node->cont);
 }
 
@@ -58,11 +71,12 @@ static void destroytree(ts_algo_tree_t      *head,
 static void deletenode(ts_algo_tree_t      *head,
                        ts_algo_tree_node_t *node) 
 {
-	head->onDelete(head,&node->cont); free(node);
+	head->onDelete(head,&node->cont);
+	ts_algo_slab_free(&head->slab, node);
 }
 
 /* ------------------------------------------------------------------------
- * Recursively search for a specific content in the tree.
+ * Search for a specific content in the tree.
  * The tree head "tree" is passed in to get access
  * to the comparison function.
  * ------------------------------------------------------------------------
@@ -71,15 +85,13 @@ static void *treefind(ts_algo_tree_t      *tree,
                       ts_algo_tree_node_t *node,
                       void                *cont)
 {
-	int cmp = tree->compare(tree,cont,node->cont);
-	if (cmp == ts_algo_cmp_equal) return node->cont;
-	if (cmp == ts_algo_cmp_less) {
-		if (node->left == NULL) return NULL;
-		return treefind(tree,node->left,cont);
-	} else {
-		if (node->right == NULL) return NULL;
-		return treefind(tree,node->right,cont);
+	while(node != NULL) {
+		int cmp = tree->compare(tree,cont,node->cont);
+		if (cmp == ts_algo_cmp_equal) return node->cont;
+		if (cmp == ts_algo_cmp_less) node = node->left;
+		else node = node->right;
 	}
+	return NULL;
 }
 
 /* ------------------------------------------------------------------------
@@ -126,53 +138,15 @@ static ts_algo_bool_t baltest (ts_algo_tree_t      *tree,
 }
 
 /* ------------------------------------------------------------------------
- * Predeclaration of insert (which is used in insertLeft and insertRight)
+ * Recompute the size of a node from its kids after a rotation.
+ * This is done whether or not the tree is ranked;
+ * it is cheap since the kids were just touched anyway.
  * ------------------------------------------------------------------------
  */
-static ts_algo_rc_t insert(ts_algo_tree_t      *tree,
-                           ts_algo_tree_node_t *mom, 
-                           ts_algo_tree_node_t *node, 
-                           void                *cont, 
-                           ts_algo_bool_t      *height);
+#define SIZE(n) ((n)==NULL?0:(n)->size)
 
-/* ------------------------------------------------------------------------
- * Recursively insert a node into the left kid
- * ------------------------------------------------------------------------
- */
-static ts_algo_rc_t insertLeft(ts_algo_tree_t      *tree,
-                               ts_algo_tree_node_t *mom,
-                               ts_algo_tree_node_t *node,
-                               void                *cont,
-                               ts_algo_bool_t      *height)
-{
-	if (node->left == NULL) {
-		node->left = maketreenode(cont);
-		if (node->left == NULL) return TS_ALGO_ERR;
-		*height = TRUE;
-		return TS_ALGO_OK;
-	} else {
-		return insert(tree,node,node->left,cont,height);
-	}
-}
-
-/* ------------------------------------------------------------------------
- * Recursively insert a node into the right kid
- * ------------------------------------------------------------------------
- */
-static ts_algo_rc_t insertRight (ts_algo_tree_t      *tree,
-                                 ts_algo_tree_node_t *mom,
-                                 ts_algo_tree_node_t *node,
-                                 void                *cont,
-                                 ts_algo_bool_t      *height)
-{
-	if (node->right == NULL) {
-		node->right = maketreenode(cont);
-		if (node->right == NULL) return TS_ALGO_ERR;
-		*height = TRUE;
-		return TS_ALGO_OK;
-	} else {
-		return insert(tree,node,node->right,cont,height);
-	}
+static inline void resize(ts_algo_tree_node_t *node) {
+	node->size = 1 + SIZE(node->left) + SIZE(node->right);
 }
 
 /* ------------------------------------------------------------------------
@@ -183,7 +157,7 @@ static void rotateLR(ts_algo_tree_node_t  *mom,
                      ts_algo_tree_node_t *node,
                      ts_algo_bool_t   oninsert)
 {
-	ts_algo_tree_node_t *tmp1,*tmp2;
+	ts_algo_tree_node_t *tmp1,*tmp2,*kid,*grand;
 
 	if (node->left->right == NULL) return;
 
@@ -220,6 +194,9 @@ static void rotateLR(ts_algo_tree_node_t  *mom,
 
 	node->left->right->bal = 0;
 	
+	kid   = node->left;
+	grand = node->left->right;
+
 	tmp1 = node->left->right->right;
 	tmp2 = node->left->right->left;
 
@@ -228,6 +205,8 @@ static void rotateLR(ts_algo_tree_node_t  *mom,
 
 	node->left->right = tmp2;
 	node->left = tmp1;
+
+	resize(kid); resize(node); resize(grand);
 }
 
 /* ------------------------------------------------------------------------
@@ -239,7 +218,7 @@ static void rotateRight(ts_algo_tree_node_t  *mom,
                         ts_algo_bool_t    *height,
                         ts_algo_bool_t   oninsert) 
 {
-	ts_algo_tree_node_t *tmp;
+	ts_algo_tree_node_t *tmp,*kid;
 
 	if (mom  == NULL) return;
 	if (node == NULL) return;
@@ -262,9 +241,11 @@ static void rotateRight(ts_algo_tree_node_t  *mom,
 			}
 		}
 
+		kid = node->left;
 		tmp = node->left->right;
 		node->left->right = node;
 		node->left = tmp;
+		resize(node); resize(kid);
 
 		if (oninsert) node->bal = 0;
 		else {
@@ -285,7 +266,7 @@ static void rotateRL(ts_algo_tree_node_t  *mom,
                      ts_algo_tree_node_t *node,
                      ts_algo_bool_t   oninsert) 
 {
-	ts_algo_tree_node_t *tmp1,*tmp2;
+	ts_algo_tree_node_t *tmp1,*tmp2,*kid,*grand;
 
 	if (node->right->left == NULL) return;
 
@@ -320,6 +301,9 @@ static void rotateRL(ts_algo_tree_node_t  *mom,
 
 	node->right->left->bal = 0;
 	
+	kid   = node->right;
+	grand = node->right->left;
+
 	tmp1 = node->right->left->left;
 	tmp2 = node->right->left->right;
 
@@ -328,6 +312,8 @@ static void rotateRL(ts_algo_tree_node_t  *mom,
 
 	node->right->left = tmp2;
 	node->right = tmp1;
+
+	resize(kid); resize(node); resize(grand);
 }
 
 /* ------------------------------------------------------------------------
@@ -339,7 +325,7 @@ static void rotateLeft (ts_algo_tree_node_t  *mom,
                         ts_algo_bool_t    *height,
                         ts_algo_bool_t   oninsert)
 {
-	ts_algo_tree_node_t *tmp;
+	ts_algo_tree_node_t *tmp,*kid;
 
 	if (mom  == NULL) return;
 	if (node == NULL) return;
@@ -362,9 +348,11 @@ static void rotateLeft (ts_algo_tree_node_t  *mom,
 			}
 		}
 
+		kid = node->right;
 		tmp = node->right->left;
 		node->right->left = node;
 		node->right = tmp;
+		resize(node); resize(kid);
 		
 		if (oninsert) node->bal = 0;
 		else {
@@ -378,187 +366,159 @@ static void rotateLeft (ts_algo_tree_node_t  *mom,
 }
 
 /* ------------------------------------------------------------------------
- * Recursively insert a new node.
+ * Insert a new node.
+ * The way down is recorded in a path (starting at the dummy);
+ * on the way back up, the balance of the nodes on the path is adjusted
+ * until a subtree has not grown or was rotated.
  * ------------------------------------------------------------------------
  */
-static ts_algo_rc_t insert(ts_algo_tree_t      *tree,
-                           ts_algo_tree_node_t *mom,
-                           ts_algo_tree_node_t *node, 
-                           void                *cont,
-                           ts_algo_bool_t      *height) 
+static ts_algo_rc_t insert(ts_algo_tree_t *tree,
+                           void           *cont)
 {
-	ts_algo_rc_t cmp = tree->compare(tree,cont,node->cont);
+	ts_algo_tree_node_t *path[MAXDEPTH];
+	char                  dir[MAXDEPTH];
+	ts_algo_tree_node_t *node = tree->tree;
+	ts_algo_bool_t height = TRUE;
 	ts_algo_rc_t rc;
+	int k = 0;
+
+	path[k] = tree->dummy; dir[k++] = LEFT;
+	for(;;) {
+		int cmp = tree->compare(tree,cont,node->cont);
+		if (cmp == ts_algo_cmp_equal) {
+			rc = tree->onUpdate(tree,node->cont,cont);
+			if (rc != TS_ALGO_OK) return rc;
+			return DOUBLE;
+		}
+		path[k] = node;
+		if (cmp == ts_algo_cmp_less) {
+			dir[k++] = LEFT;
+			if (node->left == NULL) {
+				node->left = maketreenode(tree,cont);
+				if (node->left == NULL) return TS_ALGO_ERR;
+				break;
+			}
+			node = node->left;
+		} else {
+			dir[k++] = RIGHT;
+			if (node->right == NULL) {
+				node->right = maketreenode(tree,cont);
+				if (node->right == NULL) return TS_ALGO_ERR;
+				break;
+			}
+			node = node->right;
+		}
+	}
+	/* all subtrees on the path have one more node */
+	if (tree->ranked) {
+		for(int i=1; i<k; i++) path[i]->size++;
+	}
 
-	if (cmp == ts_algo_cmp_less) {
-		rc = insertLeft(tree,mom,node,cont,height);
-		if (rc != TS_ALGO_OK) return rc;
-		if (*height) {
+	/* the subtree in direction dir[k] of path[k] has grown */
+	for(k--; k>0 && height; k--) {
+		node = path[k];
+		if (dir[k] == LEFT) {
 			if (node->bal < 0) {
-				rotateRight(mom,node,height,TRUE);
-				*height = FALSE;
+				rotateRight(path[k-1],node,&height,TRUE);
+				height = FALSE;
 			} else {
-				node->bal--; 
-				if (node->bal == 0) *height = FALSE;
+				node->bal--;
+				if (node->bal == 0) height = FALSE;
 			}
-		}
-		return rc;
-	} else if (cmp == ts_algo_cmp_greater) {
-		rc = insertRight(tree,mom,node,cont,height);
-		if (rc != TS_ALGO_OK) return rc;
-		if (*height) {
+		} else {
 			if (node->bal > 0) {
-				rotateLeft(mom,node,height,TRUE);
-				*height = FALSE;
+				rotateLeft(path[k-1],node,&height,TRUE);
+				height = FALSE;
 			} else {
 				node->bal++;
-				if (node->bal == 0) *height = FALSE;
+				if (node->bal == 0) height = FALSE;
 			}
 		}
-		return rc;
-	} else {
-		*height = FALSE;
-		rc = tree->onUpdate(tree,node->cont,cont);
-		if (rc != TS_ALGO_OK) return rc;
-		return DOUBLE; 
 	}
+	return TS_ALGO_OK;
 }
 
 /* ------------------------------------------------------------------------
- * Replace the node to be removed by the greatest node 
- * in the left subtree of that node.
+ * Delete a node.
+ * A node with two kids is replaced by the greatest node
+ * in its left subtree. As in insert, the way down is recorded
+ * in a path; on the way back up, the balance of the nodes on the path
+ * is adjusted until a subtree has not shrunk.
  * ------------------------------------------------------------------------
  */
-static void del(ts_algo_tree_t      *tree,
-                ts_algo_tree_node_t *node,
-                ts_algo_tree_node_t *mom,
-                ts_algo_tree_node_t *runner,
-                ts_algo_bool_t      *height)
+static ts_algo_bool_t delete(ts_algo_tree_t *tree,
+                             void           *cont)
 {
-	/* we have no yet found the greatest */
-	if (runner->right != NULL) {
-		char bal = runner->bal;
-		del(tree,node,runner,runner->right,height);
-		if (*height) {
-			if (bal < 0) {
-				rotateRight(mom,runner,height,FALSE);
-			} else if (bal == 0) {
-				runner->bal = -1; *height = FALSE;
-			} else {
-				runner->bal = 0;
-			}
+	ts_algo_tree_node_t *path[MAXDEPTH];
+	char                  dir[MAXDEPTH];
+	ts_algo_tree_node_t *node = tree->tree;
+	ts_algo_tree_node_t *kid;
+	ts_algo_bool_t height = TRUE;
+	int k = 0;
+
+	path[k] = tree->dummy; dir[k++] = LEFT;
+	for(;;) {
+		int cmp = tree->compare(tree,cont,node->cont);
+		if (cmp == ts_algo_cmp_equal) break;
+		path[k] = node;
+		if (cmp == ts_algo_cmp_less) {
+			if (node->left == NULL) return FALSE;
+			dir[k++] = LEFT; node = node->left;
+		} else {
+			if (node->right == NULL) return FALSE;
+			dir[k++] = RIGHT; node = node->right;
 		}
+	}
 
-	/* we have found it */
-	} else {
-		void *cont = node->cont;
-		ts_algo_tree_node_t *tmp = runner;
-
-		node->cont = runner->cont;
-		runner->cont = cont;
+	/* node has two kids: find the greatest in the left subtree */
+	if (node->left != NULL && node->right != NULL) {
+		ts_algo_tree_node_t *runner = node->left;
+		void *tmp;
 
-		/* the greatest is child
-		 * of the node we are removing */
-		if (mom == node) {
-			mom->left = tmp->left;
-		} else {
-			mom->right = tmp->left;
+		path[k] = node; dir[k++] = LEFT;
+		while(runner->right != NULL) {
+			path[k] = runner; dir[k++] = RIGHT;
+			runner = runner->right;
 		}
-		deletenode(tree, runner); 
-		*height = TRUE;
+		tmp = node->cont;
+		node->cont = runner->cont;
+		runner->cont = tmp;
+		node = runner;
 	}
-}
 
-/* ------------------------------------------------------------------------
- * Recursively delete a node.
- * ------------------------------------------------------------------------
- */
-static ts_algo_bool_t delete(ts_algo_tree_t      *tree,
-                             ts_algo_tree_node_t *mom, 
-                             ts_algo_tree_node_t *node, 
-                             void                *cont, 
-                             ts_algo_bool_t      *height)
-{
-	int cmp = tree->compare(tree,cont,node->cont);
-	ts_algo_bool_t d;
+	/* node has at most one kid */
+	kid = node->left != NULL ? node->left : node->right;
+	if (dir[k-1] == LEFT) path[k-1]->left = kid;
+	else path[k-1]->right = kid;
+	deletenode(tree, node);
+
+	/* all subtrees on the path have one node less */
+	if (tree->ranked) {
+		for(int i=1; i<k; i++) path[i]->size--;
+	}
 
-	/* the node is less than the current node */
-	if (cmp == ts_algo_cmp_less) {
-		if (node->left == NULL) return FALSE;
-		d = delete(tree,node,node->left,cont,height);
-		if (*height) {
+	/* the subtree in direction dir[k] of path[k] has shrunk */
+	for(k--; k>0 && height; k--) {
+		node = path[k];
+		if (dir[k] == LEFT) {
 			if (node->bal > 0) {
-				rotateLeft(mom,node,height,FALSE);
+				rotateLeft(path[k-1],node,&height,FALSE);
 			} else if (node->bal == 0) {
-				node->bal = 1; *height = FALSE;
+				node->bal = 1; height = FALSE;
 			} else {
 				node->bal = 0;
 			}
-		}
-		return d;
-
-	/* the node is greater than the current node */
-	} else if (cmp == ts_algo_cmp_greater) {
-		if (node->right == NULL) return FALSE;
-		d = delete(tree,node,node->right,cont,height);
-		if (*height) {
+		} else {
 			if (node->bal < 0) {
-				rotateRight(mom,node,height,FALSE);
+				rotateRight(path[k-1],node,&height,FALSE);
 			} else if (node->bal == 0) {
-				node->bal = -1; *height = FALSE;
+				node->bal = -1; height = FALSE;
 			} else {
 				node->bal = 0;
 			}
 		}
-		return d;
-
-	/* we found it */
-	} else {
-		/* a leaf node */
-		if (node->left == NULL && node->right == NULL) {
-			if (mom->left == node) {
-				mom->left = NULL;
-			} else {
-				mom->right = NULL;
-			}
-			deletenode(tree, node);
-			*height = TRUE;
-
-		/* node has left kid only */
-		} else if (node->right == NULL) {
-			if (mom->left == node) {
-				mom->left = node->left;
-			} else {
-				mom->right = node->left;
-			}
-			deletenode(tree, node); 
-			*height = TRUE;
-
-		/* node has right kid only */
-		} else if (node->left == NULL) {
-			if (mom->left == node) {
-				mom->left = node->right;
-			} else {
-				mom->right = node->right;
-			}
-			deletenode(tree, node); 
-			*height = TRUE;
-
-		/* node has two kids */
-		} else {
-			del(tree,node,node,node->left,height);
-			if (*height) {
-				if (node->bal > 0) {
-					rotateLeft(mom,node,height,FALSE);
-				} else if (node->bal == 0) {
-					node->bal = 1; *height = FALSE;
-				} else {
-					node->bal = 0;
-				}
-			}
-		}
-		return TRUE;
 	}
+	return TRUE;
 }
 
 /* ------------------------------------------------------------------------
@@ -755,8 +715,14 @@ ts_algo_rc_t ts_algo_tree_init(ts_algo_tree_t   *t,
 	t->onUpdate  = onUpdate;
 	t->onDelete  = onDelete;
 	t->onDestroy = onDestroy;
+	t->ranked    = FALSE;
+	if (ts_algo_slab_init(&t->slab, sizeof(ts_algo_tree_node_t),
+	                      TS_ALGO_TREE_CHUNK) != TS_ALGO_OK) return TS_ALGO_ERR;
 	t->dummy     = malloc(sizeof(ts_algo_tree_node_t));
-	if (t->dummy == NULL) return TS_ALGO_ERR;
+	if (t->dummy == NULL) {
+		ts_algo_slab_destroy(&t->slab);
+		return TS_ALGO_ERR;
+	}
 	return TS_ALGO_OK;
 }
 
@@ -767,9 +733,10 @@ ts_algo_rc_t ts_algo_tree_init(ts_algo_tree_t   *t,
 void ts_algo_tree_destroy(ts_algo_tree_t *head) 
 {
 	if (head->tree != NULL) {
-		destroytree(head,head->tree); free(head->tree);
+		destroytree(head,head->tree);
 		head->tree = NULL;
 	}
+	ts_algo_slab_destroy(&head->slab);
 	if (head->dummy != NULL) {
 		free(head->dummy); head->dummy = NULL;
 	}
@@ -782,17 +749,16 @@ void ts_algo_tree_destroy(ts_algo_tree_t *head)
 ts_algo_rc_t ts_algo_tree_insert(ts_algo_tree_t *head, 
                                  void           *cont)
 {
-	ts_algo_bool_t h = FALSE;
 	ts_algo_rc_t  rc;
 
 	if (head->tree == NULL) {
-		head->tree = maketreenode(cont);
+		head->tree = maketreenode(head,cont);
 		if (head->tree == NULL) return TS_ALGO_ERR;
 		head->dummy->left = head->tree;
 		head->count = 1;
 		return TS_ALGO_OK;
 	}
-	rc = insert(head,head->dummy,head->tree,cont,&h);
+	rc = insert(head,cont);
 	if (rc != TS_ALGO_OK) {
 		if (rc == TS_ALGO_ERR) return TS_ALGO_ERR;
 	} else {
@@ -811,10 +777,8 @@ ts_algo_rc_t ts_algo_tree_insert(ts_algo_tree_t *head,
 void ts_algo_tree_delete(ts_algo_tree_t *head,
                          void           *cont)
 {
-	ts_algo_bool_t h = FALSE;
-
 	if (head->tree == NULL) return;
-	if (delete(head,head->dummy,head->tree,cont,&h)) head->count--;
+	if (delete(head,cont)) head->count--;
 	if (head->dummy->left != head->tree) head->tree = head->dummy->left;
 }
 
@@ -999,3 +963,276 @@ ts_algo_rc_t ts_algo_tree_reduce(ts_algo_tree_t    *tree,
 	if (tree->tree == NULL) return TS_ALGO_OK;
 	return treefold(tree, tree->tree, aggregate, fold);
 }
+
+/* ------------------------------------------------------------------------
+ * Cursor helpers: descend to the leftmost (rightmost) node
+ * of the subtree under the cursor
+ * ------------------------------------------------------------------------
+ */
+static inline void leftmost(ts_algo_tree_cursor_t *cur) {
+	ts_algo_tree_node_t *node = cur->path[cur->depth-1];
+	while(node->left != NULL) {
+		node = node->left; cur->path[cur->depth++] = node;
+	}
+}
+
+static inline void rightmost(ts_algo_tree_cursor_t *cur) {
+	ts_algo_tree_node_t *node = cur->path[cur->depth-1];
+	while(node->right != NULL) {
+		node = node->right; cur->path[cur->depth++] = node;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * Cursor helper: descend from the root and stop at the smallest
+ * content greater than (or equal to, if 'eq') cont
+ * ------------------------------------------------------------------------
+ */
+static ts_algo_bool_t seek(ts_algo_tree_t        *tree,
+                           ts_algo_tree_cursor_t  *cur,
+                           void                  *cont,
+                           ts_algo_bool_t           eq)
+{
+	ts_algo_tree_node_t *node = tree->tree;
+	int found = 0;
+
+	cur->tree  = tree;
+	cur->depth = 0;
+
+	while(node != NULL) {
+		int cmp = tree->compare(tree,cont,node->cont);
+		cur->path[cur->depth++] = node;
+		if (cmp == ts_algo_cmp_less || (eq && cmp == ts_algo_cmp_equal)) {
+			found = cur->depth;
+			if (cmp == ts_algo_cmp_equal) break;
+			node = node->left;
+		} else {
+			node = node->right;
+		}
+	}
+	/* the path up to the candidate is the path to the candidate */
+	cur->depth = found;
+	return (found > 0);
+}
+
+/* ------------------------------------------------------------------------
+ * First
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_first(ts_algo_tree_t        *tree,
+                                  ts_algo_tree_cursor_t  *cur)
+{
+	cur->tree  = tree;
+	cur->depth = 0;
+	if (tree->tree == NULL) return FALSE;
+	cur->path[cur->depth++] = tree->tree;
+	leftmost(cur);
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------
+ * Last
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_last(ts_algo_tree_t        *tree,
+                                 ts_algo_tree_cursor_t  *cur)
+{
+	cur->tree  = tree;
+	cur->depth = 0;
+	if (tree->tree == NULL) return FALSE;
+	cur->path[cur->depth++] = tree->tree;
+	rightmost(cur);
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------------
+ * Lower Bound
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_lowerBound(ts_algo_tree_t        *tree,
+                                       ts_algo_tree_cursor_t  *cur,
+                                       void                  *cont)
+{
+	return seek(tree, cur, cont, TRUE);
+}
+
+/* ------------------------------------------------------------------------
+ * Upper Bound
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_upperBound(ts_algo_tree_t        *tree,
+                                       ts_algo_tree_cursor_t  *cur,
+                                       void                  *cont)
+{
+	return seek(tree, cur, cont, FALSE);
+}
+
+/* ------------------------------------------------------------------------
+ * Next: the leftmost node in the right subtree or,
+ *       if there is none, the first ancestor
+ *       whose left subtree we are leaving.
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_next(ts_algo_tree_cursor_t *cur) {
+	ts_algo_tree_node_t *node;
+
+	if (cur->depth == 0) return FALSE;
+	node = cur->path[cur->depth-1];
+	if (node->right != NULL) {
+		cur->path[cur->depth++] = node->right;
+		leftmost(cur);
+		return TRUE;
+	}
+	while(cur->depth > 1) {
+		node = cur->path[--cur->depth];
+		if (cur->path[cur->depth-1]->left == node) return TRUE;
+	}
+	cur->depth = 0;
+	return FALSE;
+}
+
+/* ------------------------------------------------------------------------
+ * Prev: the mirror image of next
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_prev(ts_algo_tree_cursor_t *cur) {
+	ts_algo_tree_node_t *node;
+
+	if (cur->depth == 0) return FALSE;
+	node = cur->path[cur->depth-1];
+	if (node->left != NULL) {
+		cur->path[cur->depth++] = node->left;
+		rightmost(cur);
+		return TRUE;
+	}
+	while(cur->depth > 1) {
+		node = cur->path[--cur->depth];
+		if (cur->path[cur->depth-1]->right == node) return TRUE;
+	}
+	cur->depth = 0;
+	return FALSE;
+}
+
+/* ------------------------------------------------------------------------
+ * Range
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t ts_algo_tree_range(ts_algo_tree_t    *tree,
+                                void              *from,
+                                void                *to,
+                                ts_algo_mapper_t mapper)
+{
+	ts_algo_tree_cursor_t cur;
+	ts_algo_rc_t rc;
+
+	if (tree == NULL) return TS_ALGO_OK;
+	if (from == NULL) ts_algo_tree_first(tree, &cur);
+	else ts_algo_tree_lowerBound(tree, &cur, from);
+
+	for(; cur.depth > 0; ts_algo_tree_next(&cur)) {
+		void *cont = cur.path[cur.depth-1]->cont;
+		if (to != NULL &&
+		    tree->compare(tree,cont,to) != ts_algo_cmp_less) break;
+		rc = mapper(tree,cont);
+		if (rc != TS_ALGO_OK) return rc;
+	}
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Recursively compute the sizes of a subtree
+ * ------------------------------------------------------------------------
+ */
+static uint32_t sizes(ts_algo_tree_node_t *node) {
+	if (node == NULL) return 0;
+	node->size = 1 + sizes(node->left) + sizes(node->right);
+	return node->size;
+}
+
+/* ------------------------------------------------------------------------
+ * Enable Rank
+ * ------------------------------------------------------------------------
+ */
+void ts_algo_tree_enableRank(ts_algo_tree_t *tree) {
+	if (tree->ranked) return;
+	sizes(tree->tree);
+	tree->ranked = TRUE;
+}
+
+/* ------------------------------------------------------------------------
+ * Rank: add up the left subtrees (and the nodes)
+ *       we pass when going right.
+ * ------------------------------------------------------------------------
+ */
+uint32_t ts_algo_tree_rank(ts_algo_tree_t *tree, void *cont) {
+	ts_algo_tree_node_t *node = tree->tree;
+	uint32_t r = 0;
+
+	if (!tree->ranked) return 0;
+	while(node != NULL) {
+		int cmp = tree->compare(tree,cont,node->cont);
+		if (cmp == ts_algo_cmp_equal) return r + SIZE(node->left);
+		if (cmp == ts_algo_cmp_less) node = node->left;
+		else {
+			r += SIZE(node->left) + 1;
+			node = node->right;
+		}
+	}
+	return r;
+}
+
+/* ------------------------------------------------------------------------
+ * Seek Rank
+ * ------------------------------------------------------------------------
+ */
+ts_algo_bool_t ts_algo_tree_seekRank(ts_algo_tree_t        *tree,
+                                     ts_algo_tree_cursor_t  *cur,
+                                     uint32_t                  k)
+{
+	ts_algo_tree_node_t *node = tree->tree;
+
+	cur->tree  = tree;
+	cur->depth = 0;
+
+	if (!tree->ranked) return FALSE;
+	if (k >= tree->count) return FALSE;
+	while(node != NULL) {
+		uint32_t l = SIZE(node->left);
+		cur->path[cur->depth++] = node;
+		if (k == l) return TRUE;
+		if (k < l) node = node->left;
+		else {
+			k -= l + 1;
+			node = node->right;
+		}
+	}
+	/* sizes are inconsistent */
+	cur->depth = 0;
+	return FALSE;
+}
+
+/* ------------------------------------------------------------------------
+ * Select
+ * ------------------------------------------------------------------------
+ */
+void *ts_algo_tree_select(ts_algo_tree_t *tree, uint32_t k) {
+	ts_algo_tree_cursor_t cur;
+	if (!ts_algo_tree_seekRank(tree, &cur, k)) return NULL;
+	return ts_algo_tree_cur_get(&cur);
+}
+
+/* ------------------------------------------------------------------------
+ * Count Range
+ * ------------------------------------------------------------------------
+ */
+uint32_t ts_algo_tree_countRange(ts_algo_tree_t *tree,
+                                 void           *from,
+                                 void             *to)
+{
+	uint32_t lo, hi;
+
+	if (!tree->ranked) return 0;
+	lo = from == NULL ? 0 : ts_algo_tree_rank(tree, from);
+	hi = to   == NULL ? tree->count : ts_algo_tree_rank(tree, to);
+	return hi > lo ? hi - lo : 0;
+}
@@ -0,0 +1,262 @@
+/* ========================================================================
+ * Test B+ Tree
+ * ------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tsalgo/btree.h>
+
+#define BUFSZ 8192
+
+typedef struct {
+	uint64_t  key;
+	char   intree;
+} mydata_t;
+
+mydata_t buf[BUFSZ];
+
+int updated   = 0;
+int deleted   = 0;
+int destroyed = 0;
+
+void bufinit() {
+	for(int i=0;i<BUFSZ;i++) {
+		buf[i].key = 2*i+1;
+		buf[i].intree = 0;
+	}
+}
+
+static ts_algo_cmp_t compare(void *ignore, mydata_t *left, mydata_t *right) {
+	if (left->key < right->key) return ts_algo_cmp_less;
+	if (left->key > right->key) return ts_algo_cmp_greater;
+	return ts_algo_cmp_equal;
+}
+
+static void show(mydata_t *d) {
+	printf("%lu\n", d->key);
+}
+
+static ts_algo_rc_t onUpdate(void *ignore, mydata_t *o, mydata_t *n) {
+	updated++; return TS_ALGO_OK;
+}
+
+static void onDelete(void *ignore, mydata_t **d) {
+	(*d)->intree = 0; deleted++;
+}
+
+static void onDestroy(void *ignore, mydata_t **d) {
+	(*d)->intree = 0; destroyed++;
+}
+
+static ts_algo_rc_t sum(void *ignore, uint64_t *agg, mydata_t *d) {
+	*agg += d->key; return TS_ALGO_OK;
+}
+
+int checkall(ts_algo_btree_t *tree) {
+	uint32_t n = 0;
+	if (!ts_algo_btree_check(tree)) {
+		fprintf(stderr, "tree is not consistent\n");
+		return -1;
+	}
+	for(int i=0;i<BUFSZ;i++) {
+		mydata_t *d = ts_algo_btree_find(tree, buf+i);
+		if (buf[i].intree) {
+			if (d != buf+i) {
+				fprintf(stderr, "%lu not found\n", buf[i].key);
+				return -1;
+			}
+			n++;
+		} else if (d != NULL) {
+			fprintf(stderr, "found removed %lu\n", buf[i].key);
+			return -1;
+		}
+		/* keys not in the tree at all */
+		mydata_t x;
+		x.key = buf[i].key+1;
+		if (ts_algo_btree_find(tree, &x) != NULL) {
+			fprintf(stderr, "found %lu\n", x.key);
+			return -1;
+		}
+	}
+	if (n != tree->count) {
+		fprintf(stderr, "wrong count: %u | %u\n", n, tree->count);
+		return -1;
+	}
+	return 0;
+}
+
+int checklist(ts_algo_btree_t *tree) {
+	ts_algo_list_t *list;
+	uint64_t prev = 0;
+	uint32_t n = 0;
+
+	list = ts_algo_btree_toList(tree);
+	if (list == NULL) {
+		if (tree->count == 0) return 0;
+		fprintf(stderr, "cannot get list\n");
+		return -1;
+	}
+	for(ts_algo_list_node_t *r=list->head; r!=NULL; r=r->nxt) {
+		mydata_t *d = r->cont;
+		if (d->key <= prev) {
+			fprintf(stderr, "list not ordered: %lu <= %lu\n", d->key, prev);
+			ts_algo_list_destroy(list); free(list);
+			return -1;
+		}
+		prev = d->key; n++;
+	}
+	ts_algo_list_destroy(list); free(list);
+	if (n != tree->count) {
+		fprintf(stderr, "wrong count in list: %u | %u\n", n, tree->count);
+		return -1;
+	}
+	return 0;
+}
+
+int checksum(ts_algo_btree_t *tree) {
+	uint64_t s1 = 0, s2 = 0;
+	for(int i=0;i<BUFSZ;i++) {
+		if (buf[i].intree) s1 += buf[i].key;
+	}
+	if (ts_algo_btree_reduce(tree, &s2,
+	              (ts_algo_reducer_t)&sum) != TS_ALGO_OK) {
+		fprintf(stderr, "reduce failed\n");
+		return -1;
+	}
+	if (s1 != s2) {
+		fprintf(stderr, "wrong sum: %lu | %lu\n", s1, s2);
+		return -1;
+	}
+	return 0;
+}
+
+int testSequential() {
+	ts_algo_btree_t tree;
+	int rc = -1;
+
+	fprintf(stderr, "sequential\n");
+
+	bufinit();
+	deleted = 0;
+
+	if (ts_algo_btree_init(&tree, (ts_algo_comprsc_t)&compare,
+	                              (ts_algo_show_t)&show,
+	                              (ts_algo_update_t)&onUpdate,
+	                              (ts_algo_delete_t)&onDelete,
+	                              (ts_algo_delete_t)&onDestroy) != TS_ALGO_OK)
+	{
+		fprintf(stderr, "cannot init tree\n");
+		return -1;
+	}
+	for(int i=0;i<BUFSZ;i++) {
+		if (ts_algo_btree_insert(&tree, buf+i) != TS_ALGO_OK) {
+			fprintf(stderr, "cannot insert %d\n", i);
+			goto cleanup;
+		}
+		buf[i].intree = 1;
+	}
+	if (checkall(&tree) != 0) goto cleanup;
+	if (checklist(&tree) != 0) goto cleanup;
+	fprintf(stderr, "height: %d\n", ts_algo_btree_height(&tree));
+
+	/* delete backwards */
+	for(int i=BUFSZ-1;i>=0;i--) {
+		ts_algo_btree_delete(&tree, buf+i);
+		if (buf[i].intree) {
+			fprintf(stderr, "%lu not deleted\n", buf[i].key);
+			goto cleanup;
+		}
+		if (i%1000 == 0 && checkall(&tree) != 0) goto cleanup;
+	}
+	if (tree.count != 0 || tree.root != NULL ||
+	    deleted != BUFSZ || ts_algo_btree_height(&tree) != 0) {
+		fprintf(stderr, "tree not empty\n");
+		goto cleanup;
+	}
+	rc = 0;
+
+cleanup:
+	ts_algo_btree_destroy(&tree);
+	return rc;
+}
+
+int testRandom() {
+	ts_algo_btree_t *tree;
+	int rc = -1;
+	int n = 0;
+
+	fprintf(stderr, "random\n");
+
+	bufinit();
+	updated = 0;
+	deleted = 0;
+	destroyed = 0;
+
+	tree = ts_algo_btree_new((ts_algo_comprsc_t)&compare,
+	                         (ts_algo_show_t)&show,
+	                         (ts_algo_update_t)&onUpdate,
+	                         (ts_algo_delete_t)&onDelete,
+	                         (ts_algo_delete_t)&onDestroy);
+	if (tree == NULL) {
+		fprintf(stderr, "cannot create tree\n");
+		return -1;
+	}
+	for(int k=0;k<20;k++) {
+		int ups = 0, dels = 0;
+		int u = updated, d = deleted;
+
+		/* insert, some of them twice */
+		for(int i=0;i<BUFSZ;i++) {
+			int z = rand()%BUFSZ;
+			if (buf[z].intree) ups++;
+			if (ts_algo_btree_insert(tree, buf+z) != TS_ALGO_OK) {
+				fprintf(stderr, "cannot insert %d\n", z);
+				goto cleanup;
+			}
+			if (!buf[z].intree) n++;
+			buf[z].intree = 1;
+		}
+		if (checkall(tree) != 0) goto cleanup;
+
+		/* delete, some of them not in the tree */
+		for(int i=0;i<BUFSZ;i++) {
+			int z = rand()%BUFSZ;
+			if (buf[z].intree) {
+				dels++; n--;
+			}
+			ts_algo_btree_delete(tree, buf+z);
+		}
+		if (checkall(tree) != 0) goto cleanup;
+		if (checklist(tree) != 0) goto cleanup;
+		if (checksum(tree) != 0) goto cleanup;
+
+		if (updated-u != ups || deleted-d != dels || n != tree->count) {
+			fprintf(stderr, "wrong counts: %d/%d, %d/%d, %d/%u\n",
+			                updated-u, ups, deleted-d, dels, n, tree->count);
+			goto cleanup;
+		}
+	}
+	rc = 0;
+
+cleanup:
+	ts_algo_btree_destroy(tree); free(tree);
+	if (rc == 0 && destroyed != n) {
+		fprintf(stderr, "wrong destroy count: %d | %d\n", destroyed, n);
+		rc = -1;
+	}
+	return rc;
+}
+
+int main() {
+	srand(time(NULL));
+	if (testSequential() != 0) exit(1);
+	for(int i=0;i<5;i++) {
+		if (testRandom() != 0) exit(1);
+	}
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
@@ -0,0 +1,329 @@
+/* ========================================================================
+ * Test Cuckoo Map
+ * ---------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <tsalgo/ckmap.h>
+#include <tsalgo/hash.h>
+
+#define THREADS 8
+#define KEYS    20000
+#define OPS     200000
+
+typedef struct timespec timestamp_t;
+int timestamp(timestamp_t *tmstp) {
+	return clock_gettime(CLOCK_MONOTONIC, tmstp);
+}
+
+uint64_t timediff(timestamp_t *t1, timestamp_t *t2) {
+	return (t2->tv_sec - t1->tv_sec)*1000000000 +
+	       (t2->tv_nsec - t1->tv_nsec);
+}
+
+ts_algo_rc_t countslot(void *rsc, ts_algo_map_slot_t *s) {
+	uint64_t k = *(uint64_t*)s->key;
+	if (*(uint64_t*)s->data != k) return TS_ALGO_ERR;
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Single thread: random operations compared against an array
+ * ------------------------------------------------------------------------
+ */
+int testRandom(uint32_t sz, int n) {
+	int err = 0;
+	uint32_t count = 0, visited = 0;
+	uint64_t *mem = malloc(KEYS*sizeof(uint64_t));
+	char     *in  = calloc(KEYS, 1);
+	if (mem == NULL || in == NULL) {
+		free(mem); free(in); return -1;
+	}
+	for(uint64_t k=0; k<KEYS; k++) mem[k] = k;
+
+	ts_algo_ckmap_t *map = ts_algo_ckmap_new(sz, ts_algo_hash_u64, NULL);
+	if (map == NULL) {
+		free(mem); free(in); return -1;
+	}
+	for(int i=0; i<n; i++) {
+		uint64_t k = rand()%KEYS;
+		int op = rand()%4;
+		if (op < 2) {
+			ts_algo_rc_t rc = ts_algo_ckmap_addId(map, k, mem+k);
+			if (rc != (in[k]?TS_ALGO_INVALID:TS_ALGO_OK)) {
+				fprintf(stderr, "add %lu: %d (%d)\n", k, rc, in[k]);
+				err = 1; goto cleanup;
+			}
+			if (!in[k]) count++;
+			in[k] = 1;
+		} else if (op == 2) {
+			if (ts_algo_ckmap_removeId(map, k) != (in[k]?mem+k:NULL)) {
+				fprintf(stderr, "remove %lu (%d)\n", k, in[k]);
+				err = 1; goto cleanup;
+			}
+			if (in[k]) count--;
+			in[k] = 0;
+		} else {
+			if (ts_algo_ckmap_updateId(map, k, mem+k) != (in[k]?mem+k:NULL)) {
+				fprintf(stderr, "update %lu (%d)\n", k, in[k]);
+				err = 1; goto cleanup;
+			}
+		}
+		if (i%1000 == 0) ts_algo_ckmap_reclaim(map);
+	}
+	for(uint64_t k=0; k<KEYS; k++) {
+		if (ts_algo_ckmap_getId(map, k) != (in[k]?mem+k:NULL)) {
+			fprintf(stderr, "get %lu (%d)\n", k, in[k]);
+			err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_ckmap_count(map) != count) {
+		fprintf(stderr, "wrong count: %u | %u\n",
+		                ts_algo_ckmap_count(map), count);
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_ckmap_forEach(map, countslot, &visited) != TS_ALGO_OK ||
+	    visited != count) {
+		fprintf(stderr, "forEach failed: %u | %u\n", visited, count);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_ckmap_destroy(map); free(map);
+	free(mem); free(in);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Strings and 'del'
+ * ------------------------------------------------------------------------
+ */
+void mydelete(void *ignore, void **data) {
+	free(*data);
+}
+
+int testStrings(int n) {
+	char key[32];
+	int err = 0;
+	ts_algo_ckmap_t map;
+
+	if (ts_algo_ckmap_init(&map, 0, NULL, mydelete) != TS_ALGO_OK) return -1;
+	for(int i=0; i<n; i++) {
+		size_t s = sprintf(key, "key%d", i);
+		char *v = strdup(key);
+		if (v == NULL) {
+			err = 1; goto cleanup;
+		}
+		if (ts_algo_ckmap_add(&map, key, s, v) != TS_ALGO_OK) {
+			free(v); err = 1; goto cleanup;
+		}
+	}
+	for(int i=0; i<n; i++) {
+		size_t s = sprintf(key, "key%d", i);
+		char *v = ts_algo_ckmap_get(&map, key, s);
+		if (v == NULL || strcmp(v, key) != 0) {
+			fprintf(stderr, "%s not found\n", key);
+			err = 1; goto cleanup;
+		}
+		if (i&1) ts_algo_ckmap_delete(&map, key, s);
+	}
+	if (ts_algo_ckmap_count(&map) != (uint32_t)(n-n/2)) {
+		fprintf(stderr, "wrong count: %u\n", ts_algo_ckmap_count(&map));
+		err = 1;
+	}
+cleanup:
+	ts_algo_ckmap_destroy(&map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Concurrent: readers look up the stable (even) keys, which must
+ * always be found, while one writer adds, updates and removes
+ * the odd keys and makes the table grow.
+ * ------------------------------------------------------------------------
+ */
+typedef struct {
+	ts_algo_ckmap_t *map;
+	uint64_t        *mem;
+	int              ops;
+	int              err;
+	uint32_t        seed;
+	uint64_t       found;
+} worker_t;
+
+void *reader(void *arg) {
+	worker_t *w = arg;
+	for(int i=0; i<w->ops; i++) {
+		uint64_t k = rand_r(&w->seed)%KEYS;
+		uint64_t *d = ts_algo_ckmap_getId(w->map, k);
+		if (d == NULL) {
+			if (!(k&1)) {
+				fprintf(stderr, "stable key %lu not found\n", k);
+				w->err = 1; return NULL;
+			}
+			continue;
+		}
+		if (*d != k) {
+			fprintf(stderr, "wrong data for key %lu\n", k);
+			w->err = 1; return NULL;
+		}
+		w->found++;
+	}
+	return NULL;
+}
+
+void *writer(void *arg) {
+	worker_t *w = arg;
+	for(int i=0; i<w->ops; i++) {
+		uint64_t k = (rand_r(&w->seed)%KEYS)|1;
+		switch(rand_r(&w->seed)%3) {
+		case 0: ts_algo_ckmap_addId(w->map, k, w->mem+k); break;
+		case 1: ts_algo_ckmap_removeId(w->map, k); break;
+		default: ts_algo_ckmap_updateId(w->map, k, w->mem+k);
+		}
+	}
+	return NULL;
+}
+
+int testConcurrent(int readers, int withWriter) {
+	pthread_t tids[65];
+	worker_t   ws[65];
+	timestamp_t t1, t2;
+	int err = 0;
+
+	uint64_t *mem = malloc(KEYS*sizeof(uint64_t));
+	if (mem == NULL) return -1;
+	for(uint64_t k=0; k<KEYS; k++) mem[k] = k;
+
+	// start small, so that the writer makes the table grow
+	ts_algo_ckmap_t *map = ts_algo_ckmap_new(0, ts_algo_hash_u64, NULL);
+	if (map == NULL) {
+		free(mem); return -1;
+	}
+	for(uint64_t k=0; k<KEYS; k+=2) {
+		if (ts_algo_ckmap_addId(map, k, mem+k) != TS_ALGO_OK) {
+			fprintf(stderr, "cannot add %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	timestamp(&t1);
+	for(int i=0; i<=readers; i++) {
+		ws[i].map = map; ws[i].mem = mem; ws[i].err = 0;
+		ws[i].ops = OPS; ws[i].found = 0;
+		ws[i].seed = rand();
+	}
+	if (withWriter) {
+		ws[readers].ops = OPS/4;
+		if (pthread_create(tids+readers, NULL, writer, ws+readers) != 0) {
+			fprintf(stderr, "Can't create thread\n");
+			exit(1);
+		}
+	}
+	for(int i=0; i<readers; i++) {
+		if (pthread_create(tids+i, NULL, reader, ws+i) != 0) {
+			fprintf(stderr, "Can't create thread\n");
+			exit(1);
+		}
+	}
+	for(int i=0; i<readers; i++) {
+		pthread_join(tids[i], NULL);
+		if (ws[i].err) err = 1;
+	}
+	timestamp(&t2);
+	if (withWriter) pthread_join(tids[readers], NULL);
+	if (!err) {
+		double s = (double)timediff(&t1, &t2)/1000000000.0;
+		fprintf(stderr, "%2d readers%s: %10.0f gets/s\n", readers,
+		        withWriter?" + writer":"         ",
+		        (double)readers*OPS/s);
+	}
+	ts_algo_ckmap_reclaim(map);
+	for(uint64_t k=0; k<KEYS; k+=2) {
+		if (ts_algo_ckmap_getId(map, k) != mem+k) {
+			fprintf(stderr, "lost key %lu\n", k);
+			err = 1; break;
+		}
+	}
+cleanup:
+	ts_algo_ckmap_destroy(map); free(map); free(mem);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * A degenerate hash fails adds, but the table does not grow
+ * beyond twice what the load requires
+ * ------------------------------------------------------------------------
+ */
+uint64_t consthash(const char *key, size_t ksz, void *ignore) {
+	return 42;
+}
+
+int testDegenerate(ts_algo_hash_t hsh, int n) {
+	int err = 0;
+	uint32_t ok = 0;
+	uint64_t *mem = malloc(n*sizeof(uint64_t));
+	if (mem == NULL) return -1;
+
+	ts_algo_ckmap_t *map = ts_algo_ckmap_new(0, hsh, NULL);
+	if (map == NULL) {
+		free(mem); return -1;
+	}
+	for(uint64_t k=0; k<(uint64_t)n; k++) {
+		mem[k] = k;
+		ts_algo_rc_t rc = ts_algo_ckmap_addId(map, k, mem+k);
+		if (rc == TS_ALGO_OK) {
+			ok++; continue;
+		}
+		if (rc != TS_ALGO_ERR) {
+			fprintf(stderr, "unexpected error on degenerate hash: %d\n", rc);
+			err = 1; goto cleanup;
+		}
+		if (ts_algo_ckmap_getId(map, k) != NULL) {
+			fprintf(stderr, "found %lu after failed add\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_ckmap_count(map) != ok) {
+		fprintf(stderr, "wrong count: %u | %u\n",
+		                ts_algo_ckmap_count(map), ok);
+		err = 1; goto cleanup;
+	}
+	if (map->tab->nbkt > 16 &&
+	    (uint64_t)map->tab->nbkt*TS_ALGO_CKMAP_WAYS > 4*(uint64_t)ok) {
+		fprintf(stderr, "table too big: %u buckets for %u keys\n",
+		                map->tab->nbkt, ok);
+		err = 1; goto cleanup;
+	}
+	fprintf(stderr, "degenerate: %u of %d keys in %u buckets\n",
+	                ok, n, map->tab->nbkt);
+cleanup:
+	ts_algo_ckmap_destroy(map); free(map); free(mem);
+	return err?-1:0;
+}
+
+int main() {
+	srand(time(NULL));
+	if (testRandom(0, 100) != 0) exit(1);
+	if (testRandom(0, 100000) != 0) exit(1);
+	if (testRandom(KEYS, 100000) != 0) exit(1);
+	if (testStrings(0) != 0) exit(1);
+	if (testStrings(1) != 0) exit(1);
+	if (testStrings(1000+rand()%10000) != 0) exit(1);
+	if (testDegenerate(consthash, 1000) != 0) exit(1);
+	if (testDegenerate(ts_algo_hash_id, 3000) != 0) exit(1);
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1) cpus = 1;
+	for(int t=1; t<=2*cpus && t<=64; t<<=1) {
+		if (testConcurrent(t, 0) != 0) exit(1);
+		if (testConcurrent(t, 1) != 0) exit(1);
+	}
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
@@ -0,0 +1,251 @@
+/* ========================================================================
+ * Test Concurrent Map
+ * -------------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <tsalgo/cmap.h>
+
+#define THREADS 8
+#define KEYS    20000
+#define OPS     200000
+
+typedef struct timespec timestamp_t;
+int timestamp(timestamp_t *tmstp) {
+	return clock_gettime(CLOCK_MONOTONIC, tmstp);
+}
+
+uint64_t timediff(timestamp_t *t1, timestamp_t *t2) {
+	return (t2->tv_sec - t1->tv_sec)*1000000000 +
+	       (t2->tv_nsec - t1->tv_nsec);
+}
+
+typedef struct {
+	ts_algo_cmap_t *map;
+	uint64_t        *mem; // data for all keys (data[k] = k)
+	int               id; // thread number
+	int                n; // number of threads
+	int              err;
+	uint32_t        seed;
+} worker_t;
+
+/* ------------------------------------------------------------------------
+ * Each thread owns the keys k with k%n == id;
+ * it adds, gets, updates and removes its own keys
+ * and reads the keys of the other threads.
+ * ------------------------------------------------------------------------
+ */
+void *work(void *arg) {
+	worker_t *w = arg;
+	for(uint64_t k=w->id; k<KEYS; k+=w->n) {
+		if (ts_algo_cmap_addId(w->map, k, w->mem+k) != TS_ALGO_OK) {
+			fprintf(stderr, "[%d] cannot add %lu\n", w->id, k);
+			w->err = 1; return NULL;
+		}
+	}
+	for(uint64_t k=0; k<KEYS; k++) {
+		uint64_t *d = ts_algo_cmap_getId(w->map, k);
+		if (k%w->n == w->id && d != w->mem+k) {
+			fprintf(stderr, "[%d] own key %lu not found\n", w->id, k);
+			w->err = 1; return NULL;
+		}
+		if (d != NULL && *d != k) {
+			fprintf(stderr, "[%d] wrong data for key %lu\n", w->id, k);
+			w->err = 1; return NULL;
+		}
+	}
+	for(uint64_t k=w->id; k<KEYS; k+=w->n) {
+		if (k&1) {
+			if (ts_algo_cmap_removeId(w->map, k) != w->mem+k) {
+				fprintf(stderr, "[%d] cannot remove %lu\n", w->id, k);
+				w->err = 1; return NULL;
+			}
+		} else {
+			if (ts_algo_cmap_updateId(w->map, k, w->mem+k) != w->mem+k) {
+				fprintf(stderr, "[%d] cannot update %lu\n", w->id, k);
+				w->err = 1; return NULL;
+			}
+		}
+	}
+	return NULL;
+}
+
+ts_algo_rc_t checkslot(void *rsc, ts_algo_map_slot_t *s) {
+	uint64_t k = *(uint64_t*)s->key;
+	if (k&1 || *(uint64_t*)s->data != k) return TS_ALGO_ERR;
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+int testConcurrent(uint32_t nshards, uint32_t mode) {
+	pthread_t tids[THREADS];
+	worker_t   ws[THREADS];
+	uint32_t n = 0;
+	int err = 0;
+
+	uint64_t *mem = malloc(KEYS*sizeof(uint64_t));
+	if (mem == NULL) return -1;
+	for(uint64_t k=0; k<KEYS; k++) mem[k] = k;
+
+	ts_algo_cmap_t *map = ts_algo_cmap_new(nshards, 64, ts_algo_hash_u64, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't create map\n");
+		free(mem); return -1;
+	}
+	for(int i=0; i<THREADS; i++) {
+		ws[i].map = map; ws[i].mem = mem;
+		ws[i].id = i; ws[i].n = THREADS; ws[i].err = 0;
+		if (pthread_create(tids+i, NULL, work, ws+i) != 0) {
+			fprintf(stderr, "Can't create thread\n");
+			exit(1);
+		}
+	}
+	for(int i=0; i<THREADS; i++) {
+		pthread_join(tids[i], NULL);
+		if (ws[i].err) err = 1;
+	}
+	if (err) goto cleanup;
+	if (ts_algo_cmap_count(map) != KEYS/2) {
+		fprintf(stderr, "wrong count: %u\n", ts_algo_cmap_count(map));
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_cmap_forEach(map, checkslot, &n) != TS_ALGO_OK || n != KEYS/2) {
+		fprintf(stderr, "wrong content (%u)\n", n);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_cmap_destroy(map); free(map); free(mem);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Throughput: 90% get, 5% add, 5% remove on random keys
+ * ------------------------------------------------------------------------
+ */
+void *mixed(void *arg) {
+	worker_t *w = arg;
+	for(int i=0; i<OPS; i++) {
+		uint64_t k = rand_r(&w->seed)%KEYS;
+		int op = rand_r(&w->seed)%20;
+		if (op == 0) {
+			if (ts_algo_cmap_addId(w->map, k, w->mem+k) != TS_ALGO_OK) {
+				w->err = 1; return NULL;
+			}
+		} else if (op == 1) {
+			ts_algo_cmap_removeId(w->map, k);
+		} else {
+			uint64_t *d = ts_algo_cmap_getId(w->map, k);
+			if (d != NULL && *d != k) {
+				w->err = 1; return NULL;
+			}
+		}
+	}
+	return NULL;
+}
+
+int testThroughput(int threads) {
+	pthread_t tids[64];
+	worker_t   ws[64];
+	timestamp_t t1, t2;
+	int err = 0;
+
+	uint64_t *mem = malloc(KEYS*sizeof(uint64_t));
+	if (mem == NULL) return -1;
+	for(uint64_t k=0; k<KEYS; k++) mem[k] = k;
+
+	ts_algo_cmap_t *map = ts_algo_cmap_new(0, 0, ts_algo_hash_u64, NULL,
+	                                       TS_ALGO_MAP_SLAB);
+	if (map == NULL) {
+		free(mem); return -1;
+	}
+	for(uint64_t k=0; k<KEYS; k+=2) ts_algo_cmap_addId(map, k, mem+k);
+
+	timestamp(&t1);
+	for(int i=0; i<threads; i++) {
+		ws[i].map = map; ws[i].mem = mem; ws[i].err = 0;
+		ws[i].seed = rand();
+		if (pthread_create(tids+i, NULL, mixed, ws+i) != 0) {
+			fprintf(stderr, "Can't create thread\n");
+			exit(1);
+		}
+	}
+	for(int i=0; i<threads; i++) {
+		pthread_join(tids[i], NULL);
+		if (ws[i].err) err = 1;
+	}
+	timestamp(&t2);
+	if (!err) {
+		double s = (double)timediff(&t1, &t2)/1000000000.0;
+		fprintf(stderr, "%2d threads: %10.0f ops/s\n",
+		        threads, (double)threads*OPS/s);
+	}
+	ts_algo_cmap_destroy(map); free(map); free(mem);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Each operation hashes the key only once
+ * (the shard map gets the hash computed for choosing the shard)
+ * ------------------------------------------------------------------------
+ */
+static uint64_t hashed = 0;
+
+static uint64_t countinghash(const char *key, size_t ksz, void *rsc) {
+	hashed++;
+	return ts_algo_hash_u64(key, ksz, rsc);
+}
+
+int testHashOnce(uint32_t mode) {
+	int err = 0;
+	uint64_t mem[1000];
+
+	ts_algo_cmap_t *map = ts_algo_cmap_new(16, 64, countinghash, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't create map\n");
+		return -1;
+	}
+	hashed = 0;
+	for(uint64_t k=0; k<1000; k++) {
+		mem[k] = k;
+		if (ts_algo_cmap_addId(map, mem[k], mem+k) != TS_ALGO_OK) err = 1;
+	}
+	for(uint64_t k=0; k<1000; k++) {
+		if (ts_algo_cmap_getId(map, mem[k]) != mem+k) err = 1;
+		if (ts_algo_cmap_updateId(map, mem[k], mem+k) != mem+k) err = 1;
+		if (ts_algo_cmap_removeId(map, mem[k]) != mem+k) err = 1;
+	}
+	if (err) fprintf(stderr, "hash once: wrong data\n");
+	if (!err && hashed != 4000) {
+		fprintf(stderr, "%lu hashes for 4000 operations\n", hashed);
+		err = 1;
+	}
+	ts_algo_cmap_destroy(map); free(map);
+	return err?-1:0;
+}
+
+int main() {
+	srand(time(NULL));
+	uint32_t modes[] = {TS_ALGO_MAP_DEFAULT,
+	                    TS_ALGO_MAP_SLAB,
+	                    TS_ALGO_MAP_INCREMENTAL};
+	for(int m=0; m<3; m++) {
+		if (testHashOnce(modes[m]) != 0) exit(1);
+		if (testConcurrent(1, modes[m]) != 0) exit(1);
+		if (testConcurrent(16, modes[m]) != 0) exit(1);
+		if (testConcurrent(0, modes[m]) != 0) exit(1);
+	}
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1) cpus = 1;
+	for(int t=1; t<=2*cpus && t<=64; t<<=1) {
+		if (testThroughput(t) != 0) exit(1);
+	}
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
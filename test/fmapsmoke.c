@@ -0,0 +1,318 @@
+/* ========================================================================
+ * Test File Map
+ * -------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tsalgo/fmap.h>
+#include <tsalgo/map.h>
+
+#define PATH "rsc/fmap.bin"
+#define ELEMENTS 1000000
+
+typedef struct timespec timestamp_t;
+int timestamp(timestamp_t *tmstp) {
+	return clock_gettime(CLOCK_MONOTONIC, tmstp);
+}
+
+uint64_t timediff(timestamp_t *t1, timestamp_t *t2) {
+	return (t2->tv_sec - t1->tv_sec)*1000000000 +
+	       (t2->tv_nsec - t1->tv_nsec);
+}
+
+void mydelete(void *ignore, void **data) {
+	free(*data);
+}
+
+/* ------------------------------------------------------------------------
+ * The data are strings, we store them without the terminating 0
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t strvalue(void *rsc, void *data, char **val, size_t *vsz) {
+	(*(uint32_t*)rsc)++;
+	*val = data;
+	*vsz = strlen(data);
+	return TS_ALGO_OK;
+}
+
+ts_algo_rc_t checkpair(void *rsc, const char *key, size_t ksz,
+                                  const char *val, size_t vsz) {
+	if (ksz < 4 || vsz != ksz+2 || memcmp(key+3, val+5, ksz-3) != 0) {
+		return TS_ALGO_ERR;
+	}
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+int testStrings(uint32_t n) {
+	int err = 0;
+	uint32_t calls = 0;
+	char key[32], val[32];
+	ts_algo_fmap_t *fmap = NULL;
+	ts_algo_map_t  *map  = ts_algo_map_new(0, NULL, mydelete);
+	if (map == NULL) return -1;
+
+	for(uint32_t i=0; i<n; i++) {
+		size_t s = sprintf(key, "key%u", i);
+		sprintf(val, "value%u", i);
+		char *v = strdup(val);
+		if (v == NULL) {
+			err = 1; goto cleanup;
+		}
+		if (ts_algo_map_add(map, key, s, v) != TS_ALGO_OK) {
+			free(v); err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_fmap_write(map, PATH, strvalue, &calls) != TS_ALGO_OK) {
+		fprintf(stderr, "can't write map of %u\n", n);
+		err = 1; goto cleanup;
+	}
+	if (calls != n) {
+		fprintf(stderr, "wrong number of value calls: %u | %u\n", calls, n);
+		err = 1; goto cleanup;
+	}
+	fmap = ts_algo_fmap_new(PATH);
+	if (fmap == NULL) {
+		fprintf(stderr, "can't open map of %u\n", n);
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_fmap_count(fmap) != n) {
+		fprintf(stderr, "wrong count: %u | %u\n", ts_algo_fmap_count(fmap), n);
+		err = 1; goto cleanup;
+	}
+	for(uint32_t i=0; i<n; i++) {
+		size_t vsz = 0;
+		size_t s = sprintf(key, "key%u", i);
+		size_t l = sprintf(val, "value%u", i);
+		const char *v = ts_algo_fmap_get(fmap, key, s, &vsz);
+		if (v == NULL || vsz != l || memcmp(v, val, l) != 0) {
+			fprintf(stderr, "%s not found\n", key);
+			err = 1; goto cleanup;
+		}
+		s = sprintf(key, "yek%u", i);
+		if (ts_algo_fmap_get(fmap, key, s, NULL) != NULL) {
+			fprintf(stderr, "found absent key %s\n", key);
+			err = 1; goto cleanup;
+		}
+	}
+	calls = 0;
+	if (ts_algo_fmap_forEach(fmap, checkpair, &calls) != TS_ALGO_OK ||
+	    calls != n) {
+		fprintf(stderr, "forEach failed: %u | %u\n", calls, n);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	if (fmap != NULL) {
+		ts_algo_fmap_close(fmap); free(fmap);
+	}
+	ts_algo_map_destroy(map); free(map);
+	remove(PATH);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Integer data stored as pointers; compare with ts_algo_map_t
+ * ------------------------------------------------------------------------
+ */
+int testIds() {
+	timestamp_t t1, t2, t3;
+	int err = 0;
+	uint64_t x = 0;
+	ts_algo_fmap_t fmap;
+	ts_algo_map_t *map = ts_algo_map_newMode(0, ts_algo_hash_u64, NULL,
+	                                         TS_ALGO_MAP_SLAB);
+	if (map == NULL) return -1;
+
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		uint64_t key = k*7919;
+		if (ts_algo_map_addId(map, key, (void*)k) != TS_ALGO_OK) {
+			err = 1; goto cleanup;
+		}
+	}
+	timestamp(&t1);
+	if (ts_algo_fmap_write(map, PATH, NULL, NULL) != TS_ALGO_OK) {
+		fprintf(stderr, "can't write map\n");
+		err = 1; goto cleanup;
+	}
+	timestamp(&t2);
+	if (ts_algo_fmap_open(&fmap, PATH) != TS_ALGO_OK) {
+		fprintf(stderr, "can't open map\n");
+		err = 1; goto cleanup;
+	}
+	timestamp(&t3);
+	fprintf(stderr, "fmap: written in %ldus, opened in %ldus, %zu bytes\n",
+	        timediff(&t1,&t2)/1000, timediff(&t2,&t3)/1000, fmap.size);
+
+	timestamp(&t1);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		size_t vsz = 0;
+		uint64_t key = ((k*31)%ELEMENTS+1)*7919;
+		const char *v = ts_algo_fmap_getId(&fmap, key, &vsz);
+		if (v == NULL || vsz != sizeof(uint64_t)) {
+			fprintf(stderr, "%lu not found\n", key);
+			err = 1; break;
+		}
+		x += *(const uint64_t*)v;
+	}
+	timestamp(&t2);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		uint64_t key = ((k*31)%ELEMENTS+1)*7919;
+		x -= (uint64_t)ts_algo_map_getId(map, key);
+	}
+	timestamp(&t3);
+	fprintf(stderr, "fmap get: %ldus, map get: %ldus\n",
+	        timediff(&t1,&t2)/1000, timediff(&t2,&t3)/1000);
+	if (x != 0) {
+		fprintf(stderr, "fmap and map differ\n");
+		err = 1;
+	}
+	ts_algo_fmap_close(&fmap);
+cleanup:
+	ts_algo_map_destroy(map); free(map);
+	remove(PATH);
+	return err?-1:0;
+}
+
+ts_algo_rc_t countpair(void *rsc, const char *key, size_t ksz,
+                                  const char *val, size_t vsz) {
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+/* ------------------------------------------------------------------------
+ * Write a (corrupted) copy of a map file
+ * ------------------------------------------------------------------------
+ */
+int writecopy(const char *buf, size_t sz) {
+	FILE *f = fopen(PATH, "wb");
+	if (f == NULL) return -1;
+	if (fwrite(buf, sz, 1, f) != 1) {
+		fclose(f); return -1;
+	}
+	fclose(f);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Truncated and corrupted files are rejected
+ * ------------------------------------------------------------------------
+ */
+int testCorrupt() {
+	int err = 0;
+	ts_algo_fmap_t fmap;
+	ts_algo_fmap_head_t head;
+	ts_algo_fmap_slot_t *slots;
+	char  *buf = NULL;
+	size_t sz;
+	uint32_t found;
+	ts_algo_map_t *map = ts_algo_map_new(0, ts_algo_hash_id, NULL);
+	if (map == NULL) return -1;
+
+	for(uint64_t k=1; k<=100; k++) {
+		if (ts_algo_map_addId(map, k, (void*)k) != TS_ALGO_OK) {
+			err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_fmap_write(map, PATH, NULL, NULL) != TS_ALGO_OK) {
+		fprintf(stderr, "can't write map\n");
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_fmap_open(&fmap, PATH) != TS_ALGO_OK) {
+		fprintf(stderr, "can't open map\n");
+		err = 1; goto cleanup;
+	}
+	sz = fmap.size;
+	head = *fmap.head;
+	buf = malloc(sz);
+	if (buf == NULL) {
+		ts_algo_fmap_close(&fmap);
+		err = 1; goto cleanup;
+	}
+	memcpy(buf, fmap.base, sz);
+	ts_algo_fmap_close(&fmap);
+	slots = (ts_algo_fmap_slot_t*)(buf+head.slots);
+
+	// truncated
+	if (writecopy(buf, sz-8) != 0) {
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_fmap_open(&fmap, PATH) != TS_ALGO_INVALID) {
+		fprintf(stderr, "opened truncated file\n");
+		err = 1; goto cleanup;
+	}
+
+	// record beyond the end of the file and value beyond the end of the file:
+	// the file is opened, but the corrupted slots are not used
+	slots[7].off = sz;
+	slots[9].vsz = 0xffffffff;
+	if (writecopy(buf, sz) != 0) {
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_fmap_open(&fmap, PATH) != TS_ALGO_OK) {
+		fprintf(stderr, "can't open corrupted map\n");
+		err = 1; goto cleanup;
+	}
+	found = 0;
+	for(uint64_t k=1; k<=100; k++) {
+		if (ts_algo_fmap_getId(&fmap, k, NULL) != NULL) found++;
+	}
+	if (found != 98) {
+		fprintf(stderr, "wrong number of keys in corrupted map: %u\n", found);
+		err = 1;
+	}
+	if (ts_algo_fmap_forEach(&fmap, countpair, &found) != TS_ALGO_INVALID) {
+		fprintf(stderr, "visited corrupted map\n");
+		err = 1;
+	}
+	ts_algo_fmap_close(&fmap);
+cleanup:
+	if (buf != NULL) free(buf);
+	ts_algo_map_destroy(map); free(map);
+	remove(PATH);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Files that are not maps are rejected
+ * ------------------------------------------------------------------------
+ */
+int testBadFiles() {
+	ts_algo_fmap_t fmap;
+	char junk[256];
+	FILE *f;
+
+	if (ts_algo_fmap_open(&fmap, "rsc/doesnotexist.bin") != TS_ALGO_FOPEN) {
+		fprintf(stderr, "opened non-existing file\n");
+		return -1;
+	}
+	memset(junk, 'x', 256);
+	f = fopen(PATH, "wb");
+	if (f == NULL) return -1;
+	if (fwrite(junk, 256, 1, f) != 1) {
+		fclose(f); return -1;
+	}
+	fclose(f);
+	if (ts_algo_fmap_open(&fmap, PATH) != TS_ALGO_INVALID) {
+		fprintf(stderr, "opened junk file\n");
+		remove(PATH); return -1;
+	}
+	remove(PATH);
+	return 0;
+}
+
+int main() {
+	srand(time(NULL));
+	if (testStrings(0) != 0) exit(1);
+	if (testStrings(1) != 0) exit(1);
+	if (testStrings(100) != 0) exit(1);
+	if (testStrings(1000+rand()%100000) != 0) exit(1);
+	if (testBadFiles() != 0) exit(1);
+	if (testCorrupt() != 0) exit(1);
+	if (testIds() != 0) exit(1);
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
@@ -0,0 +1,170 @@
+/* ========================================================================
+ * Test Hash Functions
+ * -------------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <tsalgo/hash.h>
+
+#define BUCKETS 1024
+#define KEYS    (64*BUCKETS)
+#define MAXLEN  1100
+
+typedef struct timespec timestamp_t;
+int timestamp(timestamp_t *tmstp) {
+	return clock_gettime(CLOCK_MONOTONIC, tmstp);
+}
+
+uint64_t timediff(timestamp_t *t1, timestamp_t *t2) {
+	return (t2->tv_sec - t1->tv_sec)*1000000000 +
+	       (t2->tv_nsec - t1->tv_nsec);
+}
+
+int popcount(uint64_t x) {
+	int n = 0;
+	for(; x!=0; x&=x-1) n++;
+	return n;
+}
+
+/* ------------------------------------------------------------------------
+ * Sequential keys must be distributed evenly in the lower bits
+ * ------------------------------------------------------------------------
+ */
+int testDistribution(ts_algo_hash_t hsh, size_t ksz, const char *name) {
+	uint32_t buckets[BUCKETS];
+	char key[16];
+	memset(buckets, 0, sizeof(buckets));
+	memset(key, 0, 16);
+	for(uint64_t i=0; i<KEYS; i++) {
+		memcpy(key, &i, ksz<8?ksz:8);
+		buckets[hsh(key, ksz, NULL)%BUCKETS]++;
+	}
+	// expected: 64 per bucket; chi-square with 1023 degrees of freedom
+	double chi = 0;
+	for(int i=0; i<BUCKETS; i++) {
+		double d = (double)buckets[i] - 64.0;
+		chi += d*d/64.0;
+	}
+	if (chi > 1200) {
+		fprintf(stderr, "%s: bad distribution (chi-square: %f)\n", name, chi);
+		return -1;
+	}
+	return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Flipping one bit of the key flips about half of the bits of the hash
+ * ------------------------------------------------------------------------
+ */
+int testAvalanche(ts_algo_hash_t hsh, size_t ksz, const char *name) {
+	char key[MAXLEN];
+	uint64_t flips = 0, n = 0;
+	for(int r=0; r<64; r++) {
+		for(size_t i=0; i<ksz; i++) key[i] = rand();
+		uint64_t h = hsh(key, ksz, NULL);
+		for(size_t b=0; b<ksz*8; b++) {
+			key[b>>3] ^= 1<<(b&7);
+			flips += popcount(h^hsh(key, ksz, NULL)); n++;
+			key[b>>3] ^= 1<<(b&7);
+		}
+	}
+	double avg = (double)flips/(double)n;
+	if (avg < 30 || avg > 34) {
+		fprintf(stderr, "%s(%zu): bad avalanche: %f\n", name, ksz, avg);
+		return -1;
+	}
+	return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * The seed changes the hash; the alignment of the key does not.
+ * All lengths result in different hashes.
+ * ------------------------------------------------------------------------
+ */
+int testSeedAndAlignment() {
+	static char buf[MAXLEN+8];
+	static uint64_t hs[MAXLEN];
+	uint64_t s1 = 1, s2 = 2;
+	for(int i=0; i<MAXLEN+8; i++) buf[i] = rand();
+	for(size_t l=0; l<MAXLEN; l++) {
+		uint64_t h = ts_algo_hash_bytes(buf, l, &s1);
+		if (h == ts_algo_hash_bytes(buf, l, &s2)) {
+			fprintf(stderr, "seed has no effect for length %zu\n", l);
+			return -1;
+		}
+		for(int a=1; a<8; a++) {
+			memmove(buf+a, buf, l);
+			if (h != ts_algo_hash_bytes(buf+a, l, &s1)) {
+				fprintf(stderr, "alignment %d changes hash for length %zu\n", a, l);
+				return -1;
+			}
+			memmove(buf, buf+a, l);
+		}
+		hs[l] = ts_algo_hash_bytes(buf, l, NULL);
+		for(size_t k=0; k<l; k++) {
+			if (hs[k] == hs[l]) {
+				fprintf(stderr, "length %zu and %zu collide\n", k, l);
+				return -1;
+			}
+		}
+	}
+	uint64_t k = 42;
+	if (ts_algo_hash_u64((char*)&k, 8, &s1) == ts_algo_hash_u64((char*)&k, 8, &s2)) {
+		fprintf(stderr, "seed has no effect on u64\n");
+		return -1;
+	}
+	uint32_t k4 = 42;
+	if (ts_algo_hash_u32((char*)&k4, 4, &s1) == ts_algo_hash_u32((char*)&k4, 4, &s2)) {
+		fprintf(stderr, "seed has no effect on u32\n");
+		return -1;
+	}
+	return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Just show how fast we are
+ * ------------------------------------------------------------------------
+ */
+void speed(size_t ksz, int it) {
+	timestamp_t t1, t2;
+	uint64_t x = 0;
+	char *key = malloc(ksz);
+	if (key == NULL) return;
+	memset(key, 'x', ksz);
+	timestamp(&t1);
+	for(int i=0; i<it; i++) {
+		key[0] = (char)i;
+		x ^= ts_algo_hash_bytes(key, ksz, NULL);
+	}
+	timestamp(&t2);
+	double ns = (double)timediff(&t1,&t2)/it;
+	fprintf(stderr, "%7zu bytes: %8.1fns per key, %6.2f GB/s (%lx)\n",
+	                ksz, ns, (double)ksz/ns, x&0xf);
+	free(key);
+}
+
+int main() {
+	srand(time(NULL));
+	if (testDistribution(ts_algo_hash_bytes, 8, "bytes") != 0) exit(1);
+	if (testDistribution(ts_algo_hash_bytes, 13, "bytes") != 0) exit(1);
+	if (testDistribution(ts_algo_hash_u64, 8, "u64") != 0) exit(1);
+	if (testDistribution(ts_algo_hash_u32, 4, "u32") != 0) exit(1);
+	if (testAvalanche(ts_algo_hash_u64, 8, "u64") != 0) exit(1);
+	if (testAvalanche(ts_algo_hash_u32, 4, "u32") != 0) exit(1);
+	size_t lens[] = {3, 8, 16, 31, 100, 256, 1000};
+	for(int i=0; i<7; i++) {
+		if (testAvalanche(ts_algo_hash_bytes, lens[i], "bytes") != 0) exit(1);
+	}
+	if (testSeedAndAlignment() != 0) exit(1);
+	speed(8, 10000000);
+	speed(64, 10000000);
+	speed(1024, 1000000);
+	speed(65536, 10000);
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
@@ -0,0 +1,330 @@
+/* ========================================================================
+ * Test Integer Map
+ * ----------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tsalgo/imap.h>
+#include <tsalgo/map.h>
+
+#define BUFSZ 4096
+#define ELEMENTS 1000000
+
+typedef struct {
+	uint64_t  key;
+	char   inmap;
+} mydata_t;
+
+mydata_t buf[BUFSZ];
+
+typedef struct timespec timestamp_t;
+int timestamp(timestamp_t *tmstp) {
+	return clock_gettime(CLOCK_MONOTONIC, tmstp);
+}
+
+uint64_t timediff(timestamp_t *t1, timestamp_t *t2) {
+	return (t2->tv_sec - t1->tv_sec)*1000000000 +
+	       (t2->tv_nsec - t1->tv_nsec);
+}
+
+void bufinit() {
+	for(int i=0;i<BUFSZ;i++) {
+		buf[i].key = i;
+		buf[i].inmap = 0;
+	}
+	// the extremes are keys like any other
+	buf[1].key = UINT64_MAX;
+	buf[2].key = 1UL<<63;
+	buf[3].key = 0xffffffff;
+}
+
+int checkall(ts_algo_imap_t *map) {
+	uint32_t n = 0;
+	for(int i=0;i<BUFSZ;i++) {
+		mydata_t *d = ts_algo_imap_get(map, buf[i].key);
+		if (buf[i].inmap) {
+			if (d != buf+i) {
+				fprintf(stderr, "%lu not found\n", buf[i].key);
+				return -1;
+			}
+			n++;
+		} else if (d != NULL) {
+			fprintf(stderr, "found removed %lu\n", buf[i].key);
+			return -1;
+		}
+	}
+	if (n != map->count) {
+		fprintf(stderr, "wrong count: %u | %u\n", n, map->count);
+		return -1;
+	}
+	return 0;
+}
+
+int checkiter(ts_algo_imap_t *map) {
+	uint32_t n = 0;
+	ts_algo_imap_it_t *it = ts_algo_imap_iterate(map);
+	if (it == NULL) return -1;
+	for(; !ts_algo_imap_it_eof(it); ts_algo_imap_it_advance(it)) {
+		ts_algo_imap_slot_t *s = ts_algo_imap_it_get(it);
+		if (s == NULL) {
+			fprintf(stderr, "NO SLOT\n");
+			free(it); return -1;
+		}
+		mydata_t *d = s->data;
+		if (!d->inmap || s->key != d->key) {
+			fprintf(stderr, "wrong slot for %lu\n", d->key);
+			free(it); return -1;
+		}
+		n++;
+	}
+	free(it);
+	if (n != map->count) {
+		fprintf(stderr, "wrong iteration count: %u | %u\n", n, map->count);
+		return -1;
+	}
+	return 0;
+}
+
+ts_algo_rc_t countslots(void *rsc, ts_algo_imap_slot_t *s) {
+	if (((mydata_t*)s->data)->key != s->key) return TS_ALGO_ERR;
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+int testRandom(uint32_t sz, uint64_t seed) {
+	int err = 0;
+	uint32_t n = 0;
+	bufinit();
+	ts_algo_imap_t *map = ts_algo_imap_new(sz, NULL);
+	if (map == NULL) {
+		fprintf(stderr, "Can't create map\n");
+		return -1;
+	}
+	map->seed = seed;
+	for(int r=0; r<8; r++) {
+		for(int i=0; i<BUFSZ; i++) {
+			int k = rand()%BUFSZ;
+			if (buf[k].inmap) {
+				if (rand()%2) {
+					if (ts_algo_imap_remove(map, buf[k].key) != buf+k) {
+						fprintf(stderr, "can't remove %d\n", k);
+						err = 1; goto cleanup;
+					}
+					buf[k].inmap = 0;
+				} else {
+					if (ts_algo_imap_update(map, buf[k].key, buf+k) != buf+k) {
+						fprintf(stderr, "can't update %d\n", k);
+						err = 1; goto cleanup;
+					}
+				}
+			} else {
+				if (ts_algo_imap_add(map, buf[k].key, buf+k) != TS_ALGO_OK) {
+					fprintf(stderr, "can't add %d\n", k);
+					err = 1; goto cleanup;
+				}
+				buf[k].inmap = 1;
+			}
+		}
+		if (checkall(map) != 0 || checkiter(map) != 0) {
+			err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_imap_forEach(map, countslots, &n) != TS_ALGO_OK ||
+	    n != map->count) {
+		fprintf(stderr, "forEach failed: %u | %u\n", n, map->count);
+		err = 1; goto cleanup;
+	}
+	{
+		ts_algo_list_t *l = ts_algo_imap_toList(map);
+		if (l == NULL) {
+			fprintf(stderr, "can't get list from map\n");
+			err = 1; goto cleanup;
+		}
+		if (l->len != map->count) {
+			fprintf(stderr, "wrong list length: %u | %u\n", l->len, map->count);
+			err = 1;
+		}
+		ts_algo_list_destroy(l); free(l);
+	}
+cleanup:
+	ts_algo_imap_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Adding the same key again and again ends in an error,
+ * not in a corrupted map
+ * ------------------------------------------------------------------------
+ */
+int testDuplicates() {
+	int err = 0;
+	int i;
+	uint32_t sz = 0;
+	ts_algo_imap_t *map = ts_algo_imap_new(8, NULL);
+	if (map == NULL) return -1;
+	for(i=0; i<1000; i++) {
+		sz = map->curSize;
+		if (ts_algo_imap_add(map, 42, buf) != TS_ALGO_OK) break;
+	}
+	if (i == 1000) {
+		fprintf(stderr, "no error on duplicates\n");
+		err = 1; goto cleanup;
+	}
+	// the error does not resize and other keys still work
+	if (map->curSize != sz) {
+		fprintf(stderr, "resized on duplicates: %u | %u\n", sz, map->curSize);
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=1000; k<1005; k++) {
+		if (ts_algo_imap_add(map, k, buf+k) != TS_ALGO_OK) {
+			fprintf(stderr, "cannot add %lu after duplicates\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->curSize != sz || map->count != (uint32_t)i+5) {
+		fprintf(stderr, "wrong size or count after duplicates: %u | %u\n",
+		                map->curSize, map->count);
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=1000; k<1005; k++) {
+		if (ts_algo_imap_remove(map, k) != buf+k) {
+			fprintf(stderr, "cannot remove %lu after duplicates\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	for(; i>0; i--) {
+		if (ts_algo_imap_remove(map, 42) != buf) {
+			fprintf(stderr, "can't remove duplicate\n");
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->count != 0 || ts_algo_imap_get(map, 42) != NULL) {
+		fprintf(stderr, "map not empty: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_imap_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Distinct keys with the same home position (seed 0, default size)
+ * fail the add, but do not grow the buffer of a map that is not loaded
+ * ------------------------------------------------------------------------
+ */
+int testCollisions() {
+	int err = 0;
+	int fails = 0;
+	uint32_t n = 0;
+	uint64_t k = 0;
+	ts_algo_imap_t *map = ts_algo_imap_new(0, NULL);
+	if (map == NULL) return -1;
+
+	uint32_t sz = map->curSize;
+	uint64_t home = ts_algo_hash_mix64(0, map->seed)&(sz-1);
+	for(int i=0; i<300; i++) {
+		while((ts_algo_hash_mix64(k, map->seed)&(sz-1)) != home) k++;
+		ts_algo_rc_t rc = ts_algo_imap_add(map, k, buf);
+		if (rc == TS_ALGO_ERR) fails++;
+		else if (rc != TS_ALGO_OK) {
+			fprintf(stderr, "unexpected error on collisions: %d\n", rc);
+			err = 1; goto cleanup;
+		} else n++;
+		k++;
+	}
+	if (fails == 0) {
+		fprintf(stderr, "no error on collisions\n");
+		err = 1; goto cleanup;
+	}
+	if (map->curSize != sz || map->count != n) {
+		fprintf(stderr, "resized on collisions: %u | %u (%u keys)\n",
+		                sz, map->curSize, map->count);
+		err = 1; goto cleanup;
+	}
+	// keys with another home position are still added
+	for(int i=0; i<5; i++) {
+		while((ts_algo_hash_mix64(k, map->seed)&(sz-1)) == home) k++;
+		if (ts_algo_imap_add(map, k, buf) != TS_ALGO_OK ||
+		    ts_algo_imap_get(map, k) != buf) {
+			fprintf(stderr, "cannot add %lu after collisions\n", k);
+			err = 1; goto cleanup;
+		}
+		k++;
+	}
+cleanup:
+	ts_algo_imap_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Compare with ts_algo_map_t (slab mode, hash_u64)
+ * ------------------------------------------------------------------------
+ */
+int testSpeed() {
+	timestamp_t t1, t2, t3;
+	int err = 0;
+	uint64_t x = 0;
+
+	ts_algo_imap_t *imap = ts_algo_imap_new(0, NULL);
+	if (imap == NULL) return -1;
+	ts_algo_map_t *map = ts_algo_map_newMode(0, ts_algo_hash_u64, NULL,
+	                                         TS_ALGO_MAP_SLAB);
+	if (map == NULL) {
+		ts_algo_imap_destroy(imap); free(imap);
+		return -1;
+	}
+	timestamp(&t1);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		if (ts_algo_imap_add(imap, k*7919, (void*)k) != TS_ALGO_OK) {
+			err = 1; goto cleanup;
+		}
+	}
+	timestamp(&t2);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		x += (uint64_t)ts_algo_imap_get(imap, ((k*31)%ELEMENTS+1)*7919);
+	}
+	timestamp(&t3);
+	fprintf(stderr, "imap: add %ldus, get %ldus\n",
+	        timediff(&t1,&t2)/1000, timediff(&t2,&t3)/1000);
+	timestamp(&t1);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		uint64_t key = k*7919;
+		if (ts_algo_map_addId(map, key, (void*)k) != TS_ALGO_OK) {
+			err = 1; goto cleanup;
+		}
+	}
+	timestamp(&t2);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		uint64_t key = ((k*31)%ELEMENTS+1)*7919;
+		x -= (uint64_t)ts_algo_map_getId(map, key);
+	}
+	timestamp(&t3);
+	fprintf(stderr, "map : add %ldus, get %ldus\n",
+	        timediff(&t1,&t2)/1000, timediff(&t2,&t3)/1000);
+	if (x != 0) {
+		fprintf(stderr, "imap and map differ\n");
+		err = 1;
+	}
+cleanup:
+	ts_algo_imap_destroy(imap); free(imap);
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+int main() {
+	srand(time(NULL));
+	for(int i=0;i<10;i++) {
+		if (testRandom(0, 0) != 0) exit(1);
+		if (testRandom(8, rand()) != 0) exit(1);
+		if (testRandom(64, 0) != 0) exit(1);
+	}
+	if (testDuplicates() != 0) exit(1);
+	if (testCollisions() != 0) exit(1);
+	if (testSpeed() != 0) exit(1);
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
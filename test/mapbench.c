@@ -106,8 +106,8 @@ cleanup:
 	return err;
 }
 
-char testinsmap(int it, uint32_t sz, ts_algo_hash_t hsh) {
-	char city=0;
+char testinsmap(int it, uint32_t sz, ts_algo_hash_t hsh, uint32_t mode) {
+	char strkeys=0;
 	progress_t p;
 	timestamp_t t1,t2;
 	uint64_t d = 0;
@@ -118,14 +118,20 @@ char testinsmap(int it, uint32_t sz, ts_algo_hash_t hsh) {
 		return -1;
 	}
 	if (hsh == (ts_algo_hash_t)ts_algo_hash_id) {
-		fprintf(stderr, "Map with Id and base size %u\n", sz);
+		fprintf(stderr, "Map with Id and base size %u", sz);
+	} else if (hsh == ts_algo_hash_u64) {
+		fprintf(stderr, "Map with hash_u64 and base size %u", sz);
+	} else if (hsh == ts_algo_hash_bytes) {
+		strkeys=1;
+		fprintf(stderr, "Map with hash_bytes and base size %u", sz);
 	} else {
-		city=1;
-		fprintf(stderr, "Map with Hash64 and base size %u\n", sz);
+		strkeys=1;
+		fprintf(stderr, "Map with Hash64 and base size %u", sz);
 	}
+	fprintf(stderr, "%s\n", mode&TS_ALGO_MAP_SLAB?" (slab)":"");
 	init_progress(&p,stdout,it);
 	for (int j=0;j<it;j++) {
-		if (ts_algo_map_init(map, sz, hsh, NULL) != TS_ALGO_OK) {
+		if (ts_algo_map_initMode(map, sz, hsh, NULL, mode) != TS_ALGO_OK) {
 			printf("cannot init map\n");
 			err = 1;
 			break;
@@ -137,7 +143,7 @@ char testinsmap(int it, uint32_t sz, ts_algo_hash_t hsh) {
 		}
 		for (uint64_t i=0;i<ELEMENTS;i++) {
 			ts_algo_rc_t rc;
-			if (city)
+			if (strkeys)
 				rc = ts_algo_map_add(map, mystrings[i], 8, (void*)(uint64_t)i);
 			else 
 				rc = ts_algo_map_add(map, (char*)&i, sizeof(uint64_t), (void*)(uint64_t)i);
@@ -167,6 +173,496 @@ cleanup:
 	return err;
 }
 
+char testlatency(int it, uint32_t mode) {
+	progress_t p;
+	timestamp_t t1,t2;
+	uint64_t mx = 0;
+	char err = 0;
+	ts_algo_map_t *map = (ts_algo_map_t*)malloc(sizeof(ts_algo_map_t));
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	fprintf(stderr, "Worst-case add latency%s\n",
+	        mode&TS_ALGO_MAP_INCREMENTAL?" (incremental)":"");
+	init_progress(&p,stdout,it);
+	for (int j=0;j<it;j++) {
+		if (ts_algo_map_initMode(map, 8, ts_algo_hash_id, NULL, mode) != TS_ALGO_OK) {
+			printf("cannot init map\n");
+			err = 1;
+			break;
+		}
+		for (uint64_t i=0;i<ELEMENTS;i++) {
+			if (timestamp(&t1)) {
+				printf("cannot timestamp\n");
+				err = 1; break;
+			}
+			ts_algo_rc_t rc = ts_algo_map_add(map, (char*)&i, sizeof(uint64_t), (void*)(uint64_t)i);
+			if (timestamp(&t2)) {
+				printf("cannot timestamp\n");
+				err = 1; break;
+			}
+			if (rc != TS_ALGO_OK) {
+				fprintf(stderr, "Can't add: %d\n", rc);
+				err = 1; break;
+			}
+			uint64_t d = timediff(&t2,&t1);
+			if (d > mx) mx = d;
+		}
+		ts_algo_map_destroy(map);
+		if (err != 0) break;
+		update_progress(&p,j);
+	}
+	close_progress(&p);printf("\n");
+	if (err == 0) {
+		fprintf(stderr, "Max: %ldus for %d elements\n", mx/1000, ELEMENTS);
+	}
+	free(map);
+	return err;
+}
+
+#define LOOKUPS (10*ELEMENTS)
+#define BATCHSZ 256
+
+char testgetbatch(int it, uint32_t mode) {
+	timestamp_t t1,t2;
+	uint64_t ds = 0, db = 0, x = 0;
+	char err = 0;
+	uint64_t *keys = NULL;
+	char    **kp = NULL;
+	size_t   *ksz = NULL;
+	void    **out = NULL;
+	ts_algo_map_t *map = ts_algo_map_newMode(LOOKUPS/2, ts_algo_hash_u64, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	fprintf(stderr, "Single vs. batched get on %d elements%s%s\n", LOOKUPS,
+	        mode&TS_ALGO_MAP_SLAB?" (slab)":"",
+	        mode&TS_ALGO_MAP_STATS?" (stats)":"");
+	keys = malloc(LOOKUPS*sizeof(uint64_t));
+	kp   = malloc(LOOKUPS*sizeof(char*));
+	ksz  = malloc(LOOKUPS*sizeof(size_t));
+	out  = malloc(LOOKUPS*sizeof(void*));
+	if (keys == NULL || kp == NULL || ksz == NULL || out == NULL) {
+		fprintf(stderr, "out of mem\n");
+		err = 1; goto cleanup;
+	}
+	for (uint64_t i=0;i<LOOKUPS;i++) {
+		keys[i] = i; ksz[i] = sizeof(uint64_t);
+		if (ts_algo_map_add(map, (char*)&i, sizeof(uint64_t), keys+i) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add\n");
+			err = 1; goto cleanup;
+		}
+	}
+	// look the keys up in random order
+	for (int i=0;i<LOOKUPS;i++) kp[i] = (char*)(keys+rand()%LOOKUPS);
+	for (int j=0;j<it;j++) {
+		timestamp(&t1);
+		for (int i=0;i<LOOKUPS;i++) {
+			out[i] = ts_algo_map_get(map, kp[i], ksz[i]);
+		}
+		timestamp(&t2);
+		ds += timediff(&t2,&t1);
+		for (int i=0;i<LOOKUPS;i++) x += *(uint64_t*)out[i];
+		timestamp(&t1);
+		for (int i=0;i<LOOKUPS;i+=BATCHSZ) {
+			uint32_t n = LOOKUPS-i<BATCHSZ?LOOKUPS-i:BATCHSZ;
+			ts_algo_map_getBatch(map, kp+i, ksz+i, n, out+i);
+		}
+		timestamp(&t2);
+		db += timediff(&t2,&t1);
+		for (int i=0;i<LOOKUPS;i++) x -= *(uint64_t*)out[i];
+	}
+	if (x != 0) {
+		fprintf(stderr, "single and batched get differ\n");
+		err = 1; goto cleanup;
+	}
+	fprintf(stderr, "Single : %ldus\n", (ds/it)/1000);
+	fprintf(stderr, "Batched: %ldus\n", (db/it)/1000);
+	if (mode & TS_ALGO_MAP_STATS) {
+		ts_algo_map_stats_t stats;
+		ts_algo_map_stats(map, &stats);
+		fprintf(stderr, "load: %.2f, longest chain: %u, probes/lookup: %.2f, "
+		                "%zu bytes\n", stats.load, stats.maxchain,
+		                (double)stats.probes/stats.lookups, stats.mem);
+	}
+cleanup:
+	if (keys != NULL) free(keys);
+	if (kp != NULL) free(kp);
+	if (ksz != NULL) free(ksz);
+	if (out != NULL) free(out);
+	ts_algo_map_destroy(map); free(map);
+	return err;
+}
+
+#define TINYMAPS 100000
+#define TINYSZ   10
+
+char testtiny(uint32_t mode) {
+	timestamp_t t1,t2;
+	uint64_t x = 0;
+	size_t mem = 0;
+	char err = 0;
+	uint32_t n = 0;
+	ts_algo_map_stats_t stats;
+	ts_algo_map_t *maps = calloc(TINYMAPS, sizeof(ts_algo_map_t));
+	if (maps == NULL) {
+		fprintf(stderr, "Can't creat maps\n");
+		return -1;
+	}
+	fprintf(stderr, "%d maps with %d elements%s\n", TINYMAPS, TINYSZ,
+	        mode&TS_ALGO_MAP_SMALL?" (small)":"");
+	timestamp(&t1);
+	for(n=0; n<TINYMAPS; n++) {
+		if (ts_algo_map_initMode(maps+n, 64, ts_algo_hash_u64, NULL, mode)
+		                                                  != TS_ALGO_OK) {
+			fprintf(stderr, "Can't init map\n");
+			err = 1; goto cleanup;
+		}
+		for(uint64_t k=0; k<TINYSZ; k++) {
+			if (ts_algo_map_addId(maps+n, k, (void*)(k+1)) != TS_ALGO_OK) {
+				fprintf(stderr, "Can't add\n");
+				n++; err = 1; goto cleanup;
+			}
+		}
+	}
+	for(uint32_t i=0; i<TINYMAPS; i++) {
+		for(uint64_t k=0; k<TINYSZ; k++) {
+			x += (uint64_t)ts_algo_map_getId(maps+i, k);
+		}
+	}
+	timestamp(&t2);
+	if (x != (uint64_t)TINYMAPS*TINYSZ*(TINYSZ+1)/2) {
+		fprintf(stderr, "wrong sum\n");
+		err = 1; goto cleanup;
+	}
+	for(uint32_t i=0; i<TINYMAPS; i++) {
+		ts_algo_map_stats(maps+i, &stats);
+		mem += stats.mem + sizeof(ts_algo_map_t);
+	}
+	fprintf(stderr, "create, add and get: %ldus, %zu bytes per map\n",
+	                timediff(&t2,&t1)/1000, mem/TINYMAPS);
+cleanup:
+	for(uint32_t i=0; i<n; i++) ts_algo_map_destroy(maps+i);
+	free(maps);
+	return err;
+}
+
+char testcounting(int it, uint32_t mode) {
+	timestamp_t t1,t2;
+	uint64_t d1 = 0, d2 = 0;
+	char err = 0;
+	ts_algo_map_t *map = (ts_algo_map_t*)malloc(sizeof(ts_algo_map_t));
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	fprintf(stderr, "Counting %d keys: get+add+update vs. getOrInsert%s\n",
+	        ELEMENTS, mode&TS_ALGO_MAP_SLAB?" (slab)":"");
+	for (int j=0;j<it && !err;j++) {
+		if (ts_algo_map_initMode(map, 8, ts_algo_hash_u64, NULL, mode) != TS_ALGO_OK) {
+			printf("cannot init map\n");
+			err = 1; break;
+		}
+		timestamp(&t1);
+		for (uint64_t i=0;i<ELEMENTS;i++) {
+			uint64_t k = (i*7919)%(ELEMENTS/10);
+			void *c = ts_algo_map_getId(map, k);
+			if (c == NULL) {
+				if (ts_algo_map_addId(map, k, (void*)1) != TS_ALGO_OK) {
+					err = 1; break;
+				}
+			} else {
+				ts_algo_map_updateId(map, k, (void*)((uint64_t)c+1));
+			}
+		}
+		timestamp(&t2);
+		d1 += timediff(&t2,&t1);
+		ts_algo_map_destroy(map);
+
+		if (ts_algo_map_initMode(map, 8, ts_algo_hash_u64, NULL, mode) != TS_ALGO_OK) {
+			printf("cannot init map\n");
+			err = 1; break;
+		}
+		timestamp(&t1);
+		for (uint64_t i=0;i<ELEMENTS;i++) {
+			uint64_t k = (i*7919)%(ELEMENTS/10);
+			ts_algo_map_slot_t *s = ts_algo_map_getOrInsertId(map, k, NULL, NULL);
+			if (s == NULL) {
+				err = 1; break;
+			}
+			s->data = (void*)((uint64_t)s->data+1);
+		}
+		timestamp(&t2);
+		d2 += timediff(&t2,&t1);
+		ts_algo_map_destroy(map);
+	}
+	if (err == 0) {
+		fprintf(stderr, "get+add+update: %ldus\n", (d1/it)/1000);
+		fprintf(stderr, "getOrInsert   : %ldus\n", (d2/it)/1000);
+	}
+	free(map);
+	return err;
+}
+
+char testreserve(int it, char reserve) {
+	timestamp_t t1,t2;
+	uint64_t d = 0;
+	char err = 0;
+	ts_algo_map_t *map = (ts_algo_map_t*)malloc(sizeof(ts_algo_map_t));
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	for (int j=0;j<it && !err;j++) {
+		if (ts_algo_map_initMode(map, 0, ts_algo_hash_u64, NULL,
+		                         TS_ALGO_MAP_SLAB) != TS_ALGO_OK) {
+			printf("cannot init map\n");
+			err = 1; break;
+		}
+		timestamp(&t1);
+		if (reserve && ts_algo_map_reserve(map, 10*ELEMENTS) != TS_ALGO_OK) {
+			err = 1;
+		}
+		for (uint64_t i=0;i<10*ELEMENTS && !err;i++) {
+			if (ts_algo_map_addId(map, i, (void*)i) != TS_ALGO_OK) err = 1;
+		}
+		timestamp(&t2);
+		d += timediff(&t2,&t1);
+		ts_algo_map_destroy(map);
+	}
+	if (err == 0) {
+		fprintf(stderr, "Adding %d elements%s: %ldus\n", 10*ELEMENTS,
+		        reserve?" (reserved)":"", (d/it)/1000);
+	}
+	free(map);
+	return err;
+}
+
+/* ------------------------------------------------------------------------
+ * Strings as keys and data: copied vs. borrowed keys
+ * ------------------------------------------------------------------------
+ */
+char testborrow(int it, uint32_t mode) {
+	timestamp_t t1,t2;
+	uint64_t d = 0;
+	size_t mem = 0;
+	char err = 0;
+	ts_algo_map_stats_t stats;
+	ts_algo_map_t *map = (ts_algo_map_t*)malloc(sizeof(ts_algo_map_t));
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	for (int j=0;j<it && !err;j++) {
+		if (ts_algo_map_initMode(map, ELEMENTS, ts_algo_hash_bytes, NULL,
+		                         mode) != TS_ALGO_OK) {
+			printf("cannot init map\n");
+			err = 1; break;
+		}
+		timestamp(&t1);
+		for (int i=0;i<ELEMENTS && !err;i++) {
+			if (ts_algo_map_add(map, mystrings[i], 8, mystrings[i]) != TS_ALGO_OK) {
+				err = 1;
+			}
+		}
+		ts_algo_map_stats(map, &stats);
+		mem = stats.mem;
+		for (int i=0;i<ELEMENTS && !err;i++) {
+			if (ts_algo_map_remove(map, mystrings[i], 8) == NULL) err = 1;
+		}
+		timestamp(&t2);
+		d += timediff(&t2,&t1);
+		ts_algo_map_destroy(map);
+	}
+	if (err == 0) {
+		fprintf(stderr, "Adding and removing %d strings (%s%s): %ldus, %zu bytes\n",
+		        ELEMENTS, mode&TS_ALGO_MAP_BORROW?"borrowed":"copied",
+		        mode&TS_ALGO_MAP_SLAB?", slab":"", (d/it)/1000, mem);
+	}
+	free(map);
+	return err;
+}
+
+/* ------------------------------------------------------------------------
+ * Bulk build and traversal: serial vs. parallel
+ * ------------------------------------------------------------------------
+ */
+ts_algo_rc_t sumdata(void *rsc, ts_algo_map_slot_t *s) {
+	__atomic_fetch_add((uint64_t*)rsc, *(uint64_t*)s->data, __ATOMIC_RELAXED);
+	return TS_ALGO_OK;
+}
+
+char testfromarray(int it, uint32_t nthreads) {
+	timestamp_t t1,t2,t3;
+	uint64_t d1 = 0, d2 = 0, sum = 0;
+	char err = 0;
+	uint32_t n = 10*ELEMENTS;
+	uint64_t *keys = calloc(n, sizeof(uint64_t));
+	char    **kp   = calloc(n, sizeof(char*));
+	size_t   *ksz  = calloc(n, sizeof(size_t));
+	ts_algo_map_t *map = (ts_algo_map_t*)malloc(sizeof(ts_algo_map_t));
+	if (map == NULL || keys == NULL || kp == NULL || ksz == NULL) {
+		fprintf(stderr, "out of mem\n");
+		err = 1; goto cleanup;
+	}
+	for (uint32_t i=0;i<n;i++) {
+		keys[i] = i; kp[i] = (char*)(keys+i); ksz[i] = sizeof(uint64_t);
+	}
+	for (int j=0;j<it && !err;j++) {
+		if (ts_algo_map_initMode(map, 0, ts_algo_hash_u64, NULL,
+		                         TS_ALGO_MAP_SLAB) != TS_ALGO_OK) {
+			printf("cannot init map\n");
+			err = 1; break;
+		}
+		timestamp(&t1);
+		if (ts_algo_map_fromArray(map, kp, ksz, (void**)kp, n,
+		                          nthreads) != TS_ALGO_OK) err = 1;
+		timestamp(&t2);
+		sum = 0;
+		if (ts_algo_map_forEachPar(map, sumdata, &sum, nthreads) != TS_ALGO_OK ||
+		    sum != (uint64_t)n*(n-1)/2) err = 1;
+		timestamp(&t3);
+		d1 += timediff(&t2,&t1);
+		d2 += timediff(&t3,&t2);
+		ts_algo_map_destroy(map);
+	}
+	if (err == 0) {
+		fprintf(stderr, "Building %u elements with %u threads: %ldus, "
+		                "visiting: %ldus\n", n, nthreads,
+		                (d1/it)/1000, (d2/it)/1000);
+	}
+cleanup:
+	free(map); free(keys); free(kp); free(ksz);
+	return err;
+}
+
+/* ------------------------------------------------------------------------
+ * Merging a delta into a base map: key by key vs. ts_algo_map_merge
+ * ------------------------------------------------------------------------
+ */
+char testmerge(int it, char bulk) {
+	timestamp_t t1,t2;
+	uint64_t d = 0;
+	char err = 0;
+	ts_algo_map_t base, delta;
+
+	for (int j=0;j<it && !err;j++) {
+		if (ts_algo_map_initMode(&base, 0, ts_algo_hash_u64, NULL,
+		                         TS_ALGO_MAP_SLAB) != TS_ALGO_OK) {
+			err = 1; break;
+		}
+		if (ts_algo_map_initMode(&delta, 0, ts_algo_hash_u64, NULL,
+		                         TS_ALGO_MAP_SLAB) != TS_ALGO_OK) {
+			ts_algo_map_destroy(&base);
+			err = 1; break;
+		}
+		for (uint64_t i=0;i<10*ELEMENTS && !err;i++) {
+			if (ts_algo_map_addId(&base, i, (void*)i) != TS_ALGO_OK) err = 1;
+		}
+		// half of the delta is new
+		for (uint64_t i=0;i<ELEMENTS && !err;i++) {
+			uint64_t k = 9*ELEMENTS+2*i;
+			if (ts_algo_map_addId(&delta, k, (void*)k) != TS_ALGO_OK) err = 1;
+		}
+		timestamp(&t1);
+		if (bulk) {
+			if (ts_algo_map_merge(&base, &delta, TS_ALGO_MAP_REPLACE,
+			                      0) != TS_ALGO_OK) err = 1;
+		} else {
+			ts_algo_map_it_t *it = ts_algo_map_iterate(&delta);
+			if (it == NULL) err = 1;
+			for(;!err && !ts_algo_map_it_eof(it);ts_algo_map_it_advance(it)) {
+				ts_algo_map_slot_t *s = ts_algo_map_it_get(it);
+				if (ts_algo_map_upsert(&base, s->key, s->ksz, s->data,
+				                       NULL) != TS_ALGO_OK) err = 1;
+			}
+			free(it);
+		}
+		timestamp(&t2);
+		d += timediff(&t2,&t1);
+		if (base.count != 10*ELEMENTS+ELEMENTS/2) err = 1;
+		ts_algo_map_destroy(&base);
+		ts_algo_map_destroy(&delta);
+	}
+	if (err == 0) {
+		fprintf(stderr, "Merging %d into %d elements (%s): %ldus\n",
+		        ELEMENTS, 10*ELEMENTS, bulk?"merge":"key by key",
+		        (d/it)/1000);
+	}
+	return err;
+}
+
+/* ------------------------------------------------------------------------
+ * A consistent view for a reader while the writer changes
+ * ELEMENTS keys: full copy vs. snapshot
+ * ------------------------------------------------------------------------
+ */
+char testsnapshot(int it, char cow) {
+	timestamp_t t1,t2,t3;
+	uint64_t d1 = 0, d2 = 0;
+	size_t mem = 0;
+	char err = 0;
+	ts_algo_map_stats_t stats;
+	ts_algo_map_snap_t snap;
+	ts_algo_map_t base, copy;
+
+	for (int j=0;j<it && !err;j++) {
+		if (ts_algo_map_initMode(&base, 0, ts_algo_hash_u64, NULL,
+		                         TS_ALGO_MAP_SLAB) != TS_ALGO_OK) {
+			err = 1; break;
+		}
+		for (uint64_t i=0;i<10*ELEMENTS && !err;i++) {
+			if (ts_algo_map_addId(&base, i, (void*)i) != TS_ALGO_OK) err = 1;
+		}
+		timestamp(&t1);
+		if (cow) {
+			if (ts_algo_map_snapshot(&base, &snap) != TS_ALGO_OK) err = 1;
+		} else {
+			if (ts_algo_map_initMode(&copy, base.curSize, ts_algo_hash_u64,
+			                         NULL, TS_ALGO_MAP_SLAB) != TS_ALGO_OK) {
+				ts_algo_map_destroy(&base);
+				err = 1; break;
+			}
+			ts_algo_map_it_t *it = ts_algo_map_iterate(&base);
+			if (it == NULL) err = 1;
+			for(;!err && !ts_algo_map_it_eof(it);ts_algo_map_it_advance(it)) {
+				ts_algo_map_slot_t *s = ts_algo_map_it_get(it);
+				if (ts_algo_map_add(&copy, s->key, s->ksz,
+				                    s->data) != TS_ALGO_OK) err = 1;
+			}
+			free(it);
+		}
+		timestamp(&t2);
+		for (uint64_t i=0;i<ELEMENTS && !err;i++) {
+			uint64_t k = rand()%(10*ELEMENTS);
+			if (ts_algo_map_updateId(&base, k, (void*)(k+1)) == NULL) err = 1;
+		}
+		timestamp(&t3);
+		d1 += timediff(&t2,&t1);
+		d2 += timediff(&t3,&t2);
+		ts_algo_map_stats(&base, &stats);
+		mem = stats.mem;
+		if (cow) {
+			if (err == 0 && snap.count != 10*ELEMENTS) err = 1;
+			ts_algo_map_release(&snap);
+		} else {
+			ts_algo_map_stats(&copy, &stats);
+			mem += stats.mem;
+			ts_algo_map_destroy(&copy);
+		}
+		ts_algo_map_destroy(&base);
+	}
+	if (err == 0) {
+		fprintf(stderr, "View of %d elements (%s): %ldus, "
+		                "%d updates: %ldus, %zu bytes\n",
+		        10*ELEMENTS, cow?"snapshot":"copy", (d1/it)/1000,
+		        ELEMENTS, (d2/it)/1000, mem);
+	}
+	return err;
+}
+
 int main() {
 	srand(time(NULL));
 	if (initstringbuf() != 0) {
@@ -177,23 +673,93 @@ int main() {
 		fprintf(stderr, "FAILED!\n");
 		exit(1);
 	} 
-	if (testinsmap(100, 32768, ts_algo_hash_id) != 0) {
+	if (testinsmap(100, 32768, ts_algo_hash_id, TS_ALGO_MAP_DEFAULT) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testinsmap(100, 65536, ts_algo_hash_id, TS_ALGO_MAP_DEFAULT) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testinsmap(100, 65536, ts_algo_hash_id, TS_ALGO_MAP_SLAB) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testinsmap(100, 65536, ts_algo_hash_u64, TS_ALGO_MAP_SLAB) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testinsmap(100, 65536, ts_algo_hash_bytes, TS_ALGO_MAP_SLAB) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testgetbatch(10, TS_ALGO_MAP_DEFAULT) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testgetbatch(10, TS_ALGO_MAP_SLAB) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testgetbatch(10, TS_ALGO_MAP_SLAB|TS_ALGO_MAP_STATS) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testcounting(10, TS_ALGO_MAP_SLAB) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testtiny(TS_ALGO_MAP_DEFAULT) != 0 ||
+	    testtiny(TS_ALGO_MAP_SMALL) != 0) {
 		fprintf(stderr, "FAILED!\n");
 		exit(1);
 	}
-	if (testinsmap(100, 65536, ts_algo_hash_id) != 0) {
+	if (testreserve(5, 0) != 0 || testreserve(5, 1) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testfromarray(5, 1) != 0 ||
+	    testfromarray(5, 2) != 0 ||
+	    testfromarray(5, 4) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testmerge(5, 0) != 0 || testmerge(5, 1) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testsnapshot(5, 0) != 0 || testsnapshot(5, 1) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testborrow(10, TS_ALGO_MAP_DEFAULT) != 0 ||
+	    testborrow(10, TS_ALGO_MAP_BORROW) != 0 ||
+	    testborrow(10, TS_ALGO_MAP_SLAB) != 0 ||
+	    testborrow(10, TS_ALGO_MAP_SLAB|TS_ALGO_MAP_BORROW) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testlatency(10, TS_ALGO_MAP_DEFAULT) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
+	if (testlatency(10, TS_ALGO_MAP_INCREMENTAL) != 0) {
 		fprintf(stderr, "FAILED!\n");
 		exit(1);
 	}
 #ifdef _CITY_ 
-	if (testinsmap(100, 32768, Hash64) != 0) {
+	if (testinsmap(100, 32768, Hash64, TS_ALGO_MAP_DEFAULT) != 0) {
 		fprintf(stderr, "FAILED!\n");
 		exit(1);
 	}
-	if (testinsmap(100, 65536, Hash64) != 0) {
+	if (testinsmap(100, 65536, Hash64, TS_ALGO_MAP_DEFAULT) != 0) {
 		fprintf(stderr, "FAILED!\n");
 		exit(1);
 	} 
+	if (testinsmap(100, 65536, Hash64, TS_ALGO_MAP_SLAB) != 0) {
+		fprintf(stderr, "FAILED!\n");
+		exit(1);
+	}
 #endif
 	destroystringbuf();
 	fprintf(stderr, "PASSED!\n");
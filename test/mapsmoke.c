@@ -5,6 +5,7 @@ extern "C" {
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <pthread.h>
 #include <tsalgo/map.h>
 #ifdef __cplusplus
 }
@@ -79,13 +80,13 @@ int testEmpty() {
 	return -1;
 }
 
-int testAddAndIter(uint32_t mapsz, ts_algo_hash_t hsh) {
+int testAddAndIter(uint32_t mapsz, ts_algo_hash_t hsh, uint32_t mode) {
 	ts_algo_map_it_t *it=NULL;
 	uint64_t *mem = NULL;
 	char err = 0;
 	srand(time(NULL));
 	bufinit();
-	ts_algo_map_t *map = ts_algo_map_new(mapsz, hsh, NULL);
+	ts_algo_map_t *map = ts_algo_map_newMode(mapsz, hsh, NULL, mode);
 	if (map == NULL) {
 		fprintf(stderr, "Can't creat map\n");
 		return -1;
@@ -220,17 +221,1243 @@ cleanup:
 	return -1;
 }
 
+uint64_t strhash(const char *key, size_t ksz, void *ignore) {
+	uint64_t h = 5381;
+	for(size_t i=0; i<ksz; i++) h = h*33 + key[i];
+	return h;
+}
+
+int testKeySizes(uint32_t mode) {
+	char key[256];
+	char err = 0;
+	uint64_t seed = rand();
+	ts_algo_map_t *map = ts_algo_map_newMode(16, ts_algo_hash_bytes, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	map->rsc = &seed;
+	// keys of all sizes from 1 to 255 (beyond TS_ALGO_MAP_SLABKEY)
+	memset(key, 'x', 256);
+	for(int i=1; i<256; i++) {
+		key[0] = (char)i;
+		if (ts_algo_map_add(map, key, i, buf+i%BUFSZ) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add key of size %d\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+	for(int i=1; i<256; i++) {
+		key[0] = (char)i;
+		if (ts_algo_map_get(map, key, i) != buf+i%BUFSZ) {
+			fprintf(stderr, "key of size %d not found\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+	for(int i=1; i<256; i+=2) {
+		key[0] = (char)i;
+		if (ts_algo_map_remove(map, key, i) != buf+i%BUFSZ) {
+			fprintf(stderr, "can't remove key of size %d\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->count != 127) {
+		fprintf(stderr, "wrong count: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+#define MANY 8192
+
+ts_algo_rc_t countslots(void *rsc, ts_algo_map_slot_t *s) {
+	uint64_t *d = s->data;
+	if (*d != *(uint64_t*)s->key) return TS_ALGO_ERR;
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+ts_algo_rc_t stopat10(void *rsc, ts_algo_map_slot_t *s) {
+	(*(uint32_t*)rsc)++;
+	if (*(uint32_t*)rsc == 10) return TS_ALGO_INVALID;
+	return TS_ALGO_OK;
+}
+
+int testGrowing(uint32_t mode) {
+	uint64_t *keys;
+	char err = 0;
+	ts_algo_map_t *map = ts_algo_map_newMode(8, strhash, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	keys = calloc(MANY, sizeof(uint64_t));
+	if (keys == NULL) {
+		fprintf(stderr, "No more memory\n");
+		ts_algo_map_destroy(map); free(map);
+		return -1;
+	}
+	// while the map grows, every operation
+	// must see all entries (in incremental mode
+	// these are distributed over two buffers)
+	for(uint32_t i=0; i<MANY; i++) {
+		keys[i] = i+1;
+		if (ts_algo_map_addId(map, keys[i], keys+i) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add %u\n", i);
+			err = 1; goto cleanup;
+		}
+		uint32_t k = rand()%(i+1);
+		void *d = ts_algo_map_getId(map, keys[k]);
+		if (keys[k] != 0 && d != keys+k) {
+			fprintf(stderr, "%u not found\n", k);
+			err = 1; goto cleanup;
+		}
+		if (keys[k] == 0 && d != NULL) {
+			fprintf(stderr, "removed %u found\n", k);
+			err = 1; goto cleanup;
+		}
+		if (keys[k] != 0 && rand()%4 == 0) {
+			if (ts_algo_map_removeId(map, keys[k]) != keys+k) {
+				fprintf(stderr, "Can't remove %u\n", k);
+				err = 1; goto cleanup;
+			}
+			keys[k] = 0;
+		}
+	}
+	// forEach sees all entries
+	// (even those not yet migrated)
+	{
+		uint32_t n = 0;
+		if (ts_algo_map_forEach(map, countslots, &n) != TS_ALGO_OK) {
+			fprintf(stderr, "forEach failed\n");
+			err = 1; goto cleanup;
+		}
+		if (n != map->count) {
+			fprintf(stderr, "forEach wrong count: %u | %u\n", n, map->count);
+			err = 1; goto cleanup;
+		}
+		n = 0;
+		if (ts_algo_map_forEach(map, stopat10, &n) != TS_ALGO_INVALID ||
+		    n != 10) {
+			fprintf(stderr, "forEach did not stop\n");
+			err = 1; goto cleanup;
+		}
+	}
+	for(uint32_t i=0; i<MANY; i++) {
+		uint64_t k = i+1;
+		void *d = ts_algo_map_getId(map, k);
+		if ((keys[i] == 0) != (d == NULL)) {
+			fprintf(stderr, "wrong result for %u\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+cleanup:
+	free(keys);
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+int testBatch(uint32_t mode) {
+	uint64_t *keys;
+	char    **kp;
+	size_t   *ksz;
+	void    **out;
+	char err = 0;
+	ts_algo_map_t *map = ts_algo_map_newMode(8, ts_algo_hash_u64, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	keys = calloc(MANY, sizeof(uint64_t));
+	kp   = calloc(MANY, sizeof(char*));
+	ksz  = calloc(MANY, sizeof(size_t));
+	out  = calloc(MANY, sizeof(void*));
+	if (keys == NULL || kp == NULL || ksz == NULL || out == NULL) {
+		fprintf(stderr, "No more memory\n");
+		err = 1; goto cleanup;
+	}
+	// the first half is added, the second half is not
+	for(uint32_t i=0; i<MANY; i++) {
+		keys[i] = i+1; kp[i] = (char*)(keys+i);
+		ksz[i] = sizeof(uint64_t); out[i] = keys+i;
+	}
+	if (ts_algo_map_addBatch(map, kp, ksz, out, MANY/2) != TS_ALGO_OK) {
+		fprintf(stderr, "Can't add batch\n");
+		err = 1; goto cleanup;
+	}
+	if (map->count != MANY/2) {
+		fprintf(stderr, "wrong count after addBatch: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+	// odd batch size
+	ts_algo_map_getBatch(map, kp, ksz, MANY-1, out);
+	for(uint32_t i=0; i<MANY-1; i++) {
+		if (out[i] != (i<MANY/2?keys+i:NULL)) {
+			fprintf(stderr, "wrong result for %u in batch\n", i);
+			err = 1; goto cleanup;
+		}
+		if (ts_algo_map_get(map, kp[i], ksz[i]) != out[i]) {
+			fprintf(stderr, "get and getBatch differ for %u\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+	// remove every key from MANY/4 to 3*MANY/4
+	ts_algo_map_removeBatch(map, kp+MANY/4, ksz+MANY/4, MANY/2, out);
+	for(uint32_t i=MANY/4; i<3*MANY/4; i++) {
+		if (out[i-MANY/4] != (i<MANY/2?keys+i:NULL)) {
+			fprintf(stderr, "wrong data removed for %u\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->count != MANY/4) {
+		fprintf(stderr, "wrong count after removeBatch: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_removeBatch(map, kp, ksz, MANY, NULL);
+	if (map->count != 0) {
+		fprintf(stderr, "map not empty: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	if (keys != NULL) free(keys);
+	if (kp != NULL) free(kp);
+	if (ksz != NULL) free(ksz);
+	if (out != NULL) free(out);
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Parallel build and visit
+ * ------------------------------------------------------------------------
+ */
+#define PARALLEL 100000
+
+ts_algo_rc_t sumslots(void *rsc, ts_algo_map_slot_t *s) {
+	uint64_t k = *(uint64_t*)s->key;
+	if (s->data == NULL || *(uint64_t*)s->data != k) return TS_ALGO_ERR;
+	__atomic_fetch_add((uint64_t*)rsc, k+1, __ATOMIC_RELAXED);
+	return TS_ALGO_OK;
+}
+
+ts_algo_rc_t failat777(void *rsc, ts_algo_map_slot_t *s) {
+	if (*(uint64_t*)s->key == 777) return TS_ALGO_INVALID;
+	return TS_ALGO_OK;
+}
+
+int checksum(ts_algo_map_t *map, uint64_t n, uint32_t nthreads) {
+	uint64_t sum = 0;
+	if (ts_algo_map_forEachPar(map, sumslots, &sum, nthreads) != TS_ALGO_OK) {
+		fprintf(stderr, "forEachPar failed\n");
+		return -1;
+	}
+	if (sum != n*(n+1)/2) {
+		fprintf(stderr, "wrong sum: %lu | %lu\n", sum, n*(n+1)/2);
+		return -1;
+	}
+	return 0;
+}
+
+int testFromArray(uint32_t mode, uint32_t nthreads) {
+	uint64_t *keys;
+	char    **kp;
+	size_t   *ksz;
+	char err = 0;
+	ts_algo_map_t *map = ts_algo_map_newMode(8, ts_algo_hash_u64, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	keys = calloc(PARALLEL, sizeof(uint64_t));
+	kp   = calloc(PARALLEL, sizeof(char*));
+	ksz  = calloc(PARALLEL, sizeof(size_t));
+	if (keys == NULL || kp == NULL || ksz == NULL) {
+		fprintf(stderr, "No more memory\n");
+		err = 1; goto cleanup;
+	}
+	// the data are the keys themselves
+	for(uint32_t i=0; i<PARALLEL; i++) {
+		keys[i] = i; kp[i] = (char*)(keys+i);
+		ksz[i] = sizeof(uint64_t);
+	}
+	// the map is not empty (and, in incremental mode, it is migrating)
+	if (ts_algo_map_addBatch(map, kp, ksz, (void**)kp, PARALLEL/5) != TS_ALGO_OK) {
+		fprintf(stderr, "Can't add batch\n");
+		err = 1; goto cleanup;
+	}
+	if (checksum(map, PARALLEL/5, nthreads) != 0) {
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_map_fromArray(map, kp+PARALLEL/5, ksz+PARALLEL/5,
+	                          (void**)kp+PARALLEL/5, PARALLEL-PARALLEL/5,
+	                          nthreads) != TS_ALGO_OK) {
+		fprintf(stderr, "Can't build from array\n");
+		err = 1; goto cleanup;
+	}
+	if (map->count != PARALLEL) {
+		fprintf(stderr, "wrong count after fromArray: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=0; k<PARALLEL; k++) {
+		if (ts_algo_map_getId(map, k) != keys+k) {
+			fprintf(stderr, "%lu not found after fromArray\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (checksum(map, PARALLEL, nthreads) != 0) {
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_map_forEachPar(map, failat777, NULL,
+	                           nthreads) != TS_ALGO_INVALID) {
+		fprintf(stderr, "forEachPar did not fail\n");
+		err = 1; goto cleanup;
+	}
+	// the entries were created by the workers and are released by the map
+	for(uint64_t k=0; k<PARALLEL; k+=2) {
+		if (ts_algo_map_removeId(map, k) != keys+k) {
+			fprintf(stderr, "can't remove %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->count != PARALLEL/2) {
+		fprintf(stderr, "wrong count after remove: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	if (keys != NULL) free(keys);
+	if (kp != NULL) free(kp);
+	if (ksz != NULL) free(ksz);
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Merge and intersect: the keys of dst are 0..SETSZ-1 with data in dvals,
+ * the keys of src are SETSZ/2..3*SETSZ/2-1 with data in svals
+ * ------------------------------------------------------------------------
+ */
+#define SETSZ 20000
+
+uint64_t dvals[2*SETSZ];
+uint64_t svals[2*SETSZ];
+uint32_t dropped = 0;
+
+void countdrop(void *ignore, void **data) {
+	dropped++;
+}
+
+ts_algo_map_t *makeset(uint64_t from, uint64_t to, uint64_t *vals,
+                       ts_algo_hash_t hsh, uint32_t mode) {
+	ts_algo_map_t *map = ts_algo_map_newMode(8, hsh, countdrop, mode);
+	if (map == NULL) return NULL;
+	for(uint64_t k=from; k<to; k++) {
+		if (ts_algo_map_addId(map, k, vals+k) != TS_ALGO_OK) {
+			ts_algo_map_destroy(map); free(map);
+			return NULL;
+		}
+	}
+	return map;
+}
+
+int testMerge(uint32_t dmode, uint32_t smode, ts_algo_hash_t shsh,
+              uint32_t policy, uint32_t nthreads) {
+	char err = 0;
+	ts_algo_map_t *dst = makeset(0, SETSZ, dvals, ts_algo_hash_u64, dmode);
+	ts_algo_map_t *src = makeset(SETSZ/2, 3*SETSZ/2, svals, shsh, smode);
+	if (dst == NULL || src == NULL) {
+		fprintf(stderr, "Can't creat maps\n");
+		err = 1; goto cleanup;
+	}
+	dropped = 0;
+	if (ts_algo_map_merge(dst, src, policy, nthreads) != TS_ALGO_OK) {
+		fprintf(stderr, "merge failed\n");
+		err = 1; goto cleanup;
+	}
+	if (dst->count != 3*SETSZ/2 || src->count != 0 || dropped != SETSZ/2) {
+		fprintf(stderr, "wrong counts after merge: %u, %u, %u\n",
+		                dst->count, src->count, dropped);
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=0; k<3*SETSZ/2; k++) {
+		uint64_t *d = ts_algo_map_getId(dst, k);
+		uint64_t *x = k<SETSZ/2 ? dvals+k :
+		              k>=SETSZ  ? svals+k :
+		              policy == TS_ALGO_MAP_KEEP ? dvals+k : svals+k;
+		if (d != x || ts_algo_map_getId(src, k) != NULL) {
+			fprintf(stderr, "wrong data after merge for %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	// the moved entries can be removed from dst
+	for(uint64_t k=0; k<3*SETSZ/2; k+=3) {
+		if (ts_algo_map_removeId(dst, k) == NULL) {
+			fprintf(stderr, "can't remove %lu after merge\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	// src is still usable
+	for(uint64_t k=0; k<SETSZ; k++) {
+		if (ts_algo_map_addId(src, k, svals+k) != TS_ALGO_OK) {
+			fprintf(stderr, "can't add %lu after merge\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+cleanup:
+	if (dst != NULL) {
+		ts_algo_map_destroy(dst); free(dst);
+	}
+	if (src != NULL) {
+		ts_algo_map_destroy(src); free(src);
+	}
+	return err?-1:0;
+}
+
+int testIntersect(uint32_t mode, ts_algo_hash_t shsh, uint32_t nthreads) {
+	char err = 0;
+	ts_algo_map_t *dst = makeset(0, SETSZ, dvals, ts_algo_hash_u64, mode);
+	ts_algo_map_t *src = makeset(SETSZ/2, 3*SETSZ/2, svals, shsh, mode);
+	if (dst == NULL || src == NULL) {
+		fprintf(stderr, "Can't creat maps\n");
+		err = 1; goto cleanup;
+	}
+	dropped = 0;
+	if (ts_algo_map_intersect(dst, src, nthreads) != TS_ALGO_OK) {
+		fprintf(stderr, "intersect failed\n");
+		err = 1; goto cleanup;
+	}
+	if (dst->count != SETSZ/2 || src->count != SETSZ || dropped != SETSZ/2) {
+		fprintf(stderr, "wrong counts after intersect: %u, %u, %u\n",
+		                dst->count, src->count, dropped);
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=0; k<3*SETSZ/2; k++) {
+		if (ts_algo_map_getId(dst, k) != (k>=SETSZ/2 && k<SETSZ?dvals+k:NULL)) {
+			fprintf(stderr, "wrong data after intersect for %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+cleanup:
+	if (dst != NULL) {
+		ts_algo_map_destroy(dst); free(dst);
+	}
+	if (src != NULL) {
+		ts_algo_map_destroy(src); free(src);
+	}
+	return err?-1:0;
+}
+
+uint64_t consthash(const char *key, size_t ksz, void *ignore) {
+	return 42;
+}
+
+int testCollisions(uint32_t mode) {
+	char *keys[] = {"a", "ab", "abc", "abd", "abcd", "b", "ba"};
+	char err = 0;
+	ts_algo_map_t *map = ts_algo_map_newMode(8, consthash, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	// all keys have the same hash; keys are prefixes of each other
+	for(int i=0; i<7; i++) {
+		if (ts_algo_map_add(map, keys[i], strlen(keys[i]), keys[i]) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add %s\n", keys[i]);
+			err = 1; goto cleanup;
+		}
+	}
+	for(int i=0; i<7; i++) {
+		if (ts_algo_map_get(map, keys[i], strlen(keys[i])) != keys[i]) {
+			fprintf(stderr, "wrong result for %s\n", keys[i]);
+			err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_map_get(map, "abce", 4) != NULL ||
+	    ts_algo_map_get(map, "abcde", 5) != NULL) {
+		fprintf(stderr, "found key not in the map\n");
+		err = 1; goto cleanup;
+	}
+	for(int i=0; i<7; i+=2) {
+		if (ts_algo_map_remove(map, keys[i], strlen(keys[i])) != keys[i]) {
+			fprintf(stderr, "can't remove %s\n", keys[i]);
+			err = 1; goto cleanup;
+		}
+	}
+	for(int i=0; i<7; i++) {
+		if (ts_algo_map_get(map, keys[i], strlen(keys[i])) != (i%2?keys[i]:NULL)) {
+			fprintf(stderr, "wrong result after remove for %s\n", keys[i]);
+			err = 1; goto cleanup;
+		}
+	}
+cleanup:
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+#define DISTINCT 1000
+
+int testUpsert(uint32_t mode) {
+	uint32_t counts[DISTINCT];
+	char err = 0;
+	char inserted;
+	void *old;
+	ts_algo_map_t *map = ts_algo_map_newMode(8, ts_algo_hash_u64, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	// count occurrences: the data is the counter itself
+	memset(counts, 0, sizeof(counts));
+	for(int i=0; i<10*DISTINCT; i++) {
+		uint64_t k = rand()%DISTINCT;
+		ts_algo_map_slot_t *s = ts_algo_map_getOrInsertId(map, k, NULL, &inserted);
+		if (s == NULL) {
+			fprintf(stderr, "getOrInsert failed\n");
+			err = 1; goto cleanup;
+		}
+		if (inserted != (counts[k] == 0)) {
+			fprintf(stderr, "wrong inserted flag for %lu\n", k);
+			err = 1; goto cleanup;
+		}
+		s->data = (void*)((uint64_t)s->data+1);
+		counts[k]++;
+	}
+	for(uint64_t k=0; k<DISTINCT; k++) {
+		void *d = ts_algo_map_getId(map, k);
+		if ((uint64_t)d != counts[k]) {
+			fprintf(stderr, "wrong count for %lu: %lu\n", k, (uint64_t)d);
+			err = 1; goto cleanup;
+		}
+	}
+	// upsert replaces existing and adds new keys
+	for(uint64_t k=0; k<2*DISTINCT; k++) {
+		if (ts_algo_map_upsertId(map, k, (void*)(k+1), &old) != TS_ALGO_OK) {
+			fprintf(stderr, "upsert failed\n");
+			err = 1; goto cleanup;
+		}
+		if ((uint64_t)old != (k<DISTINCT?counts[k]:0)) {
+			fprintf(stderr, "wrong old value for %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->count != 2*DISTINCT) {
+		fprintf(stderr, "wrong count after upsert: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=0; k<2*DISTINCT; k++) {
+		if ((uint64_t)ts_algo_map_getId(map, k) != k+1) {
+			fprintf(stderr, "wrong value after upsert for %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+cleanup:
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+#define RESERVE 100000
+
+int testCapacity(uint32_t mode) {
+	char err = 0;
+	ts_algo_map_t *map = ts_algo_map_newMode(64, ts_algo_hash_u64, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	if (ts_algo_map_reserve(map, RESERVE) != TS_ALGO_OK) {
+		fprintf(stderr, "Can't reserve\n");
+		err = 1; goto cleanup;
+	}
+	uint32_t sz = map->curSize;
+	for(uint64_t k=0; k<RESERVE; k++) {
+		if (ts_algo_map_addId(map, k, (void*)(k+1)) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->curSize != sz) {
+		fprintf(stderr, "map grew after reserve: %u -> %u\n", sz, map->curSize);
+		err = 1; goto cleanup;
+	}
+	// remove all but 100 elements
+	for(uint64_t k=100; k<RESERVE; k++) {
+		if (ts_algo_map_removeId(map, k) != (void*)(k+1)) {
+			fprintf(stderr, "Can't remove %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (mode & TS_ALGO_MAP_SHRINK) {
+		if (map->curSize > sz>>2) {
+			fprintf(stderr, "map did not shrink: %u\n", map->curSize);
+			err = 1; goto cleanup;
+		}
+	} else if (map->curSize != sz) {
+		fprintf(stderr, "map shrunk: %u -> %u\n", sz, map->curSize);
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_map_shrink(map) != TS_ALGO_OK) {
+		fprintf(stderr, "Can't shrink\n");
+		err = 1; goto cleanup;
+	}
+	if (map->curSize != (map->baseSize>100?map->baseSize:100) ||
+	    map->old != NULL) {
+		fprintf(stderr, "wrong size after shrink: %u\n", map->curSize);
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=0; k<RESERVE; k++) {
+		if (ts_algo_map_getId(map, k) != (k<100?(void*)(k+1):NULL)) {
+			fprintf(stderr, "wrong result after shrink for %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+cleanup:
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Statistics
+ * ------------------------------------------------------------------------
+ */
+#define STATSZ 10000
+
+int checkhisto(ts_algo_map_stats_t *stats) {
+	uint32_t b = 0, n = 0;
+	for(int i=0; i<TS_ALGO_MAP_HISTO; i++) {
+		b += stats->histo[i];
+		n += i*stats->histo[i];
+	}
+	if (b != stats->buckets || n > stats->count ||
+	   (stats->maxchain < TS_ALGO_MAP_HISTO-1 && n != stats->count)) {
+		fprintf(stderr, "wrong histogram: %u/%u buckets, %u/%u elements\n",
+		                b, stats->buckets, n, stats->count);
+		return -1;
+	}
+	return 0;
+}
+
+int testStats(uint32_t mode) {
+	char err = 0;
+	ts_algo_map_stats_t stats;
+	ts_algo_map_t *map = ts_algo_map_newMode(64, ts_algo_hash_u64, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	for(uint64_t k=0; k<STATSZ; k++) {
+		if (ts_algo_map_addId(map, k, (void*)(k+1)) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	for(uint64_t k=0; k<STATSZ; k++) {
+		if (ts_algo_map_getId(map, k) != (void*)(k+1)) {
+			fprintf(stderr, "Can't get %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	ts_algo_map_stats(map, &stats);
+	if (stats.count != STATSZ || stats.resizes == 0 ||
+	    stats.load != (double)STATSZ/stats.buckets) {
+		fprintf(stderr, "wrong stats: %u, %u, %f\n",
+		        stats.count, stats.resizes, stats.load);
+		err = 1; goto cleanup;
+	}
+	if (checkhisto(&stats) != 0) {
+		err = 1; goto cleanup;
+	}
+	if (mode & TS_ALGO_MAP_STATS) {
+		if (stats.lookups != STATSZ || stats.probes < STATSZ ||
+		    (double)stats.probes/stats.lookups > 1+stats.load) {
+			fprintf(stderr, "wrong lookups/probes: %lu/%lu\n",
+			        stats.lookups, stats.probes);
+			err = 1; goto cleanup;
+		}
+	} else if (stats.lookups != 0 || stats.probes != 0) {
+		fprintf(stderr, "lookups counted without stats mode\n");
+		err = 1; goto cleanup;
+	}
+	if (stats.mem < stats.buckets*sizeof(ts_algo_list_t) +
+	                STATSZ*sizeof(ts_algo_map_slot_t)) {
+		fprintf(stderr, "memory too small: %zu\n", stats.mem);
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_resetStats(map);
+	for(uint64_t k=0; k<STATSZ; k++) {
+		if (ts_algo_map_removeId(map, k) != (void*)(k+1)) {
+			fprintf(stderr, "Can't remove %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	// all entries outside slabs are released
+	if (map->mem != 0) {
+		fprintf(stderr, "memory left: %zu\n", map->mem);
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_stats(map, &stats);
+	if (stats.count != 0 || stats.maxchain != 0 ||
+	    stats.histo[0] != stats.buckets) {
+		fprintf(stderr, "map not empty\n");
+		err = 1; goto cleanup;
+	}
+	if (mode & TS_ALGO_MAP_STATS && stats.lookups != STATSZ) {
+		fprintf(stderr, "wrong lookups after reset: %lu\n", stats.lookups);
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_destroy(map); free(map);
+
+	// a bad hash function shows
+	map = ts_algo_map_newMode(64, consthash, NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	for(uint64_t k=0; k<100; k++) {
+		if (ts_algo_map_addId(map, k, (void*)(k+1)) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	ts_algo_map_stats(map, &stats);
+	if (stats.maxchain != 100 || stats.histo[TS_ALGO_MAP_HISTO-1] != 1 ||
+	    checkhisto(&stats) != 0) {
+		fprintf(stderr, "bad hash not detected: %u\n", stats.maxchain);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Small representation
+ * ------------------------------------------------------------------------
+ */
+int checksmall(ts_algo_map_t *map, uint64_t n) {
+	uint32_t k = 0;
+	for(uint64_t i=0; i<2*TS_ALGO_MAP_SMALLSZ; i++) {
+		if (ts_algo_map_getId(map, i) != (i<n?(void*)(i+1):NULL)) {
+			fprintf(stderr, "wrong result for %lu of %lu\n", i, n);
+			return -1;
+		}
+	}
+	ts_algo_map_it_t *it = ts_algo_map_iterate(map);
+	if (it == NULL) return -1;
+	for(; !ts_algo_map_it_eof(it); ts_algo_map_it_advance(it)) {
+		ts_algo_map_slot_t *s = ts_algo_map_it_get(it);
+		if (s == NULL || *(uint64_t*)s->key >= n) {
+			fprintf(stderr, "wrong slot\n");
+			free(it); return -1;
+		}
+		k++;
+	}
+	free(it);
+	if (k != n || map->count != n) {
+		fprintf(stderr, "wrong count: %u | %u | %lu\n", k, map->count, n);
+		return -1;
+	}
+	return 0;
+}
+
+int testSmall(uint32_t mode) {
+	char err = 0;
+	uint64_t k;
+	ts_algo_map_stats_t stats;
+	ts_algo_map_t *map = ts_algo_map_newMode(64, ts_algo_hash_u64, NULL,
+	                                         mode|TS_ALGO_MAP_SMALL);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	for(k=0; k<TS_ALGO_MAP_SMALLSZ; k++) {
+		if (ts_algo_map_addId(map, k, (void*)(k+1)) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (map->curSize != 1) {
+		fprintf(stderr, "small map grew: %u\n", map->curSize);
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_stats(map, &stats);
+	if (stats.buckets != 1 || stats.maxchain != TS_ALGO_MAP_SMALLSZ) {
+		fprintf(stderr, "wrong small stats: %u, %u\n",
+		                stats.buckets, stats.maxchain);
+		err = 1; goto cleanup;
+	}
+	if (checksmall(map, k) != 0) {
+		err = 1; goto cleanup;
+	}
+	// one more and the map switches to the hashed layout
+	if (ts_algo_map_addId(map, k, (void*)(k+1)) != TS_ALGO_OK) {
+		fprintf(stderr, "Can't add %lu\n", k);
+		err = 1; goto cleanup;
+	}
+	k++;
+	if (map->curSize != 64 || checksmall(map, k) != 0) {
+		fprintf(stderr, "small map did not grow: %u\n", map->curSize);
+		err = 1; goto cleanup;
+	}
+	// remove down to half of the small size
+	while(k>TS_ALGO_MAP_SMALLSZ/2) {
+		k--;
+		if (ts_algo_map_removeId(map, k) != (void*)(k+1)) {
+			fprintf(stderr, "Can't remove %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (checksmall(map, k) != 0) {
+		err = 1; goto cleanup;
+	}
+	if ((mode & TS_ALGO_MAP_SHRINK) && map->curSize != 1) {
+		fprintf(stderr, "map did not return to small: %u\n", map->curSize);
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_map_shrink(map) != TS_ALGO_OK || map->curSize != 1 ||
+	    checksmall(map, k) != 0) {
+		fprintf(stderr, "map did not shrink to small: %u\n", map->curSize);
+		err = 1; goto cleanup;
+	}
+	// reserving a small number keeps the map small
+	if (ts_algo_map_reserve(map, TS_ALGO_MAP_SMALLSZ) != TS_ALGO_OK ||
+	    map->curSize != 1) {
+		fprintf(stderr, "reserve left small mode: %u\n", map->curSize);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Borrowed keys: the key is a field of the record stored in the map
+ * ------------------------------------------------------------------------
+ */
+typedef struct {
+	uint64_t  val;
+	size_t    ksz;
+	char  key[200]; // longer than TS_ALGO_MAP_SLABKEY
+} record_t;
+
+#define RECORDS 1000
+
+void freerecord(void *ignore, void **rec) {
+	free(*rec);
+}
+
+// every tenth key is bigger than TS_ALGO_MAP_SLABKEY
+size_t makekey(char *key, int i) {
+	memset(key, 'k', 200);
+	size_t s = sprintf(key, "key%d", i);
+	return i%10 == 0 ? 200 : s;
+}
+
+record_t *newrecord(int i, uint64_t val) {
+	record_t *r = malloc(sizeof(record_t));
+	if (r == NULL) return NULL;
+	r->val = val;
+	r->ksz = makekey(r->key, i);
+	return r;
+}
+
+int testBorrow(uint32_t mode) {
+	char err = 0;
+	char key[200];
+	ts_algo_map_stats_t s1, s2;
+	ts_algo_map_t *copied = ts_algo_map_newMode(64, NULL, NULL, mode);
+	ts_algo_map_t *map = ts_algo_map_newMode(64, NULL, freerecord,
+	                                         mode|TS_ALGO_MAP_BORROW);
+	if (map == NULL || copied == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		free(map); free(copied);
+		return -1;
+	}
+	for(int i=0; i<RECORDS; i++) {
+		record_t *r = newrecord(i, i);
+		if (r == NULL) {
+			err = 1; goto cleanup;
+		}
+		if (ts_algo_map_add(map, r->key, r->ksz, r) != TS_ALGO_OK ||
+		    ts_algo_map_add(copied, r->key, r->ksz, r) != TS_ALGO_OK) {
+			fprintf(stderr, "Can't add record %d\n", i);
+			err = 1; goto cleanup;
+		}
+		if (ts_algo_map_get(map, r->key, r->ksz) != r) {
+			err = 1; goto cleanup;
+		}
+	}
+	// the map stores the key of the record, not a copy
+	for(int i=0; i<RECORDS; i++) {
+		record_t *r = ts_algo_map_get(copied, key, makekey(key, i));
+		if (r == NULL) {
+			fprintf(stderr, "record %d not found\n", i);
+			err = 1; goto cleanup;
+		}
+		ts_algo_map_slot_t *sl = ts_algo_map_getOrInsert(map, r->key, r->ksz,
+		                                                 NULL, NULL);
+		if (sl == NULL || sl->data != r || sl->key != r->key) {
+			fprintf(stderr, "key of record %d not borrowed\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+	ts_algo_map_stats(map, &s1);
+	ts_algo_map_stats(copied, &s2);
+	if (s1.mem >= s2.mem) {
+		fprintf(stderr, "borrowing keys does not save memory: %zu | %zu\n",
+		                s1.mem, s2.mem);
+		err = 1; goto cleanup;
+	}
+	// update replaces the record and the key with it
+	for(int i=0; i<RECORDS; i+=2) {
+		record_t *r = newrecord(i, i+1);
+		if (r == NULL) {
+			err = 1; goto cleanup;
+		}
+		record_t *o = ts_algo_map_update(map, r->key, r->ksz, r);
+		if (o == NULL || o->val != (uint64_t)i) {
+			fprintf(stderr, "Can't update record %d\n", i);
+			free(r); err = 1; goto cleanup;
+		}
+		if (ts_algo_map_remove(copied, o->key, o->ksz) != o) {
+			fprintf(stderr, "Can't remove record %d\n", i);
+			err = 1; goto cleanup;
+		}
+		memset(o, 0, sizeof(record_t)); free(o);
+	}
+	// remove the odd records
+	for(int i=1; i<RECORDS; i+=2) {
+		record_t *r = ts_algo_map_remove(copied, key, makekey(key, i));
+		if (r == NULL || ts_algo_map_remove(map, r->key, r->ksz) != r) {
+			fprintf(stderr, "Can't remove record %d\n", i);
+			err = 1; goto cleanup;
+		}
+		free(r);
+	}
+	if (map->count != RECORDS/2 || copied->count != 0) {
+		fprintf(stderr, "wrong count: %u | %u\n", map->count, copied->count);
+		err = 1; goto cleanup;
+	}
+	for(int i=0; i<RECORDS; i+=2) {
+		record_t *r = ts_algo_map_get(map, key, makekey(key, i));
+		if (r == NULL || r->val != (uint64_t)i+1) {
+			fprintf(stderr, "record %d not updated\n", i);
+			err = 1; goto cleanup;
+		}
+	}
+	// a borrowing map can't take over copied keys
+	if (ts_algo_map_merge(map, copied, TS_ALGO_MAP_KEEP, 0) != TS_ALGO_INVALID) {
+		fprintf(stderr, "borrowing map merged copied keys\n");
+		err = 1; goto cleanup;
+	}
+cleanup:
+	// the records are released by the borrowing map
+	ts_algo_map_destroy(copied); free(copied);
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Snapshots: the keys are 0..SNAPSZ-1 with data snapvals+k;
+ * the writer removes the even keys, updates the odd keys
+ * to snapvals+SNAPSZ+k and adds the keys SNAPSZ..2*SNAPSZ-1
+ * ------------------------------------------------------------------------
+ */
+#define SNAPSZ 10000
+
+uint64_t snapvals[3*SNAPSZ];
+uint64_t snapkeys[2*SNAPSZ]; // keys that can be borrowed
+
+ts_algo_rc_t countsnap(void *rsc, ts_algo_map_slot_t *s) {
+	uint64_t k = *(uint64_t*)s->key;
+	if (k >= SNAPSZ || s->data != snapvals+k) return TS_ALGO_ERR;
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+// the snapshot still shows the original keys and data
+int checksnap(ts_algo_map_snap_t *snap) {
+	uint32_t n = 0;
+	if (snap->count != SNAPSZ) {
+		fprintf(stderr, "wrong snapshot count: %u\n", snap->count);
+		return -1;
+	}
+	for(uint64_t k=0; k<2*SNAPSZ; k++) {
+		if (ts_algo_map_snapGetId(snap, k) != (k<SNAPSZ?snapvals+k:NULL)) {
+			fprintf(stderr, "snapshot changed for %lu\n", k);
+			return -1;
+		}
+	}
+	if (ts_algo_map_snapForEach(snap, countsnap, &n) != TS_ALGO_OK ||
+	    n != SNAPSZ) {
+		fprintf(stderr, "wrong slots in snapshot: %u\n", n);
+		return -1;
+	}
+	return 0;
+}
+
+// the map shows the changes of the writer up to key 'upto'
+int checkwriter(ts_algo_map_t *map, uint64_t upto) {
+	for(uint64_t k=0; k<upto; k++) {
+		uint64_t *d = ts_algo_map_getId(map, k);
+		uint64_t *x = k>=SNAPSZ ? snapvals+SNAPSZ+k :
+		              k%2 == 0  ? NULL : snapvals+SNAPSZ+k;
+		if (d != x) {
+			fprintf(stderr, "wrong data in map for %lu\n", k);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// remove the even keys and update the odd ones
+int changemap(ts_algo_map_t *map) {
+	for(uint64_t k=0; k<SNAPSZ; k++) {
+		void *d = k%2 == 0 ? ts_algo_map_removeId(map, snapkeys[k]) :
+		          ts_algo_map_updateId(map, snapkeys[k], snapvals+SNAPSZ+k);
+		if (d != snapvals+k) {
+			fprintf(stderr, "can't change %lu\n", k);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// add the keys SNAPSZ..2*SNAPSZ-1 (the map grows)
+int growmap(ts_algo_map_t *map) {
+	for(uint64_t k=SNAPSZ; k<2*SNAPSZ; k++) {
+		if (ts_algo_map_addId(map, snapkeys[k],
+		                      snapvals+SNAPSZ+k) != TS_ALGO_OK) {
+			fprintf(stderr, "can't add %lu\n", k);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+typedef struct {
+	ts_algo_map_snap_t *snap;
+	char               *done;
+	int                  err;
+} reader_t;
+
+void *reader(void *arg) {
+	reader_t *r = arg;
+	do {
+		if (checksnap(r->snap) != 0) {
+			r->err = 1; break;
+		}
+	} while(!__atomic_load_n(r->done, __ATOMIC_ACQUIRE));
+	return NULL;
+}
+
+int testSnapshot(uint32_t mode) {
+	char err = 0;
+	char done = 0;
+	pthread_t tid;
+	uint64_t k1 = 1;
+	ts_algo_map_snap_t snap, snap2;
+	reader_t r = {&snap, &done, 0};
+
+	snap.buf = NULL; snap2.buf = NULL;
+	ts_algo_map_t *map = ts_algo_map_newMode(SNAPSZ/4, ts_algo_hash_u64,
+	                                         NULL, mode);
+	if (map == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		return -1;
+	}
+	for(uint64_t k=0; k<2*SNAPSZ; k++) snapkeys[k] = k;
+	for(uint64_t k=0; k<SNAPSZ; k++) {
+		if (ts_algo_map_addId(map, snapkeys[k], snapvals+k) != TS_ALGO_OK) {
+			fprintf(stderr, "can't add %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	// the writer changes every bucket while the snapshot is attached
+	if (ts_algo_map_snapshot(map, &snap) != TS_ALGO_OK) {
+		fprintf(stderr, "can't take snapshot\n");
+		err = 1; goto cleanup;
+	}
+	if (changemap(map) != 0 || checksnap(&snap) != 0 ||
+	    checkwriter(map, SNAPSZ) != 0) {
+		ts_algo_map_release(&snap);
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_release(&snap);
+	if (map->count != SNAPSZ/2 || checkwriter(map, SNAPSZ) != 0) {
+		fprintf(stderr, "map changed by release: %u\n", map->count);
+		err = 1; goto cleanup;
+	}
+	// restore the original map, take a snapshot and release it unchanged
+	for(uint64_t k=0; k<SNAPSZ; k++) {
+		if (ts_algo_map_upsertId(map, snapkeys[k],
+		                         snapvals+k, NULL) != TS_ALGO_OK) {
+			err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_map_snapshot(map, &snap) != TS_ALGO_OK) {
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_release(&snap);
+	if (ts_algo_map_snapshot(map, &snap) != TS_ALGO_OK) {
+		err = 1; goto cleanup;
+	}
+	// a reader checks the snapshot while the writer changes and grows
+	// the map (which detaches the snapshot)
+	if (pthread_create(&tid, NULL, reader, &r) != 0) {
+		ts_algo_map_release(&snap);
+		err = 1; goto cleanup;
+	}
+	if (changemap(map) != 0 || growmap(map) != 0) err = 1;
+	// taking a second snapshot detaches nothing (already detached)
+	if (!err && ts_algo_map_snapshot(map, &snap2) != TS_ALGO_OK) err = 1;
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	pthread_join(tid, NULL);
+	if (err || r.err || checksnap(&snap) != 0 ||
+	    checkwriter(map, 2*SNAPSZ) != 0) {
+		ts_algo_map_release(&snap);
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_release(&snap);
+	if (snap.buf != NULL || snap.count != 0) {
+		fprintf(stderr, "snapshot not released\n");
+		err = 1; goto cleanup;
+	}
+	// the second snapshot is still attached while the map changes
+	for(uint64_t k=1; k<SNAPSZ; k+=2) {
+		if (ts_algo_map_removeId(map, snapkeys[k]) != snapvals+SNAPSZ+k) {
+			fprintf(stderr, "can't remove %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (snap2.count != SNAPSZ+SNAPSZ/2 ||
+	    ts_algo_map_snapGetId(&snap2, k1) != snapvals+SNAPSZ+k1) {
+		fprintf(stderr, "second snapshot wrong\n");
+		err = 1; goto cleanup;
+	}
+cleanup:
+	// snapshots are released before the map is destroyed
+	// (releasing a released snapshot has no effect)
+	ts_algo_map_release(&snap2);
+	ts_algo_map_release(&snap);
+	if (map->cow != NULL) {
+		fprintf(stderr, "snapshot still attached\n");
+		err = 1;
+	}
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * A map with snapshots not yet released is not merged
+ * ------------------------------------------------------------------------
+ */
+int testSnapMerge(uint32_t mode) {
+	char err = 0;
+	uint64_t keys[100];
+	ts_algo_map_snap_t snap, snap2;
+	ts_algo_map_t *src = ts_algo_map_newMode(0, ts_algo_hash_u64, NULL, mode);
+	ts_algo_map_t *dst = ts_algo_map_newMode(0, ts_algo_hash_u64, NULL, mode);
+
+	snap.buf = NULL; snap2.buf = NULL;
+	if (src == NULL || dst == NULL) {
+		fprintf(stderr, "Can't creat map\n");
+		if (src != NULL) free(src);
+		if (dst != NULL) free(dst);
+		return -1;
+	}
+	for(uint64_t k=0; k<100; k++) {
+		keys[k] = k;
+		if (ts_algo_map_addId(src, keys[k], keys+k) != TS_ALGO_OK) {
+			fprintf(stderr, "can't add %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	// the first snapshot sees entries the map no longer has
+	// and is detached by the second one
+	if (ts_algo_map_snapshot(src, &snap) != TS_ALGO_OK) {
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=0; k<100; k+=2) {
+		if (ts_algo_map_removeId(src, keys[k]) != keys+k) {
+			fprintf(stderr, "can't remove %lu\n", k);
+			err = 1; goto cleanup;
+		}
+	}
+	if (ts_algo_map_snapshot(src, &snap2) != TS_ALGO_OK) {
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_map_merge(dst, src, TS_ALGO_MAP_KEEP, 1) != TS_ALGO_INVALID) {
+		fprintf(stderr, "merged map with snapshots\n");
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_release(&snap2);
+	if (ts_algo_map_merge(dst, src, TS_ALGO_MAP_KEEP, 1) != TS_ALGO_INVALID) {
+		fprintf(stderr, "merged map with detached snapshot\n");
+		err = 1; goto cleanup;
+	}
+	ts_algo_map_release(&snap);
+	if (ts_algo_map_merge(dst, src, TS_ALGO_MAP_KEEP, 1) != TS_ALGO_OK) {
+		fprintf(stderr, "can't merge after release\n");
+		err = 1; goto cleanup;
+	}
+	if (dst->count != 50 || src->count != 0 ||
+	    ts_algo_map_getId(dst, keys[1]) != keys+1) {
+		fprintf(stderr, "wrong merge after release: %u | %u\n",
+		                dst->count, src->count);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_map_release(&snap2);
+	ts_algo_map_release(&snap);
+	ts_algo_map_destroy(src); free(src);
+	ts_algo_map_destroy(dst); free(dst);
+	return err?-1:0;
+}
+
 int main() {
 	if (testEmpty() != 0) exit(1);
+	for(uint32_t mode=0;
+	    mode<=(TS_ALGO_MAP_SLAB|TS_ALGO_MAP_INCREMENTAL|
+	           TS_ALGO_MAP_SHRINK); mode++)
 	for(int i=0;i<100;i++) {
+		if (i == 0 && testCapacity(mode) != 0) exit(1);
+		if (i == 0 && testStats(mode) != 0) exit(1);
+		if (i == 0 && testStats(mode|TS_ALGO_MAP_STATS) != 0) exit(1);
+		if (i == 0 && testSmall(mode) != 0) exit(1);
+		if (i == 0 && testBorrow(mode) != 0) exit(1);
+		if (i == 0 && testSnapshot(mode) != 0) exit(1);
+		if (i == 0 && testSnapshot(mode|TS_ALGO_MAP_BORROW) != 0) exit(1);
+		if (i == 0 && testSnapMerge(mode) != 0) exit(1);
+		if (i == 0 && testFromArray(mode, 0) != 0) exit(1);
+		if (i == 0 && testFromArray(mode, 4) != 0) exit(1);
+		if (i == 0 && testFromArray(mode, 1) != 0) exit(1);
+		for(uint32_t t=0; i==0 && t<=4; t+=4) {
+			if (testMerge(mode, mode, ts_algo_hash_u64,
+			              TS_ALGO_MAP_KEEP, t) != 0) exit(1);
+			if (testMerge(mode, mode, ts_algo_hash_bytes,
+			              TS_ALGO_MAP_REPLACE, t) != 0) exit(1);
+			if (testMerge(mode, mode^TS_ALGO_MAP_SLAB, ts_algo_hash_u64,
+			              TS_ALGO_MAP_REPLACE, t) != 0) exit(1);
+			if (testIntersect(mode, ts_algo_hash_u64, t) != 0) exit(1);
+			if (testIntersect(mode, ts_algo_hash_bytes, t) != 0) exit(1);
+		}
+		if (i == 0 && testAddAndIter(0, ts_algo_hash_u64,
+		                   mode|TS_ALGO_MAP_SMALL) != 0) exit(1);
+		if (testGrowing(mode) != 0) exit(1);
+		if (testKeySizes(mode) != 0) exit(1);
+		if (testBatch(mode) != 0) exit(1);
+		if (testCollisions(mode) != 0) exit(1);
+		if (testUpsert(mode) != 0) exit(1);
 		// fprintf(stderr, "Iteration %d\n", i);
-		if (testAddAndIter(0, ts_algo_hash_id) != 0) exit(1);
-		if (testAddAndIter(256, ts_algo_hash_id) != 0) exit(1);
-		if (testAddAndIter(32, ts_algo_hash_id) != 0) exit(1);
+		if (testAddAndIter(0, ts_algo_hash_id, mode) != 0) exit(1);
+		if (testAddAndIter(256, ts_algo_hash_id, mode) != 0) exit(1);
+		if (testAddAndIter(32, ts_algo_hash_id, mode) != 0) exit(1);
+		if (testAddAndIter(0, ts_algo_hash_u64, mode) != 0) exit(1);
+		if (testAddAndIter(32, NULL, mode) != 0) exit(1);
 #ifdef _CITY_
-		if (testAddAndIter(0, Hash64) != 0) exit(1);
-		if (testAddAndIter(256, Hash64) != 0) exit(1);
-		if (testAddAndIter(32, Hash64) != 0) exit(1);
+		if (testAddAndIter(0, Hash64, mode) != 0) exit(1);
+		if (testAddAndIter(256, Hash64, mode) != 0) exit(1);
+		if (testAddAndIter(32, Hash64, mode) != 0) exit(1);
 #endif
 	}
 	fprintf(stderr, "SUCCESS!\n");
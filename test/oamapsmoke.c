@@ -0,0 +1,219 @@
+/* ========================================================================
+ * Test Open Addressing Map
+ * ------------------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tsalgo/oamap.h>
+
+#define BUFSZ 4096
+
+typedef struct {
+	uint64_t  key;
+	char name[32];
+	char   inmap;
+} mydata_t;
+
+mydata_t buf[BUFSZ];
+
+void bufinit() {
+	for(int i=0;i<BUFSZ;i++) {
+		uint64_t k = 1000+i;
+		buf[i].key = k;
+		buf[i].inmap = 0;
+		sprintf(buf[i].name, "%lu", k);
+	}
+}
+
+uint64_t fnv(const char *key, size_t ksz, void *ignore) {
+	uint64_t h = 14695981039346656037UL;
+	for(size_t i=0; i<ksz; i++) {
+		h ^= (unsigned char)key[i]; h *= 1099511628211UL;
+	}
+	return h;
+}
+
+int checkall(ts_algo_oamap_t *map) {
+	uint32_t n = 0;
+	for(int i=0;i<BUFSZ;i++) {
+		mydata_t *d = ts_algo_oamap_getId(map, buf[i].key);
+		if (buf[i].inmap) {
+			if (d != buf+i) {
+				fprintf(stderr, "%lu not found\n", buf[i].key);
+				return -1;
+			}
+			n++;
+		} else if (d != NULL) {
+			fprintf(stderr, "found removed %lu\n", buf[i].key);
+			return -1;
+		}
+	}
+	if (n != map->count) {
+		fprintf(stderr, "wrong count: %u | %u\n", n, map->count);
+		return -1;
+	}
+	return 0;
+}
+
+int checkiter(ts_algo_oamap_t *map) {
+	uint32_t n = 0;
+	ts_algo_oamap_it_t *it = ts_algo_oamap_iterate(map);
+	if (it == NULL) return -1;
+	for(; !ts_algo_oamap_it_eof(it); ts_algo_oamap_it_advance(it)) {
+		ts_algo_map_slot_t *s = ts_algo_oamap_it_get(it);
+		if (s == NULL) {
+			fprintf(stderr, "NO SLOT\n");
+			free(it); return -1;
+		}
+		mydata_t *d = s->data;
+		if (!d->inmap || *(uint64_t*)s->key != d->key) {
+			fprintf(stderr, "wrong slot for %lu\n", d->key);
+			free(it); return -1;
+		}
+		n++;
+	}
+	free(it);
+	if (n != map->count) {
+		fprintf(stderr, "wrong iteration count: %u | %u\n", n, map->count);
+		return -1;
+	}
+	return 0;
+}
+
+int testRandom(uint32_t sz, ts_algo_hash_t hsh) {
+	int err = 0;
+	bufinit();
+	ts_algo_oamap_t *map = ts_algo_oamap_new(sz, hsh, NULL);
+	if (map == NULL) {
+		fprintf(stderr, "Can't create map\n");
+		return -1;
+	}
+	for(int r=0; r<8; r++) {
+		for(int i=0; i<BUFSZ; i++) {
+			int k = rand()%BUFSZ;
+			if (buf[k].inmap) {
+				if (rand()%2) {
+					if (ts_algo_oamap_removeId(map, buf[k].key) != buf+k) {
+						fprintf(stderr, "can't remove %d\n", k);
+						err = 1; goto cleanup;
+					}
+					buf[k].inmap = 0;
+				} else {
+					if (ts_algo_oamap_updateId(map, buf[k].key, buf+k) != buf+k) {
+						fprintf(stderr, "can't update %d\n", k);
+						err = 1; goto cleanup;
+					}
+				}
+			} else {
+				if (ts_algo_oamap_addId(map, buf[k].key, buf+k) != TS_ALGO_OK) {
+					fprintf(stderr, "can't add %d\n", k);
+					err = 1; goto cleanup;
+				}
+				buf[k].inmap = 1;
+			}
+		}
+		if (checkall(map) != 0 || checkiter(map) != 0) {
+			err = 1; goto cleanup;
+		}
+	}
+	{
+		ts_algo_list_t *l = ts_algo_oamap_toList(map);
+		if (l == NULL) {
+			fprintf(stderr, "can't get list from map\n");
+			err = 1; goto cleanup;
+		}
+		if (l->len != map->count) {
+			fprintf(stderr, "wrong list length: %u | %u\n", l->len, map->count);
+			err = 1;
+		}
+		ts_algo_list_destroy(l); free(l);
+	}
+cleanup:
+	ts_algo_oamap_destroy(map); free(map);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Keys of all sizes around TS_ALGO_OAMAP_INLINE, including the empty key
+ * ------------------------------------------------------------------------
+ */
+#define MAXKSZ (4*TS_ALGO_OAMAP_INLINE)
+
+int checksizes(ts_algo_oamap_t *map, char *keys, char *in) {
+	for(int i=0; i<=MAXKSZ; i++) {
+		void *d = ts_algo_oamap_get(map, keys, i);
+		if (in[i] && d != keys+i) {
+			fprintf(stderr, "key of size %d not found\n", i);
+			return -1;
+		}
+		if (!in[i] && d != NULL) {
+			fprintf(stderr, "found removed key of size %d\n", i);
+			return -1;
+		}
+	}
+	ts_algo_oamap_it_t *it = ts_algo_oamap_iterate(map);
+	if (it == NULL) return -1;
+	for(; !ts_algo_oamap_it_eof(it); ts_algo_oamap_it_advance(it)) {
+		ts_algo_map_slot_t *s = ts_algo_oamap_it_get(it);
+		if (s->data != keys+s->ksz || !in[s->ksz] ||
+		    (s->ksz > 0 && memcmp(s->key, keys, s->ksz) != 0)) {
+			fprintf(stderr, "wrong slot for key of size %zu\n", s->ksz);
+			free(it); return -1;
+		}
+	}
+	free(it);
+	return 0;
+}
+
+int testKeySizes() {
+	int err = 0;
+	char keys[MAXKSZ];
+	char in[MAXKSZ+1];
+
+	for(int i=0; i<MAXKSZ; i++) keys[i] = 'a'+i%26;
+	memset(in, 0, MAXKSZ+1);
+
+	// a small map that is resized while we add
+	ts_algo_oamap_t *map = ts_algo_oamap_new(8, NULL, NULL);
+	if (map == NULL) return -1;
+	for(int i=0; i<=MAXKSZ; i++) {
+		if (ts_algo_oamap_add(map, keys, i, keys+i) != TS_ALGO_OK) {
+			fprintf(stderr, "can't add key of size %d\n", i);
+			err = 1; goto cleanup;
+		}
+		in[i] = 1;
+	}
+	if (map->count != MAXKSZ+1 || checksizes(map, keys, in) != 0) {
+		err = 1; goto cleanup;
+	}
+	// removing shifts entries with inline keys
+	for(int i=0; i<=MAXKSZ; i+=3) {
+		if (ts_algo_oamap_remove(map, keys, i) != keys+i) {
+			fprintf(stderr, "can't remove key of size %d\n", i);
+			err = 1; goto cleanup;
+		}
+		in[i] = 0;
+	}
+	if (checksizes(map, keys, in) != 0) {
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_oamap_destroy(map); free(map);
+	return err?-1:0;
+}
+
+int main() {
+	srand(time(NULL));
+	for(int i=0;i<10;i++) {
+		if (testRandom(0, fnv) != 0) exit(1);
+		if (testRandom(8, fnv) != 0) exit(1);
+		if (testRandom(64, ts_algo_hash_id) != 0) exit(1);
+	}
+	if (testKeySizes() != 0) exit(1);
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
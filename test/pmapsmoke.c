@@ -0,0 +1,268 @@
+/* ========================================================================
+ * Test Perfect Hash Map
+ * ---------------------
+ * (c) Tobias Schoofs, 2021
+ * ========================================================================
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <tsalgo/pmap.h>
+#include <tsalgo/map.h>
+
+#define KEYSZ 32
+#define ELEMENTS 1000000
+
+typedef struct timespec timestamp_t;
+int timestamp(timestamp_t *tmstp) {
+	return clock_gettime(CLOCK_MONOTONIC, tmstp);
+}
+
+uint64_t timediff(timestamp_t *t1, timestamp_t *t2) {
+	return (t2->tv_sec - t1->tv_sec)*1000000000 +
+	       (t2->tv_nsec - t1->tv_nsec);
+}
+
+/* ------------------------------------------------------------------------
+ * Keys, sizes and data for n elements;
+ * keys are strings of different length without the terminating 0.
+ * ------------------------------------------------------------------------
+ */
+typedef struct {
+	char   **keys;
+	size_t   *ksz;
+	void   **data;
+	char     *buf;
+	uint32_t    n;
+} keyset_t;
+
+void freekeys(keyset_t *ks) {
+	free(ks->keys); free(ks->ksz); free(ks->data); free(ks->buf);
+}
+
+int mkkeys(keyset_t *ks, uint32_t n, uint32_t salt) {
+	ks->n = n;
+	ks->keys = malloc((n+1)*sizeof(char*));
+	ks->ksz  = malloc((n+1)*sizeof(size_t));
+	ks->data = malloc((n+1)*sizeof(void*));
+	ks->buf  = malloc((size_t)(n+1)*KEYSZ);
+	if (ks->keys == NULL || ks->ksz == NULL ||
+	    ks->data == NULL || ks->buf == NULL) {
+		freekeys(ks); return -1;
+	}
+	for(uint32_t i=0; i<n; i++) {
+		ks->keys[i] = ks->buf+(size_t)i*KEYSZ;
+		ks->ksz[i]  = sprintf(ks->keys[i], "k%u-%x", i, salt*(i%7+1));
+		ks->data[i] = ks->keys[i];
+	}
+	return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * All keys are found, keys not in the set are not found
+ * ------------------------------------------------------------------------
+ */
+int checkall(ts_algo_pmap_t *map, keyset_t *ks) {
+	char tmp[KEYSZ];
+	for(uint32_t i=0; i<ks->n; i++) {
+		if (ts_algo_pmap_get(map, ks->keys[i], ks->ksz[i]) != ks->data[i]) {
+			fprintf(stderr, "%.*s not found\n", (int)ks->ksz[i], ks->keys[i]);
+			return -1;
+		}
+		// prefixes and other keys are not in the map
+		if (ks->ksz[i] > 1 &&
+		    ts_algo_pmap_get(map, ks->keys[i], ks->ksz[i]-1) != NULL) {
+			fprintf(stderr, "found prefix of %.*s\n",
+			                (int)ks->ksz[i], ks->keys[i]);
+			return -1;
+		}
+		size_t s = sprintf(tmp, "x%u", i);
+		if (ts_algo_pmap_get(map, tmp, s) != NULL) {
+			fprintf(stderr, "found absent key %s\n", tmp);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+ts_algo_rc_t countslots(void *rsc, ts_algo_map_slot_t *s) {
+	if (s->data == NULL) return TS_ALGO_ERR;
+	(*(uint32_t*)rsc)++;
+	return TS_ALGO_OK;
+}
+
+int testArray(uint32_t n) {
+	int err = 0;
+	uint32_t k = 0;
+	keyset_t ks;
+	ts_algo_pmap_t *map;
+
+	if (mkkeys(&ks, n, rand()) != 0) return -1;
+	map = ts_algo_pmap_new(ks.keys, ks.ksz, ks.data, n);
+	if (map == NULL) {
+		fprintf(stderr, "can't build map of %u\n", n);
+		freekeys(&ks); return -1;
+	}
+	if (map->count != n) {
+		fprintf(stderr, "wrong count: %u | %u\n", map->count, n);
+		err = 1; goto cleanup;
+	}
+	if (checkall(map, &ks) != 0) {
+		err = 1; goto cleanup;
+	}
+	if (ts_algo_pmap_forEach(map, countslots, &k) != TS_ALGO_OK || k != n) {
+		fprintf(stderr, "forEach failed: %u | %u\n", k, n);
+		err = 1; goto cleanup;
+	}
+cleanup:
+	ts_algo_pmap_destroy(map); free(map);
+	freekeys(&ks);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * The layout is a bijection
+ * ------------------------------------------------------------------------
+ */
+int testLayout(uint32_t n) {
+	int err = 0;
+	uint32_t nbkt = n/TS_ALGO_PMAP_LAMBDA+1;
+	uint64_t *h   = calloc(n, sizeof(uint64_t));
+	uint32_t *pos = malloc(n*sizeof(uint32_t));
+	uint32_t *disp = malloc(nbkt*sizeof(uint32_t));
+	char     *seen = calloc(n, 1);
+
+	if (h == NULL || pos == NULL || disp == NULL || seen == NULL) {
+		err = 1; goto cleanup;
+	}
+	for(uint32_t i=0; i<n; i++) h[i] = ts_algo_hash_mix64(i, 42);
+	if (ts_algo_pmap_layout(h, n, nbkt, disp, pos) != TS_ALGO_OK) {
+		fprintf(stderr, "no layout for %u\n", n);
+		err = 1; goto cleanup;
+	}
+	for(uint32_t i=0; i<n; i++) {
+		uint32_t d = disp[ts_algo_pmap_bucket(h[i], nbkt)];
+		if (pos[i] >= n || seen[pos[i]] ||
+		    pos[i] != ts_algo_pmap_slot(h[i], d, n)) {
+			fprintf(stderr, "wrong position for %u: %u\n", i, pos[i]);
+			err = 1; goto cleanup;
+		}
+		seen[pos[i]] = 1;
+	}
+cleanup:
+	free(h); free(pos); free(disp); free(seen);
+	return err?-1:0;
+}
+
+/* ------------------------------------------------------------------------
+ * Duplicates are rejected, empty sets are accepted
+ * ------------------------------------------------------------------------
+ */
+int testDuplicates() {
+	keyset_t ks;
+	ts_algo_pmap_t map;
+
+	if (mkkeys(&ks, 1000, 7) != 0) return -1;
+	ks.keys[999] = ks.keys[500]; ks.ksz[999] = ks.ksz[500];
+	if (ts_algo_pmap_init(&map, ks.keys, ks.ksz, ks.data, 1000)
+	                                         != TS_ALGO_INVALID) {
+		fprintf(stderr, "duplicates not detected\n");
+		freekeys(&ks); return -1;
+	}
+	if (ts_algo_pmap_init(&map, ks.keys, ks.ksz, ks.data, 0) != TS_ALGO_OK) {
+		fprintf(stderr, "can't build empty map\n");
+		freekeys(&ks); return -1;
+	}
+	if (map.count != 0 ||
+	    ts_algo_pmap_get(&map, ks.keys[0], ks.ksz[0]) != NULL) {
+		fprintf(stderr, "empty map not empty\n");
+		ts_algo_pmap_destroy(&map); freekeys(&ks); return -1;
+	}
+	ts_algo_pmap_destroy(&map);
+	freekeys(&ks);
+	return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * Build from ts_algo_map_t and compare
+ * ------------------------------------------------------------------------
+ */
+int testFromMap() {
+	timestamp_t t1, t2, t3;
+	int err = 0;
+	uint64_t x = 0;
+	size_t   mem;
+	ts_algo_pmap_t *pmap = NULL;
+
+	ts_algo_map_t *map = ts_algo_map_newMode(0, ts_algo_hash_u64, NULL,
+	                                         TS_ALGO_MAP_SLAB);
+	if (map == NULL) return -1;
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		uint64_t key = k*7919;
+		if (ts_algo_map_addId(map, key, (void*)k) != TS_ALGO_OK) {
+			err = 1; goto cleanup;
+		}
+	}
+	timestamp(&t1);
+	pmap = ts_algo_pmap_newFromMap(map);
+	timestamp(&t2);
+	if (pmap == NULL) {
+		fprintf(stderr, "can't build map from map\n");
+		err = 1; goto cleanup;
+	}
+	mem = pmap->nbkt*sizeof(uint32_t) +
+	      pmap->count*(sizeof(ts_algo_map_slot_t)+sizeof(uint64_t));
+	fprintf(stderr, "pmap: built %u keys in %ldus, %zu bytes/key\n",
+	                pmap->count, timediff(&t1,&t2)/1000, mem/pmap->count);
+	if (pmap->count != map->count) {
+		fprintf(stderr, "wrong count: %u | %u\n", pmap->count, map->count);
+		err = 1; goto cleanup;
+	}
+	timestamp(&t1);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		uint64_t key = ((k*31)%ELEMENTS+1)*7919;
+		x += (uint64_t)ts_algo_pmap_getId(pmap, key);
+	}
+	timestamp(&t2);
+	for(uint64_t k=1; k<=ELEMENTS; k++) {
+		uint64_t key = ((k*31)%ELEMENTS+1)*7919;
+		x -= (uint64_t)ts_algo_map_getId(map, key);
+	}
+	timestamp(&t3);
+	fprintf(stderr, "pmap get: %ldus, map get: %ldus\n",
+	        timediff(&t1,&t2)/1000, timediff(&t2,&t3)/1000);
+	if (x != 0) {
+		fprintf(stderr, "pmap and map differ\n");
+		err = 1; goto cleanup;
+	}
+	for(uint64_t k=ELEMENTS+1; k<=ELEMENTS+1000; k++) {
+		uint64_t key = k*7919;
+		if (ts_algo_pmap_getId(pmap, key) != NULL) {
+			fprintf(stderr, "found absent key %lu\n", key);
+			err = 1; goto cleanup;
+		}
+	}
+cleanup:
+	if (pmap != NULL) {
+		ts_algo_pmap_destroy(pmap); free(pmap);
+	}
+	ts_algo_map_destroy(map); free(map);
+	return err?-1:0;
+}
+
+int main() {
+	srand(time(NULL));
+	for(uint32_t n=1; n<=100; n++) {
+		if (testLayout(n) != 0) exit(1);
+		if (testArray(n) != 0) exit(1);
+	}
+	if (testLayout(1000000) != 0) exit(1);
+	for(int i=0;i<5;i++) {
+		if (testArray(1000+rand()%100000) != 0) exit(1);
+	}
+	if (testDuplicates() != 0) exit(1);
+	if (testFromMap() != 0) exit(1);
+	fprintf(stderr, "SUCCESS!\n");
+	exit(0);
+}
@@ -6,6 +6,7 @@
 #include <math.h>
 
 #include <tsalgo/tree.h>
+#include <tsalgo/btree.h>
 #include <tsalgo/random.h>
 #include <progress.h>
 
@@ -70,12 +71,14 @@ int nodecompare(void *ignore,
 void showNode(node_t *n) {}
 
 /* node update */
-void onUpdate(void *ignore, node_t *on, node_t *nn) {
-	free(nn);
+ts_algo_rc_t onUpdate(void *ignore, node_t *on, node_t *nn) {
+	free(nn); return TS_ALGO_OK;
 }
 
 /* do nothing */
-void noUpdate(void *ignore, node_t *on, node_t *nn) {}
+ts_algo_rc_t noUpdate(void *ignore, node_t *on, node_t *nn) {
+	return TS_ALGO_OK;
+}
 
 /* node destroy destroys nodes */
 void onDestroy(void *ignore, node_t **node) {
@@ -291,6 +294,121 @@ char findtest2(int it) {
 	return 1;
 }
 
+/* search random keys with hits (nodes are not in the cache) */
+char findtest3(int it, char btree) {
+	int i,j;
+	timestamp_t t1,t2;
+	uint64_t d = 0;
+	ts_algo_tree_t  *tree = NULL;
+	ts_algo_btree_t *bt = NULL;
+	uint64_t    node;
+	progress_t p;
+
+	if (btree) {
+		bt = ts_algo_btree_new(
+		       (ts_algo_comprsc_t)&mycompare,
+	               (ts_algo_show_t)&showNode,
+	               (ts_algo_update_t)&noUpdate,
+	               (ts_algo_delete_t)&noDestroy,
+	               (ts_algo_delete_t)&noDestroy);
+		if (bt == NULL) return 0;
+	} else {
+		tree = ts_algo_tree_new(
+		       (ts_algo_comprsc_t)&mycompare,
+	               (ts_algo_show_t)&showNode,
+	               (ts_algo_update_t)&noUpdate,
+	               (ts_algo_delete_t)&noDestroy,
+	               (ts_algo_delete_t)&noDestroy);
+		if (tree == NULL) return 0;
+	}
+	for (i=0;i<ELEMENTS;i++) {
+		node = keys[i];
+		if (btree) {
+			if (ts_algo_btree_insert(bt,(void*)node) != TS_ALGO_OK)
+				return 0;
+		} else {
+			if (ts_algo_tree_insert(tree,(void*)node) != TS_ALGO_OK)
+				return 0;
+		}
+	}
+
+	init_progress(&p,stdout,it);
+	countcmps=0;
+	for (j=0;j<it;j++) {
+		if (timestamp(&t1)) {
+			printf("cannot timestamp\n");
+			return FALSE;
+		}
+		for (i=0;i<ELEMENTS;i++) {
+			if (btree) node = (uint64_t)ts_algo_btree_find(
+			                             bt,(void*)keys[i]);
+			else node = (uint64_t)ts_algo_tree_find(
+			                             tree,(void*)keys[i]);
+			if (node == 0) return FALSE;
+		}
+		if (timestamp(&t2)) {
+			printf("cannot timestamp\n");
+			return FALSE;
+		}
+		d += timediff(&t2,&t1);
+		update_progress(&p,j);
+	}
+	close_progress(&p);printf("\n");
+	d /= 1000*it;
+	printf("%d random searches (%s): %llu usecs\n", ELEMENTS,
+	      btree?"B+ tree":"AVL tree", (unsigned long long)d);
+	printf("average number of compares is %d\n", countcmps/(it*ELEMENTS));
+	if (btree) {
+		ts_algo_btree_destroy(bt); free(bt);
+	} else {
+		ts_algo_tree_destroy(tree); free(tree);
+	}
+	return 1;
+}
+
+/* destroy trees */
+char destroytest(int it) {
+	int i,j;
+	timestamp_t t1,t2;
+	uint64_t d = 0;
+	ts_algo_tree_t *tree;
+	uint64_t       node;
+	progress_t p;
+
+	init_progress(&p,stdout,it);
+	for (j=0;j<it;j++) {
+		tree = ts_algo_tree_new(
+		       (ts_algo_comprsc_t)&mycompare,
+	               (ts_algo_show_t)&showNode,
+	               (ts_algo_update_t)&noUpdate,
+	               (ts_algo_delete_t)&noDestroy,
+	               (ts_algo_delete_t)&noDestroy);
+		if (tree == NULL) return 0;
+		for (i=0;i<ELEMENTS;i++) {
+			node = i+1;
+			if (ts_algo_tree_insert(tree,(void*)node) != TS_ALGO_OK)
+				return 0;
+		}
+		if (timestamp(&t1)) {
+			printf("cannot timestamp\n");
+			return FALSE;
+		}
+		ts_algo_tree_destroy(tree);
+		if (timestamp(&t2)) {
+			printf("cannot timestamp\n");
+			return FALSE;
+		}
+		free(tree);
+		d += timediff(&t2,&t1);
+		update_progress(&p,j);
+	}
+	close_progress(&p);printf("\n");
+	d /= 1000*it;
+	printf("destroying %d nodes: %llu usecs\n", ELEMENTS,
+	      (unsigned long long)d);
+	return 1;
+}
+
 int main () {
 	int i;
 	int it=51;
@@ -317,4 +435,16 @@ int main () {
 		printf("find2 failed!\n");
 		return EXIT_FAILURE;
 	}
+	if (!findtest3(it, 0)) {
+		printf("find3 (AVL) failed!\n");
+		return EXIT_FAILURE;
+	}
+	if (!findtest3(it, 1)) {
+		printf("find3 (B+) failed!\n");
+		return EXIT_FAILURE;
+	}
+	if (!destroytest(it)) {
+		printf("destroy failed!\n");
+		return EXIT_FAILURE;
+	}
 }
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
 
 #include <tsalgo/tree.h>
@@ -366,8 +367,259 @@ void wirth() {
 
 }
 
+#define CURSORSZ 1000
+
+static int rangeCount = 0;
+static uint64_t rangeNext = 0;
+
+static ts_algo_rc_t countRange(void *ignore, mynode_t *n) {
+	if (n->k1 != rangeNext) return TS_ALGO_ERR;
+	rangeCount++; rangeNext += 2;
+	return TS_ALGO_OK;
+}
+
+/* keys are the even numbers 2..2*CURSORSZ */
+int cursortest() {
+	ts_algo_tree_t        *tree;
+	ts_algo_tree_cursor_t  cur;
+	mynode_t *n, k;
+	uint64_t i;
+	int rc = -1;
+
+	tree = ts_algo_tree_new(
+	          (ts_algo_comprsc_t)&compareNodes,
+	          (ts_algo_show_t)&showNode,
+	          (ts_algo_update_t)&onUpdate,
+	          (ts_algo_delete_t)&onDelete,
+	          (ts_algo_delete_t)&onDelete);
+	if (tree == NULL) return -1;
+
+	if (ts_algo_tree_first(tree, &cur) || !ts_algo_tree_cur_eof(&cur)) {
+		printf("cursor on empty tree\n");
+		goto cleanup;
+	}
+	for (i=1;i<=CURSORSZ;i++) {
+		n = mknode(2*i);
+		if (n == NULL) goto cleanup;
+		if (ts_algo_tree_insert(tree,n) != TS_ALGO_OK) {
+			printf("Cannot insert\n");
+			free(n); goto cleanup;
+		}
+	}
+
+	/* forward and backward */
+	i = 2;
+	for(ts_algo_tree_first(tree, &cur);
+	   !ts_algo_tree_cur_eof(&cur); ts_algo_tree_next(&cur)) {
+		n = ts_algo_tree_cur_get(&cur);
+		if (n->k1 != i) {
+			printf("next: %lu instead of %lu\n", n->k1, i);
+			goto cleanup;
+		}
+		i+=2;
+	}
+	if (i != 2*CURSORSZ+2) {
+		printf("next stopped at %lu\n", i);
+		goto cleanup;
+	}
+	i = 2*CURSORSZ;
+	for(ts_algo_tree_last(tree, &cur);
+	   !ts_algo_tree_cur_eof(&cur); ts_algo_tree_prev(&cur)) {
+		n = ts_algo_tree_cur_get(&cur);
+		if (n->k1 != i) {
+			printf("prev: %lu instead of %lu\n", n->k1, i);
+			goto cleanup;
+		}
+		i-=2;
+	}
+	if (i != 0) {
+		printf("prev stopped at %lu\n", i);
+		goto cleanup;
+	}
+
+	/* seek to all keys and between them */
+	memset(&k, 0, sizeof(mynode_t));
+	for (i=0;i<=2*CURSORSZ+1;i++) {
+		uint64_t lb = i%2==0?i:i+1;
+		uint64_t ub = i%2==0?i+2:i+1;
+		char haslb, hasub;
+
+		if (lb == 0) lb = 2;
+		k.k1 = i;
+
+		haslb = ts_algo_tree_lowerBound(tree, &cur, &k);
+		n = ts_algo_tree_cur_get(&cur);
+		if (lb > 2*CURSORSZ) {
+			if (haslb || n != NULL) {
+				printf("lower bound of %lu found\n", i);
+				goto cleanup;
+			}
+		} else if (!haslb || n == NULL || n->k1 != lb) {
+			printf("wrong lower bound of %lu\n", i);
+			goto cleanup;
+		}
+		/* step back from the lower bound */
+		if (haslb && lb > 2) {
+			ts_algo_tree_prev(&cur);
+			n = ts_algo_tree_cur_get(&cur);
+			if (n == NULL || n->k1 != lb-2) {
+				printf("wrong predecessor of %lu\n", lb);
+				goto cleanup;
+			}
+		}
+		hasub = ts_algo_tree_upperBound(tree, &cur, &k);
+		n = ts_algo_tree_cur_get(&cur);
+		if (ub > 2*CURSORSZ) {
+			if (hasub || n != NULL) {
+				printf("upper bound of %lu found\n", i);
+				goto cleanup;
+			}
+		} else if (!hasub || n == NULL || n->k1 != ub) {
+			printf("wrong upper bound of %lu\n", i);
+			goto cleanup;
+		}
+	}
+
+	/* range [100,300) */
+	mynode_t from, to;
+	memset(&from, 0, sizeof(mynode_t));
+	memset(&to, 0, sizeof(mynode_t));
+	from.k1 = 99; to.k1 = 300;
+	rangeCount = 0; rangeNext = 100;
+	if (ts_algo_tree_range(tree, &from, &to,
+	                      (ts_algo_mapper_t)&countRange) != TS_ALGO_OK ||
+	    rangeCount != 100)
+	{
+		printf("wrong range: %d\n", rangeCount);
+		goto cleanup;
+	}
+	/* unbounded */
+	rangeCount = 0; rangeNext = 2;
+	if (ts_algo_tree_range(tree, NULL, NULL,
+	                      (ts_algo_mapper_t)&countRange) != TS_ALGO_OK ||
+	    rangeCount != CURSORSZ)
+	{
+		printf("wrong unbounded range: %d\n", rangeCount);
+		goto cleanup;
+	}
+	printf("cursor test passed\n");
+	rc = 0;
+
+cleanup:
+	ts_algo_tree_destroy(tree); free(tree);
+	return rc;
+}
+
+/* checks every rank against the flags in 'in' (keys 1..CURSORSZ) */
+static int checkranks(ts_algo_tree_t *tree, char *in) {
+	ts_algo_tree_cursor_t cur;
+	mynode_t *n, k;
+	uint32_t r = 0;
+
+	memset(&k, 0, sizeof(mynode_t));
+	for (uint64_t i=1;i<=CURSORSZ;i++) {
+		k.k1 = i;
+		if (ts_algo_tree_rank(tree, &k) != r) {
+			printf("wrong rank of %lu: %u | %u\n", i,
+			        ts_algo_tree_rank(tree, &k), r);
+			return -1;
+		}
+		if (in[i]) {
+			n = ts_algo_tree_select(tree, r);
+			if (n == NULL || n->k1 != i) {
+				printf("wrong select of %u\n", r);
+				return -1;
+			}
+			r++;
+		}
+	}
+	if (r != tree->count || ts_algo_tree_select(tree, r) != NULL) {
+		printf("wrong count: %u | %u\n", r, tree->count);
+		return -1;
+	}
+	/* pages of 10 */
+	for (uint32_t p=0; p<r; p+=10) {
+		uint32_t j = p;
+		for(ts_algo_tree_seekRank(tree, &cur, p);
+		   !ts_algo_tree_cur_eof(&cur) && j<p+10; ts_algo_tree_next(&cur)) {
+			n = ts_algo_tree_cur_get(&cur);
+			if (ts_algo_tree_rank(tree, n) != j) {
+				printf("wrong page %u\n", p);
+				return -1;
+			}
+			j++;
+		}
+	}
+	return 0;
+}
+
+int ranktest() {
+	ts_algo_tree_t *tree;
+	mynode_t *n, from, to;
+	char in[CURSORSZ+1];
+	uint32_t c;
+	int rc = -1;
+
+	tree = ts_algo_tree_new(
+	          (ts_algo_comprsc_t)&compareNodes,
+	          (ts_algo_show_t)&showNode,
+	          (ts_algo_update_t)&onUpdate,
+	          (ts_algo_delete_t)&onDelete,
+	          (ts_algo_delete_t)&onDelete);
+	if (tree == NULL) return -1;
+
+	memset(in, 0, CURSORSZ+1);
+	for (int i=0;i<2*CURSORSZ;i++) {
+		uint64_t z = rand()%CURSORSZ+1;
+
+		/* enable ranks on a non-empty tree */
+		if (i == CURSORSZ/2) ts_algo_tree_enableRank(tree);
+
+		if (rand()%3 == 0) {
+			mynode_t k;
+			memset(&k, 0, sizeof(mynode_t));
+			k.k1 = z;
+			ts_algo_tree_delete(tree, &k);
+			in[z] = 0;
+		} else {
+			n = mknode(z);
+			if (n == NULL) goto cleanup;
+			if (ts_algo_tree_insert(tree,n) != TS_ALGO_OK) {
+				printf("Cannot insert\n");
+				free(n); goto cleanup;
+			}
+			in[z] = 1;
+		}
+		if (i%100 == 0 && i >= CURSORSZ/2) {
+			if (checkranks(tree, in) != 0) goto cleanup;
+		}
+	}
+	if (checkranks(tree, in) != 0) goto cleanup;
+
+	/* count [100,300) */
+	memset(&from, 0, sizeof(mynode_t));
+	memset(&to, 0, sizeof(mynode_t));
+	from.k1 = 100; to.k1 = 300; c = 0;
+	for(int i=100;i<300;i++) c+=in[i];
+	if (ts_algo_tree_countRange(tree, &from, &to) != c ||
+	    ts_algo_tree_countRange(tree, &to, &from) != 0 ||
+	    ts_algo_tree_countRange(tree, NULL, NULL) != tree->count)
+	{
+		printf("wrong range count\n");
+		goto cleanup;
+	}
+	printf("rank test passed\n");
+	rc = 0;
+
+cleanup:
+	ts_algo_tree_destroy(tree); free(tree);
+	return rc;
+}
+
 int main () {
 	simpletest(); 
 	wirth();
+	if (cursortest() != 0) return EXIT_FAILURE;
+	if (ranktest() != 0) return EXIT_FAILURE;
 	return EXIT_SUCCESS;
 }